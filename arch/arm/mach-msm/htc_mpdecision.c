@@ -0,0 +1,296 @@
+/* arch/arm/mach-msm/htc_mpdecision.c
+ *
+ * In-kernel core hotplug governor. Onlines and offlines cores from the
+ * run queue average kept by the scheduler, with the thresholds, windows
+ * and cpu bounds that pnpmgr exposes under hotplug/.
+ *
+ * With n cores online, one more core is brought up once the average
+ * number of runnable tasks has stayed at or above mp_nw[n - 1] for
+ * mp_tw[n - 1] ms, and one is taken down once it has stayed below
+ * mp_ns[n - 2] for mp_ts[n - 2] ms. mp_min_cpus/mp_max_cpus bound the
+ * number of online cores, and no core is taken down while a perflock
+ * is held.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt)	"mpdecision: " fmt
+
+#include <linux/cpu.h>
+#include <linux/cpumask.h>
+#include <linux/ctype.h>
+#include <linux/htc_mpdecision.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <mach/perflock.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/htc_mpdecision.h>
+
+#define MPD_STEPS		(CONFIG_NR_CPUS - 1)
+#define DEFAULT_DECISION_MS	20
+
+static void mpd_work_fn(struct work_struct *work);
+
+static DEFINE_MUTEX(mpd_lock);
+static DECLARE_DEFERRED_WORK(mpd_work, mpd_work_fn);
+
+static int mpd_enabled = 1;
+static unsigned int decision_ms = DEFAULT_DECISION_MS;
+static unsigned int min_cpus;
+static unsigned int max_cpus;
+
+/* nr_running averages are in hundredths, windows in ms */
+static unsigned int nw[MPD_STEPS];
+static unsigned int ns[MPD_STEPS];
+static unsigned int tw[MPD_STEPS];
+static unsigned int ts[MPD_STEPS];
+
+static const unsigned int default_nw[] = { 199, 270, 350 };
+static const unsigned int default_ns[] = { 110, 210, 310 };
+#define DEFAULT_TW	140
+#define DEFAULT_TS	190
+
+static ktime_t up_since;
+static ktime_t down_since;
+
+/*
+ * Parses up to @max values separated by blanks or commas. With @frac set
+ * the values may carry up to two decimals and are returned in hundredths,
+ * the way userspace writes the nr_running thresholds ("1.9 2.7 3.5").
+ */
+static int mpd_parse(const char *buf, unsigned int *vals, int max, bool frac)
+{
+	int n = 0;
+
+	while (*buf && n < max) {
+		unsigned int val = 0, scale = frac ? 100 : 1;
+
+		while (*buf == ' ' || *buf == ',' || *buf == '\t')
+			buf++;
+		if (!*buf || *buf == '\n')
+			break;
+		if (!isdigit(*buf))
+			return -EINVAL;
+
+		while (isdigit(*buf))
+			val = val * 10 + (*buf++ - '0');
+		val *= scale;
+		if (frac && *buf == '.') {
+			buf++;
+			while (isdigit(*buf)) {
+				scale /= 10;
+				val += (*buf++ - '0') * scale;
+			}
+		}
+		if (*buf && !isspace(*buf) && *buf != ',')
+			return -EINVAL;
+		vals[n++] = val;
+	}
+	return n;
+}
+
+static void mpd_bounds(unsigned int *lo, unsigned int *hi)
+{
+	unsigned int present = num_present_cpus();
+
+	*hi = max_cpus ? min(max_cpus, present) : present;
+	*lo = clamp(min_cpus, 1U, *hi);
+}
+
+static void __ref mpd_hotplug(bool up, int nr, ktime_t since, ktime_t now)
+{
+	unsigned int cpu, target = nr_cpu_ids;
+	ktime_t start;
+	int ret;
+
+	for_each_present_cpu(cpu) {
+		if (!cpu || cpu_online(cpu) == up)
+			continue;
+		target = cpu;
+		if (up)
+			break;
+	}
+	if (target >= nr_cpu_ids)
+		return;
+
+	start = ktime_get();
+	ret = up ? cpu_up(target) : cpu_down(target);
+	if (ret) {
+		pr_debug("cpu%u %s failed: %d\n", target, up ? "up" : "down",
+			 ret);
+		return;
+	}
+
+	trace_htc_mpdecision_hotplug(target, up, nr,
+				     ktime_us_delta(now, since),
+				     ktime_us_delta(ktime_get(), start));
+}
+
+static void mpd_decide(void)
+{
+	unsigned int online = num_online_cpus();
+	unsigned int lo, hi, step;
+	ktime_t now = ktime_get();
+	int nr, iowait;
+
+	sched_get_nr_running_avg(&nr, &iowait);
+	mpd_bounds(&lo, &hi);
+	if (is_perf_locked())
+		lo = max(lo, min(online, hi));
+
+	trace_htc_mpdecision_sample(nr, iowait, online, lo, hi);
+
+	if (online < lo || online > hi) {
+		up_since = down_since = ktime_set(0, 0);
+		mpd_hotplug(online < lo, nr, now, now);
+		return;
+	}
+
+	step = online - 1;
+	if (online < hi && step < MPD_STEPS && nr >= nw[step]) {
+		if (!up_since.tv64)
+			up_since = now;
+		if (ktime_us_delta(now, up_since) >= tw[step] * USEC_PER_MSEC) {
+			mpd_hotplug(true, nr, up_since, now);
+			up_since = down_since = ktime_set(0, 0);
+			return;
+		}
+	} else {
+		up_since = ktime_set(0, 0);
+	}
+
+	if (online > lo && step > 0 && step <= MPD_STEPS &&
+	    nr < ns[step - 1]) {
+		if (!down_since.tv64)
+			down_since = now;
+		if (ktime_us_delta(now, down_since) >=
+		    ts[step - 1] * USEC_PER_MSEC) {
+			mpd_hotplug(false, nr, down_since, now);
+			up_since = down_since = ktime_set(0, 0);
+		}
+	} else {
+		down_since = ktime_set(0, 0);
+	}
+}
+
+static void mpd_work_fn(struct work_struct *work)
+{
+	mutex_lock(&mpd_lock);
+	if (!mpd_enabled) {
+		mutex_unlock(&mpd_lock);
+		return;
+	}
+	mpd_decide();
+	mutex_unlock(&mpd_lock);
+
+	/*
+	 * cpu0 is never taken down, so the decisions always run there. The
+	 * timer is deferrable so that an idle system is not woken for them;
+	 * any load to act on keeps waking cpu0 anyway.
+	 */
+	queue_delayed_work_on(0, system_freezable_wq, &mpd_work,
+			      msecs_to_jiffies(decision_ms));
+}
+
+static void mpd_kick(void)
+{
+	cancel_delayed_work(&mpd_work);
+	queue_delayed_work_on(0, system_freezable_wq, &mpd_work, 0);
+}
+
+int mpdecision_set_thresholds(const char *nw_buf, const char *tw_buf,
+			      const char *ns_buf, const char *ts_buf)
+{
+	unsigned int new_nw[MPD_STEPS], new_ns[MPD_STEPS];
+	unsigned int new_tw[MPD_STEPS], new_ts[MPD_STEPS];
+	int n_nw, n_ns, n_tw, n_ts, i;
+
+	n_nw = mpd_parse(nw_buf, new_nw, MPD_STEPS, true);
+	n_ns = mpd_parse(ns_buf, new_ns, MPD_STEPS, true);
+	n_tw = mpd_parse(tw_buf, new_tw, MPD_STEPS, false);
+	n_ts = mpd_parse(ts_buf, new_ts, MPD_STEPS, false);
+	if (n_nw < 0 || n_ns < 0 || n_tw < 0 || n_ts < 0) {
+		pr_warn("malformed thresholds ignored\n");
+		return -EINVAL;
+	}
+
+	mutex_lock(&mpd_lock);
+	for (i = 0; i < n_nw; i++)
+		nw[i] = new_nw[i];
+	for (i = 0; i < n_ns; i++)
+		ns[i] = new_ns[i];
+	for (i = 0; i < n_tw; i++)
+		tw[i] = new_tw[i];
+	for (i = 0; i < n_ts; i++)
+		ts[i] = new_ts[i];
+	mutex_unlock(&mpd_lock);
+	return 0;
+}
+
+void mpdecision_set_decision_ms(int ms)
+{
+	if (ms <= 0)
+		return;
+	mutex_lock(&mpd_lock);
+	decision_ms = ms;
+	mutex_unlock(&mpd_lock);
+}
+
+void mpdecision_set_cpu_bounds(int min_nr, int max_nr)
+{
+	mutex_lock(&mpd_lock);
+	min_cpus = max(min_nr, 0);
+	max_cpus = max(max_nr, 0);
+	mutex_unlock(&mpd_lock);
+
+	if (mpd_enabled)
+		mpd_kick();
+}
+
+void mpdecision_set_enabled(int enabled)
+{
+	mutex_lock(&mpd_lock);
+	enabled = !!enabled;
+	if (enabled == mpd_enabled) {
+		mutex_unlock(&mpd_lock);
+		return;
+	}
+	mpd_enabled = enabled;
+	up_since = down_since = ktime_set(0, 0);
+	mutex_unlock(&mpd_lock);
+
+	if (enabled)
+		mpd_kick();
+	else
+		cancel_delayed_work_sync(&mpd_work);
+}
+
+static int __init htc_mpdecision_init(void)
+{
+	int i, last = ARRAY_SIZE(default_nw) - 1;
+
+	for (i = 0; i < MPD_STEPS; i++) {
+		nw[i] = default_nw[min(i, last)] + 100 * max(i - last, 0);
+		ns[i] = default_ns[min(i, last)] + 100 * max(i - last, 0);
+		tw[i] = DEFAULT_TW;
+		ts[i] = DEFAULT_TS;
+	}
+
+	if (mpd_enabled)
+		queue_delayed_work_on(0, system_freezable_wq, &mpd_work,
+				      msecs_to_jiffies(decision_ms));
+	return 0;
+}
+late_initcall(htc_mpdecision_init);
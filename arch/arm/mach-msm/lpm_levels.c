@@ -25,6 +25,10 @@
 #include <linux/suspend.h>
 #include <linux/pm_qos.h>
 #include <linux/of_platform.h>
+#include <linux/interrupt.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sched.h>
 #include <mach/mpm.h>
 #include <mach/cpuidle.h>
 #include <mach/event_timer.h>
@@ -34,6 +38,7 @@
 #include "idle.h"
 
 #define SCLK_HZ (32768)
+#define LPM_HIST_SAMPLES (5)
 
 enum {
 	MSM_LPM_LVL_DBG_SUSPEND_LIMITS = BIT(0),
@@ -83,6 +88,26 @@ struct lpm_system_state {
 static struct lpm_system_state sys_state;
 static bool suspend_in_progress;
 
+/*
+ * Recent idle residencies of a cpu and how well the levels picked for it
+ * worked out. limited_level is the deeper level the prediction ruled out
+ * on the current entry, or -1; histtimer then wakes the cpu up if the
+ * predicted wakeup does not come, so that it can go deeper.
+ */
+struct lpm_history {
+	uint32_t resi[LPM_HIST_SAMPLES];
+	int nsamp;
+	int hptr;
+	int limited_level;
+	struct hrtimer histtimer;
+	uint32_t entered[CPUIDLE_STATE_MAX];
+	uint32_t too_deep[CPUIDLE_STATE_MAX];
+	uint32_t too_shallow[CPUIDLE_STATE_MAX];
+	uint32_t htmr_wakeups;
+};
+
+static DEFINE_PER_CPU(struct lpm_history, lpm_history);
+
 struct lpm_lookup_table {
 	uint32_t modes;
 	const char *mode_name;
@@ -123,6 +148,53 @@ static int msm_pm_sleep_time_override;
 module_param_named(sleep_time_override,
 	msm_pm_sleep_time_override, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+static bool lpm_prediction = true;
+static bool lpm_prediction_ready;
+static bool lpm_irq_timings_on;
+static DEFINE_MUTEX(lpm_prediction_lock);
+
+/* irq timings cost every interrupt, so they are only kept while predicting */
+static void lpm_prediction_sync_timings(void)
+{
+	if (lpm_prediction == lpm_irq_timings_on)
+		return;
+	if (lpm_prediction)
+		irq_timings_enable();
+	else
+		irq_timings_disable();
+	lpm_irq_timings_on = lpm_prediction;
+}
+
+static int lpm_prediction_set(const char *val, const struct kernel_param *kp)
+{
+	int ret;
+
+	mutex_lock(&lpm_prediction_lock);
+	ret = param_set_bool(val, kp);
+	/* a boot parameter is applied before static keys can be changed */
+	if (!ret && lpm_prediction_ready)
+		lpm_prediction_sync_timings();
+	mutex_unlock(&lpm_prediction_lock);
+	return ret;
+}
+
+static struct kernel_param_ops lpm_prediction_ops = {
+	.set = lpm_prediction_set,
+	.get = param_get_bool,
+};
+module_param_cb(lpm_prediction, &lpm_prediction_ops, &lpm_prediction,
+	S_IRUGO | S_IWUSR | S_IWGRP);
+
+static uint32_t ref_stddev = 100;
+module_param_named(
+	ref_stddev, ref_stddev, uint, S_IRUGO | S_IWUSR | S_IWGRP
+);
+
+static uint32_t tmr_add = 100;
+module_param_named(
+	tmr_add, tmr_add, uint, S_IRUGO | S_IWUSR | S_IWGRP
+);
+
 static int num_powered_cores;
 static struct hrtimer lpm_hrtimer;
 
@@ -478,16 +550,102 @@ static void msm_pm_set_timer(uint32_t modified_time_us)
 	hrtimer_start(&lpm_hrtimer, modified_ktime, HRTIMER_MODE_REL_PINNED);
 }
 
+/*
+ * Typical residency from the history, as in the menu governor: the average
+ * of the recent samples if they agree well enough, retried once without
+ * the longest sample. 0 if there is no usable pattern.
+ */
+static uint32_t lpm_history_predict(struct lpm_history *h)
+{
+	uint32_t thresh = ~0U;
+	uint64_t avg, var;
+	int i, n, tries;
+
+	if (h->nsamp < LPM_HIST_SAMPLES)
+		return 0;
+
+	for (tries = 0; tries < 2; tries++) {
+		uint32_t longest = 0;
+
+		avg = 0;
+		n = 0;
+		for (i = 0; i < LPM_HIST_SAMPLES; i++) {
+			if (h->resi[i] > thresh)
+				continue;
+			avg += h->resi[i];
+			longest = max(longest, h->resi[i]);
+			n++;
+		}
+		do_div(avg, n);
+
+		var = 0;
+		for (i = 0; i < LPM_HIST_SAMPLES; i++) {
+			int64_t diff = (int64_t)h->resi[i] - (int64_t)avg;
+
+			if (h->resi[i] > thresh)
+				continue;
+			var += diff * diff;
+		}
+		do_div(var, n);
+
+		if (var <= (uint64_t)ref_stddev * ref_stddev ||
+				avg * avg > 36 * var)
+			return (uint32_t)avg;
+
+		thresh = longest - 1;
+	}
+	return 0;
+}
+
+static uint32_t lpm_cpu_predict(struct lpm_history *h)
+{
+	uint32_t pred_us = lpm_history_predict(h);
+	u64 now = local_clock();
+	u64 next_irq = irq_timings_next_event(now);
+
+	if (next_irq != ULLONG_MAX) {
+		u64 irq_us = next_irq > now ? next_irq - now : 0;
+
+		do_div(irq_us, NSEC_PER_USEC);
+		if (!pred_us || irq_us < pred_us)
+			pred_us = max_t(u64, irq_us, 1);
+	}
+	return pred_us;
+}
+
+static uint32_t lpm_level_power(struct power_params *pwr,
+		uint32_t next_wakeup_us)
+{
+	uint32_t power = pwr->ss_power;
+
+	if ((next_wakeup_us >> 10) > pwr->latency_us)
+		return power;
+
+	power -= (pwr->latency_us * pwr->ss_power) / next_wakeup_us;
+	power += pwr->energy_overhead / next_wakeup_us;
+	return power;
+}
+
+static enum hrtimer_restart lpm_histtimer_cb(struct hrtimer *h)
+{
+	return HRTIMER_NORESTART;
+}
+
 static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 {
 	int best_level = -1;
 	uint32_t best_level_pwr = ~0UL;
+	int pred_level = -1;
+	uint32_t pred_level_pwr = ~0UL;
 	uint32_t latency_us = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
 	uint32_t sleep_us =
 		(uint32_t)(ktime_to_us(tick_nohz_get_sleep_length()));
 	uint32_t modified_time_us = 0;
+	uint32_t pred_modified_time_us = 0;
 	uint32_t next_event_us = 0;
+	uint32_t pred_us = 0;
 	uint32_t power;
+	struct lpm_history *history = &per_cpu(lpm_history, dev->cpu);
 	int i;
 
 	if (!sys_state.cpu_level)
@@ -496,6 +654,9 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 	if (!dev->cpu)
 		next_event_us = (uint32_t)(ktime_to_us(get_next_event_time()));
 
+	if (lpm_prediction)
+		pred_us = lpm_cpu_predict(history);
+
 	for (i = 0; i < sys_state.num_cpu_levels; i++) {
 		struct lpm_cpu_level *level = &sys_state.cpu_level[i];
 		struct power_params *pwr = &level->pwr;
@@ -533,14 +694,7 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 			if (!dev->cpu && msm_rpm_waiting_for_ack())
 					break;
 
-		if ((next_wakeup_us >> 10) > pwr->latency_us) {
-			power = pwr->ss_power;
-		} else {
-			power = pwr->ss_power;
-			power -= (pwr->latency_us * pwr->ss_power)
-					/ next_wakeup_us;
-			power += pwr->energy_overhead / next_wakeup_us;
-		}
+		power = lpm_level_power(pwr, next_wakeup_us);
 
 		if (best_level_pwr >= power) {
 			best_level = i;
@@ -552,6 +706,27 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 			else
 				modified_time_us = 0;
 		}
+
+		if (!pred_us || (pred_us < next_wakeup_us &&
+				pred_us <= pwr->time_overhead_us))
+			continue;
+
+		power = lpm_level_power(pwr, min(pred_us, next_wakeup_us));
+		if (pred_level_pwr >= power) {
+			pred_level = i;
+			pred_level_pwr = power;
+			pred_modified_time_us = modified_time_us;
+		}
+	}
+
+	history->limited_level = -1;
+	if (pred_level >= 0 && pred_level < best_level) {
+		history->limited_level = best_level;
+		best_level = pred_level;
+		modified_time_us = pred_modified_time_us;
+		hrtimer_start(&history->histtimer,
+			ns_to_ktime((u64)(pred_us + tmr_add) * NSEC_PER_USEC),
+			HRTIMER_MODE_REL_PINNED);
 	}
 
 	if (modified_time_us && !dev->cpu)
@@ -560,6 +735,39 @@ static noinline int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 	return best_level;
 }
 
+static void lpm_cpu_update_history(struct cpuidle_device *dev, int idx,
+		uint32_t resi_us)
+{
+	struct lpm_history *h = &per_cpu(lpm_history, dev->cpu);
+	struct lpm_cpu_level *level = &sys_state.cpu_level[idx];
+	bool htmr_wkup = false;
+
+	if (h->limited_level >= 0) {
+		htmr_wkup = hrtimer_get_remaining(&h->histtimer).tv64 <= 0;
+		hrtimer_try_to_cancel(&h->histtimer);
+	}
+
+	h->entered[idx]++;
+	if (idx && resi_us < level->pwr.time_overhead_us)
+		h->too_deep[idx]++;
+	if (h->limited_level >= 0 && (htmr_wkup || resi_us >=
+		sys_state.cpu_level[h->limited_level].pwr.time_overhead_us))
+		h->too_shallow[idx]++;
+	h->limited_level = -1;
+
+	if (htmr_wkup) {
+		h->htmr_wakeups++;
+		h->nsamp = 0;
+		h->hptr = 0;
+		return;
+	}
+
+	h->resi[h->hptr] = resi_us;
+	h->hptr = (h->hptr + 1) % LPM_HIST_SAMPLES;
+	if (h->nsamp < LPM_HIST_SAMPLES)
+		h->nsamp++;
+}
+
 static int lpm_get_l2_cache_value(const char *l2_str)
 {
 	int i;
@@ -611,6 +819,77 @@ resource_sysfs_add_exit:
 
 	return rc;
 }
+static int lpm_prediction_show(struct seq_file *m, void *v)
+{
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_history *h = &per_cpu(lpm_history, cpu);
+
+		seq_printf(m, "cpu%d: histtimer wakeups %u\n", cpu,
+				h->htmr_wakeups);
+		for (i = 0; i < sys_state.num_cpu_levels; i++)
+			seq_printf(m,
+				"  %-16s entered %u too_deep %u too_shallow %u\n",
+				sys_state.cpu_level[i].name, h->entered[i],
+				h->too_deep[i], h->too_shallow[i]);
+	}
+	return 0;
+}
+
+static int lpm_prediction_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_prediction_show, NULL);
+}
+
+static ssize_t lpm_prediction_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_history *h = &per_cpu(lpm_history, cpu);
+
+		memset(h->entered, 0, sizeof(h->entered));
+		memset(h->too_deep, 0, sizeof(h->too_deep));
+		memset(h->too_shallow, 0, sizeof(h->too_shallow));
+		h->htmr_wakeups = 0;
+	}
+	return count;
+}
+
+static const struct file_operations lpm_prediction_fops = {
+	.open		= lpm_prediction_open,
+	.read		= seq_read,
+	.write		= lpm_prediction_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void lpm_prediction_init(void)
+{
+	struct dentry *dir;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct lpm_history *h = &per_cpu(lpm_history, cpu);
+
+		h->limited_level = -1;
+		hrtimer_init(&h->histtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		h->histtimer.function = lpm_histtimer_cb;
+	}
+	mutex_lock(&lpm_prediction_lock);
+	lpm_prediction_ready = true;
+	lpm_prediction_sync_timings();
+	mutex_unlock(&lpm_prediction_lock);
+
+	dir = debugfs_create_dir("lpm_levels", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+	debugfs_create_file("prediction", S_IRUGO | S_IWUSR, dir, NULL,
+			&lpm_prediction_fops);
+}
+
 static int lpm_cpu_menu_select(struct cpuidle_device *dev, int *index)
 {
 	int j;
@@ -739,6 +1018,7 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 	time = ktime_to_ns(ktime_get()) - time;
 	do_div(time, 1000);
 	dev->last_residency = (int)time;
+	lpm_cpu_update_history(dev, idx, (uint32_t)time);
 	local_irq_enable();
 	return index;
 }
@@ -1067,6 +1347,7 @@ static int lpm_probe(struct platform_device *pdev)
 	platform_device_register(&lpm_dev);
 	suspend_set_ops(&lpm_suspend_ops);
 	hrtimer_init(&lpm_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	lpm_prediction_init();
 	lpm_cpuidle_init();
 	return 0;
 fail:
@@ -25,6 +25,8 @@
 #include <linux/compiler.h>
 #include <linux/blktrace_api.h>
 #include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include "blk-cgroup.h"
 
 enum row_queue_prio {
 	ROWQ_PRIO_HIGH_READ = 0,
@@ -53,10 +55,21 @@ static const struct row_queue_params row_queues_def[] = {
 	{true, 100, true},	
 	{false, 1, false},	
 	{false, 1, false},	
-	{false, 1, false},	
+	{true, 1, false},	
 	{false, 1, false}	
 };
 
+static const char * const row_queue_names[] = {
+	"hp_read", "hp_swrite", "rp_read", "rp_swrite",
+	"rp_write", "lp_read", "lp_swrite",
+};
+
+/*
+ * blkio cgroups with a weight at or below this are background groups:
+ * their sync requests go to the low priority queues.
+ */
+#define ROW_BG_MAX_WEIGHT	100
+
 #define ROW_IDLE_TIME_MSEC 5
 #define ROW_READ_FREQ_MSEC 5
 
@@ -65,6 +78,16 @@ struct rowq_idling_data {
 	bool			begin_idling;
 };
 
+/* times are in usec, from insertion to dispatch (wait) or completion */
+struct rowq_stats {
+	unsigned long		nr_dispatched;
+	u64			wait_us;
+	unsigned long		max_wait_us;
+	unsigned long		nr_completed;
+	u64			lat_us;
+	unsigned long		max_lat_us;
+};
+
 struct row_queue {
 	struct row_data		*rdata;
 	struct list_head	fifo;
@@ -75,8 +98,10 @@ struct row_queue {
 	unsigned int		nr_req;
 	int			disp_quantum;
 
-	
+	int			idling_enabled;
 	struct rowq_idling_data	idle_data;
+
+	struct rowq_stats	stats;
 };
 
 struct idling_data {
@@ -110,9 +135,18 @@ struct row_data {
 	struct starvation_data		low_prio_starvation;
 
 	unsigned int			cycle_flags;
+
+	int				bg_max_weight;
+	unsigned long			nr_bg_reqs;
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
+#define RQ_INSERT_US(rq) ((unsigned long) ((rq)->elv.priv[1]))
+
+static inline unsigned long row_now_us(void)
+{
+	return (unsigned long)ktime_to_us(ktime_get());
+}
 
 #define row_log(q, fmt, args...)   \
 	blk_add_trace_msg(q, "%s():" fmt , __func__, ##args)
@@ -220,6 +254,7 @@ static void row_add_request(struct request_queue *q,
 	rd->nr_reqs[rq_data_dir(rq)]++;
 	rqueue->nr_req++;
 	rq_set_fifo_time(rq, jiffies); 
+	rq->elv.priv[1] = (void *)row_now_us();
 
 	if (rq->cmd_flags & REQ_URGENT) {
 		WARN_ON(1);
@@ -227,7 +262,20 @@ static void row_add_request(struct request_queue *q,
 		rq->cmd_flags &= ~REQ_URGENT;
 	}
 
-	if (row_queues_def[rqueue->prio].idling_enabled) {
+	/* background idling must not hold back anything else */
+	if (rd->rd_idle_data.idling_queue_idx >= ROWQ_LOW_PRIO_IDX &&
+	    rd->rd_idle_data.idling_queue_idx < ROWQ_MAX_PRIO &&
+	    rqueue->prio < ROWQ_LOW_PRIO_IDX &&
+	    hrtimer_try_to_cancel(&rd->rd_idle_data.hr_timer) >= 0) {
+		row_log_rowq(rd, rqueue->prio,
+			"Canceled low prio idling on %d",
+			rd->rd_idle_data.idling_queue_idx);
+		rd->row_queues[rd->rd_idle_data.idling_queue_idx].
+			idle_data.begin_idling = false;
+		rd->rd_idle_data.idling_queue_idx = ROWQ_MAX_PRIO;
+	}
+
+	if (rqueue->idling_enabled) {
 		if (rd->rd_idle_data.idling_queue_idx == rqueue->prio &&
 		    hrtimer_active(&rd->rd_idle_data.hr_timer)) {
 			if (hrtimer_try_to_cancel(
@@ -323,6 +371,17 @@ static int row_reinsert_req(struct request_queue *q,
 static void row_completed_req(struct request_queue *q, struct request *rq)
 {
 	struct row_data *rd = q->elevator->elevator_data;
+	struct row_queue *rqueue = RQ_ROWQ(rq);
+
+	if (rqueue) {
+		struct rowq_stats *stats = &rqueue->stats;
+		unsigned long lat = row_now_us() - RQ_INSERT_US(rq);
+
+		stats->nr_completed++;
+		stats->lat_us += lat;
+		if (lat > stats->max_lat_us)
+			stats->max_lat_us = lat;
+	}
 
 	 if (rq->cmd_flags & REQ_URGENT) {
 		if (!rd->urgent_in_flight) {
@@ -374,6 +433,7 @@ static void row_remove_request(struct row_data *rd,
 static void row_dispatch_insert(struct row_data *rd, struct request *rq)
 {
 	struct row_queue *rqueue = RQ_ROWQ(rq);
+	unsigned long wait;
 
 	row_remove_request(rd, rq);
 	elv_dispatch_sort(rd->dispatch_queue, rq);
@@ -382,6 +442,11 @@ static void row_dispatch_insert(struct row_data *rd, struct request *rq)
 		rd->urgent_in_flight = true;
 	}
 	rqueue->nr_dispatched++;
+	wait = row_now_us() - RQ_INSERT_US(rq);
+	rqueue->stats.nr_dispatched++;
+	rqueue->stats.wait_us += wait;
+	if (wait > rqueue->stats.max_wait_us)
+		rqueue->stats.max_wait_us = wait;
 	row_clear_rowq_unserved(rd, rqueue->prio);
 	row_log_rowq(rd, rqueue->prio,
 		" Dispatched request %p nr_disp = %d", rq,
@@ -450,7 +515,7 @@ check_idling:
 	
 	for (i = 0; i < ROWQ_REG_PRIO_IDX && !force; i++) {
 		if (rd->row_queues[i].idle_data.begin_idling &&
-		    row_queues_def[i].idling_enabled)
+		    rd->row_queues[i].idling_enabled)
 			goto initiate_idling;
 	}
 
@@ -459,7 +524,7 @@ check_idling:
 		if (list_empty(&rd->row_queues[i].fifo)) {
 			
 			if (rd->row_queues[i].idle_data.begin_idling &&
-			    !force && row_queues_def[i].idling_enabled)
+			    !force && rd->row_queues[i].idling_enabled)
 				goto initiate_idling;
 		} else {
 			if (row_low_req_pending(rd) &&
@@ -472,8 +537,16 @@ check_idling:
 		}
 	}
 
-	if (rd->nr_reqs[READ] || rd->nr_reqs[WRITE])
-		ret = IOPRIO_CLASS_IDLE;
+	/* only background requests left, if any */
+	for (i = ROWQ_LOW_PRIO_IDX; i < ROWQ_MAX_PRIO; i++) {
+		if (!list_empty(&rd->row_queues[i].fifo)) {
+			ret = IOPRIO_CLASS_IDLE;
+			goto done;
+		}
+		if (rd->row_queues[i].idle_data.begin_idling &&
+		    !force && rd->row_queues[i].idling_enabled)
+			goto initiate_idling;
+	}
 	goto done;
 
 initiate_idling:
@@ -604,6 +677,8 @@ static void *row_init_queue(struct request_queue *q)
 	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
 		INIT_LIST_HEAD(&rdata->row_queues[i].fifo);
 		rdata->row_queues[i].disp_quantum = row_queues_def[i].quantum;
+		rdata->row_queues[i].idling_enabled =
+			row_queues_def[i].idling_enabled;
 		rdata->row_queues[i].rdata = rdata;
 		rdata->row_queues[i].prio = i;
 		rdata->row_queues[i].idle_data.begin_idling = false;
@@ -617,6 +692,7 @@ static void *row_init_queue(struct request_queue *q)
 			ROW_LOW_STARVATION_TOLLERANCE;
 	rdata->rd_idle_data.idle_time_ms = ROW_IDLE_TIME_MSEC;
 	rdata->rd_idle_data.freq_ms = ROW_READ_FREQ_MSEC;
+	rdata->bg_max_weight = ROW_BG_MAX_WEIGHT;
 	hrtimer_init(&rdata->rd_idle_data.hr_timer,
 		CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	rdata->rd_idle_data.hr_timer.function = &row_idle_hrtimer_fn;
@@ -659,6 +735,33 @@ static void row_merged_requests(struct request_queue *q, struct request *rq,
 	rqueue->rdata->nr_reqs[rq_data_dir(rq)]--;
 }
 
+#ifdef CONFIG_BLK_CGROUP
+/*
+ * Requests are set up in the context of the task issuing them, so the
+ * blkio cgroup of current tells foreground from background apps.
+ */
+static bool row_is_bg_task(struct row_data *rd)
+{
+	struct blkio_cgroup *blkcg;
+	bool bg;
+
+	if (!rd->bg_max_weight)
+		return false;
+
+	rcu_read_lock();
+	blkcg = task_blkio_cgroup(current);
+	bg = blkcg != &blkio_root_cgroup &&
+		blkcg->weight <= rd->bg_max_weight;
+	rcu_read_unlock();
+	return bg;
+}
+#else
+static inline bool row_is_bg_task(struct row_data *rd)
+{
+	return false;
+}
+#endif
+
 static enum row_queue_prio row_get_queue_prio(struct request *rq,
 				struct row_data *rd)
 {
@@ -693,6 +796,15 @@ static enum row_queue_prio row_get_queue_prio(struct request *rq,
 	case IOPRIO_CLASS_NONE:
 	case IOPRIO_CLASS_BE:
 	default:
+		/* async writes come from the flusher, not from the group */
+		if ((data_dir == READ || is_sync) && row_is_bg_task(rd)) {
+			rd->nr_bg_reqs++;
+			if (data_dir == READ)
+				q_type = ROWQ_PRIO_LOW_READ;
+			else
+				q_type = ROWQ_PRIO_LOW_SWRITE;
+			break;
+		}
 		if (data_dir == READ)
 			q_type = ROWQ_PRIO_REG_READ;
 		else if (is_sync)
@@ -759,6 +871,9 @@ SHOW_FUNCTION(row_reg_starv_limit_show,
 	rowd->reg_prio_starvation.starvation_limit);
 SHOW_FUNCTION(row_low_starv_limit_show,
 	rowd->low_prio_starvation.starvation_limit);
+SHOW_FUNCTION(row_lp_read_idling_show,
+	rowd->row_queues[ROWQ_PRIO_LOW_READ].idling_enabled);
+SHOW_FUNCTION(row_bg_max_weight_show, rowd->bg_max_weight);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -805,9 +920,59 @@ STORE_FUNCTION(row_reg_starv_limit_store,
 STORE_FUNCTION(row_low_starv_limit_store,
 			&rowd->low_prio_starvation.starvation_limit,
 			1, INT_MAX);
+STORE_FUNCTION(row_lp_read_idling_store,
+			&rowd->row_queues[ROWQ_PRIO_LOW_READ].idling_enabled,
+			0, 1);
+STORE_FUNCTION(row_bg_max_weight_store, &rowd->bg_max_weight,
+			0, INT_MAX);
 
 #undef STORE_FUNCTION
 
+static ssize_t row_stats_show(struct elevator_queue *e, char *page)
+{
+	struct row_data *rowd = e->elevator_data;
+	ssize_t len = 0;
+	int i;
+
+	len += scnprintf(page + len, PAGE_SIZE - len,
+		"queue      dispatched wait_avg_us wait_max_us completed "
+		"lat_avg_us lat_max_us\n");
+	for (i = 0; i < ROWQ_MAX_PRIO; i++) {
+		struct rowq_stats *stats = &rowd->row_queues[i].stats;
+
+		len += scnprintf(page + len, PAGE_SIZE - len,
+			"%-10s %10lu %11llu %11lu %9lu %10llu %10lu\n",
+			row_queue_names[i], stats->nr_dispatched,
+			stats->nr_dispatched ? div64_u64(stats->wait_us,
+					stats->nr_dispatched) : 0ULL,
+			stats->max_wait_us, stats->nr_completed,
+			stats->nr_completed ? div64_u64(stats->lat_us,
+					stats->nr_completed) : 0ULL,
+			stats->max_lat_us);
+	}
+	len += scnprintf(page + len, PAGE_SIZE - len,
+		"background requests: %lu\n", rowd->nr_bg_reqs);
+	return len;
+}
+
+/* any write resets the statistics */
+static ssize_t row_stats_store(struct elevator_queue *e, const char *page,
+			       size_t count)
+{
+	struct row_data *rowd = e->elevator_data;
+	struct request_queue *q = rowd->dispatch_queue;
+	int i;
+
+	spin_lock_irq(q->queue_lock);
+	for (i = 0; i < ROWQ_MAX_PRIO; i++)
+		memset(&rowd->row_queues[i].stats, 0,
+		       sizeof(rowd->row_queues[i].stats));
+	rowd->nr_bg_reqs = 0;
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+
 #define ROW_ATTR(name) \
 	__ATTR(name, S_IRUGO|S_IWUSR, row_##name##_show, \
 				      row_##name##_store)
@@ -824,6 +989,9 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(rd_idle_data_freq),
 	ROW_ATTR(reg_starv_limit),
 	ROW_ATTR(low_starv_limit),
+	ROW_ATTR(lp_read_idling),
+	ROW_ATTR(bg_max_weight),
+	ROW_ATTR(stats),
 	__ATTR_NULL
 };
 
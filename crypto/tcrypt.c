@@ -33,6 +33,8 @@
 #include <linux/jiffies.h>
 #include <linux/timex.h>
 #include <linux/interrupt.h>
+#include <linux/random.h>
+#include <linux/slab.h>
 #include "tcrypt.h"
 #include "internal.h"
 
@@ -55,7 +57,7 @@ static char *check[] = {
 	"cast6", "arc4", "michael_mic", "deflate", "crc32c", "tea", "xtea",
 	"khazad", "wp512", "wp384", "wp256", "tnepres", "xeta",  "fcrypt",
 	"camellia", "seed", "salsa20", "rmd128", "rmd160", "rmd256", "rmd320",
-	"lzo", "cts", "zlib", NULL
+	"lzo", "cts", "zlib", "lz4", NULL
 };
 
 static int test_cipher_jiffies(struct blkcipher_desc *desc, int enc,
@@ -911,6 +913,170 @@ out:
 	crypto_free_ablkcipher(tfm);
 }
 
+/* percentage of random bytes in each page, the rest is a repeated text */
+static u8 comp_speed_template[] = { 0, 10, 25, 50, 75, 100, 0xff };
+
+static const char comp_speed_text[] =
+	"The quick brown fox jumps over the lazy dog. ";
+
+static int test_comp_jiffies(struct crypto_comp *tfm, int comp,
+			     const u8 *src, unsigned int slen, u8 *dst,
+			     unsigned int dlen, int sec)
+{
+	unsigned long start, end;
+	unsigned int len;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + sec * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		len = dlen;
+		if (comp)
+			ret = crypto_comp_compress(tfm, src, slen, dst, &len);
+		else
+			ret = crypto_comp_decompress(tfm, src, slen, dst, &len);
+
+		if (ret)
+			return ret;
+	}
+
+	printk("%d operations in %d seconds (%ld bytes)\n",
+	       bcount, sec, (long)bcount * (comp ? slen : dlen));
+	return 0;
+}
+
+static int test_comp_cycles(struct crypto_comp *tfm, int comp,
+			    const u8 *src, unsigned int slen, u8 *dst,
+			    unsigned int dlen)
+{
+	unsigned long cycles = 0;
+	unsigned int len;
+	int ret = 0;
+	int i;
+
+	local_bh_disable();
+	local_irq_disable();
+
+	
+	for (i = 0; i < 4; i++) {
+		len = dlen;
+		if (comp)
+			ret = crypto_comp_compress(tfm, src, slen, dst, &len);
+		else
+			ret = crypto_comp_decompress(tfm, src, slen, dst, &len);
+
+		if (ret)
+			goto out;
+	}
+
+	
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		len = dlen;
+		start = get_cycles();
+		if (comp)
+			ret = crypto_comp_compress(tfm, src, slen, dst, &len);
+		else
+			ret = crypto_comp_decompress(tfm, src, slen, dst, &len);
+		end = get_cycles();
+
+		if (ret)
+			goto out;
+
+		cycles += end - start;
+	}
+
+out:
+	local_irq_enable();
+	local_bh_enable();
+
+	if (ret == 0)
+		printk("1 operation in %lu cycles (%lu bytes)\n",
+		       (cycles + 4) / 8, PAGE_SIZE);
+
+	return ret;
+}
+
+static void test_comp_speed(const char *algo, unsigned int sec)
+{
+	struct crypto_comp *tfm;
+	unsigned int i, j, clen, dlen;
+	u8 *src = tvmem[0], *out = tvmem[1], *cbuf;
+	u8 *pct;
+	int ret;
+
+	printk("\ntesting speed of %s\n", algo);
+
+	tfm = crypto_alloc_comp(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		printk("failed to load transform for %s: %ld\n", algo,
+		       PTR_ERR(tfm));
+		return;
+	}
+
+	cbuf = kmalloc(2 * PAGE_SIZE, GFP_KERNEL);
+	if (!cbuf)
+		goto out;
+
+	for (i = 0, pct = comp_speed_template; *pct != 0xff; pct++, i++) {
+		for (j = 0; j < PAGE_SIZE; j++) {
+			if (random32() % 100 < *pct)
+				src[j] = random32();
+			else
+				src[j] = comp_speed_text[j %
+					(sizeof(comp_speed_text) - 1)];
+		}
+
+		clen = 2 * PAGE_SIZE;
+		ret = crypto_comp_compress(tfm, src, PAGE_SIZE, cbuf, &clen);
+		if (ret) {
+			printk("compress failed: %d\n", ret);
+			break;
+		}
+
+		dlen = PAGE_SIZE;
+		ret = crypto_comp_decompress(tfm, cbuf, clen, out, &dlen);
+		if (ret || dlen != PAGE_SIZE || memcmp(src, out, PAGE_SIZE)) {
+			printk("decompress mismatch: %d\n", ret);
+			break;
+		}
+
+		printk("test %u (%u%% random bytes): %lu -> %u bytes "
+		       "(ratio %u.%02u)\n", i, *pct, PAGE_SIZE, clen,
+		       (unsigned int)(PAGE_SIZE / clen),
+		       (unsigned int)(PAGE_SIZE * 100 / clen % 100));
+
+		printk("compress: ");
+		if (sec)
+			ret = test_comp_jiffies(tfm, 1, src, PAGE_SIZE, cbuf,
+						2 * PAGE_SIZE, sec);
+		else
+			ret = test_comp_cycles(tfm, 1, src, PAGE_SIZE, cbuf,
+					       2 * PAGE_SIZE);
+		if (ret) {
+			printk("compress failed: %d\n", ret);
+			break;
+		}
+
+		printk("decompress: ");
+		if (sec)
+			ret = test_comp_jiffies(tfm, 0, cbuf, clen, out,
+						PAGE_SIZE, sec);
+		else
+			ret = test_comp_cycles(tfm, 0, cbuf, clen, out,
+					       PAGE_SIZE);
+		if (ret) {
+			printk("decompress failed: %d\n", ret);
+			break;
+		}
+	}
+
+	kfree(cbuf);
+out:
+	crypto_free_comp(tfm);
+}
+
 static void test_available(void)
 {
 	char **name = check;
@@ -1144,6 +1310,10 @@ static int do_test(int m)
 		ret += tcrypt_test("rfc4309(ccm(aes))");
 		break;
 
+	case 46:
+		ret += tcrypt_test("lz4");
+		break;
+
 	case 100:
 		ret += tcrypt_test("hmac(md5)");
 		break;
@@ -1554,6 +1724,11 @@ static int do_test(int m)
 				   speed_template_32_64);
 		break;
 
+	case 600:
+		test_comp_speed("lzo", sec);
+		test_comp_speed("lz4", sec);
+		break;
+
 	case 1000:
 		test_available();
 		break;
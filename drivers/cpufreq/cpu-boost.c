@@ -25,6 +25,9 @@
 #include <linux/input.h>
 #include <linux/time.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpu_boost.h>
+
 struct cpu_sync {
 	struct task_struct *thread;
 	wait_queue_head_t sync_wq;
@@ -55,9 +58,19 @@ module_param(input_boost_freq, uint, 0644);
 static unsigned int input_boost_ms = 40;
 module_param(input_boost_ms, uint, 0644);
 
+static bool frame_boost = true;
+module_param(frame_boost, bool, 0644);
+
+static unsigned int input_boost_max_ms = 1000;
+module_param(input_boost_max_ms, uint, 0644);
+
 static u64 last_input_time;
 #define MIN_INPUT_INTERVAL (150 * USEC_PER_MSEC)
 
+static struct work_struct frame_boost_work;
+static DEFINE_SPINLOCK(frame_lock);
+static unsigned long frame_event;
+
 static int boost_adjust_notify(struct notifier_block *nb, unsigned long val, void *data)
 {
 	struct cpufreq_policy *policy = data;
@@ -109,6 +122,7 @@ static void do_input_boost_rem(struct work_struct *work)
 
 	pr_debug("Removing input boost for CPU%d\n", s->cpu);
 	s->input_boost_min = 0;
+	trace_cpu_boost_input(s->cpu, 0, "timeout");
 	
 	cpufreq_update_policy(s->cpu);
 }
@@ -208,6 +222,7 @@ static void do_input_boost(struct work_struct *work)
 
 		cancel_delayed_work_sync(&i_sync_info->input_boost_rem);
 		i_sync_info->input_boost_min = input_boost_freq;
+		trace_cpu_boost_input(i, input_boost_freq, "input");
 		cpufreq_update_policy(i);
 		queue_delayed_work_on(i_sync_info->cpu, cpu_boost_wq,
 			&i_sync_info->input_boost_rem,
@@ -215,6 +230,87 @@ static void do_input_boost(struct work_struct *work)
 	}
 }
 
+/*
+ * A late frame pushes the end of an active input boost out by another
+ * input_boost_ms, but never past input_boost_max_ms after the input.
+ * An idle pipeline ends it, provided the frame that retired last was
+ * queued after the input and so was the response to it.
+ */
+static void do_frame_boost(struct work_struct *work)
+{
+	unsigned int i;
+	unsigned long event;
+	struct cpu_sync *i_sync_info;
+	u64 elapsed = ktime_to_us(ktime_get()) - last_input_time;
+	u64 budget = (u64)input_boost_max_ms * USEC_PER_MSEC;
+	unsigned int delay_ms = input_boost_ms;
+
+	spin_lock_irq(&frame_lock);
+	event = frame_event;
+	spin_unlock_irq(&frame_lock);
+
+	if (event == CPUFREQ_FRAME_LATE) {
+		if (elapsed >= budget)
+			return;
+		delay_ms = min_t(u64, delay_ms,
+				 div_u64(budget - elapsed + USEC_PER_MSEC - 1,
+					 USEC_PER_MSEC));
+	}
+
+	for_each_online_cpu(i) {
+		i_sync_info = &per_cpu(sync_info, i);
+		if (!i_sync_info->input_boost_min)
+			continue;
+
+		cancel_delayed_work_sync(&i_sync_info->input_boost_rem);
+		if (!i_sync_info->input_boost_min)
+			continue;
+
+		if (event == CPUFREQ_FRAME_LATE) {
+			trace_cpu_boost_input(i, i_sync_info->input_boost_min,
+					      "frame_late");
+			queue_delayed_work_on(i_sync_info->cpu, cpu_boost_wq,
+				&i_sync_info->input_boost_rem,
+				msecs_to_jiffies(delay_ms));
+		} else {
+			i_sync_info->input_boost_min = 0;
+			trace_cpu_boost_input(i, 0, "frame_idle");
+			cpufreq_update_policy(i);
+		}
+	}
+}
+
+static int boost_frame_notify(struct notifier_block *nb, unsigned long event,
+				void *data)
+{
+	struct cpufreq_frame *frame = data;
+	unsigned long flags;
+	u64 input_time = last_input_time;
+
+	if (!frame_boost || !input_boost_freq || !input_time)
+		return NOTIFY_OK;
+
+	if (ktime_to_us(ktime_get()) - input_time >=
+	    input_boost_max_ms * USEC_PER_MSEC)
+		return NOTIFY_OK;
+
+	if (event == CPUFREQ_FRAME_IDLE &&
+	    ktime_to_us(frame->queued) < input_time)
+		return NOTIFY_OK;
+
+	spin_lock_irqsave(&frame_lock, flags);
+	frame_event = event;
+	spin_unlock_irqrestore(&frame_lock, flags);
+
+	queue_work(cpu_boost_wq, &frame_boost_work);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block boost_frame_nb = {
+	.notifier_call = boost_frame_notify,
+};
+
 static void cpuboost_input_event(struct input_handle *handle,
 		unsigned int type, unsigned int code, int value)
 {
@@ -317,6 +413,7 @@ static int cpu_boost_init(void)
 		return -EFAULT;
 
 	INIT_WORK(&input_boost_work, do_input_boost);
+	INIT_WORK(&frame_boost_work, do_frame_boost);
 
 	for_each_possible_cpu(cpu) {
 		s = &per_cpu(sync_info, cpu);
@@ -330,6 +427,7 @@ static int cpu_boost_init(void)
 	}
 	atomic_notifier_chain_register(&migration_notifier_head,
 					&boost_migration_nb);
+	cpufreq_register_notifier(&boost_frame_nb, CPUFREQ_FRAME_NOTIFIER);
 
 	ret = input_register_handler(&cpuboost_input_handler);
 	return 0;
@@ -87,6 +87,7 @@ static void handle_update(struct work_struct *work);
 
 static BLOCKING_NOTIFIER_HEAD(cpufreq_policy_notifier_list);
 static struct srcu_notifier_head cpufreq_transition_notifier_list;
+static ATOMIC_NOTIFIER_HEAD(cpufreq_frame_notifier_list);
 
 static bool init_cpufreq_transition_notifier_list_called;
 static int __init init_cpufreq_transition_notifier_list(void)
@@ -1249,6 +1250,10 @@ int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list)
 		ret = blocking_notifier_chain_register(
 				&cpufreq_policy_notifier_list, nb);
 		break;
+	case CPUFREQ_FRAME_NOTIFIER:
+		ret = atomic_notifier_chain_register(
+				&cpufreq_frame_notifier_list, nb);
+		break;
 	default:
 		ret = -EINVAL;
 	}
@@ -1271,6 +1276,10 @@ int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list)
 		ret = blocking_notifier_chain_unregister(
 				&cpufreq_policy_notifier_list, nb);
 		break;
+	case CPUFREQ_FRAME_NOTIFIER:
+		ret = atomic_notifier_chain_unregister(
+				&cpufreq_frame_notifier_list, nb);
+		break;
 	default:
 		ret = -EINVAL;
 	}
@@ -1279,6 +1288,12 @@ int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list)
 }
 EXPORT_SYMBOL(cpufreq_unregister_notifier);
 
+void cpufreq_notify_frame(unsigned long event, struct cpufreq_frame *frame)
+{
+	atomic_notifier_call_chain(&cpufreq_frame_notifier_list, event, frame);
+}
+EXPORT_SYMBOL_GPL(cpufreq_notify_frame);
+
 
 
 
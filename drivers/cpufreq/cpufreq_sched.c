@@ -0,0 +1,444 @@
+/*
+ * drivers/cpufreq/cpufreq_sched.c
+ *
+ * Scheduler driven cpufreq governor. Instead of sampling idle time from a
+ * timer, the scheduler reports the cfs utilization of a cpu whenever it
+ * changes (enqueue, dequeue and tick) and the frequency is picked from
+ * that directly. Frequency changes are rate limited and carried out by a
+ * per-policy kthread, since the callback runs under the rq lock.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <asm/div64.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/cpufreq_sched.h>
+
+struct cpufreq_sched_policyinfo {
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	raw_spinlock_t update_lock;
+	u64 last_freq_update_time;
+	unsigned int next_freq;
+	bool work_in_progress;
+	struct irq_work irq_work;
+	struct task_struct *thread;
+	struct mutex work_lock;
+};
+
+struct cpufreq_sched_cpuinfo {
+	struct update_util_data update_util;
+	struct cpufreq_sched_policyinfo *ppol;
+	unsigned long util;
+	unsigned long max;
+	u64 last_update;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_sched_cpuinfo, cpuinfo);
+
+static DEFINE_MUTEX(gov_lock);
+static int active_count;
+
+#define DEFAULT_UP_RATE_LIMIT_US 500
+static unsigned int up_rate_limit_us = DEFAULT_UP_RATE_LIMIT_US;
+
+#define DEFAULT_DOWN_RATE_LIMIT_US (20 * USEC_PER_MSEC)
+static unsigned int down_rate_limit_us = DEFAULT_DOWN_RATE_LIMIT_US;
+
+#define DEFAULT_TARGET_LOAD 80
+static unsigned int target_load = DEFAULT_TARGET_LOAD;
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+static
+#endif
+struct cpufreq_governor cpufreq_gov_sched = {
+	.name = "sched",
+	.governor = cpufreq_governor_sched,
+	.max_transition_latency = 10000000,
+	.owner = THIS_MODULE,
+};
+
+/*
+ * Utilization is not scaled by frequency here, so it is relative to the
+ * current speed: pick the frequency at which the busiest cpu of the
+ * policy would sit at target_load.
+ */
+static unsigned int cpufreq_sched_next_freq(
+	struct cpufreq_sched_policyinfo *ppol, u64 time)
+{
+	struct cpufreq_policy *policy = ppol->policy;
+	unsigned long util = 0, max = 1;
+	unsigned int cur = policy->cur ? : policy->cpuinfo.max_freq;
+	unsigned int index;
+	u64 freq;
+	int j;
+
+	for_each_cpu(j, policy->cpus) {
+		struct cpufreq_sched_cpuinfo *pcpu = &per_cpu(cpuinfo, j);
+		s64 delta = time - pcpu->last_update;
+
+		if (delta > TICK_NSEC || !pcpu->max)
+			continue;
+
+		if (pcpu->util * max > util * pcpu->max) {
+			util = pcpu->util;
+			max = pcpu->max;
+		}
+	}
+
+	freq = (u64)cur * util * 100;
+	do_div(freq, max * target_load);
+	freq = clamp_t(u64, freq, policy->min, policy->max);
+
+	if (ppol->freq_table &&
+	    !cpufreq_frequency_table_target(policy, ppol->freq_table,
+					    freq, CPUFREQ_RELATION_L, &index))
+		freq = ppol->freq_table[index].frequency;
+
+	return freq;
+}
+
+static void cpufreq_sched_update_util(struct update_util_data *data, u64 time,
+				      unsigned long util, unsigned long max)
+{
+	struct cpufreq_sched_cpuinfo *pcpu =
+		container_of(data, struct cpufreq_sched_cpuinfo, update_util);
+	struct cpufreq_sched_policyinfo *ppol = pcpu->ppol;
+	unsigned int next_freq;
+	u64 delta, limit;
+
+	raw_spin_lock(&ppol->update_lock);
+
+	pcpu->util = util;
+	pcpu->max = max;
+	pcpu->last_update = time;
+
+	if (ppol->work_in_progress)
+		goto out;
+
+	next_freq = cpufreq_sched_next_freq(ppol, time);
+	if (next_freq == ppol->next_freq)
+		goto out;
+
+	delta = time - ppol->last_freq_update_time;
+	limit = next_freq > ppol->next_freq ? up_rate_limit_us :
+		down_rate_limit_us;
+	if (delta < limit * NSEC_PER_USEC)
+		goto out;
+
+	trace_cpufreq_sched_update_util(smp_processor_id(), util, max,
+					ppol->policy->cur, next_freq);
+
+	ppol->next_freq = next_freq;
+	ppol->last_freq_update_time = time;
+	ppol->work_in_progress = true;
+	irq_work_queue(&ppol->irq_work);
+out:
+	raw_spin_unlock(&ppol->update_lock);
+}
+
+static void cpufreq_sched_irq_work(struct irq_work *irq_work)
+{
+	struct cpufreq_sched_policyinfo *ppol =
+		container_of(irq_work, struct cpufreq_sched_policyinfo,
+			     irq_work);
+
+	wake_up_process(ppol->thread);
+}
+
+static int cpufreq_sched_thread(void *data)
+{
+	struct cpufreq_sched_policyinfo *ppol = data;
+	struct cpufreq_policy *policy = ppol->policy;
+	unsigned int freq;
+	unsigned long flags;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop())
+			break;
+
+		raw_spin_lock_irqsave(&ppol->update_lock, flags);
+		if (!ppol->work_in_progress) {
+			raw_spin_unlock_irqrestore(&ppol->update_lock, flags);
+			schedule();
+			continue;
+		}
+		freq = ppol->next_freq;
+		raw_spin_unlock_irqrestore(&ppol->update_lock, flags);
+
+		set_current_state(TASK_RUNNING);
+
+		mutex_lock(&ppol->work_lock);
+		if (freq != policy->cur)
+			__cpufreq_driver_target(policy, freq,
+						CPUFREQ_RELATION_L);
+		trace_cpufreq_sched_setspeed(policy->cpu, freq, policy->cur);
+		mutex_unlock(&ppol->work_lock);
+
+		raw_spin_lock_irqsave(&ppol->update_lock, flags);
+		ppol->work_in_progress = false;
+		raw_spin_unlock_irqrestore(&ppol->update_lock, flags);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static ssize_t show_up_rate_limit_us(struct kobject *kobj,
+				     struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", up_rate_limit_us);
+}
+
+static ssize_t store_up_rate_limit_us(struct kobject *kobj,
+				      struct attribute *attr, const char *buf,
+				      size_t count)
+{
+	int ret;
+	unsigned int val;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	up_rate_limit_us = val;
+	return count;
+}
+
+static struct global_attr up_rate_limit_us_attr =
+	__ATTR(up_rate_limit_us, 0644, show_up_rate_limit_us,
+	       store_up_rate_limit_us);
+
+static ssize_t show_down_rate_limit_us(struct kobject *kobj,
+				       struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", down_rate_limit_us);
+}
+
+static ssize_t store_down_rate_limit_us(struct kobject *kobj,
+					struct attribute *attr,
+					const char *buf, size_t count)
+{
+	int ret;
+	unsigned int val;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	down_rate_limit_us = val;
+	return count;
+}
+
+static struct global_attr down_rate_limit_us_attr =
+	__ATTR(down_rate_limit_us, 0644, show_down_rate_limit_us,
+	       store_down_rate_limit_us);
+
+static ssize_t show_target_load(struct kobject *kobj,
+				struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", target_load);
+}
+
+static ssize_t store_target_load(struct kobject *kobj,
+				 struct attribute *attr, const char *buf,
+				 size_t count)
+{
+	int ret;
+	unsigned int val;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	if (!val || val > 100)
+		return -EINVAL;
+	target_load = val;
+	return count;
+}
+
+static struct global_attr target_load_attr =
+	__ATTR(target_load, 0644, show_target_load,
+	       store_target_load);
+
+static struct attribute *sched_attributes[] = {
+	&up_rate_limit_us_attr.attr,
+	&down_rate_limit_us_attr.attr,
+	&target_load_attr.attr,
+	NULL,
+};
+
+static struct attribute_group sched_attr_group = {
+	.attrs = sched_attributes,
+	.name = "sched",
+};
+
+static int cpufreq_sched_start(struct cpufreq_policy *policy)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+	struct cpufreq_sched_policyinfo *ppol;
+	unsigned int j;
+	int rc;
+
+	ppol = kzalloc(sizeof(*ppol), GFP_KERNEL);
+	if (!ppol)
+		return -ENOMEM;
+
+	ppol->policy = policy;
+	ppol->freq_table = cpufreq_frequency_get_table(policy->cpu);
+	ppol->next_freq = policy->cur;
+	raw_spin_lock_init(&ppol->update_lock);
+	mutex_init(&ppol->work_lock);
+	init_irq_work(&ppol->irq_work, cpufreq_sched_irq_work);
+
+	ppol->thread = kthread_create(cpufreq_sched_thread, ppol,
+				      "cfsched/%u", policy->cpu);
+	if (IS_ERR(ppol->thread)) {
+		rc = PTR_ERR(ppol->thread);
+		kfree(ppol);
+		return rc;
+	}
+	sched_setscheduler_nocheck(ppol->thread, SCHED_FIFO, &param);
+	wake_up_process(ppol->thread);
+
+	if (++active_count == 1) {
+		rc = sysfs_create_group(cpufreq_global_kobject,
+					&sched_attr_group);
+		if (rc) {
+			active_count--;
+			kthread_stop(ppol->thread);
+			kfree(ppol);
+			return rc;
+		}
+	}
+
+	for_each_cpu(j, policy->cpus) {
+		struct cpufreq_sched_cpuinfo *pcpu = &per_cpu(cpuinfo, j);
+
+		pcpu->ppol = ppol;
+		pcpu->util = 0;
+		pcpu->max = 0;
+		pcpu->last_update = 0;
+		pcpu->update_util.func = cpufreq_sched_update_util;
+		cpufreq_set_update_util_data(j, &pcpu->update_util);
+	}
+
+	return 0;
+}
+
+static void cpufreq_sched_stop(struct cpufreq_policy *policy)
+{
+	struct cpufreq_sched_policyinfo *ppol =
+		per_cpu(cpuinfo, policy->cpu).ppol;
+	unsigned int j;
+
+	if (!ppol)
+		return;
+
+	for_each_cpu(j, policy->cpus)
+		cpufreq_set_update_util_data(j, NULL);
+	synchronize_sched();
+
+	irq_work_sync(&ppol->irq_work);
+	kthread_stop(ppol->thread);
+
+	for_each_cpu(j, policy->cpus)
+		per_cpu(cpuinfo, j).ppol = NULL;
+	kfree(ppol);
+
+	if (--active_count == 0)
+		sysfs_remove_group(cpufreq_global_kobject, &sched_attr_group);
+}
+
+static void cpufreq_sched_limits(struct cpufreq_policy *policy)
+{
+	struct cpufreq_sched_policyinfo *ppol =
+		per_cpu(cpuinfo, policy->cpu).ppol;
+	unsigned long flags;
+
+	if (!ppol)
+		return;
+
+	mutex_lock(&ppol->work_lock);
+	if (policy->max < policy->cur)
+		__cpufreq_driver_target(policy, policy->max,
+					CPUFREQ_RELATION_H);
+	else if (policy->min > policy->cur)
+		__cpufreq_driver_target(policy, policy->min,
+					CPUFREQ_RELATION_L);
+	mutex_unlock(&ppol->work_lock);
+
+	raw_spin_lock_irqsave(&ppol->update_lock, flags);
+	ppol->next_freq = policy->cur;
+	raw_spin_unlock_irqrestore(&ppol->update_lock, flags);
+}
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	int rc = 0;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if (!cpu_online(policy->cpu))
+			return -EINVAL;
+
+		mutex_lock(&gov_lock);
+		rc = cpufreq_sched_start(policy);
+		mutex_unlock(&gov_lock);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		mutex_lock(&gov_lock);
+		cpufreq_sched_stop(policy);
+		mutex_unlock(&gov_lock);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&gov_lock);
+		cpufreq_sched_limits(policy);
+		mutex_unlock(&gov_lock);
+		break;
+	}
+	return rc;
+}
+
+static int __init cpufreq_sched_init(void)
+{
+	return cpufreq_register_governor(&cpufreq_gov_sched);
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+fs_initcall(cpufreq_sched_init);
+#else
+module_init(cpufreq_sched_init);
+#endif
+
+static void __exit cpufreq_sched_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_sched);
+}
+
+module_exit(cpufreq_sched_exit);
+
+MODULE_DESCRIPTION("'cpufreq_sched' - A cpufreq governor driven by "
+	"scheduler utilization");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,560 @@
+/*
+ *  drivers/cpufreq/cpufreq_times.c
+ *
+ *  Per task and per uid cpu time broken down by cpu frequency.
+ *
+ *  The time is charged from the scheduler's cputime accounting to the
+ *  frequency the cpu runs at, and exported through /proc/<pid>/time_in_state,
+ *  /proc/uid_time_in_state and its binary twin /proc/uid_time_in_state_bin,
+ *  whose layout is in <linux/cpufreq_times.h>.
+ *
+ *  cpus with identical frequency tables share their columns, so a uid's
+ *  row has one entry per distinct frequency of each kind of core.
+ *
+ *  Writing "start-end" or a single uid to /proc/uid_time_in_state drops
+ *  the rows of those uids, for when an app is removed.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/cpufreq_times.h>
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/rculist.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <asm/cputime.h>
+
+#define UID_HASH_BITS	10
+
+struct cpu_freqs {
+	unsigned int offset;
+	unsigned int max_state;
+	unsigned int first_cpu;
+	unsigned int freq_table[0];
+};
+
+struct uid_entry {
+	uid_t uid;
+	unsigned int max_state;
+	struct hlist_node hash;
+	struct rcu_head rcu;
+	atomic64_t time_in_state[0];
+};
+
+static struct hlist_head uid_hash_table[1 << UID_HASH_BITS];
+static DEFINE_SPINLOCK(uid_lock);
+
+static DEFINE_MUTEX(freqs_lock);
+static struct cpu_freqs *all_freqs[NR_CPUS];
+static struct cpu_freqs *tables[NR_CPUS];
+static unsigned int nr_tables;
+static unsigned int next_offset;
+
+static DEFINE_PER_CPU(unsigned int, last_index);
+
+static int freq_index(struct cpu_freqs *freqs, unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < freqs->max_state; i++)
+		if (freqs->freq_table[i] == freq)
+			return i;
+	return -1;
+}
+
+/* Called under rcu_read_lock() or uid_lock */
+static struct uid_entry *find_uid_entry(uid_t uid)
+{
+	struct uid_entry *uid_entry;
+	struct hlist_node *node;
+
+	hlist_for_each_entry_rcu(uid_entry, node,
+			&uid_hash_table[hash_32(uid, UID_HASH_BITS)], hash)
+		if (uid_entry->uid == uid)
+			return uid_entry;
+	return NULL;
+}
+
+/*
+ * Entries are sized for the frequencies known when they were created and
+ * grow when a cpu with a new frequency table shows up later. Time charged
+ * to the old entry while it is being copied is lost, which only matters
+ * while cpufreq drivers are still registering.
+ */
+static struct uid_entry *find_or_register_uid_locked(uid_t uid)
+{
+	struct uid_entry *uid_entry, *temp;
+	unsigned int max_state = ACCESS_ONCE(next_offset);
+	unsigned int i;
+
+	uid_entry = find_uid_entry(uid);
+	if (uid_entry && uid_entry->max_state == max_state)
+		return uid_entry;
+
+	temp = kzalloc(sizeof(*temp) + max_state * sizeof(atomic64_t),
+		       GFP_ATOMIC);
+	if (!temp)
+		return uid_entry;
+	temp->uid = uid;
+	temp->max_state = max_state;
+
+	if (uid_entry) {
+		for (i = 0; i < uid_entry->max_state; i++)
+			atomic64_set(&temp->time_in_state[i],
+				atomic64_read(&uid_entry->time_in_state[i]));
+		hlist_replace_rcu(&uid_entry->hash, &temp->hash);
+		kfree_rcu(uid_entry, rcu);
+	} else {
+		hlist_add_head_rcu(&temp->hash,
+				   &uid_hash_table[hash_32(uid, UID_HASH_BITS)]);
+	}
+	return temp;
+}
+
+void cpufreq_task_times_init(struct task_struct *p)
+{
+	p->time_in_state = NULL;
+	p->max_state = 0;
+}
+
+void cpufreq_task_times_alloc(struct task_struct *p)
+{
+	unsigned int max_state = ACCESS_ONCE(next_offset);
+
+	if (!max_state)
+		return;
+
+	p->time_in_state = kcalloc(max_state, sizeof(u64), GFP_KERNEL);
+	if (p->time_in_state)
+		p->max_state = max_state;
+}
+
+void cpufreq_task_times_exit(struct task_struct *p)
+{
+	kfree(p->time_in_state);
+	p->time_in_state = NULL;
+	p->max_state = 0;
+}
+
+/*
+ * Called from the cputime accounting of the cpu @p runs on. The per task
+ * array is only written from there, so it needs no lock of its own. uid
+ * entries are looked up under RCU and charged atomically, since tasks of
+ * one uid run on several cpus; uid_lock is only taken to add an entry.
+ */
+void cpufreq_acct_update_power(struct task_struct *p, cputime_t cputime)
+{
+	unsigned int cpu = task_cpu(p);
+	struct cpu_freqs *freqs = ACCESS_ONCE(all_freqs[cpu]);
+	struct uid_entry *uid_entry;
+	unsigned long flags;
+	unsigned int state;
+	uid_t uid;
+
+	if (!freqs || (p->flags & PF_EXITING))
+		return;
+
+	state = freqs->offset + per_cpu(last_index, cpu);
+
+	if (p->time_in_state && state < p->max_state)
+		p->time_in_state[state] += (__force u64)cputime;
+
+	uid = task_uid(p);
+	rcu_read_lock();
+	uid_entry = find_uid_entry(uid);
+	if (unlikely(!uid_entry ||
+		     uid_entry->max_state != ACCESS_ONCE(next_offset))) {
+		spin_lock_irqsave(&uid_lock, flags);
+		uid_entry = find_or_register_uid_locked(uid);
+		spin_unlock_irqrestore(&uid_lock, flags);
+	}
+	if (uid_entry && state < uid_entry->max_state)
+		atomic64_add((__force u64)cputime,
+			     &uid_entry->time_in_state[state]);
+	rcu_read_unlock();
+}
+
+static void cpufreq_times_remove_uids(uid_t start, uid_t end)
+{
+	struct uid_entry *uid_entry;
+	struct hlist_node *node, *tmp;
+	unsigned long flags;
+	unsigned int bkt;
+
+	spin_lock_irqsave(&uid_lock, flags);
+	for (bkt = 0; bkt < ARRAY_SIZE(uid_hash_table); bkt++) {
+		hlist_for_each_entry_safe(uid_entry, node, tmp,
+					  &uid_hash_table[bkt], hash) {
+			if (uid_entry->uid < start || uid_entry->uid > end)
+				continue;
+			hlist_del_rcu(&uid_entry->hash);
+			kfree_rcu(uid_entry, rcu);
+		}
+	}
+	spin_unlock_irqrestore(&uid_lock, flags);
+}
+
+int proc_time_in_state_show(struct seq_file *m, struct pid_namespace *ns,
+			    struct pid *pid, struct task_struct *p)
+{
+	unsigned int i, t, nr = ACCESS_ONCE(nr_tables);
+
+	for (t = 0; t < nr; t++) {
+		struct cpu_freqs *freqs = tables[t];
+
+		seq_printf(m, "cpu%u\n", freqs->first_cpu);
+		for (i = 0; i < freqs->max_state; i++) {
+			unsigned int state = freqs->offset + i;
+			u64 cputime = 0;
+
+			if (p->time_in_state && state < p->max_state)
+				cputime = p->time_in_state[state];
+			seq_printf(m, "%u %llu\n", freqs->freq_table[i],
+				   (unsigned long long)
+				   cputime64_to_clock_t(cputime));
+		}
+	}
+	return 0;
+}
+
+/*
+ * The uid files are walked one hash bucket per record, so that a read
+ * resumes where the previous one stopped instead of walking every uid
+ * again. The number of frequency tables is fixed at open, so that the
+ * header and all rows of one read agree.
+ */
+static void *uid_seq_start(struct seq_file *m, loff_t *pos)
+{
+	if (*pos >= ARRAY_SIZE(uid_hash_table))
+		return NULL;
+	return &uid_hash_table[*pos];
+}
+
+static void *uid_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	do {
+		(*pos)++;
+		if (*pos >= ARRAY_SIZE(uid_hash_table))
+			return NULL;
+	} while (hlist_empty(&uid_hash_table[*pos]));
+	return &uid_hash_table[*pos];
+}
+
+static void uid_seq_stop(struct seq_file *m, void *v)
+{
+}
+
+static u64 uid_entry_time(struct uid_entry *uid_entry, unsigned int state)
+{
+	u64 cputime = 0;
+
+	if (state < uid_entry->max_state)
+		cputime = atomic64_read(&uid_entry->time_in_state[state]);
+	return cputime64_to_clock_t(cputime);
+}
+
+static int uid_time_in_state_show(struct seq_file *m, void *v)
+{
+	unsigned int nr = (unsigned long)m->private;
+	struct uid_entry *uid_entry;
+	struct hlist_node *node;
+	unsigned int i, t;
+
+	if (v == uid_hash_table) {
+		seq_puts(m, "uid:");
+		for (t = 0; t < nr; t++)
+			for (i = 0; i < tables[t]->max_state; i++)
+				seq_printf(m, " %u", tables[t]->freq_table[i]);
+		seq_putc(m, '\n');
+	}
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(uid_entry, node, (struct hlist_head *)v,
+				 hash) {
+		seq_printf(m, "%u:", uid_entry->uid);
+		for (t = 0; t < nr; t++)
+			for (i = 0; i < tables[t]->max_state; i++)
+				seq_printf(m, " %llu", (unsigned long long)
+					   uid_entry_time(uid_entry,
+						tables[t]->offset + i));
+		seq_putc(m, '\n');
+	}
+	rcu_read_unlock();
+	return 0;
+}
+
+static int uid_time_in_state_bin_show(struct seq_file *m, void *v)
+{
+	unsigned int nr = (unsigned long)m->private;
+	struct uid_time_in_state_header hdr;
+	struct uid_time_in_state_record rec;
+	struct uid_entry *uid_entry;
+	struct hlist_node *node;
+	unsigned int i, t;
+
+	if (v == uid_hash_table) {
+		hdr.magic = UID_TIME_IN_STATE_MAGIC;
+		hdr.version = UID_TIME_IN_STATE_VERSION;
+		hdr.header_size = sizeof(hdr);
+		hdr.nr_freqs = 0;
+		for (t = 0; t < nr; t++)
+			hdr.nr_freqs += tables[t]->max_state;
+		hdr.user_hz = USER_HZ;
+		seq_write(m, &hdr, sizeof(hdr));
+		for (t = 0; t < nr; t++)
+			seq_write(m, tables[t]->freq_table,
+				  tables[t]->max_state * sizeof(u32));
+	}
+
+	rec.reserved = 0;
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(uid_entry, node, (struct hlist_head *)v,
+				 hash) {
+		rec.uid = uid_entry->uid;
+		seq_write(m, &rec, sizeof(rec));
+		for (t = 0; t < nr; t++) {
+			for (i = 0; i < tables[t]->max_state; i++) {
+				u64 cputime = uid_entry_time(uid_entry,
+						tables[t]->offset + i);
+
+				seq_write(m, &cputime, sizeof(cputime));
+			}
+		}
+	}
+	rcu_read_unlock();
+	return 0;
+}
+
+static const struct seq_operations uid_time_in_state_seq_ops = {
+	.start	= uid_seq_start,
+	.next	= uid_seq_next,
+	.stop	= uid_seq_stop,
+	.show	= uid_time_in_state_show,
+};
+
+static const struct seq_operations uid_time_in_state_bin_seq_ops = {
+	.start	= uid_seq_start,
+	.next	= uid_seq_next,
+	.stop	= uid_seq_stop,
+	.show	= uid_time_in_state_bin_show,
+};
+
+static int uid_seq_open(struct file *file, const struct seq_operations *ops)
+{
+	int ret = seq_open(file, ops);
+
+	if (!ret) {
+		struct seq_file *m = file->private_data;
+
+		m->private = (void *)(unsigned long)ACCESS_ONCE(nr_tables);
+	}
+	return ret;
+}
+
+static int uid_time_in_state_open(struct inode *inode, struct file *file)
+{
+	return uid_seq_open(file, &uid_time_in_state_seq_ops);
+}
+
+static ssize_t uid_time_in_state_write(struct file *file,
+				       const char __user *buffer,
+				       size_t count, loff_t *ppos)
+{
+	unsigned int start, end;
+	char buf[32];
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, buffer, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	ret = sscanf(buf, "%u-%u", &start, &end);
+	if (ret == 1)
+		end = start;
+	else if (ret != 2 || start > end)
+		return -EINVAL;
+
+	cpufreq_times_remove_uids(start, end);
+	return count;
+}
+
+static int uid_time_in_state_bin_open(struct inode *inode, struct file *file)
+{
+	return uid_seq_open(file, &uid_time_in_state_bin_seq_ops);
+}
+
+static const struct file_operations uid_time_in_state_fops = {
+	.open		= uid_time_in_state_open,
+	.read		= seq_read,
+	.write		= uid_time_in_state_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static const struct file_operations uid_time_in_state_bin_fops = {
+	.open		= uid_time_in_state_bin_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static bool freqs_match(struct cpu_freqs *freqs, unsigned int *table,
+			unsigned int count)
+{
+	return freqs->max_state == count &&
+		!memcmp(freqs->freq_table, table, count * sizeof(*table));
+}
+
+static void cpufreq_times_create_policy(struct cpufreq_policy *policy)
+{
+	struct cpufreq_frequency_table *table;
+	struct cpu_freqs *freqs = NULL;
+	unsigned int *tmp, count = 0;
+	unsigned int i, cpu;
+	int index;
+
+	table = cpufreq_frequency_get_table(policy->cpu);
+	if (!table)
+		return;
+
+	mutex_lock(&freqs_lock);
+	if (all_freqs[policy->cpu])
+		goto out;
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++)
+		count++;
+	tmp = kcalloc(count, sizeof(*tmp), GFP_KERNEL);
+	if (!tmp)
+		goto out;
+
+	count = 0;
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int freq = table[i].frequency, j;
+
+		if (freq == CPUFREQ_ENTRY_INVALID)
+			continue;
+		for (j = 0; j < count && tmp[j] != freq; j++)
+			;
+		if (j == count)
+			tmp[count++] = freq;
+	}
+
+	for (i = 0; i < nr_tables; i++) {
+		if (freqs_match(tables[i], tmp, count)) {
+			freqs = tables[i];
+			break;
+		}
+	}
+
+	if (!freqs) {
+		freqs = kzalloc(sizeof(*freqs) + count * sizeof(*tmp),
+				GFP_KERNEL);
+		if (!freqs) {
+			kfree(tmp);
+			goto out;
+		}
+		freqs->offset = next_offset;
+		freqs->max_state = count;
+		freqs->first_cpu = policy->cpu;
+		memcpy(freqs->freq_table, tmp, count * sizeof(*tmp));
+		tables[nr_tables] = freqs;
+		smp_wmb();
+		nr_tables++;
+		next_offset += count;
+	}
+	kfree(tmp);
+
+	index = freq_index(freqs, policy->cur);
+	for_each_cpu(cpu, policy->related_cpus) {
+		if (all_freqs[cpu])
+			continue;
+		per_cpu(last_index, cpu) = index < 0 ? 0 : index;
+		smp_wmb();
+		all_freqs[cpu] = freqs;
+	}
+	if (!all_freqs[policy->cpu]) {
+		per_cpu(last_index, policy->cpu) = index < 0 ? 0 : index;
+		smp_wmb();
+		all_freqs[policy->cpu] = freqs;
+	}
+out:
+	mutex_unlock(&freqs_lock);
+}
+
+static int cpufreq_times_notifier_policy(struct notifier_block *nb,
+		unsigned long val, void *data)
+{
+	if (val == CPUFREQ_NOTIFY)
+		cpufreq_times_create_policy(data);
+	return 0;
+}
+
+static int cpufreq_times_notifier_trans(struct notifier_block *nb,
+		unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freq = data;
+	struct cpu_freqs *freqs;
+	int index;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return 0;
+
+	freqs = ACCESS_ONCE(all_freqs[freq->cpu]);
+	if (!freqs)
+		return 0;
+
+	index = freq_index(freqs, freq->new);
+	if (index >= 0)
+		per_cpu(last_index, freq->cpu) = index;
+	return 0;
+}
+
+static struct notifier_block notifier_policy_block = {
+	.notifier_call = cpufreq_times_notifier_policy
+};
+
+static struct notifier_block notifier_trans_block = {
+	.notifier_call = cpufreq_times_notifier_trans
+};
+
+static int __init cpufreq_times_init(void)
+{
+	unsigned int cpu;
+
+	cpufreq_register_notifier(&notifier_policy_block,
+				  CPUFREQ_POLICY_NOTIFIER);
+	cpufreq_register_notifier(&notifier_trans_block,
+				  CPUFREQ_TRANSITION_NOTIFIER);
+
+	for_each_online_cpu(cpu) {
+		struct cpufreq_policy *policy = cpufreq_cpu_get(cpu);
+
+		if (!policy)
+			continue;
+		cpufreq_times_create_policy(policy);
+		cpufreq_cpu_put(policy);
+	}
+
+	proc_create("uid_time_in_state", S_IRUGO | S_IWUSR, NULL,
+		    &uid_time_in_state_fops);
+	proc_create("uid_time_in_state_bin", S_IRUGO, NULL,
+		    &uid_time_in_state_bin_fops);
+	return 0;
+}
+late_initcall(cpufreq_times_init);
@@ -258,7 +258,7 @@ static void adreno_input_event(struct input_handle *handle, unsigned int type,
 	if ((type == EV_ABS) &&
 		!(device->flags & KGSL_FLAG_WAKE_ON_TOUCH) &&
 		(device->state == KGSL_STATE_SLUMBER))
-		schedule_work(&adreno_dev->input_work);
+		queue_work(system_power_efficient_wq, &adreno_dev->input_work);
 }
 
 static int adreno_input_connect(struct input_handler *handler,
@@ -16,6 +16,7 @@
 #include <linux/sched.h>
 #include <linux/jiffies.h>
 #include <linux/err.h>
+#include <linux/cpufreq.h>
 
 #include "kgsl.h"
 #include "adreno.h"
@@ -35,6 +36,8 @@ static unsigned int _dispatcher_inflight = 15;
 
 static unsigned int _cmdbatch_timeout = 2000;
 
+static unsigned int _frame_deadline = 16;
+
 static unsigned int _fault_timer_interval = 50;
 
 static unsigned int fault_detect_regs[FT_DETECT_REGS_COUNT];
@@ -479,6 +482,7 @@ int adreno_dispatcher_queue_cmd(struct adreno_device *adreno_dev,
 	}
 
 	cmdbatch->timestamp = *timestamp;
+	cmdbatch->queue_time = ktime_get();
 
 
 	if (drawctxt->base.flags & KGSL_CONTEXT_NO_FAULT_TOLERANCE)
@@ -903,6 +907,34 @@ static inline int cmdbatch_consumed(struct kgsl_cmdbatch *cmdbatch,
 		(timestamp_cmp(retired, cmdbatch->timestamp) < 0));
 }
 
+/*
+ * Let cpufreq know when the oldest inflight command batch has been queued
+ * for longer than a frame, or when the pipeline drained after retiring
+ * work, so that input boosts can follow what the GPU is actually doing.
+ */
+static void dispatcher_notify_frame(struct adreno_dispatcher *dispatcher,
+		int count, ktime_t retired)
+{
+	struct cpufreq_frame frame;
+
+	if (dispatcher->inflight) {
+		struct kgsl_cmdbatch *cmdbatch =
+			dispatcher->cmdqueue[dispatcher->head];
+
+		if (ktime_us_delta(ktime_get(), cmdbatch->queue_time) <
+		    _frame_deadline * USEC_PER_MSEC)
+			return;
+
+		frame.pending = dispatcher->inflight;
+		frame.queued = cmdbatch->queue_time;
+		cpufreq_notify_frame(CPUFREQ_FRAME_LATE, &frame);
+	} else if (count) {
+		frame.pending = 0;
+		frame.queued = retired;
+		cpufreq_notify_frame(CPUFREQ_FRAME_IDLE, &frame);
+	}
+}
+
 static void _print_recovery(struct kgsl_device *device,
 		struct kgsl_cmdbatch *cmdbatch)
 {
@@ -936,6 +968,7 @@ static void adreno_dispatcher_work(struct work_struct *work)
 	struct kgsl_device *device = &adreno_dev->dev;
 	int count = 0;
 	int fault_handled = 0;
+	ktime_t retired_queued = ktime_set(0, 0);
 
 	mutex_lock(&dispatcher->mutex);
 
@@ -968,6 +1001,8 @@ static void adreno_dispatcher_work(struct work_struct *work)
 			trace_adreno_cmdbatch_retired(cmdbatch,
 				dispatcher->inflight - 1);
 
+			retired_queued = cmdbatch->queue_time;
+
 			
 			dispatcher->inflight--;
 
@@ -1039,6 +1074,8 @@ static void adreno_dispatcher_work(struct work_struct *work)
 		_adreno_dispatcher_issuecmds(adreno_dev);
 
 done:
+	dispatcher_notify_frame(dispatcher, count, retired_queued);
+
 	
 	if (dispatcher->inflight) {
 		struct kgsl_cmdbatch *cmdbatch
@@ -1228,6 +1265,7 @@ static DISPATCHER_UINT_ATTR(cmdbatch_timeout, 0644, 0, _cmdbatch_timeout);
 static DISPATCHER_UINT_ATTR(context_queue_wait, 0644, 0, _context_queue_wait);
 static DISPATCHER_UINT_ATTR(fault_detect_interval, 0644, 0,
 	_fault_timer_interval);
+static DISPATCHER_UINT_ATTR(frame_deadline, 0644, 0, _frame_deadline);
 
 static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_inflight.attr,
@@ -1236,6 +1274,7 @@ static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_cmdbatch_timeout.attr,
 	&dispatcher_attr_context_queue_wait.attr,
 	&dispatcher_attr_fault_detect_interval.attr,
+	&dispatcher_attr_frame_deadline.attr,
 	NULL,
 };
 
@@ -151,6 +151,7 @@ struct kgsl_cmdbatch {
 	uint32_t ibcount;
 	struct kgsl_ibdesc *ibdesc;
 	unsigned long expires;
+	ktime_t queue_time;
 	int invalid;
 	struct kref refcount;
 	struct list_head synclist;
@@ -44,7 +44,7 @@ unsigned int kgsl_get_alloc_size(int detailed)
 
 	if (detailed && time_after(jiffies, priv->next_jiffies)) {
 		priv->next_jiffies = jiffies + 20*HZ;
-		schedule_work(&kgsl_driver.priv.work);
+		queue_work(system_power_efficient_wq, &kgsl_driver.priv.work);
 	}
 
 	return kgsl_driver.stats.page_alloc;
@@ -182,19 +182,29 @@ void kgsl_pwrctrl_pwrlevel_change(struct kgsl_device *device,
 
 EXPORT_SYMBOL(kgsl_pwrctrl_pwrlevel_change);
 
+static void _thermal_pwrlevel_set(struct kgsl_device *device, int level)
+{
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+
+	if (level > pwr->num_pwrlevels - 2)
+		level = pwr->num_pwrlevels - 2;
+
+	pwr->thermal_pwrlevel = level;
+
+	if (pwr->thermal_pwrlevel > pwr->active_pwrlevel)
+		kgsl_pwrctrl_pwrlevel_change(device, pwr->thermal_pwrlevel);
+}
+
 static int kgsl_pwrctrl_thermal_pwrlevel_store(struct device *dev,
 					 struct device_attribute *attr,
 					 const char *buf, size_t count)
 {
 	struct kgsl_device *device = kgsl_device_from_dev(dev);
-	struct kgsl_pwrctrl *pwr;
 	int ret, level;
 
 	if (device == NULL)
 		return 0;
 
-	pwr = &device->pwrctrl;
-
 	ret = sscanf(buf, "%d", &level);
 	if (ret != 1)
 		return count;
@@ -203,18 +213,43 @@ static int kgsl_pwrctrl_thermal_pwrlevel_store(struct device *dev,
 		return count;
 
 	mutex_lock(&device->mutex);
+	_thermal_pwrlevel_set(device, level);
+	mutex_unlock(&device->mutex);
 
-	if (level > pwr->num_pwrlevels - 2)
-		level = pwr->num_pwrlevels - 2;
+	return count;
+}
 
-	pwr->thermal_pwrlevel = level;
+int kgsl_pwrctrl_thermal_levels(void)
+{
+	struct kgsl_device *device = kgsl_get_device(KGSL_DEVICE_3D0);
 
-	if (pwr->thermal_pwrlevel > pwr->active_pwrlevel)
-		kgsl_pwrctrl_pwrlevel_change(device, pwr->thermal_pwrlevel);
-	mutex_unlock(&device->mutex);
+	if (device == NULL)
+		return 0;
+	return device->pwrctrl.num_pwrlevels - 1;
+}
+EXPORT_SYMBOL(kgsl_pwrctrl_thermal_levels);
 
-	return count;
+/*
+ * In-kernel counterpart of the thermal_pwrlevel attribute. Returns the
+ * resulting maximum 3D core clock in Hz, or 0 if there is no 3D device.
+ */
+unsigned int kgsl_pwrctrl_thermal_limit(int level)
+{
+	struct kgsl_device *device = kgsl_get_device(KGSL_DEVICE_3D0);
+	struct kgsl_pwrctrl *pwr;
+	unsigned int freq;
+
+	if (device == NULL)
+		return 0;
+
+	pwr = &device->pwrctrl;
+	mutex_lock(&device->mutex);
+	_thermal_pwrlevel_set(device, max(level, 0));
+	freq = pwr->pwrlevels[pwr->thermal_pwrlevel].gpu_freq;
+	mutex_unlock(&device->mutex);
+	return freq;
 }
+EXPORT_SYMBOL(kgsl_pwrctrl_thermal_limit);
 
 static int kgsl_pwrctrl_thermal_pwrlevel_show(struct device *dev,
 					struct device_attribute *attr,
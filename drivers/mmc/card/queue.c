@@ -222,7 +222,7 @@ EXPORT_SYMBOL(mmc_alloc_sg);
 static void mmc_queue_setup_discard(struct request_queue *q,
 				    struct mmc_card *card)
 {
-	unsigned max_discard;
+	unsigned max_discard, granularity;
 
 	max_discard = mmc_calc_max_discard(card);
 	if (!max_discard)
@@ -232,10 +232,16 @@ static void mmc_queue_setup_discard(struct request_queue *q,
 	q->limits.max_discard_sectors = max_discard;
 	if (card->erased_byte == 0 && !mmc_can_discard(card))
 		q->limits.discard_zeroes_data = 1;
-	q->limits.discard_granularity = card->pref_erase << 9;
-	
-	if (card->pref_erase > max_discard)
-		q->limits.discard_granularity = 0;
+	/*
+	 * Without TRIM or DISCARD only whole erase groups can be released,
+	 * so let filesystems such as f2fs align their discards to them.
+	 */
+	granularity = card->pref_erase;
+	if (!mmc_can_trim(card) && !mmc_can_discard(card))
+		granularity = max(granularity, card->erase_size);
+	if (granularity > max_discard)
+		granularity = 0;
+	q->limits.discard_granularity = granularity << 9;
 	if (mmc_can_secure_erase_trim(card))
 		queue_flag_set_unlocked(QUEUE_FLAG_SECDISCARD, q);
 }
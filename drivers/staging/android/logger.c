@@ -25,6 +25,7 @@
 #include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/time.h>
+#include <linux/spinlock.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
@@ -33,23 +34,50 @@
 #define CONFIG_LOGCAT_SIZE 256
 #endif
 
+#define LOGGER_ENTRY_MAX_LEN \
+	(sizeof(struct logger_entry) + LOGGER_ENTRY_MAX_PAYLOAD)
+
+/*
+ * Writers reserve space for an entry under log->lock, write its header and
+ * drop the lock again before copying the payload from userspace, so that
+ * writers on different cores only serialize for the bookkeeping and not for
+ * the copy. An entry only becomes visible to readers once it and every entry
+ * reserved before it have been committed: c_off never passes a reservation
+ * that is still being copied into.
+ */
+#define LOGGER_MAX_INFLIGHT	32
+
+struct logger_slot {
+	size_t			start;	/* offset of the entry header */
+	size_t			end;	/* offset just past the payload */
+	bool			done;	/* payload copied */
+};
+
 struct logger_log {
 	unsigned char		*buffer;
 	struct miscdevice	misc;	
-	wait_queue_head_t	wq;	
+	wait_queue_head_t	wq;	/* readers wait here for new entries */
+	wait_queue_head_t	space_wq; /* writers wait here for room */
 	struct list_head	readers; 
-	struct mutex		mutex;	
-	size_t			w_off;	
+	spinlock_t		lock;	/* protects everything below */
+	size_t			w_off;	/* end of the last reservation */
+	size_t			c_off;	/* end of the committed entries */
 	size_t			head;	
 	size_t			size;	
+	unsigned int		r_seq;	/* reservations handed out */
+	unsigned int		c_seq;	/* reservations committed */
+	struct logger_slot	slots[LOGGER_MAX_INFLIGHT];
 };
 
 struct logger_reader {
 	struct logger_log	*log;	
 	struct list_head	list;	
+	struct mutex		mutex;	/* serializes reads on the file */
 	size_t			r_off;	
 	bool			r_all;	
 	int			r_ver;	
+	/* the entry being read, copied out of the ring under log->lock */
+	unsigned char		entry[LOGGER_ENTRY_MAX_LEN];
 };
 
 size_t logger_offset(struct logger_log *log, size_t n)
@@ -122,43 +150,47 @@ static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
 	return copy_to_user(buf, hdr, hdr_len);
 }
 
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+/*
+ * Copies the entry at r_off out of the ring into reader->entry and moves
+ * the reader past it. Once log->lock is dropped a writer may overwrite the
+ * entry in the ring, so it is only ever copied to userspace from there.
+ */
+static struct logger_entry *copy_entry_locked(struct logger_log *log,
+					      struct logger_reader *reader)
 {
-	struct logger_entry scratch;
-	struct logger_entry *entry;
+	size_t count = sizeof(struct logger_entry) +
+		get_entry_msg_len(log, reader->r_off);
 	size_t len;
-	size_t msg_start;
 
-	entry = get_entry_header(log, reader->r_off, &scratch);
-	if (copy_header_to_user(reader->r_ver, entry, buf))
-		return -EFAULT;
+	len = min(count, log->size - reader->r_off);
+	memcpy(reader->entry, log->buffer + reader->r_off, len);
+	if (count != len)
+		memcpy(reader->entry + len, log->buffer, count - len);
 
-	count -= get_user_hdr_len(reader->r_ver);
-	buf += get_user_hdr_len(reader->r_ver);
-	msg_start = logger_offset(log,
-		reader->r_off + sizeof(struct logger_entry));
+	reader->r_off = logger_offset(log, reader->r_off + count);
 
-	len = min(count, log->size - msg_start);
-	if (copy_to_user(buf, log->buffer + msg_start, len))
-		return -EFAULT;
+	return (struct logger_entry *) reader->entry;
+}
 
-	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
+static ssize_t do_read_log_to_user(struct logger_reader *reader,
+				   struct logger_entry *entry,
+				   char __user *buf)
+{
+	size_t hdr_len = get_user_hdr_len(reader->r_ver);
 
-	reader->r_off = logger_offset(log, reader->r_off +
-		sizeof(struct logger_entry) + count);
+	if (copy_header_to_user(reader->r_ver, entry, buf))
+		return -EFAULT;
+
+	if (copy_to_user(buf + hdr_len, entry->msg, entry->len))
+		return -EFAULT;
 
-	return count + get_user_hdr_len(reader->r_ver);
+	return hdr_len + entry->len;
 }
 
 static size_t get_next_entry_by_uid(struct logger_log *log,
 		size_t off, uid_t euid)
 {
-	while (off != log->w_off) {
+	while (off != log->c_off) {
 		struct logger_entry *entry;
 		struct logger_entry scratch;
 		size_t next_len;
@@ -192,17 +224,19 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 {
 	struct logger_reader *reader = file->private_data;
 	struct logger_log *log = reader->log;
+	struct logger_entry *entry;
 	ssize_t ret;
 	DEFINE_WAIT(wait);
 
+	mutex_lock(&reader->mutex);
 start:
 	while (1) {
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 
 		prepare_to_wait(&log->wq, &wait, TASK_INTERRUPTIBLE);
 
-		ret = (log->w_off == reader->r_off);
-		mutex_unlock(&log->mutex);
+		ret = (log->c_off == reader->r_off);
+		spin_unlock(&log->lock);
 		if (!ret)
 			break;
 
@@ -221,17 +255,17 @@ start:
 
 	finish_wait(&log->wq, &wait);
 	if (ret)
-		return ret;
+		goto out;
 
-	mutex_lock(&log->mutex);
+	spin_lock(&log->lock);
 
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
 
 	
-	if (unlikely(log->w_off == reader->r_off)) {
-		mutex_unlock(&log->mutex);
+	if (unlikely(log->c_off == reader->r_off)) {
+		spin_unlock(&log->lock);
 		goto start;
 	}
 
@@ -239,15 +273,19 @@ start:
 	ret = get_user_hdr_len(reader->r_ver) +
 		get_entry_msg_len(log, reader->r_off);
 	if (count < ret) {
+		spin_unlock(&log->lock);
 		ret = -EINVAL;
 		goto out;
 	}
 
+	entry = copy_entry_locked(log, reader);
+	spin_unlock(&log->lock);
+
 	
-	ret = do_read_log_to_user(log, reader, buf, ret);
+	ret = do_read_log_to_user(reader, entry, buf);
 
 out:
-	mutex_unlock(&log->mutex);
+	mutex_unlock(&reader->mutex);
 
 	return ret;
 }
@@ -295,46 +333,135 @@ static void fix_up_readers(struct logger_log *log, size_t len)
 			reader->r_off = get_next_entry(log, reader->r_off, len);
 }
 
-static void do_write_log(struct logger_log *log, const void *buf, size_t count)
+static size_t do_write_log(struct logger_log *log, size_t off,
+			   const void *buf, size_t count)
 {
 	size_t len;
 
-	len = min(count, log->size - log->w_off);
-	memcpy(log->buffer + log->w_off, buf, len);
+	len = min(count, log->size - off);
+	memcpy(log->buffer + off, buf, len);
 
 	if (count != len)
 		memcpy(log->buffer, buf + len, count - len);
 
-	log->w_off = logger_offset(log, log->w_off + count);
-
+	return logger_offset(log, off + count);
 }
 
-static ssize_t do_write_log_from_user(struct logger_log *log,
+static ssize_t do_write_log_from_user(struct logger_log *log, size_t off,
 				      const void __user *buf, size_t count)
 {
 	size_t len;
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
+	len = min(count, log->size - off);
+	if (len && copy_from_user(log->buffer + off, buf, len))
 		return -EFAULT;
 
 	if (count != len)
 		if (copy_from_user(log->buffer, buf + len, count - len))
 			return -EFAULT;
 
-	log->w_off = logger_offset(log, log->w_off + count);
-
 	return count;
 }
 
+/*
+ * A reservation must not wrap onto an entry that is still being copied
+ * into, and at most LOGGER_MAX_INFLIGHT entries can be in flight.
+ */
+static bool logger_has_room(struct logger_log *log, size_t len)
+{
+	return log->r_seq - log->c_seq < LOGGER_MAX_INFLIGHT &&
+		logger_offset(log, log->w_off - log->c_off) + len < log->size;
+}
+
+/*
+ * logger_reserve - reserve room for an entry and write its header
+ *
+ * Evicts the oldest entries as needed, like a write always did. Sets *seq to
+ * the sequence number to commit the entry with and *off to where its payload
+ * goes. Fails only if interrupted while waiting for other writers to commit.
+ */
+static int logger_reserve(struct logger_log *log, struct logger_entry *header,
+			  unsigned int *seq, size_t *off)
+{
+	size_t len = sizeof(struct logger_entry) + header->len;
+	struct logger_slot *slot;
+
+	spin_lock(&log->lock);
+	while (unlikely(!logger_has_room(log, len))) {
+		int ret;
+
+		spin_unlock(&log->lock);
+		ret = wait_event_interruptible(log->space_wq,
+					       logger_has_room(log, len));
+		if (ret)
+			return ret;
+		spin_lock(&log->lock);
+	}
+
+	fix_up_readers(log, len);
+
+	*seq = log->r_seq++;
+	slot = &log->slots[*seq % LOGGER_MAX_INFLIGHT];
+	slot->start = log->w_off;
+	slot->done = false;
+	*off = do_write_log(log, log->w_off, header, sizeof(*header));
+	log->w_off = logger_offset(log, *off + header->len);
+	slot->end = log->w_off;
+	spin_unlock(&log->lock);
+
+	return 0;
+}
+
+/* Called with log->lock held once the payload of slot seq is final. */
+static void logger_commit_locked(struct logger_log *log, unsigned int seq)
+{
+	log->slots[seq % LOGGER_MAX_INFLIGHT].done = true;
+
+	while (log->c_seq != log->r_seq) {
+		struct logger_slot *slot =
+			&log->slots[log->c_seq % LOGGER_MAX_INFLIGHT];
+
+		if (!slot->done)
+			break;
+		log->c_off = slot->end;
+		log->c_seq++;
+	}
+}
+
+/*
+ * logger_abort_locked - give up on an entry whose payload could not be copied
+ *
+ * The latest reservation is simply handed back. Once another writer has
+ * reserved behind it the space cannot be, so the payload is cleared and the
+ * entry committed as is.
+ */
+static void logger_abort_locked(struct logger_log *log, unsigned int seq,
+				size_t off, size_t len)
+{
+	struct logger_slot *slot = &log->slots[seq % LOGGER_MAX_INFLIGHT];
+
+	if (seq + 1 == log->r_seq) {
+		log->w_off = slot->start;
+		log->r_seq--;
+		return;
+	}
+
+	memset(log->buffer + off, 0, min(len, log->size - off));
+	if (len > log->size - off)
+		memset(log->buffer, 0, len - (log->size - off));
+	logger_commit_locked(log, seq);
+}
+
 ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig = log->w_off;
 	struct logger_entry header;
 	struct timespec now;
+	size_t off, payload;
+	unsigned int seq;
 	ssize_t ret = 0;
+	int err;
 
 	now = current_kernel_time();
 
@@ -350,11 +477,10 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
-	mutex_lock(&log->mutex);
-
-	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
-
-	do_write_log(log, &header, sizeof(struct logger_entry));
+	err = logger_reserve(log, &header, &seq, &off);
+	if (unlikely(err))
+		return err;
+	payload = off;
 
 	while (nr_segs-- > 0) {
 		size_t len;
@@ -364,19 +490,33 @@ ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 		len = min_t(size_t, iov->iov_len, header.len - ret);
 
 		
-		nr = do_write_log_from_user(log, iov->iov_base, len);
+		nr = do_write_log_from_user(log, off, iov->iov_base, len);
 		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
+			spin_lock(&log->lock);
+			logger_abort_locked(log, seq, payload, header.len);
+			spin_unlock(&log->lock);
+			wake_up_interruptible(&log->space_wq);
+			wake_up_interruptible(&log->wq);
 			return nr;
 		}
 
+		off = logger_offset(log, off + nr);
 		iov++;
 		ret += nr;
 	}
 
-	mutex_unlock(&log->mutex);
-
+	spin_lock(&log->lock);
+	logger_commit_locked(log, seq);
+	spin_unlock(&log->lock);
+
+	/*
+	 * Order the commit against the waitqueue check, pairing with the
+	 * barrier in prepare_to_wait(), so a writer which just found the
+	 * ring full is either seen here or sees the room we made.
+	 */
+	smp_mb();
+	if (waitqueue_active(&log->space_wq))
+		wake_up_interruptible(&log->space_wq);
 	
 	wake_up_interruptible(&log->wq);
 
@@ -411,11 +551,12 @@ static int logger_open(struct inode *inode, struct file *file)
 			capable(CAP_SYSLOG);
 
 		INIT_LIST_HEAD(&reader->list);
+		mutex_init(&reader->mutex);
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		reader->r_off = log->head;
 		list_add_tail(&reader->list, &log->readers);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
 		file->private_data = reader;
 	} else
@@ -430,9 +571,9 @@ static int logger_release(struct inode *ignored, struct file *file)
 		struct logger_reader *reader = file->private_data;
 		struct logger_log *log = reader->log;
 
-		mutex_lock(&log->mutex);
+		spin_lock(&log->lock);
 		list_del(&reader->list);
-		mutex_unlock(&log->mutex);
+		spin_unlock(&log->lock);
 
 		kfree(reader);
 	}
@@ -454,14 +595,14 @@ static unsigned int logger_poll(struct file *file, poll_table *wait)
 
 	poll_wait(file, &log->wq, wait);
 
-	mutex_lock(&log->mutex);
+	spin_lock(&log->lock);
 	if (!reader->r_all)
 		reader->r_off = get_next_entry_by_uid(log,
 			reader->r_off, current_euid());
 
-	if (log->w_off != reader->r_off)
+	if (log->c_off != reader->r_off)
 		ret |= POLLIN | POLLRDNORM;
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
@@ -486,7 +627,21 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	long ret = -EINVAL;
 	void __user *argp = (void __user *) arg;
 
-	mutex_lock(&log->mutex);
+	/*
+	 * may fault on argp, so it is handled outside of log->lock, but under
+	 * reader->mutex so that a concurrent read sees one header version
+	 */
+	if (cmd == LOGGER_SET_VERSION) {
+		if (!(file->f_mode & FMODE_READ))
+			return -EBADF;
+		reader = file->private_data;
+		mutex_lock(&reader->mutex);
+		ret = logger_set_version(reader, argp);
+		mutex_unlock(&reader->mutex);
+		return ret;
+	}
+
+	spin_lock(&log->lock);
 
 	switch (cmd) {
 	case LOGGER_GET_LOG_BUF_SIZE:
@@ -498,10 +653,10 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		reader = file->private_data;
-		if (log->w_off >= reader->r_off)
-			ret = log->w_off - reader->r_off;
+		if (log->c_off >= reader->r_off)
+			ret = log->c_off - reader->r_off;
 		else
-			ret = (log->size - reader->r_off) + log->w_off;
+			ret = (log->size - reader->r_off) + log->c_off;
 		break;
 	case LOGGER_GET_NEXT_ENTRY_LEN:
 		if (!(file->f_mode & FMODE_READ)) {
@@ -514,7 +669,7 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			reader->r_off = get_next_entry_by_uid(log,
 				reader->r_off, current_euid());
 
-		if (log->w_off != reader->r_off)
+		if (log->c_off != reader->r_off)
 			ret = get_user_hdr_len(reader->r_ver) +
 				get_entry_msg_len(log, reader->r_off);
 		else
@@ -526,8 +681,8 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			break;
 		}
 		list_for_each_entry(reader, &log->readers, list)
-			reader->r_off = log->w_off;
-		log->head = log->w_off;
+			reader->r_off = log->c_off;
+		log->head = log->c_off;
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -538,17 +693,9 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		reader = file->private_data;
 		ret = reader->r_ver;
 		break;
-	case LOGGER_SET_VERSION:
-		if (!(file->f_mode & FMODE_READ)) {
-			ret = -EBADF;
-			break;
-		}
-		reader = file->private_data;
-		ret = logger_set_version(reader, argp);
-		break;
 	}
 
-	mutex_unlock(&log->mutex);
+	spin_unlock(&log->lock);
 
 	return ret;
 }
@@ -575,9 +722,11 @@ static struct logger_log VAR = { \
 		.parent = NULL, \
 	}, \
 	.wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .wq), \
+	.space_wq = __WAIT_QUEUE_HEAD_INITIALIZER(VAR .space_wq), \
 	.readers = LIST_HEAD_INIT(VAR .readers), \
-	.mutex = __MUTEX_INITIALIZER(VAR .mutex), \
+	.lock = __SPIN_LOCK_UNLOCKED(VAR .lock), \
 	.w_off = 0, \
+	.c_off = 0, \
 	.head = 0, \
 	.size = SIZE, \
 };
@@ -41,6 +41,11 @@
 #include <linux/delay.h>
 #include <linux/swap.h>
 #include <linux/fs.h>
+#include <linux/rbtree.h>
+#include <linux/ktime.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/lowmemorykiller.h>
 
 #ifdef CONFIG_HIGHMEM
 	#define _ZONE ZONE_HIGHMEM
@@ -114,6 +119,145 @@ static int test_task_flag(struct task_struct *p, int flag)
 
 static DEFINE_MUTEX(scan_mutex);
 
+/*
+ * Thread group leaders ordered by (oom_score_adj, pid), so the shrinker can
+ * start from the most killable processes instead of walking every task.
+ */
+#define LOWMEM_SCAN_BATCH	16
+
+static struct rb_root lowmem_adj_tree = RB_ROOT;
+static DEFINE_SPINLOCK(lowmem_adj_lock);
+
+static inline bool lowmem_adj_less(int adj_a, pid_t pid_a,
+				   int adj_b, pid_t pid_b)
+{
+	return adj_a < adj_b || (adj_a == adj_b && pid_a < pid_b);
+}
+
+static void __lowmem_adj_index_insert(struct task_struct *p)
+{
+	struct rb_node **link = &lowmem_adj_tree.rb_node;
+	struct rb_node *parent = NULL;
+	struct task_struct *entry;
+
+	p->lmk_adj = p->signal->oom_score_adj;
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct task_struct, lmk_adj_node);
+		if (lowmem_adj_less(p->lmk_adj, p->pid,
+				    entry->lmk_adj, entry->pid))
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&p->lmk_adj_node, parent, link);
+	rb_insert_color(&p->lmk_adj_node, &lowmem_adj_tree);
+}
+
+void lowmem_adj_index_add(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	__lowmem_adj_index_insert(p);
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+void lowmem_adj_index_del(struct task_struct *p)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	if (!RB_EMPTY_NODE(&p->lmk_adj_node)) {
+		rb_erase(&p->lmk_adj_node, &lowmem_adj_tree);
+		RB_CLEAR_NODE(&p->lmk_adj_node);
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+/* de_thread(): @new takes over the pid and the place of @old */
+void lowmem_adj_index_replace(struct task_struct *old, struct task_struct *new)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	if (!RB_EMPTY_NODE(&old->lmk_adj_node)) {
+		new->lmk_adj = old->lmk_adj;
+		rb_replace_node(&old->lmk_adj_node, &new->lmk_adj_node,
+				&lowmem_adj_tree);
+		RB_CLEAR_NODE(&old->lmk_adj_node);
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+}
+
+void lowmem_adj_index_update(struct task_struct *task)
+{
+	struct task_struct *p;
+	unsigned long flags;
+
+	rcu_read_lock();
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	p = task->group_leader;
+	if (!RB_EMPTY_NODE(&p->lmk_adj_node) &&
+	    p->lmk_adj != p->signal->oom_score_adj) {
+		rb_erase(&p->lmk_adj_node, &lowmem_adj_tree);
+		__lowmem_adj_index_insert(p);
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+	rcu_read_unlock();
+}
+
+/*
+ * Take references on up to LOWMEM_SCAN_BATCH processes with
+ * oom_score_adj >= min_score_adj, in descending order, starting from the
+ * top of the index or below the (*adj, *pid) position of a previous batch.
+ */
+static int lowmem_adj_index_collect(struct task_struct **batch,
+				    int min_score_adj, bool first,
+				    int *adj, pid_t *pid)
+{
+	struct rb_node *node, *prev = NULL;
+	struct task_struct *p;
+	unsigned long flags;
+	int nr = 0;
+
+	spin_lock_irqsave(&lowmem_adj_lock, flags);
+	if (first) {
+		prev = rb_last(&lowmem_adj_tree);
+	} else {
+		node = lowmem_adj_tree.rb_node;
+		while (node) {
+			p = rb_entry(node, struct task_struct, lmk_adj_node);
+			if (lowmem_adj_less(p->lmk_adj, p->pid, *adj, *pid)) {
+				prev = node;
+				node = node->rb_right;
+			} else {
+				node = node->rb_left;
+			}
+		}
+	}
+
+	for (node = prev; node && nr < LOWMEM_SCAN_BATCH;
+	     node = rb_prev(node)) {
+		p = rb_entry(node, struct task_struct, lmk_adj_node);
+		if (p->lmk_adj < min_score_adj)
+			break;
+		get_task_struct(p);
+		batch[nr++] = p;
+		*adj = p->lmk_adj;
+		*pid = p->pid;
+	}
+	spin_unlock_irqrestore(&lowmem_adj_lock, flags);
+
+	return nr;
+}
+
+static void lowmem_put_batch(struct task_struct **batch, int nr)
+{
+	while (nr)
+		put_task_struct(batch[--nr]);
+}
+
 int can_use_cma_pages(gfp_t gfp_mask)
 {
 	int can_use = 0;
@@ -158,6 +302,11 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	unsigned long nr_to_scan = sc->nr_to_scan;
 	struct zone *zone;
 	int use_cma = can_use_cma_pages(sc->gfp_mask);
+	struct task_struct *batch[LOWMEM_SCAN_BATCH];
+	int nr, nr_scanned = 0;
+	int batch_adj = 0;
+	pid_t batch_pid = 0;
+	ktime_t start;
 
 	if (nr_to_scan > 0) {
 		if (!mutex_trylock(&scan_mutex)) {
@@ -218,59 +367,88 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	}
 	selected_oom_score_adj = min_score_adj;
 
-	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		int oom_score_adj;
+	start = ktime_get();
+	do {
+		nr = lowmem_adj_index_collect(batch, min_score_adj,
+					      !nr_scanned, &batch_adj,
+					      &batch_pid);
+		nr_scanned += nr;
+
+		rcu_read_lock();
+		for (i = 0; i < nr; i++) {
+			struct task_struct *p;
+			int oom_score_adj;
+
+			tsk = batch[i];
+			if (tsk->flags & PF_KTHREAD)
+				continue;
 
-		if (tsk->flags & PF_KTHREAD)
-			continue;
+			
+			if (test_task_flag(tsk, TIF_MM_RELEASED))
+				continue;
 
-		
-		if (test_task_flag(tsk, TIF_MM_RELEASED))
-			continue;
-
-		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			if (test_task_flag(tsk, TIF_MEMDIE)) {
-				lowmem_print(2, "skipping , waiting for process %d (%s) dead\n",
-				tsk->pid, tsk->comm);
-				rcu_read_unlock();
-				
-				if (!(lowmem_only_kswapd_sleep && !current_is_kswapd())) {
-					msleep_interruptible(lowmem_sleep_ms);
+			if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+				if (test_task_flag(tsk, TIF_MEMDIE)) {
+					lowmem_print(2, "skipping , waiting for process %d (%s) dead\n",
+					tsk->pid, tsk->comm);
+					rcu_read_unlock();
+					lowmem_put_batch(batch, nr);
+					if (selected)
+						put_task_struct(selected);
+					
+					if (!(lowmem_only_kswapd_sleep && !current_is_kswapd())) {
+						msleep_interruptible(lowmem_sleep_ms);
+					}
+					mutex_unlock(&scan_mutex);
+					return 0;
 				}
-				mutex_unlock(&scan_mutex);
-				return 0;
 			}
-		}
 
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
+			p = find_lock_task_mm(tsk);
+			if (!p)
+				continue;
 
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
+			oom_score_adj = p->signal->oom_score_adj;
+			if (oom_score_adj < min_score_adj) {
+				task_unlock(p);
 				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
+			}
+			tasksize = get_mm_rss(p->mm);
+			if (tasksize <= 0) {
+				task_unlock(p);
 				continue;
+			}
+			if (selected) {
+				if (oom_score_adj < selected_oom_score_adj ||
+				    (oom_score_adj == selected_oom_score_adj &&
+				     tasksize <= selected_tasksize)) {
+					task_unlock(p);
+					continue;
+				}
+				put_task_struct(selected);
+			}
+			get_task_struct(p);
+			task_unlock(p);
+			selected = p;
+			selected_tasksize = tasksize;
+			selected_oom_score_adj = oom_score_adj;
+			selected_oom_adj = p->signal->oom_adj;
+			lowmem_print(2, "select %d (%s), oom_adj %d score_adj %d, size %d, to kill\n",
+				     p->pid, p->comm, selected_oom_adj, oom_score_adj, tasksize);
 		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		selected_oom_adj = p->signal->oom_adj;
-		lowmem_print(2, "select %d (%s), oom_adj %d score_adj %d, size %d, to kill\n",
-			     p->pid, p->comm, selected_oom_adj, oom_score_adj, tasksize);
-	}
+		rcu_read_unlock();
+		lowmem_put_batch(batch, nr);
+
+		/* nothing left below the last batch can beat the selection */
+		if (selected && selected_oom_score_adj > batch_adj)
+			break;
+	} while (nr == LOWMEM_SCAN_BATCH);
+
+	trace_lowmem_select(selected, selected ? selected_oom_score_adj : 0,
+			    selected ? selected_tasksize : 0, min_score_adj,
+			    nr_scanned,
+			    ktime_to_ns(ktime_sub(ktime_get(), start)));
+
 	if (selected) {
 		bool should_dump_meminfo = false;
 
@@ -293,7 +471,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		send_sig(SIGKILL, selected, 0);
 		set_tsk_thread_flag(selected, TIF_MEMDIE);
 		rem -= selected_tasksize;
-		rcu_read_unlock();
+		put_task_struct(selected);
 
 		if (should_dump_meminfo) {
 			show_meminfo();
@@ -303,8 +481,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 		
 		if (!(lowmem_only_kswapd_sleep && !current_is_kswapd()))
 			msleep_interruptible(lowmem_sleep_ms);
-	} else
-		rcu_read_unlock();
+	}
 
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     nr_to_scan, sc->gfp_mask, rem);
@@ -0,0 +1,178 @@
+/*
+ * Compressed RAM block device - deduplication of compressed pages
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include "zram_drv.h"
+#include "zram_dedup.h"
+
+/* One hash bucket per 1024 pages of disk */
+#define ZRAM_HASH_SHIFT		10
+#define ZRAM_HASH_SIZE_MIN	(1 << 4)
+
+u32 zram_dedup_checksum(unsigned char *mem)
+{
+	return jhash2((const u32 *)mem, PAGE_SIZE / sizeof(u32), 0);
+}
+
+static struct zram_hash *zram_dedup_bucket(struct zram_meta *meta,
+					u32 checksum)
+{
+	return &meta->hash[checksum % meta->hash_size];
+}
+
+struct zram_entry *zram_dedup_insert(struct zram *zram, unsigned long handle,
+				u16 len, u32 checksum)
+{
+	struct zram_hash *hash;
+	struct rb_node **rb_node, *parent = NULL;
+	struct zram_entry *entry, *tmp;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->len = len;
+	entry->checksum = checksum;
+	entry->refcount = 1;
+
+	hash = zram_dedup_bucket(zram->meta, checksum);
+	spin_lock(&hash->lock);
+	rb_node = &hash->rb_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		tmp = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < tmp->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, rb_node);
+	rb_insert_color(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	return entry;
+}
+
+static bool zram_dedup_match(struct zram *zram, struct zram_entry *entry,
+			unsigned char *mem, unsigned char *buf)
+{
+	struct zs_pool *pool = zram->meta->mem_pool;
+	unsigned char *cmem;
+	bool match;
+
+	cmem = zs_map_object(pool, entry->handle, ZS_MM_RO);
+	if (entry->len == PAGE_SIZE)
+		match = !memcmp(mem, cmem, PAGE_SIZE);
+	else
+		match = !zcomp_decompress(zram->comp, cmem, entry->len, buf) &&
+			!memcmp(mem, buf, PAGE_SIZE);
+	zs_unmap_object(pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Look for a stored page with the same contents as @mem. @buf is a
+ * PAGE_SIZE scratch buffer used to decompress candidates. On success
+ * a reference is taken on the returned entry.
+ */
+struct zram_entry *zram_dedup_find(struct zram *zram, unsigned char *mem,
+				u32 checksum, unsigned char *buf)
+{
+	struct zram_hash *hash;
+	struct rb_node *rb_node;
+	struct zram_entry *entry = NULL;
+
+	hash = zram_dedup_bucket(zram->meta, checksum);
+	spin_lock(&hash->lock);
+	rb_node = hash->rb_root.rb_node;
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_entry, rb_node);
+		if (checksum == entry->checksum)
+			break;
+		if (checksum < entry->checksum)
+			rb_node = rb_node->rb_left;
+		else
+			rb_node = rb_node->rb_right;
+	}
+	if (!rb_node) {
+		spin_unlock(&hash->lock);
+		return NULL;
+	}
+	entry->refcount++;
+	spin_unlock(&hash->lock);
+	atomic64_add(entry->len, &zram->stats.dup_data_size);
+
+	/* Checksum collisions are rare, only the first candidate is tried */
+	if (zram_dedup_match(zram, entry, mem, buf))
+		return entry;
+
+	zram_dedup_put(zram, entry);
+	return NULL;
+}
+
+void zram_dedup_put(struct zram *zram, struct zram_entry *entry)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_hash *hash;
+	unsigned long refcount;
+
+	hash = zram_dedup_bucket(meta, entry->checksum);
+	spin_lock(&hash->lock);
+	refcount = --entry->refcount;
+	if (!refcount)
+		rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	if (refcount) {
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return;
+	}
+
+	zs_free(meta->mem_pool, entry->handle);
+	atomic64_sub(entry->len, &zram->stats.compr_size);
+	kfree(entry);
+}
+
+int zram_dedup_init(struct zram_meta *meta, size_t num_pages)
+{
+	size_t i;
+
+	meta->hash_size = num_pages >> ZRAM_HASH_SHIFT;
+	meta->hash_size = max_t(size_t, meta->hash_size, ZRAM_HASH_SIZE_MIN);
+	meta->hash = vzalloc(meta->hash_size * sizeof(struct zram_hash));
+	if (!meta->hash) {
+		pr_err("Error allocating zram entry hash\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < meta->hash_size; i++) {
+		spin_lock_init(&meta->hash[i].lock);
+		meta->hash[i].rb_root = RB_ROOT;
+	}
+
+	return 0;
+}
+
+void zram_dedup_fini(struct zram_meta *meta)
+{
+	vfree(meta->hash);
+	meta->hash = NULL;
+	meta->hash_size = 0;
+}
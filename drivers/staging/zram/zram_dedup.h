@@ -0,0 +1,50 @@
+/*
+ * Compressed RAM block device - deduplication of compressed pages
+ *
+ * This code is released using a dual license strategy: BSD/GPL
+ * You can choose the licence that better fits your requirements.
+ *
+ * Released under the terms of 3-clause BSD License
+ * Released under the terms of GNU General Public License Version 2.0
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+struct zram;
+struct zram_meta;
+struct zram_entry;
+
+#ifdef CONFIG_ZRAM_DEDUP
+u32 zram_dedup_checksum(unsigned char *mem);
+struct zram_entry *zram_dedup_find(struct zram *zram, unsigned char *mem,
+				u32 checksum, unsigned char *buf);
+struct zram_entry *zram_dedup_insert(struct zram *zram, unsigned long handle,
+				u16 len, u32 checksum);
+void zram_dedup_put(struct zram *zram, struct zram_entry *entry);
+
+int zram_dedup_init(struct zram_meta *meta, size_t num_pages);
+void zram_dedup_fini(struct zram_meta *meta);
+#else
+static inline u32 zram_dedup_checksum(unsigned char *mem) { return 0; }
+static inline struct zram_entry *zram_dedup_find(struct zram *zram,
+		unsigned char *mem, u32 checksum, unsigned char *buf)
+{
+	return NULL;
+}
+static inline struct zram_entry *zram_dedup_insert(struct zram *zram,
+		unsigned long handle, u16 len, u32 checksum)
+{
+	return NULL;
+}
+static inline void zram_dedup_put(struct zram *zram,
+		struct zram_entry *entry) { }
+
+static inline int zram_dedup_init(struct zram_meta *meta, size_t num_pages)
+{
+	return 0;
+}
+static inline void zram_dedup_fini(struct zram_meta *meta) { }
+#endif
+
+#endif /* _ZRAM_DEDUP_H_ */
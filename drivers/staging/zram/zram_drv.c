@@ -29,12 +29,13 @@
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 #include <linux/ratelimit.h>
+#include <linux/workqueue.h>
 
 #include "zram_drv.h"
+#include "zram_dedup.h"
 
 static int zram_major;
 static struct zram *zram_devices;
@@ -42,6 +43,7 @@ static struct zram *zram_devices;
 #define ALLOC_ERROR_LOG_RATE_MS 1000
 
 static unsigned int num_devices = 1;
+static const char *default_compressor = "lzo";
 
 static inline struct zram *dev_to_zram(struct device *dev)
 {
@@ -108,6 +110,23 @@ static ssize_t zero_pages_show(struct device *dev,
 	return sprintf(buf, "%u\n", zram->stats.pages_zero);
 }
 
+static ssize_t same_pages_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%u\n", zram->stats.pages_same);
+}
+
+static ssize_t dup_data_size_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%llu\n",
+			(u64)atomic64_read(&zram->stats.dup_data_size));
+}
+
 static ssize_t orig_data_size_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -131,16 +150,171 @@ static ssize_t mem_used_total_show(struct device *dev,
 {
 	u64 val = 0;
 	struct zram *zram = dev_to_zram(dev);
-	struct zram_meta *meta = zram->meta;
 
 	down_read(&zram->init_lock);
 	if (zram->init_done)
-		val = zs_get_total_size_bytes(meta->mem_pool);
+		val = zs_get_total_size_bytes(zram->meta->mem_pool);
 	up_read(&zram->init_lock);
 
 	return sprintf(buf, "%llu\n", val);
 }
 
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	zs_compact(meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t num_compacted_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	u64 val = 0;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (zram->init_done)
+		val = zs_get_pages_compacted(zram->meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return sprintf(buf, "%llu\n", val << PAGE_SHIFT);
+}
+
+static ssize_t max_comp_streams_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->max_comp_streams;
+	up_read(&zram->init_lock);
+
+	return sprintf(buf, "%d\n", val);
+}
+
+static ssize_t max_comp_streams_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int num;
+	struct zram *zram = dev_to_zram(dev);
+	int ret;
+
+	ret = kstrtoint(buf, 0, &num);
+	if (ret < 0)
+		return ret;
+	if (num < 1)
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		if (!zcomp_set_max_streams(zram->comp, num)) {
+			pr_info("Cannot change max compression streams\n");
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	zram->max_comp_streams = num;
+	ret = len;
+out:
+	up_write(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t comp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->compressor, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t comp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[sizeof(zram->compressor)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	if (!zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+	strlcpy(zram->compressor, compressor, sizeof(compressor));
+	up_write(&zram->init_lock);
+	return len;
+}
+
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return sprintf(buf, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+	int ret;
+
+	ret = kstrtoint(buf, 10, &val);
+	if (ret < 0)
+		return ret;
+	if (val != 0 && val != 1)
+		return -EINVAL;
+#ifndef CONFIG_ZRAM_DEDUP
+	if (val)
+		return -EINVAL;
+#endif
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
 {
@@ -187,53 +361,44 @@ static inline int valid_io_request(struct zram *zram, struct bio *bio)
 
 static void zram_meta_free(struct zram_meta *meta)
 {
+	zram_dedup_fini(meta);
 	zs_destroy_pool(meta->mem_pool);
-	kfree(meta->compress_workmem);
-	free_pages((unsigned long)meta->compress_buffer, 1);
 	vfree(meta->table);
 	kfree(meta);
 }
 
-static struct zram_meta *zram_meta_alloc(u64 disksize)
+static struct zram_meta *zram_meta_alloc(const char *name, u64 disksize,
+					bool use_dedup)
 {
 	size_t num_pages;
-	struct zram_meta *meta = kmalloc(sizeof(*meta), GFP_KERNEL);
+	struct zram_meta *meta = kzalloc(sizeof(*meta), GFP_KERNEL);
 	if (!meta)
 		goto out;
 
-	meta->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!meta->compress_workmem)
-		goto free_meta;
-
-	meta->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!meta->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		goto free_workmem;
-	}
-
 	num_pages = disksize >> PAGE_SHIFT;
 	meta->table = vzalloc(num_pages * sizeof(*meta->table));
 	if (!meta->table) {
 		pr_err("Error allocating zram address table\n");
-		goto free_buffer;
+		goto free_meta;
 	}
 
-	meta->mem_pool = zs_create_pool(GFP_NOIO | __GFP_HIGHMEM |
+	meta->mem_pool = zs_create_pool(name, GFP_NOIO | __GFP_HIGHMEM |
 					__GFP_NOWARN);
 	if (!meta->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		goto free_table;
 	}
 
+	if (use_dedup && zram_dedup_init(meta, num_pages))
+		goto free_pool;
+
+	rwlock_init(&meta->tb_lock);
 	return meta;
 
+free_pool:
+	zs_destroy_pool(meta->mem_pool);
 free_table:
 	vfree(meta->table);
-free_buffer:
-	free_pages((unsigned long)meta->compress_buffer, 1);
-free_workmem:
-	kfree(meta->compress_workmem);
 free_meta:
 	kfree(meta);
 	meta = NULL;
@@ -241,6 +406,242 @@ out:
 	return meta;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+#define ZRAM_WB_BATCH	32
+
+static struct workqueue_struct *zram_wb_wq;
+
+struct zram_bio_ctl {
+	atomic_t pending;
+	int err;
+	struct completion done;
+};
+
+struct zram_work {
+	struct work_struct work;
+	struct zram *zram;
+	unsigned long blk_idx;
+	struct page *page;
+	int err;
+};
+
+static void reset_bdev(struct zram *zram)
+{
+	if (!zram->bdev)
+		return;
+
+	set_blocksize(zram->bdev, zram->old_block_size);
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	vfree(zram->bitmap);
+	kfree(zram->backing_dev);
+
+	zram->bdev = NULL;
+	zram->backing_dev = NULL;
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	ret = sprintf(buf, "%s\n",
+			zram->backing_dev ? zram->backing_dev : "none");
+	up_read(&zram->init_lock);
+
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct block_device *bdev = NULL;
+	unsigned long nr_pages, *bitmap = NULL;
+	unsigned int old_block_size;
+	char *file_name;
+	size_t sz;
+	int err;
+
+	file_name = kstrndup(buf, PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	bdev = blkdev_get_by_path(file_name,
+			FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (IS_ERR(bdev)) {
+		err = PTR_ERR(bdev);
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	old_block_size = block_size(bdev);
+	err = set_blocksize(bdev, PAGE_SIZE);
+	if (err)
+		goto out;
+
+	reset_bdev(zram);
+
+	zram->bdev = bdev;
+	zram->backing_dev = file_name;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	zram->old_block_size = old_block_size;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	return len;
+
+out:
+	vfree(bitmap);
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	up_write(&zram->init_lock);
+	kfree(file_name);
+	return err;
+}
+
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	/* skip block 0 so a written back slot never has a zero handle */
+	unsigned long blk_idx = 1;
+
+retry:
+	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
+	if (blk_idx >= zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		goto retry;
+
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	WARN_ON_ONCE(!test_and_clear_bit(blk_idx, zram->bitmap));
+}
+
+static void zram_bio_end_io(struct bio *bio, int err)
+{
+	struct zram_bio_ctl *ctl = bio->bi_private;
+
+	if (err)
+		ctl->err = err;
+	bio_put(bio);
+
+	if (atomic_dec_and_test(&ctl->pending))
+		complete(&ctl->done);
+}
+
+static void zram_bio_ctl_init(struct zram_bio_ctl *ctl)
+{
+	atomic_set(&ctl->pending, 1);
+	ctl->err = 0;
+	init_completion(&ctl->done);
+}
+
+static int zram_bio_ctl_wait(struct zram_bio_ctl *ctl)
+{
+	if (!atomic_dec_and_test(&ctl->pending))
+		wait_for_completion(&ctl->done);
+
+	return ctl->err;
+}
+
+static struct bio *zram_bio_alloc(struct zram *zram, struct zram_bio_ctl *ctl,
+				unsigned long blk_idx, int nr_vecs)
+{
+	struct bio *bio;
+
+	bio = bio_alloc(GFP_NOIO, nr_vecs);
+	if (!bio)
+		return NULL;
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_sector = blk_idx << SECTORS_PER_PAGE_SHIFT;
+	bio->bi_end_io = zram_bio_end_io;
+	bio->bi_private = ctl;
+	atomic_inc(&ctl->pending);
+
+	return bio;
+}
+
+static void zram_sync_read(struct work_struct *work)
+{
+	struct zram_work *zw = container_of(work, struct zram_work, work);
+	struct zram *zram = zw->zram;
+	struct zram_bio_ctl ctl;
+	struct bio *bio;
+
+	zram_bio_ctl_init(&ctl);
+	bio = zram_bio_alloc(zram, &ctl, zw->blk_idx, 1);
+	if (!bio) {
+		zw->err = -ENOMEM;
+		return;
+	}
+
+	bio_add_page(bio, zw->page, PAGE_SIZE, 0);
+	submit_bio(READ, bio);
+	zw->err = zram_bio_ctl_wait(&ctl);
+	if (!zw->err)
+		atomic64_inc(&zram->stats.bd_reads);
+}
+
+/*
+ * A bio submitted from within zram's make_request function is only
+ * issued once that function returns, so waiting for it there would
+ * deadlock. Do the read from a worker and wait for that instead.
+ */
+static int read_from_bdev(struct zram *zram, struct page *page,
+			unsigned long blk_idx)
+{
+	struct zram_work work;
+
+	work.zram = zram;
+	work.page = page;
+	work.blk_idx = blk_idx;
+
+	INIT_WORK_ONSTACK(&work.work, zram_sync_read);
+	queue_work(zram_wb_wq, &work.work);
+	flush_work(&work.work);
+	destroy_work_on_stack(&work.work);
+
+	return work.err;
+}
+#else
+static inline void reset_bdev(struct zram *zram) { }
+static inline void free_block_bdev(struct zram *zram,
+			unsigned long blk_idx) { }
+static inline int read_from_bdev(struct zram *zram, struct page *page,
+			unsigned long blk_idx)
+{
+	return -EIO;
+}
+#endif
+
 static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 {
 	if (*offset + bvec->bv_len >= PAGE_SIZE)
@@ -248,88 +649,141 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
-static int page_zero_filled(void *ptr)
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
+	unsigned long val;
 
 	page = (unsigned long *)ptr;
+	val = page[0];
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != val)
 			return 0;
 	}
 
+	*element = val;
 	return 1;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void zram_fill_page(void *ptr, unsigned int len, unsigned long value)
+{
+	unsigned long *page = ptr;
+	unsigned int pos;
+
+	if (likely(value == 0)) {
+		memset(ptr, 0, len);
+		return;
+	}
+
+	for (pos = 0; pos < len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
-		clear_page(user_mem);
+	zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
 }
 
+static unsigned long zram_get_handle(struct zram_meta *meta, u32 index)
+{
+	struct zram_entry *entry;
+
+	if (!zram_test_flag(meta, index, ZRAM_DEDUP))
+		return meta->table[index].handle;
+
+	entry = (struct zram_entry *)meta->table[index].handle;
+	return entry->handle;
+}
+
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 	u16 size = meta->table[index].size;
 
-	if (unlikely(!handle)) {
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, handle);
+#ifdef CONFIG_ZRAM_WRITEBACK
+		atomic64_dec(&zram->stats.bd_count);
+#endif
+		meta->table[index].handle = 0;
+		return;
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		if (handle)
+			zram->stats.pages_same--;
+		else
 			zram->stats.pages_zero--;
-		}
+		meta->table[index].handle = 0;
 		return;
 	}
 
+	if (unlikely(!handle))
+		return;
+
 	if (unlikely(size > max_zpage_size))
 		zram->stats.bad_compress--;
 
-	zs_free(meta->mem_pool, handle);
+	if (zram_test_flag(meta, index, ZRAM_DEDUP)) {
+		zram_clear_flag(meta, index, ZRAM_DEDUP);
+		zram_dedup_put(zram, (struct zram_entry *)handle);
+	} else {
+		zs_free(meta->mem_pool, handle);
+		atomic64_sub(size, &zram->stats.compr_size);
+	}
 
 	if (size <= PAGE_SIZE / 2)
 		zram->stats.good_compress--;
 
-	atomic64_sub(meta->table[index].size, &zram->stats.compr_size);
 	zram->stats.pages_stored--;
 
 	meta->table[index].handle = 0;
 	meta->table[index].size = 0;
 }
 
-static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
+/* Caller must hold tb_lock and the slot must not be written back */
+static int __zram_decompress_page(struct zram *zram, char *mem, u32 index)
 {
-	int ret = LZO_E_OK;
-	size_t clen = PAGE_SIZE;
+	int ret = 0;
 	unsigned char *cmem;
 	struct zram_meta *meta = zram->meta;
-	unsigned long handle = meta->table[index].handle;
+	unsigned long handle;
+	u16 size;
+
+	handle = meta->table[index].handle;
+	size = meta->table[index].size;
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
-		clear_page(mem);
+	if (!handle || zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_fill_page(mem, PAGE_SIZE, handle);
 		return 0;
 	}
+	handle = zram_get_handle(meta, index);
 
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
-	if (meta->table[index].size == PAGE_SIZE)
+	if (size == PAGE_SIZE)
 		copy_page(mem, cmem);
 	else
-		ret = lzo1x_decompress_safe(cmem, meta->table[index].size,
-						mem, &clen);
+		ret = zcomp_decompress(zram->comp, cmem, size, mem);
 	zs_unmap_object(meta->mem_pool, handle);
 
 	
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		atomic64_inc(&zram->stats.failed_reads);
 		return ret;
@@ -338,6 +792,88 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	return 0;
 }
 
+static int zram_read_bdev_page(struct zram *zram, char *mem, unsigned int len,
+			unsigned long blk_idx, int offset)
+{
+	struct page *page;
+	void *src;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = read_from_bdev(zram, page, blk_idx);
+	if (!ret) {
+		src = kmap_atomic(page);
+		memcpy(mem, src + offset, len);
+		kunmap_atomic(src);
+	} else {
+		pr_err("Backing device read failed! err=%d\n", ret);
+		atomic64_inc(&zram->stats.failed_reads);
+	}
+	__free_page(page);
+
+	return ret;
+}
+
+static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long blk_idx;
+	int ret;
+
+	read_lock(&meta->tb_lock);
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		blk_idx = meta->table[index].handle;
+		read_unlock(&meta->tb_lock);
+		return zram_read_bdev_page(zram, mem, PAGE_SIZE, blk_idx, 0);
+	}
+
+	ret = __zram_decompress_page(zram, mem, index);
+	read_unlock(&meta->tb_lock);
+
+	return ret;
+}
+
+static int zram_bvec_read_bdev(struct zram *zram, struct bio_vec *bvec,
+			unsigned long blk_idx, int offset)
+{
+	struct page *page = bvec->bv_page;
+	unsigned char *user_mem;
+	int ret;
+
+	if (!is_partial_io(bvec)) {
+		ret = read_from_bdev(zram, page, blk_idx);
+		if (unlikely(ret)) {
+			pr_err("Backing device read failed! err=%d\n", ret);
+			atomic64_inc(&zram->stats.failed_reads);
+			return ret;
+		}
+	} else {
+		user_mem = kmap(page);
+		ret = zram_read_bdev_page(zram, user_mem + bvec->bv_offset,
+					bvec->bv_len, blk_idx, offset);
+		kunmap(page);
+		if (unlikely(ret))
+			return ret;
+	}
+
+	flush_dcache_page(page);
+	return 0;
+}
+
+/*
+ * Flags are updated with plain read-modify-write, so they may only change
+ * under the write side of tb_lock, never from a reader.
+ */
+static void zram_clear_idle(struct zram_meta *meta, u32 index)
+{
+	write_lock(&meta->tb_lock);
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	write_unlock(&meta->tb_lock);
+}
+
 static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 			  u32 index, int offset, struct bio *bio)
 {
@@ -345,13 +881,20 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	struct page *page;
 	unsigned char *user_mem, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
+	unsigned long blk_idx;
+	bool idle;
 	page = bvec->bv_page;
 
+	read_lock(&meta->tb_lock);
 	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
+			zram_test_flag(meta, index, ZRAM_SAME)) {
+		unsigned long element = meta->table[index].handle;
+
+		read_unlock(&meta->tb_lock);
+		handle_same_page(bvec, element);
 		return 0;
 	}
+	read_unlock(&meta->tb_lock);
 
 	if (is_partial_io(bvec))
 		
@@ -367,9 +910,26 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		goto out_cleanup;
 	}
 
-	ret = zram_decompress_page(zram, uncmem, index);
+	read_lock(&meta->tb_lock);
+	idle = zram_test_flag(meta, index, ZRAM_IDLE);
+
+	if (unlikely(zram_test_flag(meta, index, ZRAM_WB))) {
+		blk_idx = meta->table[index].handle;
+		read_unlock(&meta->tb_lock);
+		if (idle)
+			zram_clear_idle(meta, index);
+		kunmap_atomic(user_mem);
+		if (is_partial_io(bvec))
+			kfree(uncmem);
+		return zram_bvec_read_bdev(zram, bvec, blk_idx, offset);
+	}
+
+	ret = __zram_decompress_page(zram, uncmem, index);
+	read_unlock(&meta->tb_lock);
+	if (idle)
+		zram_clear_idle(meta, index);
 	
-	if (unlikely(ret != LZO_E_OK))
+	if (unlikely(ret))
 		goto out_cleanup;
 
 	if (is_partial_io(bvec))
@@ -390,15 +950,17 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 {
 	int ret = 0;
 	size_t clen;
-	unsigned long handle;
+	unsigned long handle, element;
+	u32 checksum = 0;
+	struct zram_entry *entry = NULL;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
+	struct zcomp_strm *zstrm;
+	bool locked = false;
 	static unsigned long zram_rs_time;
 
 	page = bvec->bv_page;
-	src = meta->compress_buffer;
-
 	if (is_partial_io(bvec)) {
 		uncmem = kmalloc(PAGE_SIZE, GFP_NOIO);
 		if (!uncmem) {
@@ -410,6 +972,8 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 	}
 
+	zstrm = zcomp_strm_find(zram->comp);
+	locked = true;
 	user_mem = kmap_atomic(page);
 
 	if (is_partial_io(bvec)) {
@@ -421,23 +985,39 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
-		kunmap_atomic(user_mem);
-		
-		zram_free_page(zram, index);
+	if (page_same_filled(uncmem, &element)) {
+		if (user_mem)
+			kunmap_atomic(user_mem);
+		zcomp_strm_release(zram->comp, zstrm);
+		locked = false;
 
-		zram->stats.pages_zero++;
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		write_lock(&meta->tb_lock);
+		zram_free_page(zram, index);
+		if (element)
+			zram->stats.pages_same++;
+		else
+			zram->stats.pages_zero++;
+		meta->table[index].handle = element;
+		zram_set_flag(meta, index, ZRAM_SAME);
+		write_unlock(&meta->tb_lock);
 		ret = 0;
 		goto out;
 	}
 
-	if (unlikely(meta->table[index].handle ||
-			zram_test_flag(meta, index, ZRAM_ZERO)))
-		zram_free_page(zram, index);
+	if (zram->use_dedup) {
+		checksum = zram_dedup_checksum(uncmem);
+		entry = zram_dedup_find(zram, uncmem, checksum, zstrm->buffer);
+		if (entry) {
+			if (user_mem)
+				kunmap_atomic(user_mem);
+			zcomp_strm_release(zram->comp, zstrm);
+			locked = false;
+			clen = entry->len;
+			goto found_dup;
+		}
+	}
 
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       meta->compress_workmem);
+	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
 
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
@@ -445,13 +1025,13 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = NULL;
 	}
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
 
+	src = zstrm->buffer;
 	if (unlikely(clen > max_zpage_size)) {
-		zram->stats.bad_compress++;
 		clen = PAGE_SIZE;
 		src = NULL;
 		if (is_partial_io(bvec))
@@ -477,20 +1057,46 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		memcpy(cmem, src, clen);
 	}
 
+	zcomp_strm_release(zram->comp, zstrm);
+	locked = false;
 	zs_unmap_object(meta->mem_pool, handle);
 
+	atomic64_add(clen, &zram->stats.compr_size);
+	if (zram->use_dedup) {
+		entry = zram_dedup_insert(zram, handle, clen, checksum);
+		if (!entry) {
+			zs_free(meta->mem_pool, handle);
+			atomic64_sub(clen, &zram->stats.compr_size);
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+found_dup:
+	write_lock(&meta->tb_lock);
 	zram_free_page(zram, index);
 
-	meta->table[index].handle = handle;
+	if (entry) {
+		meta->table[index].handle = (unsigned long)entry;
+		zram_set_flag(meta, index, ZRAM_DEDUP);
+	} else {
+		meta->table[index].handle = handle;
+	}
 	meta->table[index].size = clen;
+	if (clen == PAGE_SIZE)
+		zram_set_flag(meta, index, ZRAM_HUGE);
 
 	
-	atomic64_add(clen, &zram->stats.compr_size);
 	zram->stats.pages_stored++;
 	if (clen <= PAGE_SIZE / 2)
 		zram->stats.good_compress++;
+	else if (clen == PAGE_SIZE)
+		zram->stats.bad_compress++;
+	write_unlock(&meta->tb_lock);
 
 out:
+	if (locked)
+		zcomp_strm_release(zram->comp, zstrm);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
 
@@ -499,47 +1105,228 @@ out:
 	return ret;
 }
 
-static void handle_pending_slot_free(struct zram *zram)
-{
-	struct zram_slot_free *free_rq;
-
-	spin_lock(&zram->slot_free_lock);
-	while (zram->slot_free_rq) {
-		free_rq = zram->slot_free_rq;
-		zram->slot_free_rq = free_rq->next;
-		zram_free_page(zram, free_rq->index);
-		kfree(free_rq);
-	}
-	spin_unlock(&zram->slot_free_lock);
-}
-
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, struct bio *bio, int rw)
 {
 	int ret;
 
-	if (rw == READ) {
-		down_read(&zram->lock);
-		handle_pending_slot_free(zram);
+	if (rw == READ)
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
-		up_read(&zram->lock);
-	} else {
-		down_write(&zram->lock);
-		handle_pending_slot_free(zram);
+	else
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
-	}
 
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	size_t index, nr_pages;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		write_lock(&meta->tb_lock);
+		if (meta->table[index].handle &&
+				!zram_test_flag(meta, index, ZRAM_SAME) &&
+				!zram_test_flag(meta, index, ZRAM_WB))
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		write_unlock(&meta->tb_lock);
+	}
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static bool zram_wb_candidate(struct zram_meta *meta, size_t index,
+			enum zram_pageflags mode)
+{
+	if (!meta->table[index].handle)
+		return false;
+
+	if (zram_test_flag(meta, index, ZRAM_SAME) ||
+			zram_test_flag(meta, index, ZRAM_DEDUP) ||
+			zram_test_flag(meta, index, ZRAM_WB) ||
+			zram_test_flag(meta, index, ZRAM_UNDER_WB))
+		return false;
+
+	return zram_test_flag(meta, index, mode);
+}
+
+/*
+ * Write a batch of decompressed pages to consecutive runs of blocks with
+ * as few bios as possible, wait for them and then switch the slots that
+ * were not rewritten meanwhile over to the backing device.
+ */
+static int zram_wb_flush(struct zram *zram, struct page **pages, u32 *idx,
+			unsigned long *blk, int nr)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_bio_ctl ctl;
+	struct blk_plug plug;
+	struct bio *bio = NULL;
+	int i, err;
+
+	zram_bio_ctl_init(&ctl);
+	blk_start_plug(&plug);
+	for (i = 0; i < nr; i++) {
+		if (bio && blk[i] != blk[i - 1] + 1) {
+			submit_bio(WRITE, bio);
+			bio = NULL;
+		}
+		if (!bio) {
+			bio = zram_bio_alloc(zram, &ctl, blk[i], nr - i);
+			if (!bio) {
+				ctl.err = -ENOMEM;
+				break;
+			}
+		}
+		if (!bio_add_page(bio, pages[i], PAGE_SIZE, 0)) {
+			submit_bio(WRITE, bio);
+			bio = NULL;
+			i--;
+		}
+	}
+	if (bio)
+		submit_bio(WRITE, bio);
+	blk_finish_plug(&plug);
+
+	err = zram_bio_ctl_wait(&ctl);
+
+	for (i = 0; i < nr; i++) {
+		write_lock(&meta->tb_lock);
+		if (err || !zram_test_flag(meta, idx[i], ZRAM_UNDER_WB)) {
+			zram_clear_flag(meta, idx[i], ZRAM_UNDER_WB);
+			write_unlock(&meta->tb_lock);
+			free_block_bdev(zram, blk[i]);
+			continue;
+		}
+
+		zram_free_page(zram, idx[i]);
+		meta->table[idx[i]].handle = blk[i];
+		zram_set_flag(meta, idx[i], ZRAM_WB);
+		write_unlock(&meta->tb_lock);
+
+		atomic64_inc(&zram->stats.bd_count);
+		atomic64_inc(&zram->stats.bd_writes);
+	}
+
+	return err;
+}
+
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	struct page *pages[ZRAM_WB_BATCH];
+	u32 idx[ZRAM_WB_BATCH];
+	unsigned long blk[ZRAM_WB_BATCH];
+	enum zram_pageflags mode;
+	size_t index, nr_pages;
+	int i, nr = 0;
+	ssize_t ret = 0;
+
+	if (sysfs_streq(buf, "idle"))
+		mode = ZRAM_IDLE;
+	else if (sysfs_streq(buf, "huge"))
+		mode = ZRAM_HUGE;
+	else
+		return -EINVAL;
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			while (i)
+				__free_page(pages[--i]);
+			return -ENOMEM;
+		}
+	}
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (!zram->bdev) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		write_lock(&meta->tb_lock);
+		if (!zram_wb_candidate(meta, index, mode)) {
+			write_unlock(&meta->tb_lock);
+			continue;
+		}
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		write_unlock(&meta->tb_lock);
+
+		blk[nr] = alloc_block_bdev(zram);
+		if (!blk[nr] ||
+		    zram_decompress_page(zram, page_address(pages[nr]), index)) {
+			write_lock(&meta->tb_lock);
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			write_unlock(&meta->tb_lock);
+			if (!blk[nr]) {
+				ret = -ENOSPC;
+				break;
+			}
+			free_block_bdev(zram, blk[nr]);
+			continue;
+		}
+
+		idx[nr++] = index;
+		if (nr == ZRAM_WB_BATCH) {
+			if (zram_wb_flush(zram, pages, idx, blk, nr))
+				ret = -EIO;
+			nr = 0;
+		}
+	}
+
+	if (nr && zram_wb_flush(zram, pages, idx, blk, nr))
+		ret = -EIO;
+
+out:
+	up_read(&zram->init_lock);
+	for (i = 0; i < ZRAM_WB_BATCH; i++)
+		__free_page(pages[i]);
+
+	return ret ? ret : len;
+}
+
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.bd_count),
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
+}
+#endif
+
 static void zram_reset_device(struct zram *zram, bool reset_capacity)
 {
 	size_t index;
 	struct zram_meta *meta;
 
-	flush_work(&zram->free_work);
-
 	down_write(&zram->init_lock);
 	if (!zram->init_done) {
 		up_write(&zram->init_lock);
@@ -552,14 +1339,21 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		unsigned long handle = meta->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(meta, index, ZRAM_SAME) ||
+				zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
-		zs_free(meta->mem_pool, handle);
+		if (zram_test_flag(meta, index, ZRAM_DEDUP))
+			zram_dedup_put(zram, (struct zram_entry *)handle);
+		else
+			zs_free(meta->mem_pool, handle);
 	}
 
+	zcomp_destroy(zram->comp);
+	zram->comp = NULL;
 	zram_meta_free(zram->meta);
 	zram->meta = NULL;
+	reset_bdev(zram);
 	
 	memset(&zram->stats, 0, sizeof(zram->stats));
 
@@ -569,7 +1363,8 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	up_write(&zram->init_lock);
 }
 
-static void zram_init_device(struct zram *zram, struct zram_meta *meta)
+static void zram_init_device(struct zram *zram, struct zram_meta *meta,
+			     struct zcomp *comp)
 {
 	if (zram->disksize > 2 * (totalram_pages << PAGE_SHIFT)) {
 		pr_info(
@@ -589,6 +1384,7 @@ static void zram_init_device(struct zram *zram, struct zram_meta *meta)
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
 	zram->meta = meta;
+	zram->comp = comp;
 	zram->init_done = 1;
 
 	pr_debug("Initialization done!\n");
@@ -599,28 +1395,54 @@ static ssize_t disksize_store(struct device *dev,
 {
 	u64 disksize;
 	struct zram_meta *meta;
+	struct zcomp *comp;
 	struct zram *zram = dev_to_zram(dev);
+	bool use_dedup;
+	int err;
 
 	disksize = memparse(buf, NULL);
 	if (!disksize)
 		return -EINVAL;
 
 	disksize = PAGE_ALIGN(disksize);
-	meta = zram_meta_alloc(disksize);
+	down_read(&zram->init_lock);
+	use_dedup = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	meta = zram_meta_alloc(zram->disk->disk_name, disksize, use_dedup);
+	if (!meta)
+		return -ENOMEM;
+
 	down_write(&zram->init_lock);
 	if (zram->init_done) {
-		up_write(&zram->init_lock);
-		zram_meta_free(meta);
 		pr_info("Cannot change disksize for initialized device\n");
-		return -EBUSY;
+		err = -EBUSY;
+		goto out_free_meta;
+	}
+
+	if (zram->use_dedup != use_dedup) {
+		err = -EAGAIN;
+		goto out_free_meta;
+	}
+
+	comp = zcomp_create(zram->compressor, zram->max_comp_streams);
+	if (IS_ERR(comp)) {
+		pr_info("Cannot initialise compressing backend\n");
+		err = PTR_ERR(comp);
+		goto out_free_meta;
 	}
 
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
-	zram_init_device(zram, meta);
+	zram_init_device(zram, meta, comp);
 	up_write(&zram->init_lock);
 
 	return len;
+
+out_free_meta:
+	up_write(&zram->init_lock);
+	zram_meta_free(meta);
+	return err;
 }
 
 static ssize_t reset_store(struct device *dev,
@@ -727,40 +1549,19 @@ error:
 	bio_io_error(bio);
 }
 
-static void zram_slot_free(struct work_struct *work)
-{
-	struct zram *zram;
-
-	zram = container_of(work, struct zram, free_work);
-	down_write(&zram->lock);
-	handle_pending_slot_free(zram);
-	up_write(&zram->lock);
-}
-
-static void add_slot_free(struct zram *zram, struct zram_slot_free *free_rq)
-{
-	spin_lock(&zram->slot_free_lock);
-	free_rq->next = zram->slot_free_rq;
-	zram->slot_free_rq = free_rq;
-	spin_unlock(&zram->slot_free_lock);
-}
-
 static void zram_slot_free_notify(struct block_device *bdev,
 				unsigned long index)
 {
 	struct zram *zram;
-	struct zram_slot_free *free_rq;
+	struct zram_meta *meta;
 
 	zram = bdev->bd_disk->private_data;
-	atomic64_inc(&zram->stats.notify_free);
-
-	free_rq = kmalloc(sizeof(struct zram_slot_free), GFP_ATOMIC);
-	if (!free_rq)
-		return;
+	meta = zram->meta;
 
-	free_rq->index = index;
-	add_slot_free(zram, free_rq);
-	schedule_work(&zram->free_work);
+	write_lock(&meta->tb_lock);
+	zram_free_page(zram, index);
+	write_unlock(&meta->tb_lock);
+	atomic64_inc(&zram->stats.notify_free);
 }
 
 static const struct block_device_operations zram_devops = {
@@ -777,9 +1578,26 @@ static DEVICE_ATTR(num_writes, S_IRUGO, num_writes_show, NULL);
 static DEVICE_ATTR(invalid_io, S_IRUGO, invalid_io_show, NULL);
 static DEVICE_ATTR(notify_free, S_IRUGO, notify_free_show, NULL);
 static DEVICE_ATTR(zero_pages, S_IRUGO, zero_pages_show, NULL);
+static DEVICE_ATTR(same_pages, S_IRUGO, same_pages_show, NULL);
+static DEVICE_ATTR(dup_data_size, S_IRUGO, dup_data_size_show, NULL);
 static DEVICE_ATTR(orig_data_size, S_IRUGO, orig_data_size_show, NULL);
 static DEVICE_ATTR(compr_data_size, S_IRUGO, compr_data_size_show, NULL);
 static DEVICE_ATTR(mem_used_total, S_IRUGO, mem_used_total_show, NULL);
+static DEVICE_ATTR(compact, S_IWUSR, NULL, compact_store);
+static DEVICE_ATTR(num_compacted, S_IRUGO, num_compacted_show, NULL);
+static DEVICE_ATTR(max_comp_streams, S_IRUGO | S_IWUSR,
+		max_comp_streams_show, max_comp_streams_store);
+static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
+		comp_algorithm_show, comp_algorithm_store);
+static DEVICE_ATTR(use_dedup, S_IRUGO | S_IWUSR,
+		use_dedup_show, use_dedup_store);
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR(backing_dev, S_IRUGO | S_IWUSR,
+		backing_dev_show, backing_dev_store);
+static DEVICE_ATTR(idle, S_IWUSR, NULL, idle_store);
+static DEVICE_ATTR(writeback, S_IWUSR, NULL, writeback_store);
+static DEVICE_ATTR(bd_stat, S_IRUGO, bd_stat_show, NULL);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -790,9 +1608,22 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_invalid_io.attr,
 	&dev_attr_notify_free.attr,
 	&dev_attr_zero_pages.attr,
+	&dev_attr_same_pages.attr,
+	&dev_attr_dup_data_size.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
+	&dev_attr_compact.attr,
+	&dev_attr_num_compacted.attr,
+	&dev_attr_max_comp_streams.attr,
+	&dev_attr_comp_algorithm.attr,
+	&dev_attr_use_dedup.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_stat.attr,
+#endif
 	NULL,
 };
 
@@ -804,13 +1635,8 @@ static int create_device(struct zram *zram, int device_id)
 {
 	int ret = -ENOMEM;
 
-	init_rwsem(&zram->lock);
 	init_rwsem(&zram->init_lock);
 
-	INIT_WORK(&zram->free_work, zram_slot_free);
-	spin_lock_init(&zram->slot_free_lock);
-	zram->slot_free_rq = NULL;
-
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
 		pr_err("Error allocating disk queue for device %d\n",
@@ -855,6 +1681,8 @@ static int create_device(struct zram *zram, int device_id)
 	}
 
 	zram->init_done = 0;
+	zram->max_comp_streams = num_possible_cpus();
+	strlcpy(zram->compressor, default_compressor, sizeof(zram->compressor));
 	return 0;
 
 out_free_disk:
@@ -898,11 +1726,19 @@ static int __init zram_init(void)
 		goto out;
 	}
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram_wb_wq = alloc_workqueue("zram_wb", WQ_MEM_RECLAIM | WQ_UNBOUND, 0);
+	if (!zram_wb_wq) {
+		ret = -ENOMEM;
+		goto unregister;
+	}
+#endif
+
 	
 	zram_devices = kzalloc(num_devices * sizeof(struct zram), GFP_KERNEL);
 	if (!zram_devices) {
 		ret = -ENOMEM;
-		goto unregister;
+		goto destroy_wq;
 	}
 
 	for (dev_id = 0; dev_id < num_devices; dev_id++) {
@@ -919,6 +1755,10 @@ free_devices:
 	while (dev_id)
 		destroy_device(&zram_devices[--dev_id]);
 	kfree(zram_devices);
+destroy_wq:
+#ifdef CONFIG_ZRAM_WRITEBACK
+	destroy_workqueue(zram_wb_wq);
+#endif
 unregister:
 	unregister_blkdev(zram_major, "zram");
 out:
@@ -940,6 +1780,9 @@ static void __exit zram_exit(void)
 	unregister_blkdev(zram_major, "zram");
 
 	kfree(zram_devices);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	destroy_workqueue(zram_wb_wq);
+#endif
 	pr_debug("Cleanup done!\n");
 }
 
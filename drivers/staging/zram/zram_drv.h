@@ -17,8 +17,10 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/rbtree.h>
 
 #include "../zsmalloc/zsmalloc.h"
+#include "zcomp.h"
 
 static const unsigned max_num_devices = 32;
 
@@ -37,8 +39,18 @@ static const size_t max_zpage_size = PAGE_SIZE / 10 * 9;
 	(1 << (ZRAM_LOGICAL_BLOCK_SHIFT - SECTOR_SHIFT))
 
 enum zram_pageflags {
-	
-	ZRAM_ZERO,
+	/* Page consists entirely of one repeated word, kept in table.handle */
+	ZRAM_SAME,
+	/* table.handle points to a shared struct zram_entry */
+	ZRAM_DEDUP,
+	/* Page was written back, table.handle is the backing device block */
+	ZRAM_WB,
+	/* Page is being written back */
+	ZRAM_UNDER_WB,
+	/* Page did not compress and is stored at full size */
+	ZRAM_HUGE,
+	/* Page has not been accessed since it was marked idle */
+	ZRAM_IDLE,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -59,30 +71,45 @@ struct zram_stats {
 	atomic64_t failed_writes;	
 	atomic64_t invalid_io;	
 	atomic64_t notify_free;	
+	atomic64_t dup_data_size;	/* compressed bytes saved by dedup */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;		/* pages on the backing device */
+	atomic64_t bd_reads;		/* pages read from the backing device */
+	atomic64_t bd_writes;		/* pages written to the backing device */
+#endif
 	u32 pages_zero;		
+	u32 pages_same;		/* non-zero same-filled pages */
 	u32 pages_stored;	
 	u32 good_compress;	
 	u32 bad_compress;	
 };
 
+struct zram_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	u16 len;
+	unsigned long refcount;
+	unsigned long handle;
+};
+
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+
 struct zram_meta {
-	void *compress_workmem;
-	void *compress_buffer;
+	rwlock_t tb_lock;	/* protect table */
 	struct table *table;
 	struct zs_pool *mem_pool;
-};
-
-struct zram_slot_free {
-	unsigned long index;
-	struct zram_slot_free *next;
+#ifdef CONFIG_ZRAM_DEDUP
+	struct zram_hash *hash;
+	size_t hash_size;
+#endif
 };
 
 struct zram {
 	struct zram_meta *meta;
-	struct rw_semaphore lock; 
-
-	struct work_struct free_work;  
-	struct zram_slot_free *slot_free_rq; 
+	struct zcomp *comp;
 
 	struct request_queue *queue;
 	struct gendisk *disk;
@@ -90,7 +117,16 @@ struct zram {
 	
 	struct rw_semaphore init_lock;
 	u64 disksize;	
-	spinlock_t slot_free_lock;
+	int max_comp_streams;
+	char compressor[10];
+	bool use_dedup;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct block_device *bdev;
+	char *backing_dev;
+	unsigned long *bitmap;
+	unsigned long nr_pages;
+	unsigned int old_block_size;
+#endif
 
 	struct zram_stats stats;
 };
@@ -32,6 +32,11 @@
 #include <linux/hardirq.h>
 #include <linux/spinlock.h>
 #include <linux/types.h>
+#include <linux/bit_spinlock.h>
+#include <linux/shrinker.h>
+#include <linux/sched.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include "zsmalloc.h"
 
@@ -49,7 +54,23 @@
 #endif
 #endif
 #define _PFN_BITS		(MAX_PHYSMEM_BITS - PAGE_SHIFT)
-#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS)
+
+/*
+ * Handles are indirect: zs_malloc() returns the address of a small slot
+ * holding the current <PFN, obj_idx> location of the object, so that
+ * compaction can move objects without the user noticing. Bit 0 of the
+ * slot is a lock taken while the object is mapped, freed or migrated.
+ *
+ * Every allocated object starts with its handle, tagged in bit 0, so the
+ * compactor can tell allocated objects from free ones while it walks a
+ * zspage. Classes holding a single object per zspage keep the handle in
+ * first_page->private instead.
+ */
+#define ZS_HANDLE_SIZE		(sizeof(unsigned long))
+#define OBJ_ALLOCATED_TAG	1
+#define OBJ_TAG_BITS		1
+#define HANDLE_PIN_BIT		0
+#define OBJ_INDEX_BITS	(BITS_PER_LONG - _PFN_BITS - OBJ_TAG_BITS)
 #define OBJ_INDEX_MASK	((_AC(1, UL) << OBJ_INDEX_BITS) - 1)
 
 #define MAX(a, b) ((a) >= (b) ? (a) : (b))
@@ -72,6 +93,9 @@ enum fullness_group {
 
 static const int fullness_threshold_frac = 4;
 
+/* zspage usage histogram buckets: 0-25%, 25-50%, 50-75%, 75-99%, full */
+#define ZS_STAT_BUCKETS		5
+
 struct size_class {
 	int size;
 	unsigned int index;
@@ -79,23 +103,49 @@ struct size_class {
 	
 	int pages_per_zspage;
 
+	/* number of objects a zspage of this class holds */
+	int objs_per_zspage;
+	/* only one object per zspage, handle is kept in page_private */
+	bool huge;
+
 	spinlock_t lock;
 
 	
-	u64 pages_allocated;
+	unsigned long pages_allocated;
+	unsigned long obj_inuse;
 
 	struct page *fullness_list[_ZS_NR_FULLNESS_GROUPS];
 };
 
 struct link_free {
-	
-	void *next;
+	union {
+		/* next free object, as <PFN, obj_idx> */
+		void *next;
+		/* handle of an allocated object, with OBJ_ALLOCATED_TAG */
+		unsigned long handle;
+	};
 };
 
 struct zs_pool {
 	struct size_class size_class[ZS_SIZE_CLASSES];
 
 	gfp_t flags;	
+	const char *name;
+
+	struct shrinker shrinker;
+	atomic_long_t pages_compacted;
+
+#ifdef CONFIG_ZSMALLOC_STAT
+	struct dentry *stat_dentry;
+#endif
+};
+
+struct zs_compact_control {
+	/* source zspage page and the index of the next object to migrate */
+	struct page *s_page;
+	int index;
+	/* destination zspage */
+	struct page *d_page;
 };
 
 #define CLASS_IDX_BITS	28
@@ -115,6 +165,7 @@ struct mapping_area {
 #endif
 	char *vm_addr; 
 	enum zs_mapmode vm_mm; 
+	bool huge;	/* object carries no inline handle */
 };
 
 
@@ -160,7 +211,7 @@ static int get_size_class_index(int size)
 		idx = DIV_ROUND_UP(size - ZS_MIN_ALLOC_SIZE,
 				ZS_SIZE_CLASS_DELTA);
 
-	return idx;
+	return min_t(int, ZS_SIZE_CLASSES - 1, idx);
 }
 
 static enum fullness_group get_fullness_group(struct page *page)
@@ -290,26 +341,66 @@ static struct page *get_next_page(struct page *page)
 	return next;
 }
 
-static void *obj_location_to_handle(struct page *page, unsigned long obj_idx)
+static unsigned long location_to_obj(struct page *page, unsigned long obj_idx)
 {
-	unsigned long handle;
+	unsigned long obj;
 
 	if (!page) {
 		BUG_ON(obj_idx);
-		return NULL;
+		return 0;
 	}
 
-	handle = page_to_pfn(page) << OBJ_INDEX_BITS;
-	handle |= ((obj_idx + 1) & OBJ_INDEX_MASK);
+	obj = page_to_pfn(page) << OBJ_INDEX_BITS;
+	obj |= ((obj_idx + 1) & OBJ_INDEX_MASK);
+	obj <<= OBJ_TAG_BITS;
 
-	return (void *)handle;
+	return obj;
 }
 
-static void obj_handle_to_location(unsigned long handle, struct page **page,
+static void obj_to_location(unsigned long obj, struct page **page,
 				unsigned long *obj_idx)
 {
-	*page = pfn_to_page(handle >> OBJ_INDEX_BITS);
-	*obj_idx = (handle & OBJ_INDEX_MASK) - 1;
+	obj >>= OBJ_TAG_BITS;
+	*page = pfn_to_page(obj >> OBJ_INDEX_BITS);
+	*obj_idx = (obj & OBJ_INDEX_MASK) - 1;
+}
+
+static unsigned long handle_to_obj(unsigned long handle)
+{
+	return *(unsigned long *)handle & ~BIT(HANDLE_PIN_BIT);
+}
+
+static void record_obj(unsigned long handle, unsigned long obj)
+{
+	*(unsigned long *)handle = obj;
+}
+
+static void pin_tag(unsigned long handle)
+{
+	bit_spin_lock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static int trypin_tag(unsigned long handle)
+{
+	return bit_spin_trylock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static void unpin_tag(unsigned long handle)
+{
+	bit_spin_unlock(HANDLE_PIN_BIT, (unsigned long *)handle);
+}
+
+static struct kmem_cache *zs_handle_cache;
+
+static unsigned long alloc_handle(struct zs_pool *pool)
+{
+	return (unsigned long)kmem_cache_alloc(zs_handle_cache,
+			pool->flags & ~__GFP_HIGHMEM);
+}
+
+static void free_handle(unsigned long handle)
+{
+	kmem_cache_free(zs_handle_cache, (void *)handle);
 }
 
 static unsigned long obj_idx_to_offset(struct page *page,
@@ -379,13 +470,13 @@ static void init_zspage(struct page *first_page, struct size_class *class)
 		for (i = 1; i <= objs_on_page; i++) {
 			off += class->size;
 			if (off < PAGE_SIZE) {
-				link->next = obj_location_to_handle(page, i);
+				link->next = (void *)location_to_obj(page, i);
 				link += class->size / sizeof(*link);
 			}
 		}
 
 		next_page = get_next_page(page);
-		link->next = obj_location_to_handle(next_page, 0);
+		link->next = (void *)location_to_obj(next_page, 0);
 		kunmap_atomic(link);
 		page = next_page;
 		off = (off + class->size) % PAGE_SIZE;
@@ -425,7 +516,7 @@ static struct page *alloc_zspage(struct size_class *class, gfp_t flags)
 
 	init_zspage(first_page, class);
 
-	first_page->freelist = obj_location_to_handle(first_page, 0);
+	first_page->freelist = (void *)location_to_obj(first_page, 0);
 	
 	first_page->objects = class->pages_per_zspage * PAGE_SIZE / class->size;
 
@@ -546,6 +637,13 @@ static void __zs_unmap_object(struct mapping_area *area,
 	if (area->vm_mm == ZS_MM_RO)
 		goto out;
 
+	/* never write back the inline handle, WO mappings did not read it */
+	if (!area->huge) {
+		buf = buf + ZS_HANDLE_SIZE;
+		size -= ZS_HANDLE_SIZE;
+		off += ZS_HANDLE_SIZE;
+	}
+
 	sizes[0] = PAGE_SIZE - off;
 	sizes[1] = size - sizes[0];
 
@@ -591,6 +689,502 @@ static struct notifier_block zs_cpu_nb = {
 	.notifier_call = zs_cpu_notifier
 };
 
+static unsigned long obj_malloc(struct page *first_page,
+		struct size_class *class, unsigned long handle)
+{
+	unsigned long obj;
+	struct link_free *link;
+	struct page *m_page;
+	unsigned long m_objidx, m_offset;
+	void *vaddr;
+
+	obj = (unsigned long)first_page->freelist;
+	obj_to_location(obj, &m_page, &m_objidx);
+	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
+
+	vaddr = kmap_atomic(m_page);
+	link = (struct link_free *)vaddr + m_offset / sizeof(*link);
+	first_page->freelist = link->next;
+	if (!class->huge)
+		link->handle = handle | OBJ_ALLOCATED_TAG;
+	else
+		set_page_private(first_page, handle | OBJ_ALLOCATED_TAG);
+	kunmap_atomic(vaddr);
+
+	first_page->inuse++;
+	class->obj_inuse++;
+
+	return obj;
+}
+
+static void obj_free(struct size_class *class, unsigned long obj)
+{
+	struct link_free *link;
+	struct page *first_page, *f_page;
+	unsigned long f_objidx, f_offset;
+	void *vaddr;
+
+	obj_to_location(obj, &f_page, &f_objidx);
+	first_page = get_first_page(f_page);
+	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
+
+	vaddr = kmap_atomic(f_page);
+	link = (struct link_free *)(vaddr + f_offset);
+	link->next = first_page->freelist;
+	if (class->huge)
+		set_page_private(first_page, 0);
+	kunmap_atomic(vaddr);
+
+	first_page->freelist = (void *)obj;
+	first_page->inuse--;
+	class->obj_inuse--;
+}
+
+static void zs_object_copy(unsigned long dst, unsigned long src,
+				struct size_class *class)
+{
+	struct page *s_page, *d_page;
+	unsigned long s_objidx, d_objidx;
+	unsigned long s_off, d_off;
+	void *s_addr, *d_addr;
+	int s_size, d_size, size;
+	int written = 0;
+
+	s_size = d_size = class->size;
+
+	obj_to_location(src, &s_page, &s_objidx);
+	obj_to_location(dst, &d_page, &d_objidx);
+
+	s_off = obj_idx_to_offset(s_page, s_objidx, class->size);
+	d_off = obj_idx_to_offset(d_page, d_objidx, class->size);
+
+	if (s_off + class->size > PAGE_SIZE)
+		s_size = PAGE_SIZE - s_off;
+
+	if (d_off + class->size > PAGE_SIZE)
+		d_size = PAGE_SIZE - d_off;
+
+	s_addr = kmap_atomic(s_page);
+	d_addr = kmap_atomic(d_page);
+
+	while (1) {
+		size = min(s_size, d_size);
+		memcpy(d_addr + d_off, s_addr + s_off, size);
+		written += size;
+
+		if (written == class->size)
+			break;
+
+		s_off += size;
+		s_size -= size;
+		d_off += size;
+		d_size -= size;
+
+		if (s_off >= PAGE_SIZE) {
+			kunmap_atomic(d_addr);
+			kunmap_atomic(s_addr);
+			s_page = get_next_page(s_page);
+			BUG_ON(!s_page);
+			s_addr = kmap_atomic(s_page);
+			d_addr = kmap_atomic(d_page);
+			s_size = class->size - written;
+			s_off = 0;
+		}
+
+		if (d_off >= PAGE_SIZE) {
+			kunmap_atomic(d_addr);
+			d_page = get_next_page(d_page);
+			BUG_ON(!d_page);
+			d_addr = kmap_atomic(d_page);
+			d_size = class->size - written;
+			d_off = 0;
+		}
+	}
+
+	kunmap_atomic(d_addr);
+	kunmap_atomic(s_addr);
+}
+
+/*
+ * Find the first allocated object starting at object index @index of
+ * @page and return its handle, or 0 if there is none left on the page.
+ */
+static unsigned long find_alloced_obj(struct page *page, int *index,
+					struct size_class *class)
+{
+	unsigned long head;
+	int offset = 0;
+	unsigned long handle = 0;
+	void *addr = kmap_atomic(page);
+
+	if (!is_first_page(page))
+		offset = page->index;
+	offset += class->size * *index;
+
+	while (offset < PAGE_SIZE) {
+		head = *(unsigned long *)(addr + offset);
+		if (head & OBJ_ALLOCATED_TAG) {
+			handle = head & ~OBJ_ALLOCATED_TAG;
+			break;
+		}
+
+		offset += class->size;
+		(*index)++;
+	}
+
+	kunmap_atomic(addr);
+	return handle;
+}
+
+/*
+ * Move objects from cc->s_page's zspage into cc->d_page until either the
+ * source is empty (returns 0), the destination is full (-ENOMEM) or an
+ * object is in use by a mapping or zs_free() (-EBUSY).
+ */
+static int migrate_zspage(struct size_class *class,
+				struct zs_compact_control *cc)
+{
+	unsigned long used_obj, free_obj;
+	unsigned long handle;
+	struct page *s_page = cc->s_page;
+	struct page *d_page = cc->d_page;
+	int index = cc->index;
+	int ret = 0;
+
+	while (1) {
+		handle = find_alloced_obj(s_page, &index, class);
+		if (!handle) {
+			s_page = get_next_page(s_page);
+			if (!s_page)
+				break;
+			index = 0;
+			continue;
+		}
+
+		if (d_page->inuse == d_page->objects) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		if (!trypin_tag(handle)) {
+			ret = -EBUSY;
+			break;
+		}
+
+		used_obj = handle_to_obj(handle);
+		free_obj = obj_malloc(d_page, class, handle);
+		zs_object_copy(free_obj, used_obj, class);
+		index++;
+		/* keep the handle locked until unpin_tag() below */
+		record_obj(handle, free_obj | BIT(HANDLE_PIN_BIT));
+		unpin_tag(handle);
+		obj_free(class, used_obj);
+	}
+
+	cc->s_page = s_page;
+	cc->index = index;
+
+	return ret;
+}
+
+static struct page *isolate_zspage(struct size_class *class,
+				enum fullness_group fg)
+{
+	struct page *page = class->fullness_list[fg];
+
+	if (page)
+		remove_zspage(page, class, fg);
+
+	return page;
+}
+
+static struct page *isolate_target_page(struct size_class *class)
+{
+	struct page *page;
+
+	page = isolate_zspage(class, ZS_ALMOST_FULL);
+	if (!page)
+		page = isolate_zspage(class, ZS_ALMOST_EMPTY);
+
+	return page;
+}
+
+static enum fullness_group putback_zspage(struct size_class *class,
+					struct page *first_page)
+{
+	enum fullness_group fullness;
+
+	BUG_ON(!is_first_page(first_page));
+
+	fullness = get_fullness_group(first_page);
+	insert_zspage(first_page, class, fullness);
+	set_zspage_mapping(first_page, class->index, fullness);
+
+	return fullness;
+}
+
+/* number of zspages that could be freed by packing the class tightly */
+static unsigned long zs_can_compact(struct size_class *class)
+{
+	unsigned long obj_wasted;
+
+	if (class->huge)
+		return 0;
+
+	obj_wasted = class->pages_allocated / class->pages_per_zspage *
+			class->objs_per_zspage - class->obj_inuse;
+
+	return obj_wasted / class->objs_per_zspage;
+}
+
+static unsigned long __zs_compact(struct zs_pool *pool,
+				struct size_class *class)
+{
+	struct zs_compact_control cc;
+	struct page *src_page = NULL;
+	struct page *dst_page = NULL;
+	unsigned long freed = 0;
+	int ret = 0;
+
+	spin_lock(&class->lock);
+	while (zs_can_compact(class)) {
+		src_page = isolate_zspage(class, ZS_ALMOST_EMPTY);
+		if (!src_page)
+			break;
+
+		cc.index = 0;
+		cc.s_page = src_page;
+
+		while ((dst_page = isolate_target_page(class))) {
+			cc.d_page = dst_page;
+			ret = migrate_zspage(class, &cc);
+			if (ret != -ENOMEM)
+				break;
+			putback_zspage(class, dst_page);
+		}
+
+		/* stop if we ran out of room or hit an object in use */
+		if (!dst_page || ret) {
+			if (dst_page)
+				putback_zspage(class, dst_page);
+			break;
+		}
+
+		putback_zspage(class, dst_page);
+		if (putback_zspage(class, src_page) == ZS_EMPTY) {
+			class->pages_allocated -= class->pages_per_zspage;
+			freed += class->pages_per_zspage;
+			spin_unlock(&class->lock);
+			free_zspage(src_page);
+		} else {
+			spin_unlock(&class->lock);
+		}
+		src_page = NULL;
+
+		cond_resched();
+		spin_lock(&class->lock);
+	}
+
+	if (src_page)
+		putback_zspage(class, src_page);
+
+	spin_unlock(&class->lock);
+
+	return freed;
+}
+
+unsigned long zs_compact(struct zs_pool *pool)
+{
+	int i;
+	unsigned long freed = 0;
+
+	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--)
+		freed += __zs_compact(pool, &pool->size_class[i]);
+
+	atomic_long_add(freed, &pool->pages_compacted);
+
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zs_compact);
+
+static unsigned long zs_pages_compactable(struct zs_pool *pool)
+{
+	int i;
+	unsigned long pages = 0;
+	struct size_class *class;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = &pool->size_class[i];
+		spin_lock(&class->lock);
+		pages += zs_can_compact(class) * class->pages_per_zspage;
+		spin_unlock(&class->lock);
+	}
+
+	return pages;
+}
+
+static int zs_shrinker_shrink(struct shrinker *shrinker,
+				struct shrink_control *sc)
+{
+	struct zs_pool *pool = container_of(shrinker, struct zs_pool,
+			shrinker);
+
+	if (sc->nr_to_scan)
+		zs_compact(pool);
+
+	return zs_pages_compactable(pool);
+}
+
+#ifdef CONFIG_ZSMALLOC_STAT
+static struct dentry *zs_stat_root;
+
+static void zs_stat_init(void)
+{
+	if (!debugfs_initialized())
+		return;
+
+	zs_stat_root = debugfs_create_dir("zsmalloc", NULL);
+	if (!zs_stat_root)
+		pr_warn("debugfs 'zsmalloc' stat dir creation failed\n");
+}
+
+static void zs_stat_exit(void)
+{
+	debugfs_remove_recursive(zs_stat_root);
+}
+
+/*
+ * Per class usage, plus a histogram of how full the zspages of each class
+ * are. Columns 0-25% .. 75-99% count partially used zspages by the share
+ * of their objects in use, 100% counts full ones. "freeable" is the
+ * number of pages compaction could give back.
+ */
+static int zs_stats_size_show(struct seq_file *s, void *v)
+{
+	int i, fg;
+	struct zs_pool *pool = s->private;
+	struct size_class *class;
+	struct page *first_page, *page;
+	unsigned long hist[ZS_STAT_BUCKETS];
+	unsigned long zspages, listed, freeable;
+	unsigned long total_objs = 0, total_used = 0, total_pages = 0;
+	unsigned long total_freeable = 0;
+
+	seq_printf(s, " %5s %5s %13s %10s %10s %16s %8s"
+			" %7s %7s %7s %7s %7s\n",
+			"class", "size", "obj_allocated", "obj_used",
+			"pages_used", "pages_per_zspage", "freeable",
+			"0-25%", "25-50%", "50-75%", "75-99%", "100%");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = &pool->size_class[i];
+		memset(hist, 0, sizeof(hist));
+		listed = 0;
+
+		spin_lock(&class->lock);
+		zspages = class->pages_allocated / class->pages_per_zspage;
+		for (fg = 0; fg < _ZS_NR_FULLNESS_GROUPS; fg++) {
+			first_page = class->fullness_list[fg];
+			if (!first_page)
+				continue;
+			page = first_page;
+			do {
+				hist[page->inuse * (ZS_STAT_BUCKETS - 1) /
+						page->objects]++;
+				listed++;
+				page = list_entry(page->lru.next,
+						struct page, lru);
+			} while (page != first_page);
+		}
+		hist[ZS_STAT_BUCKETS - 1] += zspages - listed;
+		freeable = zs_can_compact(class) * class->pages_per_zspage;
+		spin_unlock(&class->lock);
+
+		if (!zspages)
+			continue;
+
+		seq_printf(s, " %5u %5u %13lu %10lu %10lu %16d %8lu"
+				" %7lu %7lu %7lu %7lu %7lu\n",
+			i, class->size, zspages * class->objs_per_zspage,
+			class->obj_inuse, class->pages_allocated,
+			class->pages_per_zspage, freeable,
+			hist[0], hist[1], hist[2], hist[3], hist[4]);
+
+		total_objs += zspages * class->objs_per_zspage;
+		total_used += class->obj_inuse;
+		total_pages += class->pages_allocated;
+		total_freeable += freeable;
+	}
+
+	seq_puts(s, "\n");
+	seq_printf(s, " %5s %5s %13lu %10lu %10lu %16s %8lu\n",
+			"Total", "", total_objs, total_used, total_pages, "",
+			total_freeable);
+	seq_printf(s, "pages_compacted: %ld\n",
+			atomic_long_read(&pool->pages_compacted));
+
+	return 0;
+}
+
+static int zs_stats_size_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_stats_size_show, inode->i_private);
+}
+
+static const struct file_operations zs_stat_size_ops = {
+	.open           = zs_stats_size_open,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
+static void zs_pool_stat_create(struct zs_pool *pool, const char *name)
+{
+	struct dentry *entry;
+
+	if (!zs_stat_root)
+		return;
+
+	entry = debugfs_create_dir(name, zs_stat_root);
+	if (!entry) {
+		pr_warn("debugfs dir <%s> creation failed\n", name);
+		return;
+	}
+	pool->stat_dentry = entry;
+
+	entry = debugfs_create_file("classes", S_IFREG | S_IRUGO,
+			pool->stat_dentry, pool, &zs_stat_size_ops);
+	if (!entry)
+		pr_warn("%s: debugfs file entry <%s> creation failed\n",
+				name, "classes");
+}
+
+static void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+	debugfs_remove_recursive(pool->stat_dentry);
+}
+
+#else 
+
+static inline void zs_stat_init(void)
+{
+}
+
+static inline void zs_stat_exit(void)
+{
+}
+
+static inline void zs_pool_stat_create(struct zs_pool *pool,
+				const char *name)
+{
+}
+
+static inline void zs_pool_stat_destroy(struct zs_pool *pool)
+{
+}
+
+#endif 
+
 static void zs_exit(void)
 {
 	int cpu;
@@ -598,25 +1192,37 @@ static void zs_exit(void)
 	for_each_online_cpu(cpu)
 		zs_cpu_notifier(NULL, CPU_DEAD, (void *)(long)cpu);
 	unregister_cpu_notifier(&zs_cpu_nb);
+
+	zs_stat_exit();
+	if (zs_handle_cache)
+		kmem_cache_destroy(zs_handle_cache);
 }
 
 static int zs_init(void)
 {
 	int cpu, ret;
 
+	zs_handle_cache = kmem_cache_create("zs_handle", ZS_HANDLE_SIZE,
+					0, 0, NULL);
+	if (!zs_handle_cache)
+		return -ENOMEM;
+
 	register_cpu_notifier(&zs_cpu_nb);
 	for_each_online_cpu(cpu) {
 		ret = zs_cpu_notifier(NULL, CPU_UP_PREPARE, (void *)(long)cpu);
 		if (notifier_to_errno(ret))
 			goto fail;
 	}
+
+	zs_stat_init();
 	return 0;
 fail:
 	zs_exit();
 	return notifier_to_errno(ret);
 }
 
-struct zs_pool *zs_create_pool(gfp_t flags)
+
+struct zs_pool *zs_create_pool(const char *name, gfp_t flags)
 {
 	int i, ovhd_size;
 	struct zs_pool *pool;
@@ -639,10 +1245,21 @@ struct zs_pool *zs_create_pool(gfp_t flags)
 		class->index = i;
 		spin_lock_init(&class->lock);
 		class->pages_per_zspage = get_pages_per_zspage(size);
+		class->objs_per_zspage = class->pages_per_zspage *
+						PAGE_SIZE / size;
+		class->huge = class->objs_per_zspage == 1;
 
 	}
 
 	pool->flags = flags;
+	pool->name = name;
+	atomic_long_set(&pool->pages_compacted, 0);
+
+	zs_pool_stat_create(pool, name);
+
+	pool->shrinker.shrink = zs_shrinker_shrink;
+	pool->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&pool->shrinker);
 
 	return pool;
 }
@@ -652,6 +1269,9 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	unregister_shrinker(&pool->shrinker);
+	zs_pool_stat_destroy(pool);
+
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 		int fg;
 		struct size_class *class = &pool->size_class[i];
@@ -669,17 +1289,20 @@ EXPORT_SYMBOL_GPL(zs_destroy_pool);
 
 unsigned long zs_malloc(struct zs_pool *pool, size_t size)
 {
-	unsigned long obj;
-	struct link_free *link;
+	unsigned long handle, obj;
 	int class_idx;
 	struct size_class *class;
-
-	struct page *first_page, *m_page;
-	unsigned long m_objidx, m_offset;
+	struct page *first_page;
 
 	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
 		return 0;
 
+	handle = alloc_handle(pool);
+	if (!handle)
+		return 0;
+
+	
+	size += ZS_HANDLE_SIZE;
 	class_idx = get_size_class_index(size);
 	class = &pool->size_class[class_idx];
 	BUG_ON(class_idx != class->index);
@@ -690,69 +1313,55 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size)
 	if (!first_page) {
 		spin_unlock(&class->lock);
 		first_page = alloc_zspage(class, pool->flags);
-		if (unlikely(!first_page))
+		if (unlikely(!first_page)) {
+			free_handle(handle);
 			return 0;
+		}
 
 		set_zspage_mapping(first_page, class->index, ZS_EMPTY);
 		spin_lock(&class->lock);
 		class->pages_allocated += class->pages_per_zspage;
 	}
 
-	obj = (unsigned long)first_page->freelist;
-	obj_handle_to_location(obj, &m_page, &m_objidx);
-	m_offset = obj_idx_to_offset(m_page, m_objidx, class->size);
-
-	link = (struct link_free *)kmap_atomic(m_page) +
-					m_offset / sizeof(*link);
-	first_page->freelist = link->next;
-	memset(link, POISON_INUSE, sizeof(*link));
-	kunmap_atomic(link);
-
-	first_page->inuse++;
+	obj = obj_malloc(first_page, class, handle);
 	
 	fix_fullness_group(pool, first_page);
+	record_obj(handle, obj);
 	spin_unlock(&class->lock);
 
-	return obj;
+	return handle;
 }
 EXPORT_SYMBOL_GPL(zs_malloc);
 
-void zs_free(struct zs_pool *pool, unsigned long obj)
+void zs_free(struct zs_pool *pool, unsigned long handle)
 {
-	struct link_free *link;
 	struct page *first_page, *f_page;
-	unsigned long f_objidx, f_offset;
-
+	unsigned long obj, f_objidx;
 	int class_idx;
 	struct size_class *class;
 	enum fullness_group fullness;
 
-	if (unlikely(!obj))
+	if (unlikely(!handle))
 		return;
 
-	obj_handle_to_location(obj, &f_page, &f_objidx);
+	pin_tag(handle);
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &f_page, &f_objidx);
 	first_page = get_first_page(f_page);
 
 	get_zspage_mapping(first_page, &class_idx, &fullness);
 	class = &pool->size_class[class_idx];
-	f_offset = obj_idx_to_offset(f_page, f_objidx, class->size);
 
 	spin_lock(&class->lock);
-
-	
-	link = (struct link_free *)((unsigned char *)kmap_atomic(f_page)
-							+ f_offset);
-	link->next = first_page->freelist;
-	kunmap_atomic(link);
-	first_page->freelist = (void *)obj;
-
-	first_page->inuse--;
+	obj_free(class, obj);
 	fullness = fix_fullness_group(pool, first_page);
 
 	if (fullness == ZS_EMPTY)
 		class->pages_allocated -= class->pages_per_zspage;
 
 	spin_unlock(&class->lock);
+	unpin_tag(handle);
+	free_handle(handle);
 
 	if (fullness == ZS_EMPTY)
 		free_zspage(first_page);
@@ -763,29 +1372,36 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 			enum zs_mapmode mm)
 {
 	struct page *page;
-	unsigned long obj_idx, off;
+	unsigned long obj, obj_idx, off;
 
 	unsigned int class_idx;
 	enum fullness_group fg;
 	struct size_class *class;
 	struct mapping_area *area;
 	struct page *pages[2];
+	void *ret;
 
 	BUG_ON(!handle);
 
 	BUG_ON(in_interrupt());
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	/* keep compaction from moving the object while it is mapped */
+	pin_tag(handle);
+
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
 
 	area = &get_cpu_var(zs_map_area);
 	area->vm_mm = mm;
+	area->huge = class->huge;
 	if (off + class->size <= PAGE_SIZE) {
 		
 		area->vm_addr = kmap_atomic(page);
-		return area->vm_addr + off;
+		ret = area->vm_addr + off;
+		goto out;
 	}
 
 	
@@ -793,14 +1409,19 @@ void *zs_map_object(struct zs_pool *pool, unsigned long handle,
 	pages[1] = get_next_page(page);
 	BUG_ON(!pages[1]);
 
-	return __zs_map_object(area, pages, off, class->size);
+	ret = __zs_map_object(area, pages, off, class->size);
+out:
+	if (!class->huge)
+		ret += ZS_HANDLE_SIZE;
+
+	return ret;
 }
 EXPORT_SYMBOL_GPL(zs_map_object);
 
 void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 {
 	struct page *page;
-	unsigned long obj_idx, off;
+	unsigned long obj, obj_idx, off;
 
 	unsigned int class_idx;
 	enum fullness_group fg;
@@ -809,7 +1430,8 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 
 	BUG_ON(!handle);
 
-	obj_handle_to_location(handle, &page, &obj_idx);
+	obj = handle_to_obj(handle);
+	obj_to_location(obj, &page, &obj_idx);
 	get_zspage_mapping(get_first_page(page), &class_idx, &fg);
 	class = &pool->size_class[class_idx];
 	off = obj_idx_to_offset(page, obj_idx, class->size);
@@ -827,6 +1449,7 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle)
 		__zs_unmap_object(area, pages, off, class->size);
 	}
 	put_cpu_var(zs_map_area);
+	unpin_tag(handle);
 }
 EXPORT_SYMBOL_GPL(zs_unmap_object);
 
@@ -842,6 +1465,12 @@ u64 zs_get_total_size_bytes(struct zs_pool *pool)
 }
 EXPORT_SYMBOL_GPL(zs_get_total_size_bytes);
 
+unsigned long zs_get_pages_compacted(struct zs_pool *pool)
+{
+	return atomic_long_read(&pool->pages_compacted);
+}
+EXPORT_SYMBOL_GPL(zs_get_pages_compacted);
+
 module_init(zs_init);
 module_exit(zs_exit);
 
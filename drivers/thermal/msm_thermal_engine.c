@@ -0,0 +1,514 @@
+/*
+ * In-kernel thermal mitigation engine
+ *
+ * Polls the TSENS sensors of every cpu core and of the GPU and runs one
+ * PID controller per domain against its setpoint. The controller output
+ * is a number of frequency steps below the top, applied as a cpufreq
+ * policy limit for a core and as the kgsl thermal power level for the
+ * GPU. The caps are reported through the pnpmgr thermal nodes, and the
+ * time spent at each cap is kept in debugfs (thermal_engine/residency)
+ * for performance analysis.
+ *
+ * Units: temperatures in degC, k_p in milli-steps per degC, k_i in
+ * milli-steps per degC*s and k_d in milli-steps per degC/s. TSENS reads
+ * whole degrees, so the derivative is taken on a moving average of the
+ * temperature over about d_window_ms, and it never throttles below the
+ * setpoint.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt)	"thermal_engine: " fmt
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/msm_kgsl.h>
+#include <linux/msm_thermal_engine.h>
+#include <linux/msm_tsens.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/thermal_engine.h>
+
+#define TE_MAX_STEPS	32
+#define TE_CPU_SENSOR0	5
+#define TE_GPU		CONFIG_NR_CPUS
+#define TE_NR_DOMAINS	(CONFIG_NR_CPUS + 1)
+
+struct te_domain {
+	char name[8];
+	int sensor;
+	int setpoint;
+	int temp;
+	int temp_avg;		/* moving average, in mdegC */
+	long integral;
+	int steps;
+	int max_steps;
+	unsigned int cap;
+	unsigned int step_cap[TE_MAX_STEPS];
+	u64 residency[TE_MAX_STEPS];
+	unsigned long throttle_events;
+	bool primed;
+	bool valid;
+};
+
+static void te_work_fn(struct work_struct *work);
+
+static DEFINE_MUTEX(te_lock);
+static DECLARE_DELAYED_WORK(te_work, te_work_fn);
+static BLOCKING_NOTIFIER_HEAD(te_notifier);
+
+static struct te_domain domains[TE_NR_DOMAINS];
+static unsigned int cpu_freqs[TE_MAX_STEPS];
+static int nr_cpu_freqs;
+static unsigned int te_cpu_cap[CONFIG_NR_CPUS];
+static unsigned int te_gpu_cap = THERMAL_ENGINE_NO_GPU_CAP;
+static ktime_t te_last;		/* last PID step */
+static ktime_t te_res_last;		/* residency accounted up to here */
+static bool te_running;
+static bool te_ready;
+
+static bool te_enabled = true;
+static int cpu_sensors[CONFIG_NR_CPUS];
+static int nr_cpu_sensors;
+static int gpu_sensor = 10;
+static int cpu_setpoint = 75;
+static int gpu_setpoint = 75;
+static int crit_margin = 15;
+static unsigned int cpu_floor;
+static int k_p = 400;
+static int k_i = 100;
+static int k_d = 20;
+static unsigned int poll_ms = 250;
+static unsigned int fast_poll_ms = 50;
+static int fast_margin = 5;
+static unsigned int d_window_ms = 1000;
+
+module_param_array(cpu_sensors, int, &nr_cpu_sensors, 0644);
+module_param(gpu_sensor, int, 0644);
+module_param(cpu_setpoint, int, 0644);
+module_param(gpu_setpoint, int, 0644);
+module_param(crit_margin, int, 0644);
+module_param(cpu_floor, uint, 0644);
+module_param(k_p, int, 0644);
+module_param(k_i, int, 0644);
+module_param(k_d, int, 0644);
+module_param(poll_ms, uint, 0644);
+module_param(fast_poll_ms, uint, 0644);
+module_param(fast_margin, int, 0644);
+module_param(d_window_ms, uint, 0644);
+
+static void te_account(ktime_t now)
+{
+	s64 delta = ktime_to_ns(ktime_sub(now, te_res_last));
+	int i;
+
+	te_res_last = now;
+	if (delta <= 0)
+		return;
+	for (i = 0; i < TE_NR_DOMAINS; i++)
+		if (domains[i].valid)
+			domains[i].residency[domains[i].steps] += delta;
+}
+
+static int te_cmp_desc(const void *a, const void *b)
+{
+	unsigned int x = *(const unsigned int *)a;
+	unsigned int y = *(const unsigned int *)b;
+
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/* All cores share one frequency plan, so cpu0's table stands for all. */
+static void te_init_cpu_freqs(void)
+{
+	struct cpufreq_frequency_table *table;
+	int i, n = 0;
+
+	table = cpufreq_frequency_get_table(0);
+	if (!table)
+		return;
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int f = table[i].frequency;
+		int j;
+
+		if (f == CPUFREQ_ENTRY_INVALID || f < cpu_floor)
+			continue;
+		for (j = 0; j < n && cpu_freqs[j] != f; j++)
+			;
+		if (j == n && n < TE_MAX_STEPS)
+			cpu_freqs[n++] = f;
+	}
+	sort(cpu_freqs, n, sizeof(cpu_freqs[0]), te_cmp_desc, NULL);
+	nr_cpu_freqs = n;
+}
+
+static void te_init_domains(void)
+{
+	int i;
+
+	if (!nr_cpu_freqs)
+		te_init_cpu_freqs();
+
+	for (i = 0; i < CONFIG_NR_CPUS; i++) {
+		struct te_domain *d = &domains[i];
+
+		snprintf(d->name, sizeof(d->name), "cpu%d", i);
+		d->sensor = i < nr_cpu_sensors ? cpu_sensors[i] :
+			TE_CPU_SENSOR0 + i;
+		d->setpoint = cpu_setpoint;
+		if (!d->valid && nr_cpu_freqs && d->sensor >= 0) {
+			d->max_steps = nr_cpu_freqs - 1;
+			memcpy(d->step_cap, cpu_freqs, sizeof(cpu_freqs));
+			d->cap = cpu_freqs[0];
+			d->valid = true;
+		}
+	}
+
+	domains[TE_GPU].sensor = gpu_sensor;
+	domains[TE_GPU].setpoint = gpu_setpoint;
+	if (!domains[TE_GPU].valid && gpu_sensor >= 0) {
+		int levels = kgsl_pwrctrl_thermal_levels();
+
+		if (levels > 0) {
+			strlcpy(domains[TE_GPU].name, "gpu",
+				sizeof(domains[TE_GPU].name));
+			domains[TE_GPU].max_steps = min(levels, TE_MAX_STEPS) - 1;
+			domains[TE_GPU].cap = kgsl_pwrctrl_thermal_limit(0);
+			domains[TE_GPU].step_cap[0] = domains[TE_GPU].cap;
+			domains[TE_GPU].valid = true;
+		}
+	}
+}
+
+static int te_pid(struct te_domain *d, unsigned int dt_ms)
+{
+	int err = d->temp - d->setpoint;
+	unsigned int avg_ms = min(dt_ms, 60000U);
+	long i_max, d_out, out;
+	int avg;
+
+	if (!d->primed) {
+		d->temp_avg = d->temp * 1000;
+		d->primed = true;
+	}
+	avg = d->temp_avg + div_s64(((s64)d->temp * 1000 - d->temp_avg) *
+				    avg_ms, max(d_window_ms + avg_ms, 1U));
+	d_out = div_s64((s64)k_d * (avg - d->temp_avg), max(dt_ms, 1U));
+	d->temp_avg = avg;
+
+	if (err >= crit_margin) {
+		d->integral = 0;
+		return d->max_steps;
+	}
+	if (err < 0)
+		d_out = min(d_out, 0L);
+
+	/* The integral only builds up throttling, it never boosts. */
+	d->integral += (long)err * dt_ms;
+	i_max = k_i > 0 ? (long)d->max_steps * 1000000 / k_i : 0;
+	d->integral = clamp(d->integral, 0L, i_max);
+
+	out = (long)k_p * err + (long)k_i * d->integral / 1000 + d_out;
+
+	if (out <= 0)
+		return 0;
+	return min_t(long, DIV_ROUND_UP(out, 1000), d->max_steps);
+}
+
+static bool te_set_steps(struct te_domain *d, int steps)
+{
+	if (steps == d->steps)
+		return false;
+
+	if (!d->steps)
+		d->throttle_events++;
+	d->steps = steps;
+	if (d == &domains[TE_GPU]) {
+		d->cap = kgsl_pwrctrl_thermal_limit(steps);
+		d->step_cap[steps] = d->cap;
+		te_gpu_cap = steps ? d->cap : THERMAL_ENGINE_NO_GPU_CAP;
+	} else {
+		d->cap = d->step_cap[steps];
+		te_cpu_cap[d - domains] = steps ? d->cap : 0;
+	}
+	trace_thermal_engine_limit(d->name, d->temp, d->temp - d->setpoint,
+				   steps, d->cap);
+	return true;
+}
+
+static void te_update_policies(unsigned long changed)
+{
+	unsigned int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		if (changed & BIT(cpu))
+			cpufreq_update_policy(cpu);
+	put_online_cpus();
+}
+
+static void te_work_fn(struct work_struct *work)
+{
+	unsigned long changed = 0;
+	unsigned int dt_ms, delay = poll_ms;
+	bool notify = false;
+	ktime_t now;
+	int i;
+
+	mutex_lock(&te_lock);
+	if (!te_running) {
+		mutex_unlock(&te_lock);
+		return;
+	}
+
+	now = ktime_get();
+	dt_ms = ktime_to_ms(ktime_sub(now, te_last));
+	te_last = now;
+	te_account(now);
+	te_init_domains();
+
+	for (i = 0; i < TE_NR_DOMAINS; i++) {
+		struct te_domain *d = &domains[i];
+		struct tsens_device tsens_dev;
+		unsigned long temp;
+
+		if (!d->valid)
+			continue;
+		tsens_dev.sensor_num = d->sensor;
+		if (tsens_get_temp(&tsens_dev, &temp))
+			continue;
+		d->temp = (long)temp;
+
+		if (te_set_steps(d, te_pid(d, dt_ms))) {
+			notify = true;
+			if (i != TE_GPU)
+				changed |= BIT(i);
+		}
+		if (d->steps || d->temp >= d->setpoint - fast_margin)
+			delay = fast_poll_ms;
+	}
+	mutex_unlock(&te_lock);
+
+	if (changed)
+		te_update_policies(changed);
+	if (notify)
+		blocking_notifier_call_chain(&te_notifier, 0, NULL);
+
+	queue_delayed_work(system_power_efficient_wq, &te_work,
+			   msecs_to_jiffies(delay));
+}
+
+static int te_cpufreq_notify(struct notifier_block *nb, unsigned long event,
+			     void *data)
+{
+	struct cpufreq_policy *policy = data;
+	unsigned int cap;
+
+	if (event != CPUFREQ_ADJUST || policy->cpu >= CONFIG_NR_CPUS)
+		return NOTIFY_OK;
+
+	cap = ACCESS_ONCE(te_cpu_cap[policy->cpu]);
+	if (cap)
+		cpufreq_verify_within_limits(policy, 0, cap);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block te_cpufreq_nb = {
+	.notifier_call = te_cpufreq_notify,
+};
+
+static void te_start(void)
+{
+	mutex_lock(&te_lock);
+	te_last = ktime_get();
+	te_res_last = te_last;
+	te_running = true;
+	mutex_unlock(&te_lock);
+	queue_delayed_work(system_power_efficient_wq, &te_work, 0);
+}
+
+static void te_stop(void)
+{
+	unsigned long changed = 0;
+	int i;
+
+	mutex_lock(&te_lock);
+	te_running = false;
+	mutex_unlock(&te_lock);
+	cancel_delayed_work_sync(&te_work);
+
+	mutex_lock(&te_lock);
+	te_account(ktime_get());
+	for (i = 0; i < TE_NR_DOMAINS; i++) {
+		struct te_domain *d = &domains[i];
+
+		if (d->valid && te_set_steps(d, 0) && i != TE_GPU)
+			changed |= BIT(i);
+		d->integral = 0;
+		d->primed = false;
+	}
+	mutex_unlock(&te_lock);
+
+	te_update_policies(changed);
+	blocking_notifier_call_chain(&te_notifier, 0, NULL);
+}
+
+static int te_set_enabled(const char *val, const struct kernel_param *kp)
+{
+	bool old = te_enabled;
+	int ret;
+
+	ret = param_set_bool(val, kp);
+	if (ret || te_enabled == old || !te_ready)
+		return ret;
+
+	if (te_enabled)
+		te_start();
+	else
+		te_stop();
+	return 0;
+}
+
+static struct kernel_param_ops te_enabled_ops = {
+	.set = te_set_enabled,
+	.get = param_get_bool,
+};
+module_param_cb(enabled, &te_enabled_ops, &te_enabled, 0644);
+
+bool thermal_engine_enabled(void)
+{
+	return ACCESS_ONCE(te_enabled);
+}
+EXPORT_SYMBOL(thermal_engine_enabled);
+
+unsigned int thermal_engine_cpu_cap(unsigned int cpu)
+{
+	unsigned int cap;
+
+	if (cpu >= CONFIG_NR_CPUS)
+		return THERMAL_ENGINE_NO_CPU_CAP;
+	cap = ACCESS_ONCE(te_cpu_cap[cpu]);
+	return cap ? cap : THERMAL_ENGINE_NO_CPU_CAP;
+}
+EXPORT_SYMBOL(thermal_engine_cpu_cap);
+
+unsigned int thermal_engine_final_cpu_cap(void)
+{
+	unsigned int cpu, cap = THERMAL_ENGINE_NO_CPU_CAP;
+
+	for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++)
+		cap = min(cap, thermal_engine_cpu_cap(cpu));
+	return cap;
+}
+EXPORT_SYMBOL(thermal_engine_final_cpu_cap);
+
+unsigned int thermal_engine_gpu_cap(void)
+{
+	return ACCESS_ONCE(te_gpu_cap);
+}
+EXPORT_SYMBOL(thermal_engine_gpu_cap);
+
+int thermal_engine_register_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&te_notifier, nb);
+}
+EXPORT_SYMBOL(thermal_engine_register_notifier);
+
+static int te_residency_show(struct seq_file *m, void *unused)
+{
+	int i, s;
+
+	mutex_lock(&te_lock);
+	if (te_running)
+		te_account(ktime_get());
+	for (i = 0; i < TE_NR_DOMAINS; i++) {
+		struct te_domain *d = &domains[i];
+		u64 throttled = 0;
+
+		if (!d->valid)
+			continue;
+		for (s = 1; s <= d->max_steps; s++)
+			throttled += d->residency[s];
+		seq_printf(m, "%s: sensor=%d temp=%d setpoint=%d steps=%d "
+			   "cap=%u throttled_ms=%llu events=%lu\n", d->name,
+			   d->sensor, d->temp, d->setpoint, d->steps, d->cap,
+			   div_u64(throttled, NSEC_PER_MSEC),
+			   d->throttle_events);
+		for (s = 0; s <= d->max_steps; s++)
+			if (d->residency[s])
+				seq_printf(m, "  %2d %10u %llu\n", s,
+					   d->step_cap[s],
+					   div_u64(d->residency[s],
+						   NSEC_PER_MSEC));
+	}
+	mutex_unlock(&te_lock);
+	return 0;
+}
+
+static int te_residency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, te_residency_show, NULL);
+}
+
+static ssize_t te_residency_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	int i;
+
+	mutex_lock(&te_lock);
+	te_res_last = ktime_get();
+	for (i = 0; i < TE_NR_DOMAINS; i++) {
+		memset(domains[i].residency, 0, sizeof(domains[i].residency));
+		domains[i].throttle_events = 0;
+	}
+	mutex_unlock(&te_lock);
+	return count;
+}
+
+static const struct file_operations te_residency_fops = {
+	.open = te_residency_open,
+	.read = seq_read,
+	.write = te_residency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init msm_thermal_engine_init(void)
+{
+	struct dentry *dir;
+	int ret;
+
+	ret = cpufreq_register_notifier(&te_cpufreq_nb,
+					CPUFREQ_POLICY_NOTIFIER);
+	if (ret) {
+		pr_err("cannot register cpufreq notifier: %d\n", ret);
+		return ret;
+	}
+
+	dir = debugfs_create_dir("thermal_engine", NULL);
+	if (!IS_ERR_OR_NULL(dir))
+		debugfs_create_file("residency", 0644, dir, NULL,
+				    &te_residency_fops);
+
+	te_ready = true;
+	if (te_enabled)
+		te_start();
+	return 0;
+}
+late_initcall(msm_thermal_engine_init);
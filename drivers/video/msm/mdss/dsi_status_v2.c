@@ -78,7 +78,8 @@ void check_dsi_ctrl_status(struct work_struct *work)
 
 	if ((pdsi_status->mfd->panel_power_on)) {
 		if (ret > 0) {
-			schedule_delayed_work(&pdsi_status->check_status,
+			queue_delayed_work(system_power_efficient_wq,
+				&pdsi_status->check_status,
 				msecs_to_jiffies(pdsi_status->check_interval));
 		} else {
 			char *envp[2] = {"PANEL_ALIVE=0", NULL};
@@ -104,8 +105,9 @@ static int fb_event_callback(struct notifier_block *self,
 		int *blank = evdata->data;
 		switch (*blank) {
 		case FB_BLANK_UNBLANK:
-			schedule_delayed_work(&pdata->check_status,
-			msecs_to_jiffies(STATUS_CHECK_INTERVAL));
+			queue_delayed_work(system_power_efficient_wq,
+				&pdata->check_status,
+				msecs_to_jiffies(STATUS_CHECK_INTERVAL));
 			break;
 		case FB_BLANK_POWERDOWN:
 			cancel_delayed_work(&pdata->check_status);
@@ -921,7 +921,7 @@ void mdp3_ppp_req_pop(struct blit_req_queue *req_q)
 
 void mdp3_free_fw_timer_func(unsigned long arg)
 {
-	schedule_work(&ppp_stat->free_bw_work);
+	queue_work(system_power_efficient_wq, &ppp_stat->free_bw_work);
 }
 
 static void mdp3_free_bw_wq_handler(struct work_struct *work)
@@ -1078,7 +1078,7 @@ int mdp3_ppp_parse_req(void __user *p,
 
 	mdp3_ppp_req_push(req_q, req);
 	mutex_unlock(&ppp_stat->req_mutex);
-	schedule_work(&ppp_stat->blit_work);
+	queue_work(system_power_efficient_wq, &ppp_stat->blit_work);
 	if (!async) {
 		
 		rc = sync_fence_wait(fence,
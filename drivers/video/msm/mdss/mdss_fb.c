@@ -1418,7 +1418,7 @@ static int mdss_fb_pan_display_ex(struct fb_info *info,
 		sizeof(struct mdp_display_commit));
 	INIT_COMPLETION(mfd->commit_comp);
 	mfd->is_committing = 1;
-	schedule_work(&mfd->commit_work);
+	queue_work(system_power_efficient_wq, &mfd->commit_work);
 	mutex_unlock(&mfd->mdp_sync_pt_data.sync_mutex);
 	if (wait_for_finish)
 		mdss_fb_pan_idle(mfd);
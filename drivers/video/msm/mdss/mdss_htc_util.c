@@ -349,7 +349,8 @@ void htc_dimming_on(struct msm_fb_data_type *mfd)
 
 	INIT_DELAYED_WORK(&dimming_work, dimming_do_work);
 
-	schedule_delayed_work(&dimming_work, msecs_to_jiffies(1000));
+	queue_delayed_work(system_power_efficient_wq, &dimming_work,
+			   msecs_to_jiffies(1000));
 	return;
 }
 
@@ -249,7 +249,7 @@ static void mdss_mdp_cmd_readptr_done(void *arg)
 		mdss_mdp_irq_disable_nosync
 			(MDSS_MDP_IRQ_PING_PONG_RD_PTR, ctx->pp_num);
 		complete(&ctx->stop_comp);
-		schedule_work(&ctx->clk_work);
+		queue_work(system_power_efficient_wq, &ctx->clk_work);
 	}
 
 	spin_unlock(&ctx->clk_lock);
@@ -362,7 +362,7 @@ static int mdss_mdp_rotator_queue(struct mdss_mdp_rotator_session *rot)
 	int ret = 0;
 
 	if (rot->use_sync_pt)
-		schedule_work(&rot->commit_work);
+		queue_work(system_power_efficient_wq, &rot->commit_work);
 	else
 		ret = mdss_mdp_rotator_queue_helper(rot);
 
@@ -291,9 +291,10 @@ struct flex_groups {
 #define EXT4_EXTENTS_FL			0x00080000 
 #define EXT4_EA_INODE_FL	        0x00200000 
 #define EXT4_EOFBLOCKS_FL		0x00400000 
+#define EXT4_INLINE_DATA_FL		0x10000000 /* Inode has inline data */
 #define EXT4_RESERVED_FL		0x80000000 
 
-#define EXT4_FL_USER_VISIBLE		0x004BDFFF 
+#define EXT4_FL_USER_VISIBLE		0x104BDFFF 
 #define EXT4_FL_USER_MODIFIABLE		0x004B80FF 
 
 #define EXT4_FL_INHERITED (EXT4_SECRM_FL | EXT4_UNRM_FL | EXT4_COMPR_FL |\
@@ -338,6 +339,7 @@ enum {
 	EXT4_INODE_EXTENTS	= 19,	
 	EXT4_INODE_EA_INODE	= 21,	
 	EXT4_INODE_EOFBLOCKS	= 22,	
+	EXT4_INODE_INLINE_DATA	= 28,	
 	EXT4_INODE_RESERVED	= 31,	
 };
 
@@ -684,6 +686,10 @@ struct ext4_inode_info {
 	
 	__u16 i_extra_isize;
 
+	/* offset of system.data in the raw inode, 0 if none */
+	u16 i_inline_off;
+	unsigned int i_inline_size;
+
 #ifdef CONFIG_QUOTA
 	
 	qsize_t i_reserved_quota;
@@ -1062,6 +1068,7 @@ enum {
 	EXT4_STATE_DIO_UNWRITTEN,	
 	EXT4_STATE_NEWENTRY,		
 	EXT4_STATE_DELALLOC_RESERVED,	
+	EXT4_STATE_MAY_INLINE_DATA,	/* may have in-inode data */
 };
 
 #define EXT4_INODE_BIT_FNS(name, field, offset)				\
@@ -1094,6 +1101,21 @@ static inline void ext4_clear_state_flags(struct ext4_inode_info *ei)
 	
 }
 #endif
+
+/*
+ * Inline data lives in i_block and, past EXT4_MIN_INLINE_DATA_SIZE, in
+ * the in-inode xattr system.data. An inline directory keeps the parent
+ * inode number in the first four bytes instead of "." and "..".
+ */
+#define EXT4_MIN_INLINE_DATA_SIZE	((sizeof(__le32) * EXT4_N_BLOCKS))
+#define EXT4_INLINE_DOTDOT_OFFSET	2
+#define EXT4_INLINE_DOTDOT_SIZE		4
+
+static inline int ext4_has_inline_data(struct inode *inode)
+{
+	return ext4_test_inode_flag(inode, EXT4_INODE_INLINE_DATA) &&
+	       EXT4_I(inode)->i_inline_off;
+}
 #else
 #define EXT4_SB(sb)	(sb)
 #endif
@@ -1183,13 +1205,19 @@ static inline void ext4_clear_state_flags(struct ext4_inode_info *ei)
 					 EXT4_FEATURE_RO_COMPAT_BTREE_DIR)
 
 #define EXT4_FEATURE_COMPAT_SUPP	EXT2_FEATURE_COMPAT_EXT_ATTR
+#ifdef CONFIG_EXT4_FS_XATTR
+#define EXT4_FEATURE_INCOMPAT_INLINE_SUPP	EXT4_FEATURE_INCOMPAT_INLINEDATA
+#else
+#define EXT4_FEATURE_INCOMPAT_INLINE_SUPP	0
+#endif
 #define EXT4_FEATURE_INCOMPAT_SUPP	(EXT4_FEATURE_INCOMPAT_FILETYPE| \
 					 EXT4_FEATURE_INCOMPAT_RECOVER| \
 					 EXT4_FEATURE_INCOMPAT_META_BG| \
 					 EXT4_FEATURE_INCOMPAT_EXTENTS| \
 					 EXT4_FEATURE_INCOMPAT_64BIT| \
 					 EXT4_FEATURE_INCOMPAT_FLEX_BG| \
-					 EXT4_FEATURE_INCOMPAT_MMP)
+					 EXT4_FEATURE_INCOMPAT_MMP| \
+					 EXT4_FEATURE_INCOMPAT_INLINE_SUPP)
 #define EXT4_FEATURE_RO_COMPAT_SUPP	(EXT4_FEATURE_RO_COMPAT_SPARSE_SUPER| \
 					 EXT4_FEATURE_RO_COMPAT_LARGE_FILE| \
 					 EXT4_FEATURE_RO_COMPAT_GDT_CSUM| \
@@ -1477,10 +1505,12 @@ ext4_fsblk_t ext4_inode_to_goal_block(struct inode *);
 extern int __ext4_check_dir_entry(const char *, unsigned int, struct inode *,
 				  struct file *,
 				  struct ext4_dir_entry_2 *,
-				  struct buffer_head *, unsigned int);
-#define ext4_check_dir_entry(dir, filp, de, bh, offset)			\
+				  struct buffer_head *, char *, int,
+				  unsigned int);
+#define ext4_check_dir_entry(dir, filp, de, bh, buf, size, offset)	\
 	unlikely(__ext4_check_dir_entry(__func__, __LINE__, (dir), (filp), \
-					(de), (bh), (offset)))
+					(de), (bh), (buf), (size), (offset)))
+extern unsigned char get_dtype(struct super_block *sb, int filetype);
 extern int ext4_htree_store_dirent(struct file *dir_file, __u32 hash,
 				    __u32 minor_hash,
 				    struct ext4_dir_entry_2 *dirent);
@@ -1551,6 +1581,11 @@ extern void ext4_get_inode_flags(struct ext4_inode_info *);
 extern int ext4_alloc_da_blocks(struct inode *inode);
 extern void ext4_set_aops(struct inode *inode);
 extern int ext4_writepage_trans_blocks(struct inode *);
+extern int ext4_walk_page_buffers(handle_t *handle,
+				  struct buffer_head *head,
+				  unsigned from, unsigned to, int *partial,
+				  int (*fn)(handle_t *handle,
+					    struct buffer_head *bh));
 extern int ext4_chunk_trans_blocks(struct inode *, int nrblocks);
 extern int ext4_discard_partial_page_buffers(handle_t *handle,
 		struct address_space *mapping, loff_t from,
@@ -1578,6 +1613,24 @@ extern int ext4_orphan_add(handle_t *, struct inode *);
 extern int ext4_orphan_del(handle_t *, struct inode *);
 extern int ext4_htree_fill_tree(struct file *dir_file, __u32 start_hash,
 				__u32 start_minor_hash, __u32 *next_hash);
+extern int search_dir(struct buffer_head *bh, char *search_buf,
+		      int buf_size, struct inode *dir,
+		      const struct qstr *d_name, unsigned int offset,
+		      struct ext4_dir_entry_2 **res_dir);
+extern int ext4_find_dest_de(struct inode *dir, struct inode *inode,
+			     struct buffer_head *bh, void *buf, int buf_size,
+			     const char *name, int namelen,
+			     struct ext4_dir_entry_2 **dest_de);
+extern void ext4_insert_dentry(struct inode *inode,
+			       struct ext4_dir_entry_2 *de, int buf_size,
+			       const char *name, int namelen);
+extern struct ext4_dir_entry_2 *ext4_init_dot_dotdot(struct inode *inode,
+				struct ext4_dir_entry_2 *de, int blocksize,
+				unsigned int parent_ino, int dotdot_real_len);
+extern int ext4_generic_delete_entry(handle_t *handle, struct inode *dir,
+				     struct ext4_dir_entry_2 *de_del,
+				     struct buffer_head *bh, void *entry_buf,
+				     int buf_size);
 
 extern int ext4_group_add(struct super_block *sb,
 				struct ext4_new_group_data *input);
@@ -720,6 +720,10 @@ got:
 	if (err)
 		goto fail_free_drop;
 
+	if (EXT4_HAS_INCOMPAT_FEATURE(sb, EXT4_FEATURE_INCOMPAT_INLINEDATA) &&
+	    (S_ISDIR(mode) || S_ISREG(mode)))
+		ext4_set_inode_state(inode, EXT4_STATE_MAY_INLINE_DATA);
+
 	if (EXT4_HAS_INCOMPAT_FEATURE(sb, EXT4_FEATURE_INCOMPAT_EXTENTS)) {
 		
 		if (S_ISDIR(mode) || S_ISREG(mode) || S_ISLNK(mode)) {
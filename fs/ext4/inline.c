@@ -0,0 +1,1422 @@
+/*
+ * linux/fs/ext4/inline.c
+ *
+ * Inline data: small files and directories stored in i_block and in the
+ * in-inode extended attribute system.data, laid out as e2fsprogs does.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/fiemap.h>
+#include <linux/pagemap.h>
+
+#include "ext4_jbd2.h"
+#include "ext4.h"
+#include "xattr.h"
+
+/*
+ * Writers hold xattr_sem for write with EXT4_STATE_NO_EXPAND set, so that
+ * marking the inode dirty never tries to expand i_extra_isize and take
+ * xattr_sem again.
+ */
+static void ext4_write_lock_xattr(struct inode *inode, int *save)
+{
+	down_write(&EXT4_I(inode)->xattr_sem);
+	*save = ext4_test_inode_state(inode, EXT4_STATE_NO_EXPAND);
+	ext4_set_inode_state(inode, EXT4_STATE_NO_EXPAND);
+}
+
+static void ext4_write_unlock_xattr(struct inode *inode, int *save)
+{
+	if (!*save)
+		ext4_clear_inode_state(inode, EXT4_STATE_NO_EXPAND);
+	up_write(&EXT4_I(inode)->xattr_sem);
+}
+
+static int get_max_inline_xattr_value_size(struct inode *inode,
+					   struct ext4_iloc *iloc)
+{
+	struct ext4_xattr_ibody_header *header;
+	struct ext4_xattr_entry *entry;
+	struct ext4_inode *raw_inode;
+	int free, min_offs;
+
+	min_offs = EXT4_SB(inode->i_sb)->s_inode_size -
+			EXT4_GOOD_OLD_INODE_SIZE -
+			EXT4_I(inode)->i_extra_isize -
+			sizeof(struct ext4_xattr_ibody_header);
+
+	/* The entry table is terminated by an empty __u32 */
+	if (!ext4_test_inode_state(inode, EXT4_STATE_XATTR))
+		return EXT4_XATTR_SIZE(min_offs -
+			EXT4_XATTR_LEN(strlen(EXT4_XATTR_SYSTEM_DATA)) -
+			EXT4_XATTR_ROUND - sizeof(__u32));
+
+	raw_inode = ext4_raw_inode(iloc);
+	header = IHDR(inode, raw_inode);
+	entry = IFIRST(header);
+
+	for (; !IS_LAST_ENTRY(entry); entry = EXT4_XATTR_NEXT(entry)) {
+		if (!entry->e_value_block && entry->e_value_size) {
+			size_t offs = le16_to_cpu(entry->e_value_offs);
+			if (offs < min_offs)
+				min_offs = offs;
+		}
+	}
+	free = min_offs -
+		((void *)entry - (void *)IFIRST(header)) - sizeof(__u32);
+
+	if (EXT4_I(inode)->i_inline_off) {
+		entry = (struct ext4_xattr_entry *)
+			((void *)raw_inode + EXT4_I(inode)->i_inline_off);
+		return free + EXT4_XATTR_SIZE(le32_to_cpu(entry->e_value_size));
+	}
+
+	free -= EXT4_XATTR_LEN(strlen(EXT4_XATTR_SYSTEM_DATA));
+	if (free > EXT4_XATTR_ROUND)
+		return EXT4_XATTR_SIZE(free - EXT4_XATTR_ROUND);
+	return 0;
+}
+
+static int ext4_get_max_inline_size(struct inode *inode)
+{
+	struct ext4_iloc iloc;
+	int max_inline_size;
+
+	if (EXT4_I(inode)->i_extra_isize == 0)
+		return 0;
+
+	if (ext4_get_inode_loc(inode, &iloc))
+		return 0;
+
+	down_read(&EXT4_I(inode)->xattr_sem);
+	max_inline_size = get_max_inline_xattr_value_size(inode, &iloc);
+	up_read(&EXT4_I(inode)->xattr_sem);
+
+	brelse(iloc.bh);
+
+	if (!max_inline_size)
+		return 0;
+	return max_inline_size + EXT4_MIN_INLINE_DATA_SIZE;
+}
+
+int ext4_get_inline_size(struct inode *inode)
+{
+	if (EXT4_I(inode)->i_inline_off)
+		return EXT4_I(inode)->i_inline_size;
+	return 0;
+}
+
+int ext4_find_inline_data_nolock(struct inode *inode)
+{
+	struct ext4_xattr_ibody_find is = {
+		.s = { .not_found = -ENODATA, },
+	};
+	struct ext4_xattr_info i = {
+		.name_index = EXT4_XATTR_INDEX_SYSTEM,
+		.name = EXT4_XATTR_SYSTEM_DATA,
+	};
+	int error;
+
+	if (EXT4_I(inode)->i_extra_isize == 0)
+		return 0;
+
+	error = ext4_get_inode_loc(inode, &is.iloc);
+	if (error)
+		return error;
+
+	error = ext4_xattr_ibody_find(inode, &i, &is);
+	if (error)
+		goto out;
+
+	if (!is.s.not_found) {
+		EXT4_I(inode)->i_inline_off = (u16)((void *)is.s.here -
+					(void *)ext4_raw_inode(&is.iloc));
+		EXT4_I(inode)->i_inline_size = EXT4_MIN_INLINE_DATA_SIZE +
+				le32_to_cpu(is.s.here->e_value_size);
+		ext4_set_inode_state(inode, EXT4_STATE_MAY_INLINE_DATA);
+	}
+out:
+	brelse(is.iloc.bh);
+	return error;
+}
+
+static void *ext4_get_inline_xattr_pos(struct inode *inode,
+				       struct ext4_iloc *iloc)
+{
+	struct ext4_inode *raw_inode = ext4_raw_inode(iloc);
+	struct ext4_xattr_entry *entry;
+
+	entry = (struct ext4_xattr_entry *)((void *)raw_inode +
+					    EXT4_I(inode)->i_inline_off);
+	return (void *)IFIRST(IHDR(inode, raw_inode)) +
+		le16_to_cpu(entry->e_value_offs);
+}
+
+static int ext4_read_inline_data(struct inode *inode, void *buffer,
+				 unsigned int len, struct ext4_iloc *iloc)
+{
+	struct ext4_xattr_entry *entry;
+	unsigned int cp_len;
+
+	if (!len)
+		return 0;
+
+	BUG_ON(len > EXT4_I(inode)->i_inline_size);
+
+	cp_len = min_t(unsigned int, len, EXT4_MIN_INLINE_DATA_SIZE);
+	memcpy(buffer, (void *)ext4_raw_inode(iloc)->i_block, cp_len);
+
+	len -= cp_len;
+	if (!len)
+		return cp_len;
+
+	entry = (struct ext4_xattr_entry *)((void *)ext4_raw_inode(iloc) +
+					    EXT4_I(inode)->i_inline_off);
+	len = min_t(unsigned int, len, le32_to_cpu(entry->e_value_size));
+	memcpy(buffer + cp_len, ext4_get_inline_xattr_pos(inode, iloc), len);
+
+	return cp_len + len;
+}
+
+/* buffer holds the whole inline area; only [pos, pos + len) is copied */
+static void ext4_write_inline_data(struct inode *inode, struct ext4_iloc *iloc,
+				   void *buffer, loff_t pos, unsigned int len)
+{
+	unsigned int cp_len;
+
+	BUG_ON(!EXT4_I(inode)->i_inline_off);
+	BUG_ON(pos + len > EXT4_I(inode)->i_inline_size);
+
+	buffer += pos;
+	if (pos < EXT4_MIN_INLINE_DATA_SIZE) {
+		cp_len = min_t(unsigned int, len,
+			       EXT4_MIN_INLINE_DATA_SIZE - pos);
+		memcpy((void *)ext4_raw_inode(iloc)->i_block + pos,
+		       buffer, cp_len);
+		len -= cp_len;
+		buffer += cp_len;
+		pos += cp_len;
+	}
+
+	if (!len)
+		return;
+
+	pos -= EXT4_MIN_INLINE_DATA_SIZE;
+	memcpy(ext4_get_inline_xattr_pos(inode, iloc) + pos, buffer, len);
+}
+
+static int ext4_create_inline_data(handle_t *handle,
+				   struct inode *inode, unsigned int len)
+{
+	struct ext4_xattr_ibody_find is = {
+		.s = { .not_found = -ENODATA, },
+	};
+	struct ext4_xattr_info i = {
+		.name_index = EXT4_XATTR_INDEX_SYSTEM,
+		.name = EXT4_XATTR_SYSTEM_DATA,
+	};
+	int error;
+
+	error = ext4_get_inode_loc(inode, &is.iloc);
+	if (error)
+		return error;
+
+	error = ext4_journal_get_write_access(handle, is.iloc.bh);
+	if (error)
+		goto out;
+
+	if (len > EXT4_MIN_INLINE_DATA_SIZE) {
+		i.value = EXT4_ZERO_XATTR_VALUE;
+		i.value_len = len - EXT4_MIN_INLINE_DATA_SIZE;
+	} else {
+		i.value = "";
+		i.value_len = 0;
+	}
+
+	error = ext4_xattr_ibody_find(inode, &i, &is);
+	if (error)
+		goto out;
+
+	error = ext4_xattr_ibody_set(handle, inode, &i, &is);
+	if (error) {
+		if (error == -ENOSPC)
+			ext4_clear_inode_state(inode,
+					       EXT4_STATE_MAY_INLINE_DATA);
+		goto out;
+	}
+
+	memset((void *)ext4_raw_inode(&is.iloc)->i_block, 0,
+	       EXT4_MIN_INLINE_DATA_SIZE);
+
+	EXT4_I(inode)->i_inline_off = (u16)((void *)is.s.here -
+				(void *)ext4_raw_inode(&is.iloc));
+	EXT4_I(inode)->i_inline_size = i.value_len + EXT4_MIN_INLINE_DATA_SIZE;
+	ext4_clear_inode_flag(inode, EXT4_INODE_EXTENTS);
+	ext4_set_inode_flag(inode, EXT4_INODE_INLINE_DATA);
+	get_bh(is.iloc.bh);
+	error = ext4_mark_iloc_dirty(handle, inode, &is.iloc);
+out:
+	brelse(is.iloc.bh);
+	return error;
+}
+
+static int ext4_update_inline_data(handle_t *handle, struct inode *inode,
+				   unsigned int len)
+{
+	struct ext4_xattr_ibody_find is = {
+		.s = { .not_found = -ENODATA, },
+	};
+	struct ext4_xattr_info i = {
+		.name_index = EXT4_XATTR_INDEX_SYSTEM,
+		.name = EXT4_XATTR_SYSTEM_DATA,
+	};
+	void *value = NULL;
+	int error;
+
+	if (len <= EXT4_I(inode)->i_inline_size)
+		return 0;
+
+	error = ext4_get_inode_loc(inode, &is.iloc);
+	if (error)
+		return error;
+
+	error = ext4_xattr_ibody_find(inode, &i, &is);
+	if (error)
+		goto out;
+	if (is.s.not_found) {
+		EXT4_ERROR_INODE(inode, "missing inline data xattr");
+		error = -EIO;
+		goto out;
+	}
+
+	len -= EXT4_MIN_INLINE_DATA_SIZE;
+	value = kzalloc(len, GFP_NOFS);
+	if (!value) {
+		error = -ENOMEM;
+		goto out;
+	}
+
+	error = ext4_xattr_ibody_get(inode, i.name_index, i.name,
+				     value, len);
+	if (error < 0)
+		goto out;
+
+	error = ext4_journal_get_write_access(handle, is.iloc.bh);
+	if (error)
+		goto out;
+
+	i.value = value;
+	i.value_len = len;
+	error = ext4_xattr_ibody_set(handle, inode, &i, &is);
+	if (error)
+		goto out;
+
+	EXT4_I(inode)->i_inline_off = (u16)((void *)is.s.here -
+				(void *)ext4_raw_inode(&is.iloc));
+	EXT4_I(inode)->i_inline_size = EXT4_MIN_INLINE_DATA_SIZE +
+				le32_to_cpu(is.s.here->e_value_size);
+	get_bh(is.iloc.bh);
+	error = ext4_mark_iloc_dirty(handle, inode, &is.iloc);
+out:
+	kfree(value);
+	brelse(is.iloc.bh);
+	return error;
+}
+
+static int ext4_prepare_inline_data(handle_t *handle, struct inode *inode,
+				    unsigned int len)
+{
+	int ret, no_expand;
+
+	if (!ext4_test_inode_state(inode, EXT4_STATE_MAY_INLINE_DATA))
+		return -ENOSPC;
+
+	if (len > ext4_get_max_inline_size(inode))
+		return -ENOSPC;
+
+	ext4_write_lock_xattr(inode, &no_expand);
+	if (EXT4_I(inode)->i_inline_off)
+		ret = ext4_update_inline_data(handle, inode, len);
+	else
+		ret = ext4_create_inline_data(handle, inode, len);
+	ext4_write_unlock_xattr(inode, &no_expand);
+
+	return ret;
+}
+
+static int ext4_destroy_inline_data_nolock(handle_t *handle,
+					   struct inode *inode)
+{
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	struct ext4_xattr_ibody_find is = {
+		.s = { .not_found = -ENODATA, },
+	};
+	struct ext4_xattr_info i = {
+		.name_index = EXT4_XATTR_INDEX_SYSTEM,
+		.name = EXT4_XATTR_SYSTEM_DATA,
+		.value = NULL,
+		.value_len = 0,
+	};
+	int error;
+
+	if (!ei->i_inline_off)
+		return 0;
+
+	error = ext4_get_inode_loc(inode, &is.iloc);
+	if (error)
+		return error;
+
+	error = ext4_xattr_ibody_find(inode, &i, &is);
+	if (error)
+		goto out;
+
+	error = ext4_journal_get_write_access(handle, is.iloc.bh);
+	if (error)
+		goto out;
+
+	error = ext4_xattr_ibody_set(handle, inode, &i, &is);
+	if (error)
+		goto out;
+
+	memset((void *)ext4_raw_inode(&is.iloc)->i_block, 0,
+	       EXT4_MIN_INLINE_DATA_SIZE);
+	memset(ei->i_data, 0, sizeof(ei->i_data));
+
+	if (EXT4_HAS_INCOMPAT_FEATURE(inode->i_sb,
+				      EXT4_FEATURE_INCOMPAT_EXTENTS) &&
+	    (S_ISDIR(inode->i_mode) || S_ISREG(inode->i_mode) ||
+	     S_ISLNK(inode->i_mode))) {
+		ext4_set_inode_flag(inode, EXT4_INODE_EXTENTS);
+		ext4_ext_tree_init(handle, inode);
+	}
+	ext4_clear_inode_flag(inode, EXT4_INODE_INLINE_DATA);
+
+	get_bh(is.iloc.bh);
+	error = ext4_mark_iloc_dirty(handle, inode, &is.iloc);
+
+	ei->i_inline_off = 0;
+	ei->i_inline_size = 0;
+	ext4_clear_inode_state(inode, EXT4_STATE_MAY_INLINE_DATA);
+out:
+	brelse(is.iloc.bh);
+	return error;
+}
+
+/*
+ * Put back inline data that was destroyed for a conversion whose block
+ * allocation then failed. The data always fits in a single block, so
+ * nothing was allocated yet.
+ */
+static int ext4_restore_inline_data(handle_t *handle, struct inode *inode,
+				    struct ext4_iloc *iloc,
+				    void *buf, int inline_size)
+{
+	int err;
+
+	err = ext4_create_inline_data(handle, inode, inline_size);
+	if (err)
+		return err;
+
+	ext4_write_inline_data(inode, iloc, buf, 0, inline_size);
+	ext4_set_inode_state(inode, EXT4_STATE_MAY_INLINE_DATA);
+	get_bh(iloc->bh);
+	return ext4_mark_iloc_dirty(handle, inode, iloc);
+}
+
+static int ext4_read_inline_page(struct inode *inode, struct page *page)
+{
+	struct ext4_iloc iloc;
+	void *kaddr;
+	size_t len;
+	int ret;
+
+	BUG_ON(!PageLocked(page));
+	BUG_ON(page->index);
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		return ret;
+
+	len = min_t(size_t, ext4_get_inline_size(inode), i_size_read(inode));
+	kaddr = kmap_atomic(page);
+	ret = ext4_read_inline_data(inode, kaddr, len, &iloc);
+	flush_dcache_page(page);
+	kunmap_atomic(kaddr);
+	zero_user_segment(page, len, PAGE_CACHE_SIZE);
+	SetPageUptodate(page);
+	brelse(iloc.bh);
+
+	return ret;
+}
+
+int ext4_readpage_inline(struct inode *inode, struct page *page)
+{
+	int ret = 0;
+
+	down_read(&EXT4_I(inode)->xattr_sem);
+	if (!ext4_has_inline_data(inode)) {
+		up_read(&EXT4_I(inode)->xattr_sem);
+		return -EAGAIN;
+	}
+
+	if (!page->index)
+		ret = ext4_read_inline_page(inode, page);
+	else if (!PageUptodate(page)) {
+		zero_user_segment(page, 0, PAGE_CACHE_SIZE);
+		SetPageUptodate(page);
+	}
+	up_read(&EXT4_I(inode)->xattr_sem);
+
+	unlock_page(page);
+	return ret >= 0 ? 0 : ret;
+}
+
+static int ext4_journal_inline_buffer(handle_t *handle, struct buffer_head *bh)
+{
+	int ret;
+
+	if (!buffer_mapped(bh) || buffer_freed(bh))
+		return 0;
+	ret = ext4_journal_get_write_access(handle, bh);
+	if (!ret)
+		ret = ext4_handle_dirty_metadata(handle, NULL, bh);
+	return ret;
+}
+
+static int ext4_convert_inline_data_to_extent(struct address_space *mapping,
+					      struct inode *inode,
+					      unsigned flags)
+{
+	int ret, no_expand, retries = 0;
+	unsigned int to;
+	struct ext4_iloc iloc;
+	struct page *page;
+	handle_t *handle;
+
+	if (!ext4_has_inline_data(inode)) {
+		ext4_clear_inode_state(inode, EXT4_STATE_MAY_INLINE_DATA);
+		return 0;
+	}
+
+retry:
+	handle = ext4_journal_start(inode, ext4_writepage_trans_blocks(inode));
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	page = grab_cache_page_write_begin(mapping, 0, flags | AOP_FLAG_NOFS);
+	if (!page) {
+		ret = -ENOMEM;
+		goto out_stop;
+	}
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		goto out_page;
+
+	ext4_write_lock_xattr(inode, &no_expand);
+	if (!ext4_has_inline_data(inode)) {
+		ext4_clear_inode_state(inode, EXT4_STATE_MAY_INLINE_DATA);
+		ret = 0;
+		goto out_unlock;
+	}
+
+	if (!PageUptodate(page)) {
+		ret = ext4_read_inline_page(inode, page);
+		if (ret < 0)
+			goto out_unlock;
+	}
+
+	to = min_t(unsigned int, ext4_get_inline_size(inode),
+		   i_size_read(inode));
+	ret = ext4_destroy_inline_data_nolock(handle, inode);
+	if (ret || !to)
+		goto out_unlock;
+
+	ret = __block_write_begin(page, 0, to, ext4_get_block);
+	if (ret) {
+		ext4_restore_inline_data(handle, inode, &iloc,
+					 kmap(page), to);
+		kunmap(page);
+		goto out_unlock;
+	}
+
+	if (ext4_should_journal_data(inode)) {
+		ret = ext4_walk_page_buffers(handle, page_buffers(page), 0, to,
+					     NULL, ext4_journal_inline_buffer);
+		ext4_set_inode_state(inode, EXT4_STATE_JDATA);
+	} else {
+		block_commit_write(page, 0, to);
+		if (ext4_should_order_data(inode))
+			ret = ext4_jbd2_file_inode(handle, inode);
+	}
+
+out_unlock:
+	ext4_write_unlock_xattr(inode, &no_expand);
+	brelse(iloc.bh);
+out_page:
+	unlock_page(page);
+	page_cache_release(page);
+out_stop:
+	ext4_journal_stop(handle);
+	if (ret == -ENOSPC && ext4_should_retry_alloc(inode->i_sb, &retries))
+		goto retry;
+	return ret;
+}
+
+int ext4_convert_inline_data(struct inode *inode)
+{
+	if (!ext4_has_inline_data(inode)) {
+		ext4_clear_inode_state(inode, EXT4_STATE_MAY_INLINE_DATA);
+		return 0;
+	}
+	return ext4_convert_inline_data_to_extent(inode->i_mapping, inode, 0);
+}
+
+/*
+ * Returns 1 with page 0 locked in *pagep and a handle running if the write
+ * goes to the inode, 0 if it has to use blocks, or a negative error.
+ */
+int ext4_try_to_write_inline_data(struct address_space *mapping,
+				  struct inode *inode,
+				  loff_t pos, unsigned len,
+				  unsigned flags,
+				  struct page **pagep)
+{
+	struct page *page;
+	handle_t *handle;
+	int ret;
+
+	if (pos + len > ext4_get_max_inline_size(inode))
+		goto convert;
+
+	handle = ext4_journal_start(inode, ext4_writepage_trans_blocks(inode));
+	if (IS_ERR(handle))
+		return PTR_ERR(handle);
+
+	ret = ext4_prepare_inline_data(handle, inode, pos + len);
+	if (ret == -ENOSPC) {
+		ext4_journal_stop(handle);
+		goto convert;
+	}
+	if (ret)
+		goto out_stop;
+
+	page = grab_cache_page_write_begin(mapping, 0, flags | AOP_FLAG_NOFS);
+	if (!page) {
+		ret = -ENOMEM;
+		goto out_stop;
+	}
+
+	down_read(&EXT4_I(inode)->xattr_sem);
+	if (!ext4_has_inline_data(inode)) {
+		ret = 0;
+		goto out_release;
+	}
+
+	if (!PageUptodate(page)) {
+		ret = ext4_read_inline_page(inode, page);
+		if (ret < 0)
+			goto out_release;
+	}
+	up_read(&EXT4_I(inode)->xattr_sem);
+
+	*pagep = page;
+	return 1;
+
+out_release:
+	up_read(&EXT4_I(inode)->xattr_sem);
+	unlock_page(page);
+	page_cache_release(page);
+out_stop:
+	ext4_journal_stop(handle);
+	return ret;
+convert:
+	return ext4_convert_inline_data_to_extent(mapping, inode, flags);
+}
+
+int ext4_write_inline_data_end(struct inode *inode, loff_t pos, unsigned len,
+			       unsigned copied, struct page *page)
+{
+	handle_t *handle = ext4_journal_current_handle();
+	struct ext4_iloc iloc;
+	void *kaddr;
+	int ret, no_expand;
+
+	if (unlikely(copied < len) && !PageUptodate(page))
+		return 0;
+
+	ret = ext4_reserve_inode_write(handle, inode, &iloc);
+	if (ret) {
+		ext4_std_error(inode->i_sb, ret);
+		return 0;
+	}
+
+	ext4_write_lock_xattr(inode, &no_expand);
+	BUG_ON(!ext4_has_inline_data(inode));
+
+	kaddr = kmap_atomic(page);
+	ext4_write_inline_data(inode, &iloc, kaddr, pos, copied);
+	kunmap_atomic(kaddr);
+	SetPageUptodate(page);
+	/* The data is in the inode now, writeback must not see the page */
+	ClearPageDirty(page);
+	ext4_write_unlock_xattr(inode, &no_expand);
+
+	ret = ext4_mark_iloc_dirty(handle, inode, &iloc);
+	if (ret)
+		ext4_std_error(inode->i_sb, ret);
+
+	return copied;
+}
+
+void ext4_inline_data_truncate(struct inode *inode, int *has_inline)
+{
+	struct ext4_xattr_ibody_find is = {
+		.s = { .not_found = -ENODATA, },
+	};
+	struct ext4_xattr_info i = {
+		.name_index = EXT4_XATTR_INDEX_SYSTEM,
+		.name = EXT4_XATTR_SYSTEM_DATA,
+	};
+	int inline_size, value_len, no_expand;
+	void *value = NULL;
+	handle_t *handle;
+	size_t i_size;
+
+	handle = ext4_journal_start(inode, ext4_writepage_trans_blocks(inode));
+	if (IS_ERR(handle))
+		return;
+
+	ext4_write_lock_xattr(inode, &no_expand);
+	if (!ext4_has_inline_data(inode)) {
+		*has_inline = 0;
+		ext4_write_unlock_xattr(inode, &no_expand);
+		ext4_journal_stop(handle);
+		return;
+	}
+
+	if (ext4_get_inode_loc(inode, &is.iloc))
+		goto out;
+	if (ext4_journal_get_write_access(handle, is.iloc.bh))
+		goto out;
+
+	down_write(&EXT4_I(inode)->i_data_sem);
+	i_size = inode->i_size;
+	inline_size = ext4_get_inline_size(inode);
+	EXT4_I(inode)->i_disksize = i_size;
+
+	if (i_size < inline_size) {
+		if (inline_size > EXT4_MIN_INLINE_DATA_SIZE) {
+			if (ext4_xattr_ibody_find(inode, &i, &is) ||
+			    is.s.not_found)
+				goto out_sem;
+
+			value_len = le32_to_cpu(is.s.here->e_value_size);
+			value = kmalloc(value_len, GFP_NOFS);
+			if (!value)
+				goto out_sem;
+
+			if (ext4_xattr_ibody_get(inode, i.name_index, i.name,
+						 value, value_len) != value_len)
+				goto out_sem;
+
+			i.value = value;
+			i.value_len = i_size > EXT4_MIN_INLINE_DATA_SIZE ?
+					i_size - EXT4_MIN_INLINE_DATA_SIZE : 0;
+			if (ext4_xattr_ibody_set(handle, inode, &i, &is))
+				goto out_sem;
+		}
+
+		if (i_size < EXT4_MIN_INLINE_DATA_SIZE)
+			memset((void *)ext4_raw_inode(&is.iloc)->i_block +
+			       i_size, 0, EXT4_MIN_INLINE_DATA_SIZE - i_size);
+
+		EXT4_I(inode)->i_inline_size = max_t(size_t, i_size,
+						EXT4_MIN_INLINE_DATA_SIZE);
+	}
+
+out_sem:
+	up_write(&EXT4_I(inode)->i_data_sem);
+out:
+	brelse(is.iloc.bh);
+	ext4_write_unlock_xattr(inode, &no_expand);
+	kfree(value);
+
+	inode->i_mtime = inode->i_ctime = ext4_current_time(inode);
+	ext4_mark_inode_dirty(handle, inode);
+	if (IS_SYNC(inode))
+		ext4_handle_sync(handle);
+
+	ext4_journal_stop(handle);
+}
+
+int ext4_inline_data_fiemap(struct inode *inode,
+			    struct fiemap_extent_info *fieinfo,
+			    int *has_inline)
+{
+	__u32 flags = FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_LAST;
+	struct ext4_iloc iloc;
+	__u64 physical;
+	int error = 0;
+
+	down_read(&EXT4_I(inode)->xattr_sem);
+	if (!ext4_has_inline_data(inode)) {
+		*has_inline = 0;
+		goto out;
+	}
+
+	error = ext4_get_inode_loc(inode, &iloc);
+	if (error)
+		goto out;
+
+	physical = (__u64)iloc.bh->b_blocknr << inode->i_sb->s_blocksize_bits;
+	physical += (char *)ext4_raw_inode(&iloc) - iloc.bh->b_data;
+	physical += offsetof(struct ext4_inode, i_block);
+
+	error = fiemap_fill_next_extent(fieinfo, 0, physical,
+					i_size_read(inode), flags);
+	brelse(iloc.bh);
+out:
+	up_read(&EXT4_I(inode)->xattr_sem);
+	return error < 0 ? error : 0;
+}
+
+/*
+ * An inline directory has no "." and "..": i_block starts with the parent
+ * inode number and is followed by a dirent chain, and the xattr value
+ * holds a second, separate chain.
+ */
+int ext4_try_create_inline_dir(handle_t *handle, struct inode *parent,
+			       struct inode *inode)
+{
+	int ret, inline_size = EXT4_MIN_INLINE_DATA_SIZE;
+	struct ext4_dir_entry_2 *de;
+	struct ext4_iloc iloc;
+
+	ret = ext4_prepare_inline_data(handle, inode, inline_size);
+	if (ret)
+		return ret;
+
+	ret = ext4_reserve_inode_write(handle, inode, &iloc);
+	if (ret)
+		return ret;
+
+	de = (struct ext4_dir_entry_2 *)ext4_raw_inode(&iloc)->i_block;
+	de->inode = cpu_to_le32(parent->i_ino);
+	de = (struct ext4_dir_entry_2 *)((void *)de + EXT4_INLINE_DOTDOT_SIZE);
+	de->inode = 0;
+	de->rec_len = ext4_rec_len_to_disk(inline_size -
+					   EXT4_INLINE_DOTDOT_SIZE,
+					   inline_size);
+	set_nlink(inode, 2);
+	inode->i_size = EXT4_I(inode)->i_disksize = inline_size;
+
+	return ext4_mark_iloc_dirty(handle, inode, &iloc);
+}
+
+/* Stretch the last entry of a chain of old_size bytes to new_size */
+static void ext4_update_final_de(void *de_buf, int old_size, int new_size)
+{
+	struct ext4_dir_entry_2 *de, *prev_de;
+	void *limit;
+	int de_len;
+
+	de = (struct ext4_dir_entry_2 *)de_buf;
+	if (!old_size) {
+		de->inode = 0;
+		de->rec_len = ext4_rec_len_to_disk(new_size, new_size);
+		return;
+	}
+
+	limit = de_buf + old_size;
+	do {
+		prev_de = de;
+		de_len = ext4_rec_len_from_disk(de->rec_len, old_size);
+		de_buf += de_len;
+		de = (struct ext4_dir_entry_2 *)de_buf;
+	} while (de_len && de_buf < limit);
+
+	prev_de->rec_len = ext4_rec_len_to_disk(de_len + new_size - old_size,
+						old_size);
+}
+
+static int ext4_update_inline_dir(handle_t *handle, struct inode *dir,
+				  struct ext4_iloc *iloc)
+{
+	int old_size = EXT4_I(dir)->i_inline_size - EXT4_MIN_INLINE_DATA_SIZE;
+	int new_size = get_max_inline_xattr_value_size(dir, iloc);
+	int ret;
+
+	if (new_size - old_size <= EXT4_DIR_REC_LEN(1))
+		return -ENOSPC;
+
+	ret = ext4_update_inline_data(handle, dir,
+				      new_size + EXT4_MIN_INLINE_DATA_SIZE);
+	if (ret)
+		return ret;
+
+	ext4_update_final_de(ext4_get_inline_xattr_pos(dir, iloc), old_size,
+			     EXT4_I(dir)->i_inline_size -
+			     EXT4_MIN_INLINE_DATA_SIZE);
+	dir->i_size = EXT4_I(dir)->i_disksize = EXT4_I(dir)->i_inline_size;
+	return 0;
+}
+
+static int ext4_add_dirent_to_inline(handle_t *handle,
+				     struct dentry *dentry,
+				     struct inode *inode,
+				     struct ext4_iloc *iloc,
+				     void *inline_start, int inline_size)
+{
+	struct inode *dir = dentry->d_parent->d_inode;
+	const char *name = dentry->d_name.name;
+	int namelen = dentry->d_name.len;
+	struct ext4_dir_entry_2 *de;
+	int err;
+
+	err = ext4_find_dest_de(dir, inode, iloc->bh, inline_start,
+				inline_size, name, namelen, &de);
+	if (err)
+		return err;
+
+	BUFFER_TRACE(iloc->bh, "get_write_access");
+	err = ext4_journal_get_write_access(handle, iloc->bh);
+	if (err)
+		return err;
+	ext4_insert_dentry(inode, de, inline_size, name, namelen);
+
+	dir->i_mtime = dir->i_ctime = ext4_current_time(dir);
+	dir->i_version++;
+	return 1;
+}
+
+static int ext4_check_all_de(struct inode *dir, struct buffer_head *bh,
+			     void *buf, int buf_size)
+{
+	struct ext4_dir_entry_2 *de;
+	unsigned int offset = 0;
+
+	while (offset < buf_size) {
+		de = (struct ext4_dir_entry_2 *)(buf + offset);
+		if (ext4_check_dir_entry(dir, NULL, de, bh, buf, buf_size,
+					 offset))
+			return -EIO;
+		offset += ext4_rec_len_from_disk(de->rec_len, buf_size);
+	}
+	return 0;
+}
+
+static int ext4_finish_convert_inline_dir(handle_t *handle,
+					  struct inode *inode,
+					  struct buffer_head *dir_block,
+					  void *buf, int inline_size)
+{
+	unsigned int blocksize = inode->i_sb->s_blocksize;
+	struct ext4_dir_entry_2 *de;
+	int header_size;
+
+	de = ext4_init_dot_dotdot(inode,
+				  (struct ext4_dir_entry_2 *)dir_block->b_data,
+				  blocksize, le32_to_cpu(*(__le32 *)buf), 1);
+	header_size = (void *)de - (void *)dir_block->b_data;
+
+	memcpy(de, buf + EXT4_INLINE_DOTDOT_SIZE,
+	       inline_size - EXT4_INLINE_DOTDOT_SIZE);
+	ext4_update_final_de(dir_block->b_data,
+			     inline_size - EXT4_INLINE_DOTDOT_SIZE +
+			     header_size, blocksize);
+
+	inode->i_size = EXT4_I(inode)->i_disksize = blocksize;
+
+	BUFFER_TRACE(dir_block, "call ext4_handle_dirty_metadata");
+	return ext4_handle_dirty_metadata(handle, inode, dir_block);
+}
+
+static int ext4_convert_inline_data_nolock(handle_t *handle,
+					   struct inode *inode,
+					   struct ext4_iloc *iloc)
+{
+	int inline_size = ext4_get_inline_size(inode);
+	struct buffer_head *dir_block;
+	void *buf;
+	int error;
+
+	buf = kmalloc(inline_size, GFP_NOFS);
+	if (!buf)
+		return -ENOMEM;
+
+	error = ext4_read_inline_data(inode, buf, inline_size, iloc);
+	if (error < 0)
+		goto out;
+
+	/* Refuse to spread a corrupted inline directory into a block */
+	error = ext4_check_all_de(inode, iloc->bh,
+				  buf + EXT4_INLINE_DOTDOT_SIZE,
+				  inline_size - EXT4_INLINE_DOTDOT_SIZE);
+	if (error)
+		goto out;
+
+	error = ext4_destroy_inline_data_nolock(handle, inode);
+	if (error)
+		goto out;
+
+	dir_block = ext4_bread(handle, inode, 0, 1, &error);
+	if (!dir_block) {
+		ext4_restore_inline_data(handle, inode, iloc, buf,
+					 inline_size);
+		if (!error)
+			error = -EIO;
+		goto out;
+	}
+
+	BUFFER_TRACE(dir_block, "get_write_access");
+	error = ext4_journal_get_write_access(handle, dir_block);
+	if (!error)
+		error = ext4_finish_convert_inline_dir(handle, inode,
+						       dir_block, buf,
+						       inline_size);
+	brelse(dir_block);
+out:
+	kfree(buf);
+	return error;
+}
+
+/*
+ * Returns 1 if the entry went into the inode, 0 if the caller has to add
+ * it to a block (the directory has been converted if needed), or a
+ * negative error.
+ */
+int ext4_try_add_inline_entry(handle_t *handle, struct dentry *dentry,
+			      struct inode *inode)
+{
+	struct inode *dir = dentry->d_parent->d_inode;
+	int ret, err, inline_size, no_expand;
+	struct ext4_iloc iloc;
+	void *inline_start;
+
+	ret = ext4_get_inode_loc(dir, &iloc);
+	if (ret)
+		return ret;
+
+	ext4_write_lock_xattr(dir, &no_expand);
+	if (!ext4_has_inline_data(dir))
+		goto out;
+
+	inline_start = (void *)ext4_raw_inode(&iloc)->i_block +
+			EXT4_INLINE_DOTDOT_SIZE;
+	inline_size = EXT4_MIN_INLINE_DATA_SIZE - EXT4_INLINE_DOTDOT_SIZE;
+	ret = ext4_add_dirent_to_inline(handle, dentry, inode, &iloc,
+					inline_start, inline_size);
+	if (ret != -ENOSPC)
+		goto out;
+
+	inline_size = EXT4_I(dir)->i_inline_size - EXT4_MIN_INLINE_DATA_SIZE;
+	if (!inline_size) {
+		ret = ext4_update_inline_dir(handle, dir, &iloc);
+		if (ret && ret != -ENOSPC)
+			goto out;
+		inline_size = EXT4_I(dir)->i_inline_size -
+				EXT4_MIN_INLINE_DATA_SIZE;
+	}
+
+	if (inline_size) {
+		inline_start = ext4_get_inline_xattr_pos(dir, &iloc);
+		ret = ext4_add_dirent_to_inline(handle, dentry, inode, &iloc,
+						inline_start, inline_size);
+		if (ret != -ENOSPC)
+			goto out;
+	}
+
+	/* The inode is full, move the entries to the first block */
+	ret = ext4_convert_inline_data_nolock(handle, dir, &iloc);
+out:
+	ext4_write_unlock_xattr(dir, &no_expand);
+	if (ret >= 0) {
+		err = ext4_mark_inode_dirty(handle, dir);
+		if (err)
+			ret = err;
+	}
+	brelse(iloc.bh);
+	return ret;
+}
+
+struct buffer_head *ext4_find_inline_entry(struct inode *dir,
+					   const struct qstr *d_name,
+					   struct ext4_dir_entry_2 **res_dir,
+					   int *has_inline_data)
+{
+	struct ext4_iloc iloc;
+	void *inline_start;
+	int inline_size;
+	int ret;
+
+	if (ext4_get_inode_loc(dir, &iloc))
+		return NULL;
+
+	down_read(&EXT4_I(dir)->xattr_sem);
+	if (!ext4_has_inline_data(dir)) {
+		*has_inline_data = 0;
+		goto out;
+	}
+
+	/* Only the inode field of the returned entry is valid for ".." */
+	if (d_name->len == 2 && !memcmp(d_name->name, "..", 2)) {
+		*res_dir = (struct ext4_dir_entry_2 *)
+				ext4_raw_inode(&iloc)->i_block;
+		goto out_find;
+	}
+
+	inline_start = (void *)ext4_raw_inode(&iloc)->i_block +
+			EXT4_INLINE_DOTDOT_SIZE;
+	inline_size = EXT4_MIN_INLINE_DATA_SIZE - EXT4_INLINE_DOTDOT_SIZE;
+	ret = search_dir(iloc.bh, inline_start, inline_size, dir, d_name,
+			 0, res_dir);
+	if (ret == 1)
+		goto out_find;
+	if (ret < 0)
+		goto out;
+
+	inline_size = ext4_get_inline_size(dir) - EXT4_MIN_INLINE_DATA_SIZE;
+	if (!inline_size)
+		goto out;
+
+	inline_start = ext4_get_inline_xattr_pos(dir, &iloc);
+	ret = search_dir(iloc.bh, inline_start, inline_size, dir, d_name,
+			 0, res_dir);
+	if (ret == 1)
+		goto out_find;
+out:
+	brelse(iloc.bh);
+	iloc.bh = NULL;
+out_find:
+	up_read(&EXT4_I(dir)->xattr_sem);
+	return iloc.bh;
+}
+
+int ext4_delete_inline_entry(handle_t *handle,
+			     struct inode *dir,
+			     struct ext4_dir_entry_2 *de_del,
+			     struct buffer_head *bh,
+			     int *has_inline_data)
+{
+	int err, inline_size, no_expand;
+	struct ext4_iloc iloc;
+	void *inline_start;
+
+	err = ext4_get_inode_loc(dir, &iloc);
+	if (err)
+		return err;
+
+	ext4_write_lock_xattr(dir, &no_expand);
+	if (!ext4_has_inline_data(dir)) {
+		*has_inline_data = 0;
+		goto out;
+	}
+
+	if ((void *)de_del - (void *)ext4_raw_inode(&iloc)->i_block <
+	    EXT4_MIN_INLINE_DATA_SIZE) {
+		inline_start = (void *)ext4_raw_inode(&iloc)->i_block +
+				EXT4_INLINE_DOTDOT_SIZE;
+		inline_size = EXT4_MIN_INLINE_DATA_SIZE -
+				EXT4_INLINE_DOTDOT_SIZE;
+	} else {
+		inline_start = ext4_get_inline_xattr_pos(dir, &iloc);
+		inline_size = ext4_get_inline_size(dir) -
+				EXT4_MIN_INLINE_DATA_SIZE;
+	}
+
+	BUFFER_TRACE(bh, "get_write_access");
+	err = ext4_journal_get_write_access(handle, bh);
+	if (err)
+		goto out;
+
+	err = ext4_generic_delete_entry(handle, dir, de_del, bh,
+					inline_start, inline_size);
+	if (err)
+		goto out;
+
+	BUFFER_TRACE(bh, "call ext4_handle_dirty_metadata");
+	err = ext4_handle_dirty_metadata(handle, dir, bh);
+out:
+	ext4_write_unlock_xattr(dir, &no_expand);
+	brelse(iloc.bh);
+	if (err && err != -ENOENT)
+		ext4_std_error(dir->i_sb, err);
+	return err;
+}
+
+/* offset counts from the start of i_block, including the parent inode */
+static struct ext4_dir_entry_2 *
+ext4_get_inline_entry(struct inode *inode, struct ext4_iloc *iloc,
+		      unsigned int offset, void **inline_start,
+		      int *inline_size)
+{
+	void *inline_pos;
+
+	if (offset < EXT4_MIN_INLINE_DATA_SIZE) {
+		inline_pos = (void *)ext4_raw_inode(iloc)->i_block;
+		*inline_size = EXT4_MIN_INLINE_DATA_SIZE;
+	} else {
+		inline_pos = ext4_get_inline_xattr_pos(inode, iloc);
+		offset -= EXT4_MIN_INLINE_DATA_SIZE;
+		*inline_size = ext4_get_inline_size(inode) -
+				EXT4_MIN_INLINE_DATA_SIZE;
+	}
+
+	*inline_start = inline_pos;
+	return (struct ext4_dir_entry_2 *)(inline_pos + offset);
+}
+
+int empty_inline_dir(struct inode *dir, int *has_inline_data)
+{
+	struct ext4_dir_entry_2 *de;
+	struct ext4_iloc iloc;
+	unsigned int offset;
+	void *inline_pos;
+	int err, inline_size;
+	int ret = 1;
+
+	err = ext4_get_inode_loc(dir, &iloc);
+	if (err) {
+		EXT4_ERROR_INODE(dir, "error %d getting inode %lu block",
+				 err, dir->i_ino);
+		return 1;
+	}
+
+	down_read(&EXT4_I(dir)->xattr_sem);
+	if (!ext4_has_inline_data(dir)) {
+		*has_inline_data = 0;
+		goto out;
+	}
+
+	de = (struct ext4_dir_entry_2 *)ext4_raw_inode(&iloc)->i_block;
+	if (!le32_to_cpu(de->inode)) {
+		ext4_warning(dir->i_sb,
+			     "bad inline directory (dir #%lu) - no `..'",
+			     dir->i_ino);
+		goto out;
+	}
+
+	offset = EXT4_INLINE_DOTDOT_SIZE;
+	while (offset < dir->i_size) {
+		de = ext4_get_inline_entry(dir, &iloc, offset,
+					   &inline_pos, &inline_size);
+		if (ext4_check_dir_entry(dir, NULL, de, iloc.bh, inline_pos,
+					 inline_size, offset)) {
+			ext4_warning(dir->i_sb,
+				     "bad inline directory (dir #%lu) - "
+				     "inode %u, rec_len %u, name_len %d",
+				     dir->i_ino, le32_to_cpu(de->inode),
+				     le16_to_cpu(de->rec_len), de->name_len);
+			goto out;
+		}
+		if (le32_to_cpu(de->inode)) {
+			ret = 0;
+			goto out;
+		}
+		offset += ext4_rec_len_from_disk(de->rec_len, inline_size);
+	}
+out:
+	up_read(&EXT4_I(dir)->xattr_sem);
+	brelse(iloc.bh);
+	return ret;
+}
+
+static void *ext4_get_inline_dir_copy(struct inode *inode,
+				      struct ext4_iloc *iloc,
+				      int *inline_size, int *has_inline_data,
+				      int *err)
+{
+	void *buf = NULL;
+
+	*err = 0;
+	down_read(&EXT4_I(inode)->xattr_sem);
+	if (!ext4_has_inline_data(inode)) {
+		*has_inline_data = 0;
+		goto out;
+	}
+
+	*inline_size = ext4_get_inline_size(inode);
+	buf = kmalloc(*inline_size, GFP_NOFS);
+	if (!buf) {
+		*err = -ENOMEM;
+		goto out;
+	}
+	ext4_read_inline_data(inode, buf, *inline_size, iloc);
+out:
+	up_read(&EXT4_I(inode)->xattr_sem);
+	return buf;
+}
+
+/*
+ * f_pos follows the layout the directory gets once it is converted to a
+ * block: "." at 0, ".." right after it, and then the stored entries.
+ */
+int ext4_read_inline_dir(struct file *filp,
+			 void *dirent, filldir_t filldir,
+			 int *has_inline_data)
+{
+	struct inode *inode = filp->f_path.dentry->d_inode;
+	struct super_block *sb = inode->i_sb;
+	int dotdot_offset, dotdot_size, extra_offset, extra_size;
+	struct ext4_dir_entry_2 *de;
+	int ret, inline_size = 0;
+	unsigned int parent_ino;
+	struct ext4_iloc iloc;
+	void *dir_buf;
+	loff_t i;
+
+	ret = ext4_get_inode_loc(inode, &iloc);
+	if (ret)
+		return ret;
+
+	dir_buf = ext4_get_inline_dir_copy(inode, &iloc, &inline_size,
+					   has_inline_data, &ret);
+	if (!dir_buf)
+		goto out;
+
+	parent_ino = le32_to_cpu(*(__le32 *)dir_buf);
+	dotdot_offset = EXT4_DIR_REC_LEN(1);
+	dotdot_size = dotdot_offset + EXT4_DIR_REC_LEN(2);
+	extra_offset = dotdot_size - EXT4_INLINE_DOTDOT_SIZE;
+	extra_size = extra_offset + inline_size;
+
+	/* The directory changed since the last call, find an entry start */
+	if (filp->f_version != inode->i_version) {
+		for (i = dotdot_size; i < extra_size && i < filp->f_pos;) {
+			de = (struct ext4_dir_entry_2 *)
+				(dir_buf + i - extra_offset);
+			if (ext4_rec_len_from_disk(de->rec_len, extra_size) <
+			    EXT4_DIR_REC_LEN(1))
+				break;
+			i += ext4_rec_len_from_disk(de->rec_len, extra_size);
+		}
+		if (filp->f_pos > dotdot_offset)
+			filp->f_pos = i;
+		filp->f_version = inode->i_version;
+	}
+
+	while (filp->f_pos < extra_size) {
+		if (filp->f_pos == 0) {
+			if (filldir(dirent, ".", 1, 0, inode->i_ino, DT_DIR))
+				break;
+			filp->f_pos = dotdot_offset;
+			continue;
+		}
+
+		if (filp->f_pos == dotdot_offset) {
+			if (filldir(dirent, "..", 2, dotdot_offset,
+				    parent_ino, DT_DIR))
+				break;
+			filp->f_pos = dotdot_size;
+			continue;
+		}
+
+		de = (struct ext4_dir_entry_2 *)
+			(dir_buf + filp->f_pos - extra_offset);
+		if (ext4_check_dir_entry(inode, filp, de, iloc.bh, dir_buf,
+					 inline_size,
+					 filp->f_pos - extra_offset)) {
+			filp->f_pos = extra_size;
+			break;
+		}
+		if (le32_to_cpu(de->inode)) {
+			if (filldir(dirent, de->name, de->name_len,
+				    filp->f_pos, le32_to_cpu(de->inode),
+				    get_dtype(sb, de->file_type)))
+				break;
+		}
+		filp->f_pos += ext4_rec_len_from_disk(de->rec_len,
+						      extra_size);
+	}
+out:
+	kfree(dir_buf);
+	brelse(iloc.bh);
+	return ret;
+}
+
+int htree_inlinedir_to_tree(struct file *dir_file,
+			    struct inode *dir, ext4_lblk_t block,
+			    struct dx_hash_info *hinfo,
+			    __u32 start_hash, __u32 start_minor_hash,
+			    int *has_inline_data)
+{
+	struct ext4_dir_entry_2 fake, *de;
+	int err, count = 0, inline_size = 0;
+	struct ext4_iloc iloc;
+	void *dir_buf;
+	int pos;
+
+	err = ext4_get_inode_loc(dir, &iloc);
+	if (err)
+		return err;
+
+	dir_buf = ext4_get_inline_dir_copy(dir, &iloc, &inline_size,
+					   has_inline_data, &err);
+	if (!dir_buf) {
+		count = err;
+		goto out;
+	}
+
+	memset(&fake, 0, sizeof(fake));
+	fake.file_type = EXT4_FT_DIR;
+	pos = 0;
+	while (pos < inline_size) {
+		if (pos == 0) {
+			fake.inode = cpu_to_le32(dir->i_ino);
+			fake.name_len = 1;
+			strcpy(fake.name, ".");
+			de = &fake;
+			pos = EXT4_INLINE_DOTDOT_OFFSET;
+		} else if (pos == EXT4_INLINE_DOTDOT_OFFSET) {
+			fake.inode = *(__le32 *)dir_buf;
+			fake.name_len = 2;
+			strcpy(fake.name, "..");
+			de = &fake;
+			pos = EXT4_INLINE_DOTDOT_SIZE;
+		} else {
+			de = (struct ext4_dir_entry_2 *)(dir_buf + pos);
+			if (ext4_check_dir_entry(dir, dir_file, de, iloc.bh,
+						 dir_buf, inline_size, pos))
+				break;
+			pos += ext4_rec_len_from_disk(de->rec_len,
+						      inline_size);
+		}
+
+		ext4fs_dirhash(de->name, de->name_len, hinfo);
+		if ((hinfo->hash < start_hash) ||
+		    ((hinfo->hash == start_hash) &&
+		     (hinfo->minor_hash < start_minor_hash)))
+			continue;
+		if (de->inode == 0)
+			continue;
+		err = ext4_htree_store_dirent(dir_file, hinfo->hash,
+					      hinfo->minor_hash, de);
+		if (err) {
+			count = err;
+			break;
+		}
+		count++;
+	}
+out:
+	kfree(dir_buf);
+	brelse(iloc.bh);
+	return count;
+}
+
+struct buffer_head *ext4_get_first_inline_block(struct inode *inode,
+					struct ext4_dir_entry_2 **parent_de,
+					int *retval)
+{
+	struct ext4_iloc iloc;
+
+	*retval = ext4_get_inode_loc(inode, &iloc);
+	if (*retval)
+		return NULL;
+
+	*parent_de = (struct ext4_dir_entry_2 *)ext4_raw_inode(&iloc)->i_block;
+	return iloc.bh;
+}
@@ -28,7 +28,6 @@
 #define BHDR(bh) ((struct ext4_xattr_header *)((bh)->b_data))
 #define ENTRY(ptr) ((struct ext4_xattr_entry *)(ptr))
 #define BFIRST(bh) ENTRY(BHDR(bh)+1)
-#define IS_LAST_ENTRY(entry) (*(__u32 *)(entry) == 0)
 
 #ifdef EXT4_XATTR_DEBUG
 # define ea_idebug(inode, f...) do { \
@@ -134,7 +133,7 @@ ext4_xattr_check_entry(struct ext4_xattr_entry *entry, size_t size)
 	return 0;
 }
 
-static int
+int
 ext4_xattr_find_entry(struct ext4_xattr_entry **pentry, int name_index,
 		      const char *name, size_t size, int sorted)
 {
@@ -212,7 +211,7 @@ cleanup:
 	return error;
 }
 
-static int
+int
 ext4_xattr_ibody_get(struct inode *inode, int name_index, const char *name,
 		     void *buffer, size_t buffer_size)
 {
@@ -449,21 +448,6 @@ static size_t ext4_xattr_free_space(struct ext4_xattr_entry *last,
 	return (*min_offs - ((void *)last - base) - sizeof(__u32));
 }
 
-struct ext4_xattr_info {
-	int name_index;
-	const char *name;
-	const void *value;
-	size_t value_len;
-};
-
-struct ext4_xattr_search {
-	struct ext4_xattr_entry *first;
-	void *base;
-	void *end;
-	struct ext4_xattr_entry *here;
-	int not_found;
-};
-
 static int
 ext4_xattr_set_entry(struct ext4_xattr_info *i, struct ext4_xattr_search *s)
 {
@@ -516,7 +500,10 @@ ext4_xattr_set_entry(struct ext4_xattr_info *i, struct ext4_xattr_search *s)
 					cpu_to_le32(i->value_len);
 				memset(val + size - EXT4_XATTR_PAD, 0,
 				       EXT4_XATTR_PAD); 
-				memcpy(val, i->value, i->value_len);
+				if (i->value == EXT4_ZERO_XATTR_VALUE)
+					memset(val, 0, i->value_len);
+				else
+					memcpy(val, i->value, i->value_len);
 				return 0;
 			}
 
@@ -557,7 +544,10 @@ ext4_xattr_set_entry(struct ext4_xattr_info *i, struct ext4_xattr_search *s)
 			s->here->e_value_offs = cpu_to_le16(min_offs - size);
 			memset(val + size - EXT4_XATTR_PAD, 0,
 			       EXT4_XATTR_PAD); 
-			memcpy(val, i->value, i->value_len);
+			if (i->value == EXT4_ZERO_XATTR_VALUE)
+				memset(val, 0, i->value_len);
+			else
+				memcpy(val, i->value, i->value_len);
 		}
 	}
 	return 0;
@@ -810,12 +800,7 @@ bad_block:
 #undef header
 }
 
-struct ext4_xattr_ibody_find {
-	struct ext4_xattr_search s;
-	struct ext4_iloc iloc;
-};
-
-static int
+int
 ext4_xattr_ibody_find(struct inode *inode, struct ext4_xattr_info *i,
 		      struct ext4_xattr_ibody_find *is)
 {
@@ -845,7 +830,7 @@ ext4_xattr_ibody_find(struct inode *inode, struct ext4_xattr_info *i,
 	return 0;
 }
 
-static int
+int
 ext4_xattr_ibody_set(handle_t *handle, struct inode *inode,
 		     struct ext4_xattr_info *i,
 		     struct ext4_xattr_ibody_find *is)
@@ -867,6 +852,20 @@ ext4_xattr_ibody_set(handle_t *handle, struct inode *inode,
 		header->h_magic = cpu_to_le32(0);
 		ext4_clear_inode_state(inode, EXT4_STATE_XATTR);
 	}
+
+	/* Removing other entries may have moved system.data */
+	if (ext4_test_inode_flag(inode, EXT4_INODE_INLINE_DATA)) {
+		struct ext4_xattr_entry *entry = s->first;
+
+		if (!ext4_xattr_find_entry(&entry, EXT4_XATTR_INDEX_SYSTEM,
+					   EXT4_XATTR_SYSTEM_DATA,
+					   s->end - s->base, 0))
+			EXT4_I(inode)->i_inline_off =
+				(u16)((void *)entry - (void *)ext4_raw_inode(
+					&is->iloc));
+		else
+			EXT4_I(inode)->i_inline_off = 0;
+	}
 	return 0;
 }
 
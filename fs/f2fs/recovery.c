@@ -0,0 +1,344 @@
+/*
+ * fs/f2fs/recovery.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/fs.h>
+#include <linux/f2fs_fs.h>
+#include "f2fs.h"
+#include "node.h"
+#include "segment.h"
+
+/*
+ * fsync() writes only the dnodes of the file, chained through the warm
+ * node log, instead of a checkpoint. At mount the chain is walked from
+ * where the last checkpoint left that log: first to find the inodes to
+ * recover, then to replay their block addresses.
+ */
+struct fsync_inode_entry {
+	struct list_head list;	/* list head */
+	struct inode *inode;	/* vfs inode pointer */
+	block_t blkaddr;	/* block address locating the last inode */
+};
+
+bool space_for_roll_forward(struct f2fs_sb_info *sbi)
+{
+	if (sbi->last_valid_block_count + sbi->alloc_valid_block_count
+			> sbi->user_block_count)
+		return false;
+	return true;
+}
+
+static struct fsync_inode_entry *get_fsync_inode(struct list_head *head,
+								nid_t ino)
+{
+	struct fsync_inode_entry *entry;
+
+	list_for_each_entry(entry, head, list)
+		if (entry->inode->i_ino == ino)
+			return entry;
+	return NULL;
+}
+
+static int recover_dentry(struct page *ipage, struct inode *inode)
+{
+	struct f2fs_node *raw_node = (struct f2fs_node *)page_address(ipage);
+	struct f2fs_inode *raw_inode = &(raw_node->i);
+	struct qstr name;
+	struct f2fs_dir_entry *de;
+	struct page *page;
+	struct inode *dir;
+	int err = 0;
+
+	if (!is_dent_dnode(ipage))
+		return 0;
+
+	dir = f2fs_iget(inode->i_sb, le32_to_cpu(raw_inode->i_pino));
+	if (IS_ERR(dir))
+		return PTR_ERR(dir);
+
+	name.len = le32_to_cpu(raw_inode->i_namelen);
+	name.name = raw_inode->i_name;
+	if (name.len > F2FS_MAX_NAME_LEN) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	de = f2fs_find_entry(dir, &name, &page);
+	if (de) {
+		kunmap(page);
+		f2fs_put_page(page, 0);
+	} else {
+		err = __f2fs_add_link(dir, &name, inode);
+	}
+out:
+	iput(dir);
+	return err;
+}
+
+static int recover_inode(struct inode *inode, struct page *node_page)
+{
+	struct f2fs_node *raw_node = (struct f2fs_node *)page_address(node_page);
+	struct f2fs_inode *raw_inode = &(raw_node->i);
+
+	inode->i_mode = le16_to_cpu(raw_inode->i_mode);
+	i_size_write(inode, le64_to_cpu(raw_inode->i_size));
+	inode->i_atime.tv_sec = le64_to_cpu(raw_inode->i_atime);
+	inode->i_ctime.tv_sec = le64_to_cpu(raw_inode->i_ctime);
+	inode->i_mtime.tv_sec = le64_to_cpu(raw_inode->i_mtime);
+	inode->i_atime.tv_nsec = le32_to_cpu(raw_inode->i_atime_nsec);
+	inode->i_ctime.tv_nsec = le32_to_cpu(raw_inode->i_ctime_nsec);
+	inode->i_mtime.tv_nsec = le32_to_cpu(raw_inode->i_mtime_nsec);
+
+	return recover_dentry(node_page, inode);
+}
+
+/*
+ * Read the next block of the chain. It ends at a block which is outside
+ * the main area or was not written since the last checkpoint.
+ */
+static int read_chain_block(struct f2fs_sb_info *sbi, struct page *page,
+							block_t blkaddr)
+{
+	unsigned long long cp_ver = le64_to_cpu(F2FS_CKPT(sbi)->checkpoint_ver);
+	int err;
+
+	if (!IS_MAIN_BLKADDR(sbi, blkaddr))
+		return -ENOENT;
+
+	err = f2fs_read_block(sbi, page, blkaddr, READ_SYNC);
+	if (err)
+		return err;
+
+	if (cp_ver != cpver_of_node(page))
+		return -ENOENT;
+	return 0;
+}
+
+static int find_fsync_dnodes(struct f2fs_sb_info *sbi, struct list_head *head)
+{
+	struct curseg_info *curseg;
+	struct page *page;
+	block_t blkaddr;
+	int err = 0;
+
+	/* get node pages in the current segment */
+	curseg = CURSEG_I(sbi, CURSEG_WARM_NODE);
+	blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
+
+	/* read node page */
+	page = alloc_page(GFP_F2FS_ZERO);
+	if (!page)
+		return -ENOMEM;
+	lock_page(page);
+
+	while (1) {
+		struct fsync_inode_entry *entry;
+
+		err = read_chain_block(sbi, page, blkaddr);
+		if (err) {
+			if (err == -ENOENT)
+				err = 0;
+			break;
+		}
+
+		if (!is_fsync_dnode(page))
+			goto next;
+
+		entry = get_fsync_inode(head, ino_of_node(page));
+		if (entry) {
+			entry->blkaddr = blkaddr;
+		} else {
+			if (IS_INODE(page) && is_dent_dnode(page)) {
+				err = recover_inode_page(sbi, page);
+				if (err)
+					break;
+			}
+
+			/* add this fsync inode to the list */
+			entry = kmalloc(sizeof(struct fsync_inode_entry),
+								GFP_NOFS);
+			if (!entry) {
+				err = -ENOMEM;
+				break;
+			}
+
+			entry->inode = f2fs_iget(sbi->sb, ino_of_node(page));
+			if (IS_ERR(entry->inode)) {
+				err = PTR_ERR(entry->inode);
+				kfree(entry);
+				break;
+			}
+
+			list_add_tail(&entry->list, head);
+			entry->blkaddr = blkaddr;
+		}
+		if (IS_INODE(page)) {
+			err = recover_inode(entry->inode, page);
+			if (err)
+				break;
+		}
+next:
+		/* check next segment */
+		blkaddr = next_blkaddr_of_node(page);
+	}
+	unlock_page(page);
+	__free_pages(page, 0);
+	return err;
+}
+
+static void destroy_fsync_dnodes(struct list_head *head)
+{
+	struct fsync_inode_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, head, list) {
+		iput(entry->inode);
+		list_del(&entry->list);
+		kfree(entry);
+	}
+}
+
+/*
+ * Replay the block addresses of one logged dnode into the current tree.
+ * Blocks written after the checkpoint are accounted in SIT and SSA; the
+ * node page is only dirtied and goes out with the checkpoint that ends
+ * the recovery.
+ */
+static int do_recover_data(struct f2fs_sb_info *sbi, struct inode *inode,
+					struct page *page, block_t blkaddr)
+{
+	unsigned int start, end;
+	struct dnode_of_data dn;
+	struct f2fs_summary sum;
+	struct node_info ni;
+	int err;
+
+	start = start_bidx_of_node(ofs_of_node(page));
+	if (IS_INODE(page))
+		end = start + ADDRS_PER_INODE;
+	else
+		end = start + ADDRS_PER_BLOCK;
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, start, ALLOC_NODE);
+	if (err)
+		return err;
+
+	wait_on_page_writeback(dn.node_page);
+
+	get_node_info(sbi, dn.nid, &ni);
+	BUG_ON(ni.ino != ino_of_node(page));
+	BUG_ON(ofs_of_node(dn.node_page) != ofs_of_node(page));
+
+	for (; start < end; start++) {
+		block_t src, dest;
+
+		src = datablock_addr(dn.node_page, dn.ofs_in_node);
+		dest = datablock_addr(page, dn.ofs_in_node);
+
+		if (src != dest && dest != NEW_ADDR && dest != NULL_ADDR) {
+			if (src == NULL_ADDR) {
+				err = reserve_new_block(&dn);
+				if (err)
+					break;
+			}
+
+			set_summary(&sum, dn.nid, dn.ofs_in_node, ni.version);
+
+			err = recover_data_page(sbi, &sum, src, dest);
+			if (err)
+				break;
+			set_data_blkaddr(&dn, dest);
+		}
+		dn.ofs_in_node++;
+	}
+
+	if (IS_INODE(dn.node_page))
+		sync_inode_page(&dn);
+	set_page_dirty(dn.node_page);
+
+	f2fs_put_dnode(&dn);
+	return err;
+}
+
+static int recover_data(struct f2fs_sb_info *sbi, struct list_head *head)
+{
+	struct curseg_info *curseg;
+	struct page *page;
+	block_t blkaddr;
+	int err = 0;
+
+	/* get node pages in the current segment */
+	curseg = CURSEG_I(sbi, CURSEG_WARM_NODE);
+	blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
+
+	/* read node page */
+	page = alloc_page(GFP_F2FS_ZERO);
+	if (!page)
+		return -ENOMEM;
+	lock_page(page);
+
+	while (1) {
+		struct fsync_inode_entry *entry;
+
+		err = read_chain_block(sbi, page, blkaddr);
+		if (err) {
+			if (err == -ENOENT)
+				err = 0;
+			break;
+		}
+
+		entry = get_fsync_inode(head, ino_of_node(page));
+		if (!entry)
+			goto next;
+
+		err = do_recover_data(sbi, entry->inode, page, blkaddr);
+		if (err)
+			break;
+
+		if (entry->blkaddr == blkaddr) {
+			iput(entry->inode);
+			list_del(&entry->list);
+			kfree(entry);
+		}
+next:
+		/* check next segment */
+		blkaddr = next_blkaddr_of_node(page);
+	}
+	unlock_page(page);
+	__free_pages(page, 0);
+	return err;
+}
+
+/*
+ * Called at mount time, before any other writer exists. Whatever was
+ * replayed is made durable by a checkpoint; the logs are moved to fresh
+ * segments first, since the old ones now hold the recovered blocks past
+ * their write pointers.
+ */
+void recover_fsync_data(struct f2fs_sb_info *sbi)
+{
+	struct list_head inode_list;
+	int err;
+
+	INIT_LIST_HEAD(&inode_list);
+
+	/* step #1: find fsynced inode numbers */
+	err = find_fsync_dnodes(sbi, &inode_list);
+	if (!err && list_empty(&inode_list))
+		return;
+
+	/* step #2: recover data */
+	if (!err)
+		err = recover_data(sbi, &inode_list);
+	if (err)
+		f2fs_msg(sbi->sb, KERN_WARNING,
+				"roll-forward recovery stopped: %d", err);
+
+	destroy_fsync_dnodes(&inode_list);
+
+	allocate_new_segments(sbi);
+	write_checkpoint(sbi, false);
+}
@@ -0,0 +1,1302 @@
+/*
+ * fs/f2fs/segment.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/fs.h>
+#include <linux/f2fs_fs.h>
+#include <linux/bio.h>
+#include <linux/blkdev.h>
+#include <linux/prefetch.h>
+#include <linux/vmalloc.h>
+
+#include "f2fs.h"
+#include "segment.h"
+#include "node.h"
+
+#define GET_SUM_BLOCK(sbi, segno)	(SM_I(sbi)->ssa_blkaddr + segno)
+
+/*
+ * This function balances dirty node and dentry pages.
+ * In addition, it controls garbage collection.
+ */
+void f2fs_balance_fs(struct f2fs_sb_info *sbi)
+{
+	/*
+	 * We should do GC or end up with checkpoint, if there are so many dirty
+	 * dir/node pages without enough free segments.
+	 */
+	if (has_not_enough_free_secs(sbi, 0)) {
+		mutex_lock(&sbi->gc_mutex);
+		f2fs_gc(sbi);
+	}
+}
+
+static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
+		enum dirty_type dirty_type)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+
+	/* need not be added */
+	if (IS_CURSEG(sbi, segno))
+		return;
+
+	if (!test_and_set_bit(segno, dirty_i->dirty_segmap[dirty_type]))
+		dirty_i->nr_dirty[dirty_type]++;
+
+	if (dirty_type == DIRTY) {
+		struct seg_entry *sentry = get_seg_entry(sbi, segno);
+		dirty_type = sentry->type;
+		if (!test_and_set_bit(segno, dirty_i->dirty_segmap[dirty_type]))
+			dirty_i->nr_dirty[dirty_type]++;
+	}
+}
+
+static void __remove_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
+		enum dirty_type dirty_type)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+
+	if (test_and_clear_bit(segno, dirty_i->dirty_segmap[dirty_type]))
+		dirty_i->nr_dirty[dirty_type]--;
+
+	if (dirty_type == DIRTY) {
+		struct seg_entry *sentry = get_seg_entry(sbi, segno);
+		dirty_type = sentry->type;
+		if (test_and_clear_bit(segno,
+					dirty_i->dirty_segmap[dirty_type]))
+			dirty_i->nr_dirty[dirty_type]--;
+		clear_bit(segno, dirty_i->victim_segmap);
+	}
+}
+
+/*
+ * Should not occur error such as -ENOMEM.
+ * Adding dirty entry into seglist is not critical operation.
+ * If a given segment is one of current working segments, it won't be added.
+ */
+void locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned short valid_blocks;
+
+	if (segno == NULL_SEGNO || IS_CURSEG(sbi, segno))
+		return;
+
+	mutex_lock(&dirty_i->seglist_lock);
+
+	valid_blocks = get_valid_blocks(sbi, segno);
+
+	if (valid_blocks == 0) {
+		__locate_dirty_segment(sbi, segno, PRE);
+		__remove_dirty_segment(sbi, segno, DIRTY);
+	} else if (valid_blocks < sbi->blocks_per_seg) {
+		__locate_dirty_segment(sbi, segno, DIRTY);
+	} else {
+		/* Recovery routine with SSR needs this */
+		__remove_dirty_segment(sbi, segno, DIRTY);
+	}
+
+	mutex_unlock(&dirty_i->seglist_lock);
+}
+
+/*
+ * Discard whole units of the device's discard granularity only. An eMMC
+ * part erases whole erase groups, and mmc_queue_setup_discard() reports
+ * its preferred erase size as that granularity; a partial group is either
+ * dropped by the card or costs a read-modify-write inside the FTL.
+ */
+static void f2fs_issue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	unsigned int unit = SM_I(sbi)->discard_blks;
+	block_t start = roundup(blkstart, unit);
+	block_t end = rounddown(blkstart + blklen, unit);
+
+	if (end <= start)
+		return;
+
+	blkdev_issue_discard(sbi->sb->s_bdev, SECTOR_FROM_BLOCK(sbi, start),
+			SECTOR_FROM_BLOCK(sbi, end - start), GFP_NOFS, 0);
+}
+
+/*
+ * Segments that became obsolete since the last checkpoint were kept
+ * allocated so that the previous checkpoint stays intact. Called while a
+ * new checkpoint blocks all operations, this hands them over to
+ * release_prefree_segments(), which frees them once the checkpoint is on
+ * disk.
+ */
+void clear_prefree_segments(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int bitmap_size = f2fs_bitmap_size(TOTAL_SEGS(sbi));
+	unsigned int i;
+
+	mutex_lock(&dirty_i->seglist_lock);
+	for (i = 0; i < bitmap_size / sizeof(unsigned long); i++)
+		dirty_i->cp_prefree_segmap[i] |= dirty_i->dirty_segmap[PRE][i];
+	memset(dirty_i->dirty_segmap[PRE], 0, bitmap_size);
+	dirty_i->nr_dirty[PRE] = 0;
+	mutex_unlock(&dirty_i->seglist_lock);
+}
+
+/*
+ * Nothing can allocate or dirty these segments until they are freed here,
+ * so runs of adjacent segments are discarded in one request without
+ * holding up other operations.
+ */
+void release_prefree_segments(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned long *prefree_map = dirty_i->cp_prefree_segmap;
+	unsigned int total_segs = TOTAL_SEGS(sbi);
+	unsigned int start = 0, end = -1;
+	unsigned int segno;
+
+	while (1) {
+		start = find_next_bit(prefree_map, total_segs, end + 1);
+		if (start >= total_segs)
+			break;
+		end = find_next_zero_bit(prefree_map, total_segs, start + 1);
+
+		if (test_opt(sbi, DISCARD))
+			f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
+				(end - start) << sbi->log_blocks_per_seg);
+
+		for (segno = start; segno < end; segno++) {
+			clear_bit(segno, prefree_map);
+			__set_free(sbi, segno);
+		}
+	}
+}
+
+static void __mark_sit_entry_dirty(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	if (!__test_and_set_bit(segno, sit_i->dirty_sentries_bitmap))
+		sit_i->dirty_sentries++;
+}
+
+static void __set_sit_entry_type(struct f2fs_sb_info *sbi, int type,
+					unsigned int segno, int modified)
+{
+	struct seg_entry *se = get_seg_entry(sbi, segno);
+	se->type = type;
+	if (modified)
+		__mark_sit_entry_dirty(sbi, segno);
+}
+
+static void update_sit_entry(struct f2fs_sb_info *sbi, block_t blkaddr, int del)
+{
+	struct seg_entry *se;
+	unsigned int segno, offset;
+	long int new_vblocks;
+
+	segno = GET_SEGNO(sbi, blkaddr);
+
+	se = get_seg_entry(sbi, segno);
+	new_vblocks = se->valid_blocks + del;
+	offset = GET_BLKOFF_FROM_SEG0(sbi, blkaddr);
+
+	BUG_ON((new_vblocks >> (sizeof(unsigned short) << 3) ||
+				(new_vblocks > sbi->blocks_per_seg)));
+
+	se->valid_blocks = new_vblocks;
+	se->mtime = get_mtime(sbi);
+	SIT_I(sbi)->max_mtime = se->mtime;
+
+	/* Update valid block bitmap */
+	if (del > 0) {
+		if (f2fs_set_bit(offset, se->cur_valid_map))
+			BUG();
+	} else {
+		if (!f2fs_clear_bit(offset, se->cur_valid_map))
+			BUG();
+	}
+	__mark_sit_entry_dirty(sbi, segno);
+
+	/* update total number of valid blocks to be written in ckpt area */
+	SIT_I(sbi)->written_valid_blocks += del;
+}
+
+static void refresh_sit_entry(struct f2fs_sb_info *sbi,
+			block_t old_blkaddr, block_t new_blkaddr)
+{
+	update_sit_entry(sbi, new_blkaddr, 1);
+	if (old_blkaddr != NULL_ADDR && old_blkaddr != NEW_ADDR) {
+		update_sit_entry(sbi, old_blkaddr, -1);
+		locate_dirty_segment(sbi, GET_SEGNO(sbi, old_blkaddr));
+	}
+}
+
+void invalidate_blocks(struct f2fs_sb_info *sbi, block_t addr)
+{
+	unsigned int segno = GET_SEGNO(sbi, addr);
+	struct sit_info *sit_i = SIT_I(sbi);
+
+	BUG_ON(addr == NULL_ADDR);
+	if (addr == NEW_ADDR)
+		return;
+
+	/* add it into sit main buffer */
+	mutex_lock(&sit_i->sentry_lock);
+
+	update_sit_entry(sbi, addr, -1);
+
+	/* add it into dirty seglist */
+	locate_dirty_segment(sbi, segno);
+
+	mutex_unlock(&sit_i->sentry_lock);
+}
+
+/*
+ * This function should be resided under the curseg_mutex lock
+ */
+static void __add_sum_entry(struct f2fs_sb_info *sbi, int type,
+		struct f2fs_summary *sum, unsigned short offset)
+{
+	struct curseg_info *curseg = CURSEG_I(sbi, type);
+	void *addr = curseg->sum_blk;
+	addr += offset * sizeof(struct f2fs_summary);
+	memcpy(addr, sum, sizeof(struct f2fs_summary));
+}
+
+/*
+ * Caller should put this summary page
+ */
+struct page *get_sum_page(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	return get_meta_page(sbi, GET_SUM_BLOCK(sbi, segno));
+}
+
+static void write_sum_page(struct f2fs_sb_info *sbi,
+			struct f2fs_summary_block *sum_blk, block_t blk_addr)
+{
+	struct page *page = grab_meta_page(sbi, blk_addr);
+	void *kaddr = page_address(page);
+	memcpy(kaddr, sum_blk, PAGE_CACHE_SIZE);
+	set_page_dirty(page);
+	f2fs_put_page(page, 1);
+}
+
+static unsigned int find_prev_free_segno(unsigned long *free_segmap,
+				unsigned int hint, unsigned int total_segs)
+{
+	unsigned int segno = hint;
+
+	do {
+		if (!test_bit(segno, free_segmap))
+			return segno;
+		segno = segno ? segno - 1 : total_segs - 1;
+	} while (segno != hint);
+
+	return total_segs;
+}
+
+/*
+ * Find a new segment from the free segments bitmap.
+ * Data logs grow from the start of the main area towards its end and node
+ * logs the other way round, so that hot node blocks do not get mixed with
+ * cold data when the volume fills up.
+ */
+static void get_new_segment(struct f2fs_sb_info *sbi,
+			unsigned int *newseg, int dir)
+{
+	struct free_segmap_info *free_i = FREE_I(sbi);
+	unsigned int total_segs = TOTAL_SEGS(sbi);
+	unsigned int hint = *newseg;
+	unsigned int segno;
+
+	if (hint >= total_segs)
+		hint = dir == ALLOC_LEFT ? total_segs - 1 : 0;
+
+	write_lock(&free_i->segmap_lock);
+
+	if (dir == ALLOC_LEFT) {
+		segno = find_prev_free_segno(free_i->free_segmap, hint,
+						total_segs);
+	} else {
+		segno = find_next_zero_bit(free_i->free_segmap,
+						total_segs, hint);
+		if (segno >= total_segs)
+			segno = find_next_zero_bit(free_i->free_segmap,
+						total_segs, 0);
+	}
+
+	/* the cleaner keeps reserved segments around, so we cannot run out */
+	BUG_ON(segno >= total_segs);
+	__set_inuse(sbi, segno);
+	*newseg = segno;
+	write_unlock(&free_i->segmap_lock);
+}
+
+static void reset_curseg(struct f2fs_sb_info *sbi, int type, int modified)
+{
+	struct curseg_info *curseg = CURSEG_I(sbi, type);
+	struct summary_footer *sum_footer;
+
+	curseg->next_blkoff = 0;
+	memset(curseg->sum_blk, 0, sizeof(struct f2fs_summary_block));
+	sum_footer = &(curseg->sum_blk->footer);
+	if (IS_DATASEG(type))
+		SET_SUM_TYPE(sum_footer, SUM_TYPE_DATA);
+	if (IS_NODESEG(type))
+		SET_SUM_TYPE(sum_footer, SUM_TYPE_NODE);
+	__set_sit_entry_type(sbi, type, curseg->segno, modified);
+}
+
+/*
+ * Allocate a current working segment.
+ * This function always allocates a free segment in LFS manner.
+ * Called with curseg_mutex and sentry_lock held.
+ */
+static void new_curseg(struct f2fs_sb_info *sbi, int type)
+{
+	struct curseg_info *curseg = CURSEG_I(sbi, type);
+	unsigned int old_segno = curseg->segno;
+	unsigned int segno;
+	int dir;
+
+	write_sum_page(sbi, curseg->sum_blk, GET_SUM_BLOCK(sbi, old_segno));
+
+	if (IS_NODESEG(type)) {
+		dir = ALLOC_LEFT;
+		segno = old_segno ? old_segno - 1 : TOTAL_SEGS(sbi) - 1;
+	} else {
+		dir = ALLOC_RIGHT;
+		segno = old_segno + 1;
+	}
+	get_new_segment(sbi, &segno, dir);
+
+	curseg->segno = segno;
+	reset_curseg(sbi, type, 1);
+	curseg->alloc_type = LFS;
+
+	/* the old one is no longer a log, so it may be dirty or prefree */
+	locate_dirty_segment(sbi, old_segno);
+}
+
+static void __allocate_new_segment(struct f2fs_sb_info *sbi, int type)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct curseg_info *curseg = CURSEG_I(sbi, type);
+
+	mutex_lock(&curseg->curseg_mutex);
+	mutex_lock(&sit_i->sentry_lock);
+	new_curseg(sbi, type);
+	mutex_unlock(&sit_i->sentry_lock);
+	mutex_unlock(&curseg->curseg_mutex);
+}
+
+/* Move every log to a clean segment, e.g. after roll-forward recovery */
+void allocate_new_segments(struct f2fs_sb_info *sbi)
+{
+	int i;
+
+	for (i = CURSEG_HOT_DATA; i <= CURSEG_COLD_NODE; i++)
+		__allocate_new_segment(sbi, i);
+}
+
+static void f2fs_end_io_write(struct bio *bio, int err)
+{
+	const int uptodate = test_bit(BIO_UPTODATE, &bio->bi_flags);
+	struct bio_vec *bvec = bio->bi_io_vec + bio->bi_vcnt - 1;
+	struct f2fs_sb_info *sbi = bio->bi_private;
+
+	do {
+		struct page *page = bvec->bv_page;
+
+		if (--bvec >= bio->bi_io_vec)
+			prefetchw(&bvec->bv_page->flags);
+		if (!uptodate) {
+			SetPageError(page);
+			if (page->mapping)
+				set_bit(AS_EIO, &page->mapping->flags);
+			set_ckpt_flags(sbi->ckpt, CP_ERROR_FLAG);
+			sbi->sb->s_flags |= MS_RDONLY;
+		}
+		end_page_writeback(page);
+		dec_page_count(sbi, F2FS_WRITEBACK);
+	} while (bvec >= bio->bi_io_vec);
+
+	if (!get_pages(sbi, F2FS_WRITEBACK) &&
+			waitqueue_active(&sbi->cp_wait))
+		wake_up(&sbi->cp_wait);
+
+	bio_put(bio);
+}
+
+/*
+ * Every page gets its own bio. Logs are written sequentially, so callers
+ * writing many pages plug the queue and the block layer merges them into
+ * large requests; a page is never left in a private, unsubmitted bio that
+ * someone else could end up waiting on.
+ */
+void f2fs_submit_write_page(struct f2fs_sb_info *sbi, struct page *page,
+					block_t blk_addr, int type)
+{
+	struct bio *bio;
+	int rw = WRITE;
+
+	if (type == META_FLUSH)
+		rw = WRITE_FLUSH_FUA;
+	else if (type == NODE)
+		rw = WRITE_SYNC;
+
+	inc_page_count(sbi, F2FS_WRITEBACK);
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	bio->bi_bdev = sbi->sb->s_bdev;
+	bio->bi_sector = SECTOR_FROM_BLOCK(sbi, blk_addr);
+	bio->bi_end_io = f2fs_end_io_write;
+	bio->bi_private = sbi;
+	bio_add_page(bio, page, PAGE_CACHE_SIZE, 0);
+	submit_bio(rw, bio);
+}
+
+void f2fs_wait_writeback(struct f2fs_sb_info *sbi)
+{
+	wait_event(sbi->cp_wait, !get_pages(sbi, F2FS_WRITEBACK));
+}
+
+static void f2fs_end_io_read(struct bio *bio, int err)
+{
+	complete(bio->bi_private);
+}
+
+/*
+ * Read one block into a locked page and wait for it.
+ */
+int f2fs_read_block(struct f2fs_sb_info *sbi, struct page *page,
+				block_t blk_addr, int type)
+{
+	DECLARE_COMPLETION_ONSTACK(wait);
+	struct bio *bio;
+	int err;
+
+	bio = bio_alloc(GFP_NOFS, 1);
+	bio->bi_bdev = sbi->sb->s_bdev;
+	bio->bi_sector = SECTOR_FROM_BLOCK(sbi, blk_addr);
+	bio->bi_end_io = f2fs_end_io_read;
+	bio->bi_private = &wait;
+
+	if (bio_add_page(bio, page, PAGE_CACHE_SIZE, 0) < PAGE_CACHE_SIZE) {
+		bio_put(bio);
+		return -EFAULT;
+	}
+
+	submit_bio(type, bio);
+	wait_for_completion(&wait);
+
+	err = test_bit(BIO_UPTODATE, &bio->bi_flags) ? 0 : -EIO;
+	bio_put(bio);
+
+	if (err) {
+		SetPageError(page);
+		return err;
+	}
+	SetPageUptodate(page);
+	return 0;
+}
+
+static int __get_segment_type(struct page *page, enum page_type p_type)
+{
+	if (p_type == DATA) {
+		struct inode *inode = page->mapping->host;
+
+		if (S_ISDIR(inode->i_mode))
+			return CURSEG_HOT_DATA;
+		else if (is_cold_data(page) || is_cold_file(inode))
+			return CURSEG_COLD_DATA;
+		else
+			return CURSEG_WARM_DATA;
+	} else {
+		if (IS_DNODE(page))
+			return is_cold_node(page) ? CURSEG_WARM_NODE :
+						CURSEG_HOT_NODE;
+		else
+			return CURSEG_COLD_NODE;
+	}
+}
+
+static void do_write_page(struct f2fs_sb_info *sbi, struct page *page,
+			block_t old_blkaddr, block_t *new_blkaddr,
+			struct f2fs_summary *sum, enum page_type p_type)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct curseg_info *curseg;
+	int type;
+
+	type = __get_segment_type(page, p_type);
+	curseg = CURSEG_I(sbi, type);
+
+	mutex_lock(&curseg->curseg_mutex);
+
+	*new_blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
+
+	/*
+	 * __add_sum_entry should be resided under the curseg_mutex
+	 * because, this function updates a summary entry in the
+	 * current summary block.
+	 */
+	__add_sum_entry(sbi, type, sum, curseg->next_blkoff);
+
+	mutex_lock(&sit_i->sentry_lock);
+	curseg->next_blkoff++;
+
+	refresh_sit_entry(sbi, old_blkaddr, *new_blkaddr);
+
+	if (curseg->next_blkoff >= sbi->blocks_per_seg)
+		new_curseg(sbi, type);
+
+	/* roll-forward recovery follows this chain through the node logs */
+	if (p_type == NODE)
+		fill_node_footer_blkaddr(page, NEXT_FREE_BLKADDR(sbi, curseg));
+
+	mutex_unlock(&sit_i->sentry_lock);
+
+	/* writeout dirty page into bdev */
+	f2fs_submit_write_page(sbi, page, *new_blkaddr, p_type);
+
+	mutex_unlock(&curseg->curseg_mutex);
+}
+
+int write_meta_page(struct f2fs_sb_info *sbi, struct page *page,
+			struct writeback_control *wbc)
+{
+	set_page_writeback(page);
+	f2fs_submit_write_page(sbi, page, page->index, META);
+	return 0;
+}
+
+void write_node_page(struct f2fs_sb_info *sbi, struct page *page,
+		unsigned int nid, block_t old_blkaddr, block_t *new_blkaddr)
+{
+	struct f2fs_summary sum;
+	set_summary(&sum, nid, 0, 0);
+	do_write_page(sbi, page, old_blkaddr, new_blkaddr, &sum, NODE);
+}
+
+void write_data_page(struct inode *inode, struct page *page,
+		struct dnode_of_data *dn, block_t old_blkaddr,
+		block_t *new_blkaddr)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_summary sum;
+	struct node_info ni;
+
+	BUG_ON(old_blkaddr == NULL_ADDR);
+	get_node_info(sbi, dn->nid, &ni);
+	set_summary(&sum, dn->nid, dn->ofs_in_node, ni.version);
+
+	do_write_page(sbi, page, old_blkaddr, new_blkaddr, &sum, DATA);
+}
+
+/*
+ * Roll-forward recovery found a data block that was written after the
+ * last checkpoint. Account it in SIT and record its owner in the summary
+ * of its segment, which may still be marked free.
+ */
+int recover_data_page(struct f2fs_sb_info *sbi, struct f2fs_summary *sum,
+		block_t old_blkaddr, block_t new_blkaddr)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct free_segmap_info *free_i = FREE_I(sbi);
+	struct curseg_info *curseg = NULL;
+	unsigned int segno = GET_SEGNO(sbi, new_blkaddr);
+	unsigned short blkoff = GET_BLKOFF_FROM_SEG0(sbi, new_blkaddr);
+	struct f2fs_summary_block *sum_blk;
+	struct page *sum_page;
+	int type;
+
+	for (type = CURSEG_HOT_DATA; type <= CURSEG_COLD_DATA; type++) {
+		if (CURSEG_I(sbi, type)->segno == segno) {
+			curseg = CURSEG_I(sbi, type);
+			break;
+		}
+	}
+
+	if (curseg) {
+		mutex_lock(&curseg->curseg_mutex);
+		__add_sum_entry(sbi, type, sum, blkoff);
+		mutex_unlock(&curseg->curseg_mutex);
+	} else {
+		sum_page = get_sum_page(sbi, segno);
+		if (IS_ERR(sum_page))
+			return PTR_ERR(sum_page);
+		sum_blk = page_address(sum_page);
+		SET_SUM_TYPE(&sum_blk->footer, SUM_TYPE_DATA);
+		memcpy(&sum_blk->entries[blkoff], sum, sizeof(*sum));
+		set_page_dirty(sum_page);
+		f2fs_put_page(sum_page, 1);
+	}
+
+	mutex_lock(&sit_i->sentry_lock);
+	write_lock(&free_i->segmap_lock);
+	if (!test_bit(segno, free_i->free_segmap)) {
+		__set_inuse(sbi, segno);
+		__set_sit_entry_type(sbi, CURSEG_WARM_DATA, segno, 1);
+	}
+	write_unlock(&free_i->segmap_lock);
+
+	refresh_sit_entry(sbi, old_blkaddr, new_blkaddr);
+	locate_dirty_segment(sbi, segno);
+	mutex_unlock(&sit_i->sentry_lock);
+	return 0;
+}
+
+/*
+ * The summaries of the logs are written into the checkpoint pack, since
+ * their segments are not complete yet.
+ */
+static void write_curseg_summaries(struct f2fs_sb_info *sbi,
+				block_t start_blk, int first, int last)
+{
+	int type;
+
+	for (type = first; type <= last; type++) {
+		struct curseg_info *curseg = CURSEG_I(sbi, type);
+		struct page *page = grab_meta_page(sbi, start_blk++);
+
+		mutex_lock(&curseg->curseg_mutex);
+		memcpy(page_address(page), curseg->sum_blk, PAGE_CACHE_SIZE);
+		mutex_unlock(&curseg->curseg_mutex);
+
+		set_page_dirty(page);
+		f2fs_put_page(page, 1);
+	}
+}
+
+void write_data_summaries(struct f2fs_sb_info *sbi, block_t start_blk)
+{
+	write_curseg_summaries(sbi, start_blk, CURSEG_HOT_DATA,
+							CURSEG_COLD_DATA);
+}
+
+void write_node_summaries(struct f2fs_sb_info *sbi, block_t start_blk)
+{
+	write_curseg_summaries(sbi, start_blk, CURSEG_HOT_NODE,
+							CURSEG_COLD_NODE);
+}
+
+static int read_curseg_position(struct f2fs_sb_info *sbi, int type)
+{
+	struct f2fs_checkpoint *ckpt = F2FS_CKPT(sbi);
+	struct curseg_info *curseg = CURSEG_I(sbi, type);
+	unsigned int segno;
+	unsigned short blk_off;
+
+	if (IS_DATASEG(type)) {
+		segno = le32_to_cpu(ckpt->cur_data_segno[type]);
+		blk_off = le16_to_cpu(ckpt->cur_data_blkoff[type -
+							CURSEG_HOT_DATA]);
+	} else {
+		segno = le32_to_cpu(ckpt->cur_node_segno[type -
+							CURSEG_HOT_NODE]);
+		blk_off = le16_to_cpu(ckpt->cur_node_blkoff[type -
+							CURSEG_HOT_NODE]);
+	}
+
+	if (segno >= TOTAL_SEGS(sbi) || blk_off > sbi->blocks_per_seg)
+		return -EINVAL;
+
+	curseg->segno = segno;
+	reset_curseg(sbi, type, 0);
+	curseg->next_blkoff = blk_off;
+	curseg->alloc_type = ckpt->alloc_type[type];
+	return 0;
+}
+
+/*
+ * mkfs.f2fs packs the NAT and SIT journals followed by the entries of the
+ * three data logs into as few blocks as they need.
+ */
+static int read_compacted_summaries(struct f2fs_sb_info *sbi)
+{
+	block_t start = start_sum_block(sbi);
+	struct curseg_info *curseg;
+	unsigned char *kaddr;
+	struct page *page;
+	int type, i, offset;
+	int err;
+
+	for (type = CURSEG_HOT_DATA; type <= CURSEG_COLD_DATA; type++) {
+		err = read_curseg_position(sbi, type);
+		if (err)
+			return err;
+	}
+
+	page = get_meta_page(sbi, start++);
+	if (IS_ERR(page))
+		return PTR_ERR(page);
+	kaddr = page_address(page);
+
+	curseg = CURSEG_I(sbi, CURSEG_HOT_DATA);
+	memcpy(&curseg->sum_blk->n_nats, kaddr, SUM_JOURNAL_SIZE);
+	curseg = CURSEG_I(sbi, CURSEG_COLD_DATA);
+	memcpy(&curseg->sum_blk->n_sits, kaddr + SUM_JOURNAL_SIZE,
+							SUM_JOURNAL_SIZE);
+	offset = 2 * SUM_JOURNAL_SIZE;
+
+	for (type = CURSEG_HOT_DATA; type <= CURSEG_COLD_DATA; type++) {
+		curseg = CURSEG_I(sbi, type);
+
+		for (i = 0; i < curseg->next_blkoff; i++) {
+			if (offset + SUMMARY_SIZE >
+					PAGE_CACHE_SIZE - SUM_FOOTER_SIZE) {
+				f2fs_put_page(page, 1);
+				page = get_meta_page(sbi, start++);
+				if (IS_ERR(page))
+					return PTR_ERR(page);
+				kaddr = page_address(page);
+				offset = 0;
+			}
+			memcpy(&curseg->sum_blk->entries[i], kaddr + offset,
+							SUMMARY_SIZE);
+			offset += SUMMARY_SIZE;
+		}
+	}
+	f2fs_put_page(page, 1);
+	return 0;
+}
+
+static int read_normal_summaries(struct f2fs_sb_info *sbi, int type)
+{
+	struct curseg_info *curseg = CURSEG_I(sbi, type);
+	struct page *new;
+	block_t blk_addr;
+	int err;
+
+	err = read_curseg_position(sbi, type);
+	if (err)
+		return err;
+
+	if (has_node_summaries(sbi))
+		blk_addr = sum_blk_addr(sbi, NR_CURSEG_TYPE, type);
+	else if (IS_DATASEG(type))
+		blk_addr = sum_blk_addr(sbi, NR_CURSEG_DATA_TYPE, type);
+	else
+		return restore_node_summary(sbi, curseg->segno,
+					curseg->sum_blk, curseg->next_blkoff);
+
+	new = get_meta_page(sbi, blk_addr);
+	if (IS_ERR(new))
+		return PTR_ERR(new);
+
+	memcpy(curseg->sum_blk, page_address(new), PAGE_CACHE_SIZE);
+	f2fs_put_page(new, 1);
+	return 0;
+}
+
+static int restore_curseg_summaries(struct f2fs_sb_info *sbi)
+{
+	int type = CURSEG_HOT_DATA;
+	int err;
+
+	if (is_set_ckpt_flags(F2FS_CKPT(sbi), CP_COMPACT_SUM_FLAG)) {
+		err = read_compacted_summaries(sbi);
+		if (err)
+			return err;
+		type = CURSEG_HOT_NODE;
+	}
+
+	for (; type <= CURSEG_COLD_NODE; type++) {
+		err = read_normal_summaries(sbi, type);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+static struct page *get_current_sit_page(struct f2fs_sb_info *sbi,
+					unsigned int segno)
+{
+	return get_meta_page(sbi, current_sit_addr(sbi, segno));
+}
+
+static struct page *get_next_sit_page(struct f2fs_sb_info *sbi,
+					unsigned int start)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct page *page;
+	pgoff_t src_off, dst_off;
+
+	src_off = current_sit_addr(sbi, start);
+	dst_off = next_sit_addr(sbi, src_off);
+
+	/* the whole block is rebuilt from memory, so nothing to copy */
+	page = grab_meta_page(sbi, dst_off);
+	memset(page_address(page), 0, PAGE_CACHE_SIZE);
+	set_to_next_sit(sit_i, start);
+
+	return page;
+}
+
+/*
+ * CP calls this function, which flushes SIT entries including sit_journal,
+ * and moves prefree segs to free segs.
+ *
+ * Each SIT block holding a dirty entry is written to its other copy and
+ * the SIT version bitmap, saved in the checkpoint, is flipped; the
+ * previous checkpoint keeps pointing at the untouched copy.
+ */
+void flush_sit_entries(struct f2fs_sb_info *sbi)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	unsigned long *bitmap = sit_i->dirty_sentries_bitmap;
+	unsigned int nsegs = TOTAL_SEGS(sbi);
+	unsigned int segno = 0;
+
+	mutex_lock(&sit_i->sentry_lock);
+
+	while ((segno = find_next_bit(bitmap, nsegs, segno)) < nsegs) {
+		struct f2fs_sit_block *raw_sit;
+		struct page *page;
+		unsigned int start, end, i;
+
+		start = START_SEGNO(sit_i, segno);
+		end = min(start + (unsigned int)SIT_ENTRY_PER_BLOCK, nsegs);
+
+		page = get_next_sit_page(sbi, start);
+		raw_sit = page_address(page);
+
+		for (i = start; i < end; i++) {
+			seg_info_to_raw_sit(get_seg_entry(sbi, i),
+					&raw_sit->entries[i - start]);
+			if (__test_and_clear_bit(i, bitmap))
+				sit_i->dirty_sentries--;
+		}
+
+		set_page_dirty(page);
+		f2fs_put_page(page, 1);
+		segno = end;
+	}
+
+	BUG_ON(sit_i->dirty_sentries);
+	mutex_unlock(&sit_i->sentry_lock);
+}
+
+static int build_sit_info(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_super_block *raw_super = F2FS_RAW_SUPER(sbi);
+	struct f2fs_checkpoint *ckpt = F2FS_CKPT(sbi);
+	struct sit_info *sit_i;
+	unsigned int sit_segs, start;
+	char *src_bitmap, *dst_bitmap;
+	unsigned char *maps;
+	unsigned int bitmap_size;
+
+	/* allocate memory for SIT information */
+	sit_i = kzalloc(sizeof(struct sit_info), GFP_KERNEL);
+	if (!sit_i)
+		return -ENOMEM;
+
+	SM_I(sbi)->sit_info = sit_i;
+
+	sit_i->sentries = vzalloc(TOTAL_SEGS(sbi) * sizeof(struct seg_entry));
+	if (!sit_i->sentries)
+		return -ENOMEM;
+
+	bitmap_size = f2fs_bitmap_size(TOTAL_SEGS(sbi));
+	sit_i->dirty_sentries_bitmap = kzalloc(bitmap_size, GFP_KERNEL);
+	if (!sit_i->dirty_sentries_bitmap)
+		return -ENOMEM;
+
+	/* one allocation backs the validity maps of all segments */
+	maps = vzalloc(TOTAL_SEGS(sbi) * SIT_VBLOCK_MAP_SIZE);
+	if (!maps)
+		return -ENOMEM;
+	for (start = 0; start < TOTAL_SEGS(sbi); start++)
+		sit_i->sentries[start].cur_valid_map =
+					maps + start * SIT_VBLOCK_MAP_SIZE;
+
+	sit_segs = le32_to_cpu(raw_super->segment_count_sit) >> 1;
+
+	/* setup SIT bitmap from ckeckpoint pack */
+	bitmap_size = __bitmap_size(sbi, SIT_BITMAP);
+	src_bitmap = __bitmap_ptr(sbi, SIT_BITMAP);
+
+	dst_bitmap = kmemdup(src_bitmap, bitmap_size, GFP_KERNEL);
+	if (!dst_bitmap)
+		return -ENOMEM;
+
+	/* init SIT information */
+	sit_i->sit_base_addr = le32_to_cpu(raw_super->sit_blkaddr);
+	sit_i->sit_blocks = sit_segs << sbi->log_blocks_per_seg;
+	sit_i->written_valid_blocks = le64_to_cpu(ckpt->valid_block_count);
+	sit_i->sit_bitmap = dst_bitmap;
+	sit_i->bitmap_size = bitmap_size;
+	sit_i->dirty_sentries = 0;
+	sit_i->sents_per_block = SIT_ENTRY_PER_BLOCK;
+	sit_i->elapsed_time = le64_to_cpu(sbi->ckpt->elapsed_time);
+	sit_i->mounted_time = CURRENT_TIME_SEC.tv_sec;
+	mutex_init(&sit_i->sentry_lock);
+	return 0;
+}
+
+static int build_free_segmap(struct f2fs_sb_info *sbi)
+{
+	struct free_segmap_info *free_i;
+	unsigned int bitmap_size;
+
+	/* allocate memory for free segmap information */
+	free_i = kzalloc(sizeof(struct free_segmap_info), GFP_KERNEL);
+	if (!free_i)
+		return -ENOMEM;
+
+	SM_I(sbi)->free_info = free_i;
+
+	bitmap_size = f2fs_bitmap_size(TOTAL_SEGS(sbi));
+	free_i->free_segmap = kmalloc(bitmap_size, GFP_KERNEL);
+	if (!free_i->free_segmap)
+		return -ENOMEM;
+
+	/* set all segments as dirty temporarily */
+	memset(free_i->free_segmap, 0xff, bitmap_size);
+
+	/* init free segmap information */
+	free_i->free_segments = 0;
+	rwlock_init(&free_i->segmap_lock);
+	return 0;
+}
+
+static int build_curseg(struct f2fs_sb_info *sbi)
+{
+	struct curseg_info *array;
+	int i;
+
+	array = kzalloc(sizeof(*array) * NR_CURSEG_TYPE, GFP_KERNEL);
+	if (!array)
+		return -ENOMEM;
+
+	SM_I(sbi)->curseg_array = array;
+
+	for (i = 0; i < NR_CURSEG_TYPE; i++) {
+		mutex_init(&array[i].curseg_mutex);
+		array[i].sum_blk = kzalloc(PAGE_CACHE_SIZE, GFP_KERNEL);
+		if (!array[i].sum_blk)
+			return -ENOMEM;
+		array[i].segno = NULL_SEGNO;
+		array[i].next_blkoff = 0;
+	}
+	return restore_curseg_summaries(sbi);
+}
+
+static bool check_raw_sit(struct f2fs_sb_info *sbi, struct f2fs_sit_entry *rs)
+{
+	return GET_SIT_VBLOCKS(rs) <= sbi->blocks_per_seg &&
+			GET_SIT_TYPE(rs) < NO_CHECK_TYPE;
+}
+
+/*
+ * The SIT journal kept in the cold data summary is newer than the SIT
+ * blocks. Its entries are marked dirty, so the next checkpoint writes them
+ * into the SIT blocks and the journal can be dropped.
+ */
+static int apply_sit_journal(struct f2fs_sb_info *sbi)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	struct curseg_info *curseg = CURSEG_I(sbi, CURSEG_COLD_DATA);
+	struct f2fs_summary_block *sum = curseg->sum_blk;
+	int err = 0;
+	int i, n;
+
+	mutex_lock(&curseg->curseg_mutex);
+	n = le16_to_cpu(sum->n_sits);
+	if (n > SIT_JOURNAL_ENTRIES) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct sit_journal_entry *je = &sum->sit_j.entries[i];
+		unsigned int segno = le32_to_cpu(je->segno);
+
+		if (segno >= TOTAL_SEGS(sbi) || !check_raw_sit(sbi, &je->se)) {
+			err = -EINVAL;
+			goto out;
+		}
+		seg_info_from_raw_sit(&sit_i->sentries[segno], &je->se);
+		__mark_sit_entry_dirty(sbi, segno);
+	}
+	sum->n_sits = 0;
+out:
+	mutex_unlock(&curseg->curseg_mutex);
+	return err;
+}
+
+static int build_sit_entries(struct f2fs_sb_info *sbi)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	unsigned int start;
+
+	for (start = 0; start < TOTAL_SEGS(sbi);
+				start += SIT_ENTRY_PER_BLOCK) {
+		struct f2fs_sit_block *sit_blk;
+		struct page *page;
+		unsigned int segno, end;
+
+		page = get_current_sit_page(sbi, start);
+		if (IS_ERR(page))
+			return PTR_ERR(page);
+		sit_blk = (struct f2fs_sit_block *)page_address(page);
+
+		end = min(start + (unsigned int)SIT_ENTRY_PER_BLOCK,
+				TOTAL_SEGS(sbi));
+		for (segno = start; segno < end; segno++) {
+			struct f2fs_sit_entry *rs;
+
+			rs = &sit_blk->entries[SIT_ENTRY_OFFSET(sit_i, segno)];
+			if (!check_raw_sit(sbi, rs)) {
+				f2fs_put_page(page, 1);
+				return -EINVAL;
+			}
+			seg_info_from_raw_sit(&sit_i->sentries[segno], rs);
+		}
+		f2fs_put_page(page, 1);
+	}
+	return apply_sit_journal(sbi);
+}
+
+static void init_free_segmap(struct f2fs_sb_info *sbi)
+{
+	struct free_segmap_info *free_i = FREE_I(sbi);
+	unsigned int segno;
+	int type;
+
+	for (segno = 0; segno < TOTAL_SEGS(sbi); segno++) {
+		struct seg_entry *sentry = get_seg_entry(sbi, segno);
+		if (!sentry->valid_blocks) {
+			clear_bit(segno, free_i->free_segmap);
+			free_i->free_segments++;
+		}
+	}
+
+	/* set use the current segments */
+	for (type = CURSEG_HOT_DATA; type <= CURSEG_COLD_NODE; type++) {
+		struct curseg_info *curseg_t = CURSEG_I(sbi, type);
+		__set_inuse(sbi, curseg_t->segno);
+	}
+}
+
+static void init_dirty_segmap(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int segno;
+	unsigned short valid_blocks;
+
+	mutex_lock(&dirty_i->seglist_lock);
+	for (segno = 0; segno < TOTAL_SEGS(sbi); segno++) {
+		valid_blocks = get_valid_blocks(sbi, segno);
+		if (valid_blocks >= sbi->blocks_per_seg || !valid_blocks)
+			continue;
+		__locate_dirty_segment(sbi, segno, DIRTY);
+	}
+	mutex_unlock(&dirty_i->seglist_lock);
+}
+
+static int build_dirty_segmap(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i;
+	unsigned int bitmap_size, i;
+
+	/* allocate memory for dirty segments list information */
+	dirty_i = kzalloc(sizeof(struct dirty_seglist_info), GFP_KERNEL);
+	if (!dirty_i)
+		return -ENOMEM;
+
+	SM_I(sbi)->dirty_info = dirty_i;
+	mutex_init(&dirty_i->seglist_lock);
+
+	bitmap_size = f2fs_bitmap_size(TOTAL_SEGS(sbi));
+
+	for (i = 0; i < NR_DIRTY_TYPE; i++) {
+		dirty_i->dirty_segmap[i] = kzalloc(bitmap_size, GFP_KERNEL);
+		if (!dirty_i->dirty_segmap[i])
+			return -ENOMEM;
+	}
+
+	dirty_i->victim_segmap = kzalloc(bitmap_size, GFP_KERNEL);
+	if (!dirty_i->victim_segmap)
+		return -ENOMEM;
+
+	dirty_i->cp_prefree_segmap = kzalloc(bitmap_size, GFP_KERNEL);
+	if (!dirty_i->cp_prefree_segmap)
+		return -ENOMEM;
+
+	init_dirty_segmap(sbi);
+	return 0;
+}
+
+/*
+ * Update min, max modified time for cost-benefit GC algorithm
+ */
+static void init_min_max_mtime(struct f2fs_sb_info *sbi)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+	unsigned int segno;
+
+	mutex_lock(&sit_i->sentry_lock);
+
+	sit_i->min_mtime = LLONG_MAX;
+
+	for (segno = 0; segno < TOTAL_SEGS(sbi); segno++) {
+		unsigned long long mtime = get_seg_entry(sbi, segno)->mtime;
+
+		if (sit_i->min_mtime > mtime)
+			sit_i->min_mtime = mtime;
+	}
+	sit_i->max_mtime = get_mtime(sbi);
+	mutex_unlock(&sit_i->sentry_lock);
+}
+
+static void init_discard_unit(struct f2fs_sb_info *sbi)
+{
+	struct request_queue *q = bdev_get_queue(sbi->sb->s_bdev);
+	unsigned int unit = 1;
+
+	if (test_opt(sbi, DISCARD) && !blk_queue_discard(q)) {
+		printk(KERN_INFO "F2FS-fs: device does not support discard\n");
+		clear_opt(sbi, DISCARD);
+	}
+
+	if (blk_queue_discard(q))
+		unit = q->limits.discard_granularity >> sbi->log_blocksize;
+	SM_I(sbi)->discard_blks = max(unit, 1U);
+
+	if (test_opt(sbi, DISCARD) &&
+			SM_I(sbi)->discard_blks > sbi->blocks_per_seg)
+		printk(KERN_INFO "F2FS-fs: discard granularity %u blocks spans "
+			"several segments\n", SM_I(sbi)->discard_blks);
+}
+
+int build_segment_manager(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_super_block *raw_super = F2FS_RAW_SUPER(sbi);
+	struct f2fs_checkpoint *ckpt = F2FS_CKPT(sbi);
+	struct f2fs_sm_info *sm_info;
+	int err;
+
+	sm_info = kzalloc(sizeof(struct f2fs_sm_info), GFP_KERNEL);
+	if (!sm_info)
+		return -ENOMEM;
+
+	/* init sm info */
+	sbi->sm_info = sm_info;
+	sm_info->seg0_blkaddr = le32_to_cpu(raw_super->segment0_blkaddr);
+	sm_info->main_blkaddr = le32_to_cpu(raw_super->main_blkaddr);
+	sm_info->segment_count = le32_to_cpu(raw_super->segment_count);
+	sm_info->reserved_segments = le32_to_cpu(ckpt->rsvd_segment_count);
+	sm_info->ovp_segments = le32_to_cpu(ckpt->overprov_segment_count);
+	sm_info->main_segments = le32_to_cpu(raw_super->segment_count_main);
+	sm_info->ssa_blkaddr = le32_to_cpu(raw_super->ssa_blkaddr);
+
+	init_discard_unit(sbi);
+
+	err = build_sit_info(sbi);
+	if (err)
+		return err;
+	err = build_free_segmap(sbi);
+	if (err)
+		return err;
+	err = build_curseg(sbi);
+	if (err)
+		return err;
+
+	/* reinit free segmap based on SIT */
+	err = build_sit_entries(sbi);
+	if (err)
+		return err;
+
+	init_free_segmap(sbi);
+	err = build_dirty_segmap(sbi);
+	if (err)
+		return err;
+
+	init_min_max_mtime(sbi);
+	return 0;
+}
+
+void reset_victim_segmap(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	unsigned int bitmap_size = f2fs_bitmap_size(TOTAL_SEGS(sbi));
+
+	mutex_lock(&dirty_i->seglist_lock);
+	memset(dirty_i->victim_segmap, 0, bitmap_size);
+	mutex_unlock(&dirty_i->seglist_lock);
+}
+
+static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	int i;
+
+	if (!dirty_i)
+		return;
+
+	for (i = 0; i < NR_DIRTY_TYPE; i++)
+		kfree(dirty_i->dirty_segmap[i]);
+	kfree(dirty_i->victim_segmap);
+	kfree(dirty_i->cp_prefree_segmap);
+
+	SM_I(sbi)->dirty_info = NULL;
+	kfree(dirty_i);
+}
+
+static void destroy_curseg(struct f2fs_sb_info *sbi)
+{
+	struct curseg_info *array = SM_I(sbi)->curseg_array;
+	int i;
+
+	if (!array)
+		return;
+	SM_I(sbi)->curseg_array = NULL;
+	for (i = 0; i < NR_CURSEG_TYPE; i++)
+		kfree(array[i].sum_blk);
+	kfree(array);
+}
+
+static void destroy_free_segmap(struct f2fs_sb_info *sbi)
+{
+	struct free_segmap_info *free_i = SM_I(sbi)->free_info;
+	if (!free_i)
+		return;
+	SM_I(sbi)->free_info = NULL;
+	kfree(free_i->free_segmap);
+	kfree(free_i);
+}
+
+static void destroy_sit_info(struct f2fs_sb_info *sbi)
+{
+	struct sit_info *sit_i = SIT_I(sbi);
+
+	if (!sit_i)
+		return;
+
+	if (sit_i->sentries)
+		vfree(sit_i->sentries[0].cur_valid_map);
+	vfree(sit_i->sentries);
+	kfree(sit_i->dirty_sentries_bitmap);
+
+	SM_I(sbi)->sit_info = NULL;
+	kfree(sit_i->sit_bitmap);
+	kfree(sit_i);
+}
+
+void destroy_segment_manager(struct f2fs_sb_info *sbi)
+{
+	struct f2fs_sm_info *sm_info = SM_I(sbi);
+
+	if (!sm_info)
+		return;
+	destroy_dirty_segmap(sbi);
+	destroy_curseg(sbi);
+	destroy_free_segmap(sbi);
+	destroy_sit_info(sbi);
+	sbi->sm_info = NULL;
+	kfree(sm_info);
+}
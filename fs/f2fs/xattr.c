@@ -0,0 +1,464 @@
+/*
+ * fs/f2fs/xattr.c
+ *
+ * Portions of this code from linux/fs/ext2/xattr.c
+ *
+ * Copyright (C) 2001-2003 Andreas Gruenbacher <agruen@suse.de>
+ *
+ * Fix by Harrison Xing <harrison@mountainviewdata.com>.
+ * Extended attributes for symlinks and special files added per
+ *  suggestion of Luka Renko <luka.renko@hermes.si>.
+ * xattr consolidation Copyright (c) 2004 James Morris <jmorris@redhat.com>,
+ *  Red Hat Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/rwsem.h>
+#include <linux/f2fs_fs.h>
+#include <linux/security.h>
+#include "f2fs.h"
+#include "node.h"
+#include "xattr.h"
+
+static size_t f2fs_xattr_generic_list(struct dentry *dentry, char *list,
+		size_t list_size, const char *name, size_t name_len, int type)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dentry->d_sb);
+	int total_len, prefix_len;
+	const char *prefix;
+
+	switch (type) {
+	case F2FS_XATTR_INDEX_USER:
+		if (!test_opt(sbi, XATTR_USER))
+			return 0;
+		prefix = XATTR_USER_PREFIX;
+		prefix_len = XATTR_USER_PREFIX_LEN;
+		break;
+	case F2FS_XATTR_INDEX_TRUSTED:
+		if (!capable(CAP_SYS_ADMIN))
+			return 0;
+		prefix = XATTR_TRUSTED_PREFIX;
+		prefix_len = XATTR_TRUSTED_PREFIX_LEN;
+		break;
+	case F2FS_XATTR_INDEX_SECURITY:
+		prefix = XATTR_SECURITY_PREFIX;
+		prefix_len = XATTR_SECURITY_PREFIX_LEN;
+		break;
+	default:
+		return 0;
+	}
+
+	total_len = prefix_len + name_len + 1;
+	if (list && total_len <= list_size) {
+		memcpy(list, prefix, prefix_len);
+		memcpy(list + prefix_len, name, name_len);
+		list[prefix_len + name_len] = '\0';
+	}
+	return total_len;
+}
+
+static int f2fs_xattr_permitted(struct f2fs_sb_info *sbi, int type)
+{
+	switch (type) {
+	case F2FS_XATTR_INDEX_USER:
+		if (!test_opt(sbi, XATTR_USER))
+			return -EOPNOTSUPP;
+		break;
+	case F2FS_XATTR_INDEX_TRUSTED:
+		if (!capable(CAP_SYS_ADMIN))
+			return -EPERM;
+		break;
+	case F2FS_XATTR_INDEX_SECURITY:
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * Walk the entries of an xattr block. *found is the entry named by
+ * (index, name), or NULL, and *last is where the list ends. An entry
+ * running past MIN_OFFSET means the block is corrupted.
+ */
+static int find_xattr(void *base_addr, int index, size_t len,
+		const char *name, struct f2fs_xattr_entry **found,
+		struct f2fs_xattr_entry **last)
+{
+	struct f2fs_xattr_entry *entry;
+	void *end = base_addr + MIN_OFFSET;
+
+	if (le32_to_cpu(XATTR_HDR(base_addr)->h_magic) != F2FS_XATTR_MAGIC)
+		return -EIO;
+
+	*found = NULL;
+	for (entry = XATTR_FIRST_ENTRY(base_addr); ;
+					entry = XATTR_NEXT_ENTRY(entry)) {
+		if ((void *)entry > end)
+			return -EIO;
+		if (IS_XATTR_LAST_ENTRY(entry))
+			break;
+		if ((void *)XATTR_NEXT_ENTRY(entry) > end)
+			return -EIO;
+		if (*found || entry->e_name_index != index ||
+				entry->e_name_len != len)
+			continue;
+		if (!memcmp(entry->e_name, name, len))
+			*found = entry;
+	}
+	*last = entry;
+	return 0;
+}
+
+static int f2fs_getxattr(struct inode *inode, int name_index,
+		const char *name, void *buffer, size_t buffer_size)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	struct f2fs_xattr_entry *entry, *last;
+	struct page *page;
+	size_t name_len, value_len;
+	int error;
+
+	if (name == NULL)
+		return -EINVAL;
+	name_len = strlen(name);
+	if (name_len > F2FS_XATTR_NAME_LEN)
+		return -ERANGE;
+
+	if (!fi->i_xattr_nid)
+		return -ENODATA;
+
+	page = get_node_page(sbi, fi->i_xattr_nid);
+	if (IS_ERR(page))
+		return PTR_ERR(page);
+
+	error = find_xattr(page_address(page), name_index, name_len, name,
+							&entry, &last);
+	if (error)
+		goto out;
+	if (!entry) {
+		error = -ENODATA;
+		goto out;
+	}
+
+	value_len = le16_to_cpu(entry->e_value_size);
+	if (buffer) {
+		if (value_len > buffer_size) {
+			error = -ERANGE;
+			goto out;
+		}
+		memcpy(buffer, entry->e_name + entry->e_name_len, value_len);
+	}
+	error = value_len;
+out:
+	f2fs_put_page(page, 1);
+	return error;
+}
+
+/*
+ * The caller holds f2fs_lock_op(). ipage is the locked inode page if the
+ * caller already has it, as when the inode is being created.
+ */
+static int __f2fs_setxattr(struct inode *inode, int name_index,
+			const char *name, const void *value, size_t value_len,
+			int flags, struct page *ipage)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	struct f2fs_xattr_entry *here, *last;
+	struct f2fs_xattr_header *header;
+	struct page *page, *own_ipage = NULL;
+	size_t name_len, newsize;
+	void *base_addr;
+	int error;
+
+	if (name == NULL)
+		return -EINVAL;
+	name_len = strlen(name);
+	if (value == NULL)
+		value_len = 0;
+	if (name_len > F2FS_XATTR_NAME_LEN || value_len > MAX_VALUE_LEN)
+		return -ERANGE;
+
+	if (!ipage) {
+		own_ipage = get_node_page(sbi, inode->i_ino);
+		if (IS_ERR(own_ipage))
+			return PTR_ERR(own_ipage);
+		ipage = own_ipage;
+	}
+
+	if (fi->i_xattr_nid) {
+		page = get_node_page(sbi, fi->i_xattr_nid);
+		if (IS_ERR(page)) {
+			error = PTR_ERR(page);
+			goto out;
+		}
+	} else {
+		struct dnode_of_data dn;
+		nid_t new_nid;
+
+		/* nothing to remove */
+		if (!value) {
+			error = (flags & XATTR_REPLACE) ? -ENODATA : 0;
+			goto out;
+		}
+		if (!alloc_nid(sbi, &new_nid)) {
+			error = -ENOSPC;
+			goto out;
+		}
+		set_new_dnode(&dn, inode, ipage, NULL, new_nid);
+		dn.inode_page_locked = true;
+		fi->i_xattr_nid = new_nid;
+		page = new_node_page(&dn, XATTR_NODE_OFFSET);
+		if (IS_ERR(page)) {
+			fi->i_xattr_nid = 0;
+			alloc_nid_failed(sbi, new_nid);
+			error = PTR_ERR(page);
+			goto out;
+		}
+		alloc_nid_done(sbi, new_nid);
+
+		header = XATTR_HDR(page_address(page));
+		header->h_magic = cpu_to_le32(F2FS_XATTR_MAGIC);
+		header->h_refcount = cpu_to_le32(1);
+	}
+	base_addr = page_address(page);
+
+	error = find_xattr(base_addr, name_index, name_len, name,
+							&here, &last);
+	if (error)
+		goto out_page;
+
+	if (here && (flags & XATTR_CREATE)) {
+		error = -EEXIST;
+		goto out_page;
+	}
+	if (!here) {
+		if (flags & XATTR_REPLACE) {
+			error = -ENODATA;
+			goto out_page;
+		}
+		if (!value)
+			goto out_page;
+	}
+
+	newsize = XATTR_ALIGN(sizeof(struct f2fs_xattr_entry) +
+						name_len + value_len);
+	if (value) {
+		size_t free = MIN_OFFSET - ((char *)last - (char *)base_addr);
+
+		if (here)
+			free += ENTRY_SIZE(here);
+		if (free < newsize) {
+			error = -ENOSPC;
+			goto out_page;
+		}
+	}
+
+	wait_on_page_writeback(page);
+
+	if (here) {
+		struct f2fs_xattr_entry *next = XATTR_NEXT_ENTRY(here);
+		size_t oldsize = ENTRY_SIZE(here);
+
+		memmove(here, next, (char *)last - (char *)next);
+		last = (struct f2fs_xattr_entry *)((char *)last - oldsize);
+		memset(last, 0, oldsize);
+	}
+
+	if (value) {
+		memset(last, 0, newsize);
+		last->e_name_index = name_index;
+		last->e_name_len = name_len;
+		last->e_value_size = cpu_to_le16(value_len);
+		memcpy(last->e_name, name, name_len);
+		memcpy(last->e_name + name_len, value, value_len);
+	}
+	set_page_dirty(page);
+
+	/* xattr nodes are not dnodes, so roll-forward cannot replay them */
+	set_inode_flag(fi, FI_NEED_CP);
+	inode->i_ctime = CURRENT_TIME;
+	update_inode(inode, ipage);
+out_page:
+	f2fs_put_page(page, 1);
+out:
+	if (own_ipage)
+		f2fs_put_page(own_ipage, 1);
+	return error;
+}
+
+static int f2fs_setxattr(struct inode *inode, int name_index,
+			const char *name, const void *value, size_t value_len,
+			int flags)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	int err;
+
+	f2fs_balance_fs(sbi);
+
+	f2fs_lock_op(sbi);
+	err = __f2fs_setxattr(inode, name_index, name, value, value_len,
+							flags, NULL);
+	f2fs_unlock_op(sbi);
+	return err;
+}
+
+static int f2fs_xattr_generic_get(struct dentry *dentry, const char *name,
+		void *buffer, size_t size, int type)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dentry->d_sb);
+	int err;
+
+	err = f2fs_xattr_permitted(sbi, type);
+	if (err)
+		return err;
+	if (strcmp(name, "") == 0)
+		return -EINVAL;
+	return f2fs_getxattr(dentry->d_inode, type, name, buffer, size);
+}
+
+static int f2fs_xattr_generic_set(struct dentry *dentry, const char *name,
+		const void *value, size_t size, int flags, int type)
+{
+	struct f2fs_sb_info *sbi = F2FS_SB(dentry->d_sb);
+	int err;
+
+	err = f2fs_xattr_permitted(sbi, type);
+	if (err)
+		return err;
+	if (strcmp(name, "") == 0)
+		return -EINVAL;
+	return f2fs_setxattr(dentry->d_inode, type, name, value, size, flags);
+}
+
+static const struct xattr_handler f2fs_xattr_user_handler = {
+	.prefix	= XATTR_USER_PREFIX,
+	.flags	= F2FS_XATTR_INDEX_USER,
+	.list	= f2fs_xattr_generic_list,
+	.get	= f2fs_xattr_generic_get,
+	.set	= f2fs_xattr_generic_set,
+};
+
+static const struct xattr_handler f2fs_xattr_trusted_handler = {
+	.prefix	= XATTR_TRUSTED_PREFIX,
+	.flags	= F2FS_XATTR_INDEX_TRUSTED,
+	.list	= f2fs_xattr_generic_list,
+	.get	= f2fs_xattr_generic_get,
+	.set	= f2fs_xattr_generic_set,
+};
+
+#ifdef CONFIG_F2FS_FS_SECURITY
+static const struct xattr_handler f2fs_xattr_security_handler = {
+	.prefix	= XATTR_SECURITY_PREFIX,
+	.flags	= F2FS_XATTR_INDEX_SECURITY,
+	.list	= f2fs_xattr_generic_list,
+	.get	= f2fs_xattr_generic_get,
+	.set	= f2fs_xattr_generic_set,
+};
+#endif
+
+static const struct xattr_handler *f2fs_xattr_handler_map[] = {
+	[F2FS_XATTR_INDEX_USER] = &f2fs_xattr_user_handler,
+	[F2FS_XATTR_INDEX_TRUSTED] = &f2fs_xattr_trusted_handler,
+#ifdef CONFIG_F2FS_FS_SECURITY
+	[F2FS_XATTR_INDEX_SECURITY] = &f2fs_xattr_security_handler,
+#endif
+};
+
+const struct xattr_handler *f2fs_xattr_handlers[] = {
+	&f2fs_xattr_user_handler,
+	&f2fs_xattr_trusted_handler,
+#ifdef CONFIG_F2FS_FS_SECURITY
+	&f2fs_xattr_security_handler,
+#endif
+	NULL,
+};
+
+static inline const struct xattr_handler *f2fs_xattr_handler(int name_index)
+{
+	if (name_index > 0 && name_index < ARRAY_SIZE(f2fs_xattr_handler_map))
+		return f2fs_xattr_handler_map[name_index];
+	return NULL;
+}
+
+ssize_t f2fs_listxattr(struct dentry *dentry, char *buffer, size_t buffer_size)
+{
+	struct inode *inode = dentry->d_inode;
+	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	struct f2fs_xattr_entry *entry, *last;
+	size_t rest = buffer_size;
+	struct page *page;
+	void *base_addr;
+	int error;
+
+	if (!fi->i_xattr_nid)
+		return 0;
+
+	page = get_node_page(sbi, fi->i_xattr_nid);
+	if (IS_ERR(page))
+		return PTR_ERR(page);
+	base_addr = page_address(page);
+
+	/* check the list bounds before walking it */
+	error = find_xattr(base_addr, -1, 0, NULL, &entry, &last);
+	if (error)
+		goto out;
+
+	list_for_each_xattr(entry, base_addr) {
+		const struct xattr_handler *handler =
+			f2fs_xattr_handler(entry->e_name_index);
+		size_t size;
+
+		if (!handler)
+			continue;
+
+		size = handler->list(dentry, buffer, rest, entry->e_name,
+				entry->e_name_len, handler->flags);
+		if (buffer) {
+			if (size > rest) {
+				error = -ERANGE;
+				goto out;
+			}
+			buffer += size;
+		}
+		rest -= size;
+	}
+	error = buffer_size - rest;
+out:
+	f2fs_put_page(page, 1);
+	return error;
+}
+
+#ifdef CONFIG_F2FS_FS_SECURITY
+static int f2fs_initxattrs(struct inode *inode, const struct xattr *xattr_array,
+		void *page)
+{
+	const struct xattr *xattr;
+	int err = 0;
+
+	for (xattr = xattr_array; xattr->name != NULL; xattr++) {
+		err = __f2fs_setxattr(inode, F2FS_XATTR_INDEX_SECURITY,
+				xattr->name, xattr->value,
+				xattr->value_len, 0, (struct page *)page);
+		if (err < 0)
+			break;
+	}
+	return err;
+}
+
+/*
+ * Called from f2fs_add_link() under f2fs_lock_op() with the new inode
+ * page locked.
+ */
+int f2fs_init_security(struct inode *inode, struct inode *dir,
+				const struct qstr *qstr, struct page *ipage)
+{
+	return security_inode_init_security(inode, dir, qstr,
+				&f2fs_initxattrs, ipage);
+}
+#endif
@@ -353,7 +353,7 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 	flags &= ~O_NOCTTY;
 	memset(&inarg, 0, sizeof(inarg));
 	memset(&outentry, 0, sizeof(outentry));
-	inarg.flags = flags;
+	inarg.flags = fuse_open_flags(fc, flags);
 	inarg.mode = mode;
 	inarg.umask = current_umask();
 	req->in.h.opcode = FUSE_CREATE;
@@ -384,6 +384,8 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 	if (!S_ISREG(outentry.attr.mode) || invalid_nodeid(outentry.nodeid))
 		goto out_free_ff;
 
+	ff->passthrough_filp = req->passthrough_filp;
+	req->passthrough_filp = NULL;
 	fuse_put_request(fc, req);
 	ff->fh = outopen.fh;
 	ff->nodeid = outentry.nodeid;
@@ -1218,7 +1220,7 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	struct fuse_setattr_in inarg;
 	struct fuse_attr_out outarg;
 	bool is_truncate = false;
-	loff_t oldsize;
+	loff_t oldsize, newsize;
 	int err;
 
 	if (!fuse_allow_task(fc, current))
@@ -1290,7 +1292,9 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	fuse_change_attributes_common(inode, &outarg.attr,
 				      attr_timeout(&outarg));
 	oldsize = inode->i_size;
-	i_size_write(inode, outarg.attr.size);
+	if (is_truncate || !fuse_keep_local_size(inode))
+		i_size_write(inode, outarg.attr.size);
+	newsize = inode->i_size;
 
 	if (is_truncate) {
 		
@@ -1298,8 +1302,8 @@ static int fuse_do_setattr(struct dentry *entry, struct iattr *attr,
 	}
 	spin_unlock(&fc->lock);
 
-	if (S_ISREG(inode->i_mode) && oldsize != outarg.attr.size) {
-		truncate_pagecache(inode, oldsize, outarg.attr.size);
+	if (S_ISREG(inode->i_mode) && oldsize != newsize) {
+		truncate_pagecache(inode, oldsize, newsize);
 		invalidate_inode_pages2(inode->i_mapping);
 	}
 
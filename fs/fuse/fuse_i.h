@@ -25,6 +25,8 @@
 
 #define FUSE_MAX_PAGES_PER_REQ 32
 
+#define FUSE_SUPER_MAGIC 0x65735546
+
 #define FUSE_NOWRITE INT_MIN
 
 #define FUSE_NAME_MAX 1024
@@ -116,6 +118,9 @@ struct fuse_file {
 	wait_queue_head_t poll_wait;
 
 	
+	struct file *passthrough_filp;
+
+	
 	bool flock:1;
 };
 
@@ -268,6 +273,9 @@ struct fuse_req {
 
 	
 	struct file *stolen_file;
+
+	
+	struct file *passthrough_filp;
 };
 
 struct fuse_conn {
@@ -418,6 +426,12 @@ struct fuse_conn {
 	unsigned no_flock:1;
 
 	
+	unsigned passthrough:1;
+
+	
+	unsigned writeback_cache:1;
+
+	
 	atomic_t num_waiting;
 
 	
@@ -503,6 +517,8 @@ void fuse_read_fill(struct fuse_req *req, struct file *file,
 
 int fuse_open_common(struct inode *inode, struct file *file, bool isdir);
 
+int fuse_open_flags(struct fuse_conn *fc, int flags);
+
 struct fuse_file *fuse_file_alloc(struct fuse_conn *fc);
 struct fuse_file *fuse_file_get(struct fuse_file *ff);
 void fuse_file_free(struct fuse_file *ff);
@@ -611,4 +627,15 @@ int fuse_dev_release(struct inode *inode, struct file *file);
 
 void fuse_write_update_size(struct inode *inode, loff_t pos);
 
+bool fuse_keep_local_size(struct inode *inode);
+
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_open(struct file *file, struct fuse_file *ff);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif 
@@ -0,0 +1,173 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  Passthrough of read, write and mmap to a file of a lower filesystem.
+  The daemon opts in with FUSE_PASSTHROUGH at init and then returns
+  FOPEN_PASSTHROUGH and one of its own file descriptors in the reply to
+  FUSE_OPEN or FUSE_CREATE.
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/aio.h>
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/fsnotify.h>
+#include <linux/pagemap.h>
+#include <linux/ratelimit.h>
+
+/* Called from the daemon's write to /dev/fuse, so fd is looked up there */
+void fuse_passthrough_setup(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct inode *inode;
+	struct file *lower;
+
+	if (!fc->passthrough)
+		return;
+
+	if (req->in.h.opcode == FUSE_OPEN)
+		outarg = req->out.args[0].value;
+	else if (req->in.h.opcode == FUSE_CREATE)
+		outarg = req->out.args[1].value;
+	else
+		return;
+
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+
+	lower = fget(outarg->passthrough_fd);
+	if (!lower) {
+		pr_warn_ratelimited("fuse: passthrough fd %d is not open\n",
+				    outarg->passthrough_fd);
+		return;
+	}
+
+	inode = lower->f_path.dentry->d_inode;
+	if (!S_ISREG(inode->i_mode) ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !lower->f_op || !lower->f_op->aio_read ||
+	    !lower->f_op->aio_write || !lower->f_op->mmap) {
+		pr_warn_ratelimited("fuse: passthrough fd %d not usable\n",
+				    outarg->passthrough_fd);
+		fput(lower);
+		return;
+	}
+
+	req->passthrough_filp = lower;
+}
+
+/*
+ * The lower file was opened by the daemon, so it must allow everything
+ * the fuse file allows. Otherwise the file keeps going through the
+ * daemon.
+ */
+void fuse_passthrough_open(struct file *file, struct fuse_file *ff)
+{
+	struct file *lower = ff->passthrough_filp;
+
+	if (!lower)
+		return;
+
+	if ((file->f_mode & ~lower->f_mode & (FMODE_READ | FMODE_WRITE)) ||
+	    ((file->f_flags ^ lower->f_flags) & O_APPEND))
+		fuse_passthrough_release(ff);
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
+
+/*
+ * The access goes to the lower file as the daemon, which opened it, and
+ * gets the same locking, LSM and fsnotify checks as a read or write
+ * issued on that file directly.
+ */
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos, int rw)
+{
+	struct fuse_file *ff = iocb->ki_filp->private_data;
+	struct file *lower = ff->passthrough_filp;
+	const struct cred *old_cred;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	old_cred = override_creds(lower->f_cred);
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = iov_length(iov, nr_segs);
+	kiocb.ki_nbytes = kiocb.ki_left;
+
+	ret = rw_verify_area(rw, lower, &pos, kiocb.ki_left);
+	if (ret < 0)
+		goto out;
+
+	if (rw == WRITE)
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, pos);
+	else
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, pos);
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+
+	if (ret > 0) {
+		if (rw == WRITE)
+			fsnotify_modify(lower);
+		else
+			fsnotify_access(lower);
+	}
+	iocb->ki_pos = kiocb.ki_pos;
+out:
+	revert_creds(old_cred);
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, READ);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct inode *inode = iocb->ki_filp->f_mapping->host;
+	ssize_t ret;
+
+	ret = fuse_passthrough_rw(iocb, iov, nr_segs, pos, WRITE);
+	if (ret > 0) {
+		/* Pages cached by other opens of this inode are now stale */
+		if (inode->i_mapping->nrpages)
+			invalidate_mapping_pages(inode->i_mapping,
+					(iocb->ki_pos - ret) >> PAGE_CACHE_SHIFT,
+					(iocb->ki_pos - 1) >> PAGE_CACHE_SHIFT);
+		fuse_write_update_size(inode, iocb->ki_pos);
+		fuse_invalidate_attr(inode);
+	}
+	return ret;
+}
+
+/* Map the lower file itself, as ashmem does with its shmem file */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int ret;
+
+	ret = lower->f_op->mmap(lower, vma);
+	if (ret)
+		return ret;
+
+	get_file(lower);
+	fput(vma->vm_file);
+	vma->vm_file = lower;
+	return 0;
+}
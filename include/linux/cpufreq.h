@@ -19,6 +19,7 @@
 #include <linux/completion.h>
 #include <linux/workqueue.h>
 #include <linux/cpumask.h>
+#include <linux/ktime.h>
 #include <asm/div64.h>
 
 #define CPUFREQ_NAME_LEN 16
@@ -27,10 +28,25 @@
 
 #define CPUFREQ_TRANSITION_NOTIFIER	(0)
 #define CPUFREQ_POLICY_NOTIFIER		(1)
+#define CPUFREQ_FRAME_NOTIFIER		(2)
+
+/*
+ * Frame events posted by the GPU driver. LATE: the oldest pending frame,
+ * queued at @queued, has missed its deadline. IDLE: the pipeline drained
+ * and the last retired frame was queued at @queued.
+ */
+#define CPUFREQ_FRAME_LATE	(0)
+#define CPUFREQ_FRAME_IDLE	(1)
+
+struct cpufreq_frame {
+	unsigned int	pending;
+	ktime_t		queued;
+};
 
 #ifdef CONFIG_CPU_FREQ
 int cpufreq_register_notifier(struct notifier_block *nb, unsigned int list);
 int cpufreq_unregister_notifier(struct notifier_block *nb, unsigned int list);
+void cpufreq_notify_frame(unsigned long event, struct cpufreq_frame *frame);
 extern void disable_cpufreq(void);
 #else		
 static inline int cpufreq_register_notifier(struct notifier_block *nb,
@@ -43,6 +59,8 @@ static inline int cpufreq_unregister_notifier(struct notifier_block *nb,
 {
 	return 0;
 }
+static inline void cpufreq_notify_frame(unsigned long event,
+					struct cpufreq_frame *frame) { }
 static inline void disable_cpufreq(void) { }
 #endif		
 
@@ -313,6 +331,9 @@ extern struct cpufreq_governor cpufreq_gov_conservative;
 #elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_INTERACTIVE)
 extern struct cpufreq_governor cpufreq_gov_interactive;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_interactive)
+#elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED)
+extern struct cpufreq_governor cpufreq_gov_sched;
+#define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_sched)
 #endif
 
 
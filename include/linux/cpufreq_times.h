@@ -0,0 +1,65 @@
+/* include/linux/cpufreq_times.h
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_CPUFREQ_TIMES_H
+#define _LINUX_CPUFREQ_TIMES_H
+
+#include <linux/types.h>
+
+/*
+ * Layout of /proc/uid_time_in_state_bin: one header, the frequencies in
+ * kHz, then one record per uid with a time per frequency. Times are in
+ * 1/user_hz seconds, like the text file.
+ */
+#define UID_TIME_IN_STATE_MAGIC		0x53495455	/* "UTIS" */
+#define UID_TIME_IN_STATE_VERSION	1
+
+struct uid_time_in_state_header {
+	__u32	magic;
+	__u16	version;
+	__u16	header_size;
+	__u32	nr_freqs;
+	__u32	user_hz;
+	/* __u32 freqs[nr_freqs] follows */
+};
+
+struct uid_time_in_state_record {
+	__u32	uid;
+	__u32	reserved;
+	/* __u64 times[nr_freqs] follows */
+};
+
+#ifdef __KERNEL__
+#include <asm/cputime.h>
+
+struct pid;
+struct pid_namespace;
+struct seq_file;
+struct task_struct;
+
+#ifdef CONFIG_CPU_FREQ_TIMES
+void cpufreq_task_times_init(struct task_struct *p);
+void cpufreq_task_times_alloc(struct task_struct *p);
+void cpufreq_task_times_exit(struct task_struct *p);
+int proc_time_in_state_show(struct seq_file *m, struct pid_namespace *ns,
+			    struct pid *pid, struct task_struct *p);
+void cpufreq_acct_update_power(struct task_struct *p, cputime_t cputime);
+#else
+static inline void cpufreq_task_times_init(struct task_struct *p) {}
+static inline void cpufreq_task_times_alloc(struct task_struct *p) {}
+static inline void cpufreq_task_times_exit(struct task_struct *p) {}
+static inline void cpufreq_acct_update_power(struct task_struct *p,
+					     cputime_t cputime) {}
+#endif
+#endif
+
+#endif
@@ -0,0 +1,33 @@
+/* include/linux/htc_mpdecision.h
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_HTC_MPDECISION_H
+#define _LINUX_HTC_MPDECISION_H
+
+#ifdef CONFIG_HTC_MPDECISION
+extern int mpdecision_set_thresholds(const char *nw, const char *tw,
+				     const char *ns, const char *ts);
+extern void mpdecision_set_decision_ms(int ms);
+extern void mpdecision_set_cpu_bounds(int min_cpus, int max_cpus);
+extern void mpdecision_set_enabled(int enabled);
+#else
+static inline int mpdecision_set_thresholds(const char *nw, const char *tw,
+					    const char *ns, const char *ts)
+{
+	return 0;
+}
+static inline void mpdecision_set_decision_ms(int ms) { }
+static inline void mpdecision_set_cpu_bounds(int min_cpus, int max_cpus) { }
+static inline void mpdecision_set_enabled(int enabled) { }
+#endif
+
+#endif
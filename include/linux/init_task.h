@@ -19,6 +19,15 @@
 # define INIT_PUSHABLE_TASKS(tsk)
 #endif
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+# define INIT_LMK_ADJ_NODE(tsk)						\
+	.lmk_adj_node = {						\
+		.rb_parent_color = (unsigned long)&tsk.lmk_adj_node,	\
+	},
+#else
+# define INIT_LMK_ADJ_NODE(tsk)
+#endif
+
 extern struct files_struct init_files;
 extern struct fs_struct init_fs;
 
@@ -157,6 +166,7 @@ extern struct cred init_cred;
 	},								\
 	.tasks		= LIST_HEAD_INIT(tsk.tasks),			\
 	INIT_PUSHABLE_TASKS(tsk)					\
+	INIT_LMK_ADJ_NODE(tsk)						\
 	.ptraced	= LIST_HEAD_INIT(tsk.ptraced),			\
 	.ptrace_entry	= LIST_HEAD_INIT(tsk.ptrace_entry),		\
 	.real_parent	= &tsk,						\
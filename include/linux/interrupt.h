@@ -516,4 +516,17 @@ extern int early_irq_init(void);
 extern int arch_probe_nr_irqs(void);
 extern int arch_early_irq_init(void);
 extern void irq_set_pending(unsigned int irq);
+
+#ifdef CONFIG_IRQ_TIMINGS
+extern void irq_timings_enable(void);
+extern void irq_timings_disable(void);
+extern u64 irq_timings_next_event(u64 now);
+#else
+static inline void irq_timings_enable(void) { }
+static inline void irq_timings_disable(void) { }
+static inline u64 irq_timings_next_event(u64 now)
+{
+	return ULLONG_MAX;
+}
+#endif
 #endif
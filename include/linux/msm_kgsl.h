@@ -637,5 +637,20 @@ int kgsl_gem_obj_addr(int drm_fd, int handle, unsigned long *start,
 #else
 #define kgsl_gem_obj_addr(...) 0
 #endif
+
+#if defined(CONFIG_MSM_KGSL) || defined(CONFIG_MSM_KGSL_MODULE)
+int kgsl_pwrctrl_thermal_levels(void);
+unsigned int kgsl_pwrctrl_thermal_limit(int level);
+#else
+static inline int kgsl_pwrctrl_thermal_levels(void)
+{
+	return 0;
+}
+
+static inline unsigned int kgsl_pwrctrl_thermal_limit(int level)
+{
+	return 0;
+}
+#endif
 #endif
 #endif 
@@ -0,0 +1,54 @@
+/*
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MSM_THERMAL_ENGINE_H
+#define __MSM_THERMAL_ENGINE_H
+
+#include <linux/notifier.h>
+
+/* Reported for a domain that is not being throttled */
+#define THERMAL_ENGINE_NO_CPU_CAP	9999999
+#define THERMAL_ENGINE_NO_GPU_CAP	999999999
+
+#ifdef CONFIG_MSM_THERMAL_ENGINE
+bool thermal_engine_enabled(void);
+unsigned int thermal_engine_cpu_cap(unsigned int cpu);
+unsigned int thermal_engine_final_cpu_cap(void);
+unsigned int thermal_engine_gpu_cap(void);
+int thermal_engine_register_notifier(struct notifier_block *nb);
+#else
+static inline bool thermal_engine_enabled(void)
+{
+	return false;
+}
+
+static inline unsigned int thermal_engine_cpu_cap(unsigned int cpu)
+{
+	return THERMAL_ENGINE_NO_CPU_CAP;
+}
+
+static inline unsigned int thermal_engine_final_cpu_cap(void)
+{
+	return THERMAL_ENGINE_NO_CPU_CAP;
+}
+
+static inline unsigned int thermal_engine_gpu_cap(void)
+{
+	return THERMAL_ENGINE_NO_GPU_CAP;
+}
+
+static inline int thermal_engine_register_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+#endif
+
+#endif
@@ -53,6 +53,31 @@ static inline void oom_killer_enable(void)
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+/*
+ * The lowmemorykiller keeps thread group leaders indexed by oom_score_adj.
+ * add/del/replace follow the init_task.tasks list and are called under
+ * tasklist_lock; update is called without locks after an adj change.
+ */
+static inline void lowmem_adj_index_init(struct task_struct *p)
+{
+	RB_CLEAR_NODE(&p->lmk_adj_node);
+}
+
+extern void lowmem_adj_index_add(struct task_struct *p);
+extern void lowmem_adj_index_del(struct task_struct *p);
+extern void lowmem_adj_index_replace(struct task_struct *old,
+				struct task_struct *new);
+extern void lowmem_adj_index_update(struct task_struct *p);
+#else
+static inline void lowmem_adj_index_init(struct task_struct *p) { }
+static inline void lowmem_adj_index_add(struct task_struct *p) { }
+static inline void lowmem_adj_index_del(struct task_struct *p) { }
+static inline void lowmem_adj_index_replace(struct task_struct *old,
+				struct task_struct *new) { }
+static inline void lowmem_adj_index_update(struct task_struct *p) { }
+#endif
+
 extern int sysctl_oom_dump_tasks;
 extern int sysctl_oom_kill_allocating_task;
 extern int sysctl_panic_on_oom;
@@ -210,6 +210,8 @@ enum {
 	WQ_DRAINING		= 1 << 6, 
 	WQ_RESCUER		= 1 << 7, 
 
+	WQ_POWER_EFFICIENT	= 1 << 8, 
+
 	WQ_MAX_ACTIVE		= 512,	  
 	WQ_MAX_UNBOUND_PER_CPU	= 4,	  
 	WQ_DFL_ACTIVE		= WQ_MAX_ACTIVE / 2,
@@ -224,6 +226,8 @@ extern struct workqueue_struct *system_nrt_wq;
 extern struct workqueue_struct *system_unbound_wq;
 extern struct workqueue_struct *system_freezable_wq;
 extern struct workqueue_struct *system_nrt_freezable_wq;
+extern struct workqueue_struct *system_power_efficient_wq;
+extern struct workqueue_struct *system_freezable_power_efficient_wq;
 
 extern struct workqueue_struct *
 __alloc_workqueue_key(const char *fmt, unsigned int flags, int max_active,
@@ -0,0 +1,31 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpu_boost
+
+#if !defined(_TRACE_CPU_BOOST_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPU_BOOST_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(cpu_boost_input,
+	    TP_PROTO(unsigned int cpu, unsigned int min, const char *reason),
+	    TP_ARGS(cpu, min, reason),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned int, cpu)
+		    __field(unsigned int, min)
+		    __string(reason, reason)
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu = cpu;
+		    __entry->min = min;
+		    __assign_str(reason, reason);
+	    ),
+
+	    TP_printk("cpu=%u min=%u reason=%s",
+		      __entry->cpu, __entry->min, __get_str(reason))
+);
+
+#endif
+
+#include <trace/define_trace.h>
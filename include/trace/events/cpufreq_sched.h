@@ -0,0 +1,58 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cpufreq_sched
+
+#if !defined(_TRACE_CPUFREQ_SCHED_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_CPUFREQ_SCHED_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(cpufreq_sched_update_util,
+	    TP_PROTO(unsigned int cpu, unsigned long util, unsigned long max,
+		     unsigned int cur, unsigned int next),
+	    TP_ARGS(cpu, util, max, cur, next),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned int, cpu)
+		    __field(unsigned long, util)
+		    __field(unsigned long, max)
+		    __field(unsigned int, cur)
+		    __field(unsigned int, next)
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu = cpu;
+		    __entry->util = util;
+		    __entry->max = max;
+		    __entry->cur = cur;
+		    __entry->next = next;
+	    ),
+
+	    TP_printk("cpu=%u util=%lu max=%lu cur=%u next=%u",
+		      __entry->cpu, __entry->util, __entry->max,
+		      __entry->cur, __entry->next)
+);
+
+TRACE_EVENT(cpufreq_sched_setspeed,
+	    TP_PROTO(unsigned int cpu, unsigned int targfreq,
+		     unsigned int actualfreq),
+	    TP_ARGS(cpu, targfreq, actualfreq),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned int, cpu)
+		    __field(unsigned int, targfreq)
+		    __field(unsigned int, actualfreq)
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu = cpu;
+		    __entry->targfreq = targfreq;
+		    __entry->actualfreq = actualfreq;
+	    ),
+
+	    TP_printk("cpu=%u targ=%u actual=%u",
+		      __entry->cpu, __entry->targfreq, __entry->actualfreq)
+);
+
+#endif
+
+#include <trace/define_trace.h>
@@ -0,0 +1,64 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM htc_mpdecision
+
+#if !defined(_TRACE_HTC_MPDECISION_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_HTC_MPDECISION_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(htc_mpdecision_sample,
+	    TP_PROTO(int nr, int iowait, unsigned int online,
+		     unsigned int min_cpus, unsigned int max_cpus),
+	    TP_ARGS(nr, iowait, online, min_cpus, max_cpus),
+
+	    TP_STRUCT__entry(
+		    __field(int, nr)
+		    __field(int, iowait)
+		    __field(unsigned int, online)
+		    __field(unsigned int, min_cpus)
+		    __field(unsigned int, max_cpus)
+	    ),
+
+	    TP_fast_assign(
+		    __entry->nr = nr;
+		    __entry->iowait = iowait;
+		    __entry->online = online;
+		    __entry->min_cpus = min_cpus;
+		    __entry->max_cpus = max_cpus;
+	    ),
+
+	    TP_printk("nr=%d iowait=%d online=%u min=%u max=%u",
+		      __entry->nr, __entry->iowait, __entry->online,
+		      __entry->min_cpus, __entry->max_cpus)
+);
+
+TRACE_EVENT(htc_mpdecision_hotplug,
+	    TP_PROTO(unsigned int cpu, bool up, int nr, u64 decision_us,
+		     u64 hotplug_us),
+	    TP_ARGS(cpu, up, nr, decision_us, hotplug_us),
+
+	    TP_STRUCT__entry(
+		    __field(unsigned int, cpu)
+		    __field(bool, up)
+		    __field(int, nr)
+		    __field(u64, decision_us)
+		    __field(u64, hotplug_us)
+	    ),
+
+	    TP_fast_assign(
+		    __entry->cpu = cpu;
+		    __entry->up = up;
+		    __entry->nr = nr;
+		    __entry->decision_us = decision_us;
+		    __entry->hotplug_us = hotplug_us;
+	    ),
+
+	    TP_printk("cpu=%u %s nr=%d decision_us=%llu hotplug_us=%llu",
+		      __entry->cpu, __entry->up ? "up" : "down", __entry->nr,
+		      (unsigned long long)__entry->decision_us,
+		      (unsigned long long)__entry->hotplug_us)
+);
+
+#endif
+
+#include <trace/define_trace.h>
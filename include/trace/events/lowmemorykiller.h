@@ -0,0 +1,48 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lowmemorykiller
+
+#if !defined(_TRACE_LOWMEMORYKILLER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LOWMEMORYKILLER_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(lowmem_select,
+
+	TP_PROTO(struct task_struct *p, int oom_score_adj, int tasksize,
+		 int min_score_adj, int nr_scanned, s64 latency_ns),
+
+	TP_ARGS(p, oom_score_adj, tasksize, min_score_adj, nr_scanned,
+		latency_ns),
+
+	TP_STRUCT__entry(
+		__field(	pid_t,	pid			)
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	int,	oom_score_adj		)
+		__field(	int,	tasksize		)
+		__field(	int,	min_score_adj		)
+		__field(	int,	nr_scanned		)
+		__field(	s64,	latency_ns		)
+	),
+
+	TP_fast_assign(
+		__entry->pid		= p ? p->pid : -1;
+		if (p)
+			memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		else
+			__entry->comm[0] = '\0';
+		__entry->oom_score_adj	= oom_score_adj;
+		__entry->tasksize	= tasksize;
+		__entry->min_score_adj	= min_score_adj;
+		__entry->nr_scanned	= nr_scanned;
+		__entry->latency_ns	= latency_ns;
+	),
+
+	TP_printk("pid=%d comm=%s oom_score_adj=%d tasksize=%d min_score_adj=%d nr_scanned=%d latency_ns=%lld",
+		__entry->pid, __entry->comm, __entry->oom_score_adj,
+		__entry->tasksize, __entry->min_score_adj,
+		__entry->nr_scanned, __entry->latency_ns)
+);
+
+#endif /* _TRACE_LOWMEMORYKILLER_H */
+
+#include <trace/define_trace.h>
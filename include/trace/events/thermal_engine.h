@@ -0,0 +1,37 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM thermal_engine
+
+#if !defined(_TRACE_THERMAL_ENGINE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_THERMAL_ENGINE_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(thermal_engine_limit,
+	    TP_PROTO(const char *domain, int temp, int err, int steps,
+		     unsigned int cap),
+	    TP_ARGS(domain, temp, err, steps, cap),
+
+	    TP_STRUCT__entry(
+		    __string(domain, domain)
+		    __field(int, temp)
+		    __field(int, err)
+		    __field(int, steps)
+		    __field(unsigned int, cap)
+	    ),
+
+	    TP_fast_assign(
+		    __assign_str(domain, domain);
+		    __entry->temp = temp;
+		    __entry->err = err;
+		    __entry->steps = steps;
+		    __entry->cap = cap;
+	    ),
+
+	    TP_printk("domain=%s temp=%d err=%d steps=%d cap=%u",
+		      __get_str(domain), __entry->temp, __entry->err,
+		      __entry->steps, __entry->cap)
+);
+
+#endif
+
+#include <trace/define_trace.h>
@@ -95,6 +95,7 @@ handle_irq_event_percpu(struct irq_desc *desc, struct irqaction *action)
 		action = action->next;
 	} while (action);
 
+	irq_timings_record(irq, flags);
 	add_interrupt_randomness(irq, flags);
 
 	if (!noirqdebug)
@@ -144,3 +144,19 @@ static inline bool irqd_has_set(struct irq_data *d, unsigned int mask)
 {
 	return d->state_use_accessors & mask;
 }
+
+#ifdef CONFIG_IRQ_TIMINGS
+#include <linux/jump_label.h>
+#include <linux/sched.h>
+
+extern struct static_key irq_timing_enabled;
+extern void __irq_timings_record(unsigned int irq, u64 ts);
+
+static inline void irq_timings_record(unsigned int irq, unsigned int flags)
+{
+	if (static_key_false(&irq_timing_enabled) && !(flags & __IRQF_TIMER))
+		__irq_timings_record(irq, local_clock());
+}
+#else
+static inline void irq_timings_record(unsigned int irq, unsigned int flags) { }
+#endif
@@ -0,0 +1,123 @@
+/*
+ * linux/kernel/irq/timings.c
+ *
+ * Tracks how periodically each interrupt arrives on a cpu, so that the
+ * idle code can guess when the next device interrupt is due even though
+ * no timer is armed for it.
+ *
+ * Each cpu keeps a small table of the interrupts it handled most recently
+ * with an exponential moving average of their inter-arrival time and of
+ * its absolute deviation. Interrupts that arrive regularly enough predict
+ * their next arrival one average interval after the last one.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/jump_label.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/time.h>
+
+#include "internals.h"
+
+#define IRQT_SLOTS		16
+#define IRQT_MIN_COUNT		3
+#define IRQT_MAX_INTERVAL	(NSEC_PER_SEC)
+
+struct irqt_stat {
+	unsigned int irq;
+	unsigned int count;
+	u64 last_ts;
+	u64 avg;
+	u64 dev;
+};
+
+struct static_key irq_timing_enabled = STATIC_KEY_INIT_FALSE;
+
+static DEFINE_PER_CPU(struct irqt_stat [IRQT_SLOTS], irqt_stats);
+
+static struct irqt_stat *irqt_lookup(struct irqt_stat *stats,
+				     unsigned int irq)
+{
+	struct irqt_stat *s, *oldest = stats;
+
+	for (s = stats; s < stats + IRQT_SLOTS; s++) {
+		if (s->count && s->irq == irq)
+			return s;
+		if (!s->count || s->last_ts < oldest->last_ts)
+			oldest = s;
+	}
+
+	oldest->irq = irq;
+	oldest->count = 0;
+	return oldest;
+}
+
+void __irq_timings_record(unsigned int irq, u64 ts)
+{
+	struct irqt_stat *s = irqt_lookup(__get_cpu_var(irqt_stats), irq);
+	u64 interval = ts - s->last_ts;
+	s64 diff;
+
+	if (!s->count || interval > IRQT_MAX_INTERVAL) {
+		s->count = 1;
+		s->avg = 0;
+		s->dev = 0;
+	} else if (s->count == 1) {
+		s->avg = interval;
+		s->count++;
+	} else {
+		diff = interval - s->avg;
+		s->avg += diff / 4;
+		s->dev += ((diff < 0 ? -diff : diff) - (s64)s->dev) / 4;
+		if (s->count < UINT_MAX)
+			s->count++;
+	}
+	s->last_ts = ts;
+}
+
+/*
+ * Returns the local_clock() time at which the earliest periodic interrupt
+ * is next expected on this cpu, or ULLONG_MAX. Called with interrupts off.
+ */
+u64 irq_timings_next_event(u64 now)
+{
+	struct irqt_stat *stats = __get_cpu_var(irqt_stats);
+	u64 next_evt = ULLONG_MAX;
+	int i;
+
+	for (i = 0; i < IRQT_SLOTS; i++) {
+		struct irqt_stat *s = &stats[i];
+		u64 next;
+
+		if (s->count < IRQT_MIN_COUNT || !s->avg)
+			continue;
+
+		/* irregular sources predict nothing */
+		if (s->dev > s->avg / 4)
+			continue;
+
+		next = s->last_ts + s->avg;
+		if (next < now) {
+			/* missed more than one period: no longer periodic */
+			if (now - next > s->avg)
+				continue;
+			next += s->avg;
+		}
+		if (next < next_evt)
+			next_evt = next;
+	}
+	return next_evt;
+}
+
+void irq_timings_enable(void)
+{
+	static_key_slow_inc(&irq_timing_enabled);
+}
+
+void irq_timings_disable(void)
+{
+	static_key_slow_dec(&irq_timing_enabled);
+}
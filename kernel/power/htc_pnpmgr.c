@@ -15,6 +15,8 @@
 #include <linux/module.h>
 #include <linux/string.h>
 #include <linux/cpu.h>
+#include <linux/htc_mpdecision.h>
+#include <linux/msm_thermal_engine.h>
 
 #include "power.h"
 
@@ -70,6 +72,31 @@ static ssize_t _name##_store					\
 	return -EINVAL;						\
 }
 
+#define define_thermal_show(_name, int_val, engine_val)		\
+static ssize_t _name##_show					\
+(struct kobject *kobj, struct kobj_attribute *attr, char *buf)	\
+{								\
+	if (thermal_engine_enabled())				\
+		return sprintf(buf, "%u", engine_val);		\
+	return sprintf(buf, "%d", int_val);			\
+}
+
+#define define_thermal_store(_name, int_val)			\
+static ssize_t _name##_store					\
+(struct kobject *kobj, struct kobj_attribute *attr,		\
+ const char *buf, size_t n)					\
+{								\
+	int val;						\
+	if (thermal_engine_enabled())				\
+		return -EPERM;					\
+	if (sscanf(buf, "%d", &val) > 0) {			\
+		int_val = val;					\
+		sysfs_notify(kobj, NULL, #_name);		\
+		return n;					\
+	}							\
+	return -EINVAL;						\
+}
+
 static char activity_buf[MAX_BUF];
 static char non_activity_buf[MAX_BUF];
 static char media_mode_buf[MAX_BUF];
@@ -106,45 +133,75 @@ static int thermal_final_gpu_value = 999999999;
 static int thermal_batt_value;
 static int data_throttling_value;
 
-define_int_show(thermal_c0, thermal_c0_value);
-define_int_store(thermal_c0, thermal_c0_value, null_cb);
+define_thermal_show(thermal_c0, thermal_c0_value,
+		    thermal_engine_cpu_cap(0));
+define_thermal_store(thermal_c0, thermal_c0_value);
 power_attr(thermal_c0);
 
 #if (CONFIG_NR_CPUS >= 2)
-define_int_show(thermal_c1, thermal_c1_value);
-define_int_store(thermal_c1, thermal_c1_value, null_cb);
+define_thermal_show(thermal_c1, thermal_c1_value,
+		    thermal_engine_cpu_cap(1));
+define_thermal_store(thermal_c1, thermal_c1_value);
 power_attr(thermal_c1);
 #if (CONFIG_NR_CPUS == 4)
-define_int_show(thermal_c2, thermal_c2_value);
-define_int_store(thermal_c2, thermal_c2_value, null_cb);
+define_thermal_show(thermal_c2, thermal_c2_value,
+		    thermal_engine_cpu_cap(2));
+define_thermal_store(thermal_c2, thermal_c2_value);
 power_attr(thermal_c2);
 
-define_int_show(thermal_c3, thermal_c3_value);
-define_int_store(thermal_c3, thermal_c3_value, null_cb);
+define_thermal_show(thermal_c3, thermal_c3_value,
+		    thermal_engine_cpu_cap(3));
+define_thermal_store(thermal_c3, thermal_c3_value);
 power_attr(thermal_c3);
 #endif
 #endif
 
-define_int_show(thermal_final, thermal_final_value);
-define_int_store(thermal_final, thermal_final_value, null_cb);
+define_thermal_show(thermal_final, thermal_final_value,
+		    thermal_engine_final_cpu_cap());
+define_thermal_store(thermal_final, thermal_final_value);
 power_attr(thermal_final);
 
-define_int_show(thermal_g0, thermal_g0_value);
-define_int_store(thermal_g0, thermal_g0_value, null_cb);
+define_thermal_show(thermal_g0, thermal_g0_value,
+		    thermal_engine_gpu_cap());
+define_thermal_store(thermal_g0, thermal_g0_value);
 power_attr(thermal_g0);
 
 define_int_show(thermal_batt, thermal_batt_value);
 define_int_store(thermal_batt, thermal_batt_value, null_cb);
 power_attr(thermal_batt);
 
-define_int_show(thermal_final_cpu, thermal_final_cpu_value);
-define_int_store(thermal_final_cpu, thermal_final_cpu_value, null_cb);
+define_thermal_show(thermal_final_cpu, thermal_final_cpu_value,
+		    thermal_engine_final_cpu_cap());
+define_thermal_store(thermal_final_cpu, thermal_final_cpu_value);
 power_attr(thermal_final_cpu);
 
-define_int_show(thermal_final_gpu, thermal_final_gpu_value);
-define_int_store(thermal_final_gpu, thermal_final_gpu_value, null_cb);
+define_thermal_show(thermal_final_gpu, thermal_final_gpu_value,
+		    thermal_engine_gpu_cap());
+define_thermal_store(thermal_final_gpu, thermal_final_gpu_value);
 power_attr(thermal_final_gpu);
 
+static int thermal_engine_notify(struct notifier_block *nb,
+				 unsigned long event, void *data)
+{
+	sysfs_notify(thermal_kobj, NULL, "thermal_c0");
+#if (CONFIG_NR_CPUS >= 2)
+	sysfs_notify(thermal_kobj, NULL, "thermal_c1");
+#if (CONFIG_NR_CPUS == 4)
+	sysfs_notify(thermal_kobj, NULL, "thermal_c2");
+	sysfs_notify(thermal_kobj, NULL, "thermal_c3");
+#endif
+#endif
+	sysfs_notify(thermal_kobj, NULL, "thermal_final");
+	sysfs_notify(thermal_kobj, NULL, "thermal_final_cpu");
+	sysfs_notify(thermal_kobj, NULL, "thermal_g0");
+	sysfs_notify(thermal_kobj, NULL, "thermal_final_gpu");
+	return NOTIFY_OK;
+}
+
+static struct notifier_block thermal_engine_nb = {
+	.notifier_call = thermal_engine_notify,
+};
+
 static unsigned int info_gpu_max_clk = 400000000;
 void set_gpu_clk(unsigned int value)
 {
@@ -179,35 +236,60 @@ static char mp_util_high_and_arg[MAX_BUF];
 static char mp_util_high_or_arg[MAX_BUF];
 static char mp_util_low_and_arg[MAX_BUF];
 static char mp_util_low_or_arg[MAX_BUF];
+static int mp_governor_value = IS_ENABLED(CONFIG_HTC_MPDECISION);
+
+static void mp_threshold_cb(const char *attr)
+{
+	mpdecision_set_thresholds(mp_nw_arg, mp_tw_arg, mp_ns_arg, mp_ts_arg);
+}
+
+static void mp_decision_ms_cb(const char *attr)
+{
+	mpdecision_set_decision_ms(mp_decision_ms_value);
+}
+
+static void mp_cpus_cb(const char *attr)
+{
+	mpdecision_set_cpu_bounds(mp_min_cpus_value, mp_max_cpus_value);
+}
+
+static void mp_governor_cb(const char *attr)
+{
+	mpdecision_set_enabled(mp_governor_value);
+}
 
 define_string_show(mp_nw, mp_nw_arg);
-define_string_store(mp_nw, mp_nw_arg, null_cb);
+define_string_store(mp_nw, mp_nw_arg, mp_threshold_cb);
 power_attr(mp_nw);
 
 define_string_show(mp_tw, mp_tw_arg);
-define_string_store(mp_tw, mp_tw_arg, null_cb);
+define_string_store(mp_tw, mp_tw_arg, mp_threshold_cb);
 power_attr(mp_tw);
 
 define_string_show(mp_ns, mp_ns_arg);
-define_string_store(mp_ns, mp_ns_arg, null_cb);
+define_string_store(mp_ns, mp_ns_arg, mp_threshold_cb);
 power_attr(mp_ns);
 
 define_string_show(mp_ts, mp_ts_arg);
-define_string_store(mp_ts, mp_ts_arg, null_cb);
+define_string_store(mp_ts, mp_ts_arg, mp_threshold_cb);
 power_attr(mp_ts);
 
 define_int_show(mp_decision_ms, mp_decision_ms_value);
-define_int_store(mp_decision_ms, mp_decision_ms_value, null_cb);
+define_int_store(mp_decision_ms, mp_decision_ms_value, mp_decision_ms_cb);
 power_attr(mp_decision_ms);
 
 define_int_show(mp_min_cpus, mp_min_cpus_value);
-define_int_store(mp_min_cpus, mp_min_cpus_value, null_cb);
+define_int_store(mp_min_cpus, mp_min_cpus_value, mp_cpus_cb);
 power_attr(mp_min_cpus);
 
 define_int_show(mp_max_cpus, mp_max_cpus_value);
-define_int_store(mp_max_cpus, mp_max_cpus_value, null_cb);
+define_int_store(mp_max_cpus, mp_max_cpus_value, mp_cpus_cb);
 power_attr(mp_max_cpus);
 
+define_int_show(mp_governor, mp_governor_value);
+define_int_store(mp_governor, mp_governor_value, mp_governor_cb);
+power_attr(mp_governor);
+
 define_int_show(mp_spc_enabled, mp_spc_enabled_value);
 define_int_store(mp_spc_enabled, mp_spc_enabled_value, null_cb);
 power_attr(mp_spc_enabled);
@@ -308,6 +390,7 @@ static struct attribute *hotplug_g[] = {
 	&mp_decision_ms_attr.attr,
 	&mp_min_cpus_attr.attr,
 	&mp_max_cpus_attr.attr,
+	&mp_governor_attr.attr,
 	&cpu_hotplug_attr.attr,
 	&mp_spc_enabled_attr.attr,
 	&mp_sync_enabled_attr.attr,
@@ -524,6 +607,8 @@ static int __init pnpmgr_init(void)
 		return ret;
 	}
 
+	thermal_engine_register_notifier(&thermal_engine_nb);
+
 #ifdef CONFIG_HOTPLUG_CPU
 	register_hotcpu_notifier(&cpu_hotplug_notifier);
 #endif
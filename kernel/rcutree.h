@@ -249,10 +249,36 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	struct rcu_head *nocb_head;
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;
+	struct rcu_head *nocb_gp_head;
+	struct rcu_head **nocb_gp_tail;
+	long nocb_p_count;
+	unsigned long n_nocb_invoked;
+	int nocb_defer_wakeup;
+	struct rcu_data *nocb_next;
+	struct rcu_nocb_group *nocb_grp;
+#endif 
+
 	int cpu;
 	struct rcu_state *rsp;
 };
 
+#ifdef CONFIG_RCU_NOCB_CPU
+struct rcu_nocb_group {
+	struct rcu_state *rsp;
+	struct rcu_data *head;
+	struct task_struct *kthread;
+	wait_queue_head_t wq;
+	unsigned long n_batches;
+	long batch_max;
+	u64 gp_wait_total;
+	u64 gp_wait_max;
+};
+#endif 
+
 #define RCU_GP_IDLE		0	
 #define RCU_GP_INIT		1	
 #define RCU_SAVE_DYNTICK	2	
@@ -408,5 +434,11 @@ static void print_cpu_stall_info(struct rcu_state *rsp, int cpu);
 static void print_cpu_stall_info_end(void);
 static void zero_cpu_stall_ticks(struct rcu_data *rdp);
 static void increment_cpu_stall_ticks(void);
+static void rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy, unsigned long flags);
+static int rcu_nocb_need_deferred_wakeup(int cpu);
+static void rcu_nocb_do_deferred_wakeup(int cpu);
+static void rcu_nocb_barrier(struct rcu_state *rsp);
 
 #endif 
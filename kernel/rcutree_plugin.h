@@ -25,6 +25,7 @@
  */
 
 #include <linux/delay.h>
+#include <linux/slab.h>
 
 #define RCU_KTHREAD_PRIO 1
 
@@ -1367,6 +1368,7 @@ static void rcu_cleanup_after_idle(int cpu)
 
 static void rcu_prepare_for_idle(int cpu)
 {
+	rcu_nocb_do_deferred_wakeup(cpu);
 }
 
 #else 
@@ -1387,6 +1389,9 @@ int rcu_needs_cpu(int cpu)
 	
 	if (!rcu_cpu_has_callbacks(cpu))
 		return 0;
+	/* The kthread wakeup is done from the tick or on idle entry. */
+	if (rcu_nocb_need_deferred_wakeup(cpu))
+		return 1;
 	
 	return per_cpu(rcu_dyntick_holdoff, cpu) == jiffies;
 }
@@ -1451,6 +1456,7 @@ static void rcu_cleanup_after_idle(int cpu)
 
 static void rcu_prepare_for_idle(int cpu)
 {
+	rcu_nocb_do_deferred_wakeup(cpu);
 	if (!rcu_cpu_has_callbacks(cpu)) {
 		per_cpu(rcu_dyntick_holdoff, cpu) = jiffies - 1;
 		per_cpu(rcu_dyntick_drain, cpu) = 0;
@@ -1610,3 +1616,339 @@ static void increment_cpu_stall_ticks(void)
 }
 
 #endif 
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Callbacks queued on a no-CBs CPU go onto a lockless per-CPU list instead
+ * of ->nxtlist.  One "rcuo" kthread per group of such CPUs and per flavor
+ * takes the lists over, waits for a grace period by queueing a callback of
+ * its own on whatever CPU it runs on, and then invokes them in order.
+ */
+static struct cpumask rcu_nocb_mask;
+static int rcu_nocb_group_size;
+
+static int __init rcu_nocb_setup(char *str)
+{
+	cpulist_parse(str, &rcu_nocb_mask);
+	cpumask_and(&rcu_nocb_mask, &rcu_nocb_mask, cpu_possible_mask);
+	if (cpumask_test_cpu(0, &rcu_nocb_mask)) {
+		pr_info("RCU: CPU 0 cannot be a no-CBs CPU\n");
+		cpumask_clear_cpu(0, &rcu_nocb_mask);
+	}
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+static int __init rcu_nocb_group_setup(char *str)
+{
+	get_option(&str, &rcu_nocb_group_size);
+	return 1;
+}
+__setup("rcu_nocb_group=", rcu_nocb_group_setup);
+
+struct rcu_nocb_gp {
+	struct rcu_head head;
+	struct completion done;
+};
+
+static void rcu_nocb_gp_done(struct rcu_head *rhp)
+{
+	complete(&container_of(rhp, struct rcu_nocb_gp, head)->done);
+}
+
+static void rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = NULL;
+	if (cpumask_test_cpu(rdp->cpu, &rcu_nocb_mask))
+		rdp->nocb_tail = &rdp->nocb_head;
+	atomic_long_set(&rdp->nocb_q_count, 0);
+}
+
+static void rcu_nocb_enqueue(struct rcu_data *rdp, struct rcu_head *rhp,
+			     bool can_wake)
+{
+	struct rcu_nocb_group *grp = ACCESS_ONCE(rdp->nocb_grp);
+	struct rcu_head **old_rhpp;
+
+	old_rhpp = xchg(&rdp->nocb_tail, &rhp->next);
+	ACCESS_ONCE(*old_rhpp) = rhp;
+	atomic_long_inc(&rdp->nocb_q_count);
+
+	/* The group kthread picks up whatever was queued before it started. */
+	if (old_rhpp != &rdp->nocb_head || !grp)
+		return;
+	if (can_wake)
+		wake_up(&grp->wq);
+	else
+		rdp->nocb_defer_wakeup = 1;
+}
+
+/*
+ * Callers with interrupts disabled may hold scheduler locks, so the
+ * kthread wakeup is left to the next scheduling-clock tick.  The
+ * grace-period callbacks of the kthreads themselves are never offloaded.
+ */
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy, unsigned long flags)
+{
+	long qlen;
+
+	if (!rdp->nocb_tail || rhp->func == rcu_nocb_gp_done)
+		return false;
+
+	rcu_nocb_enqueue(rdp, rhp, !irqs_disabled_flags(flags));
+	qlen = atomic_long_read(&rdp->nocb_q_count);
+	if (__is_kfree_rcu_offset((unsigned long)rhp->func))
+		trace_rcu_kfree_callback(rdp->rsp->name, rhp,
+					 (unsigned long)rhp->func, 0, qlen);
+	else
+		trace_rcu_callback(rdp->rsp->name, rhp, 0, qlen);
+	return true;
+}
+
+static int __rcu_nocb_need_deferred_wakeup(struct rcu_data *rdp)
+{
+	return ACCESS_ONCE(rdp->nocb_defer_wakeup);
+}
+
+static int rcu_nocb_need_deferred_wakeup(int cpu)
+{
+	return __rcu_nocb_need_deferred_wakeup(&per_cpu(rcu_sched_data, cpu)) ||
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	       __rcu_nocb_need_deferred_wakeup(&per_cpu(rcu_preempt_data, cpu)) ||
+#endif 
+	       __rcu_nocb_need_deferred_wakeup(&per_cpu(rcu_bh_data, cpu));
+}
+
+static void __rcu_nocb_do_deferred_wakeup(struct rcu_data *rdp)
+{
+	if (!__rcu_nocb_need_deferred_wakeup(rdp))
+		return;
+	ACCESS_ONCE(rdp->nocb_defer_wakeup) = 0;
+	wake_up(&rdp->nocb_grp->wq);
+}
+
+static void rcu_nocb_do_deferred_wakeup(int cpu)
+{
+	__rcu_nocb_do_deferred_wakeup(&per_cpu(rcu_sched_data, cpu));
+	__rcu_nocb_do_deferred_wakeup(&per_cpu(rcu_bh_data, cpu));
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	__rcu_nocb_do_deferred_wakeup(&per_cpu(rcu_preempt_data, cpu));
+#endif 
+}
+
+/*
+ * Online CPUs get their barrier callback from rcu_barrier_func(), which
+ * already lands on the offloaded list.  Offline no-CBs CPUs may still have
+ * callbacks in flight, so queue one behind those as well.
+ */
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+	struct rcu_data *rdp;
+	struct rcu_head *head;
+	int cpu;
+
+	for_each_cpu(cpu, &rcu_nocb_mask) {
+		if (cpu_online(cpu))
+			continue;
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		head = &per_cpu(rcu_barrier_head, cpu);
+		atomic_inc(&rcu_barrier_cpu_count);
+		debug_rcu_head_queue(head);
+		head->func = rcu_barrier_callback;
+		head->next = NULL;
+		smp_mb();
+		rcu_nocb_enqueue(rdp, head, true);
+	}
+}
+
+static bool rcu_nocb_group_pending(struct rcu_nocb_group *grp)
+{
+	struct rcu_data *rdp;
+
+	for (rdp = grp->head; rdp; rdp = rdp->nocb_next)
+		if (ACCESS_ONCE(rdp->nocb_head))
+			return true;
+	return false;
+}
+
+static void rcu_nocb_wait_gp(struct rcu_state *rsp)
+{
+	struct rcu_nocb_gp gp;
+
+	init_rcu_head_on_stack(&gp.head);
+	init_completion(&gp.done);
+	__call_rcu(&gp.head, rcu_nocb_gp_done, rsp, 0);
+	wait_for_completion(&gp.done);
+	destroy_rcu_head_on_stack(&gp.head);
+}
+
+static void rcu_nocb_invoke(struct rcu_data *rdp)
+{
+	struct rcu_head *list = rdp->nocb_gp_head;
+	struct rcu_head **tail = rdp->nocb_gp_tail;
+	struct rcu_head *next;
+	long c = 0;
+
+	trace_rcu_batch_start(rdp->rsp->name, 0, rdp->nocb_p_count, -1);
+	while (list) {
+		next = list->next;
+		/* Wait for a concurrent rcu_nocb_enqueue() to link the next one. */
+		while (next == NULL && &list->next != tail) {
+			schedule_timeout_interruptible(1);
+			next = list->next;
+		}
+		debug_rcu_head_unqueue(list);
+		local_bh_disable();
+		__rcu_reclaim(rdp->rsp->name, list);
+		local_bh_enable();
+		list = next;
+		c++;
+		cond_resched();
+	}
+	trace_rcu_batch_end(rdp->rsp->name, c, 0, 0, 0, 1);
+	rdp->nocb_gp_head = NULL;
+	ACCESS_ONCE(rdp->nocb_p_count) -= c;
+	ACCESS_ONCE(rdp->n_nocb_invoked) += c;
+}
+
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_nocb_group *grp = arg;
+	struct rcu_data *rdp;
+	ktime_t start;
+	u64 wait;
+	long c, batch;
+
+	for (;;) {
+		wait_event_interruptible(grp->wq, rcu_nocb_group_pending(grp));
+
+		batch = 0;
+		for (rdp = grp->head; rdp; rdp = rdp->nocb_next) {
+			rdp->nocb_gp_head = ACCESS_ONCE(rdp->nocb_head);
+			if (!rdp->nocb_gp_head)
+				continue;
+			ACCESS_ONCE(rdp->nocb_head) = NULL;
+			rdp->nocb_gp_tail = xchg(&rdp->nocb_tail,
+						 &rdp->nocb_head);
+			c = atomic_long_xchg(&rdp->nocb_q_count, 0);
+			ACCESS_ONCE(rdp->nocb_p_count) += c;
+			batch += c;
+		}
+
+		start = ktime_get();
+		rcu_nocb_wait_gp(grp->rsp);
+		wait = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		ACCESS_ONCE(grp->n_batches)++;
+		grp->gp_wait_total += wait;
+		if (wait > grp->gp_wait_max)
+			grp->gp_wait_max = wait;
+		if (batch > grp->batch_max)
+			grp->batch_max = batch;
+
+		for (rdp = grp->head; rdp; rdp = rdp->nocb_next)
+			if (rdp->nocb_gp_head)
+				rcu_nocb_invoke(rdp);
+	}
+	return 0;
+}
+
+static void __init rcu_spawn_nocb_groups(struct rcu_state *rsp,
+					 const struct cpumask *housekeeping)
+{
+	struct rcu_nocb_group *grp = NULL;
+	struct rcu_data *rdp, *prev = NULL;
+	struct task_struct *t;
+	int cpu, n = 0;
+
+	for_each_cpu(cpu, &rcu_nocb_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (n++ % rcu_nocb_group_size == 0) {
+			grp = kzalloc(sizeof(*grp), GFP_KERNEL);
+			BUG_ON(!grp);
+			grp->rsp = rsp;
+			grp->head = rdp;
+			init_waitqueue_head(&grp->wq);
+			t = kthread_create(rcu_nocb_kthread, grp, "rcuo%c/%d",
+					   rsp->name[4], cpu);
+			BUG_ON(IS_ERR(t));
+			set_cpus_allowed_ptr(t, housekeeping);
+			grp->kthread = t;
+		} else {
+			prev->nocb_next = rdp;
+		}
+		prev = rdp;
+		smp_wmb();
+		ACCESS_ONCE(rdp->nocb_grp) = grp;
+	}
+}
+
+static int __init rcu_spawn_nocb_kthreads(void)
+{
+	static struct cpumask housekeeping __initdata;
+	char buf[64];
+	int cpu;
+
+	if (cpumask_empty(&rcu_nocb_mask))
+		return 0;
+	if (rcu_nocb_group_size <= 0)
+		rcu_nocb_group_size = max_t(int, int_sqrt(nr_cpu_ids), 1);
+	cpumask_andnot(&housekeeping, cpu_possible_mask, &rcu_nocb_mask);
+
+	rcu_spawn_nocb_groups(&rcu_sched_state, &housekeeping);
+	rcu_spawn_nocb_groups(&rcu_bh_state, &housekeeping);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_groups(&rcu_preempt_state, &housekeeping);
+#endif 
+
+	for_each_cpu(cpu, &rcu_nocb_mask) {
+		struct rcu_data *rdp = &per_cpu(rcu_sched_data, cpu);
+
+		if (rdp->nocb_grp->head == rdp)
+			wake_up_process(rdp->nocb_grp->kthread);
+		rdp = &per_cpu(rcu_bh_data, cpu);
+		if (rdp->nocb_grp->head == rdp)
+			wake_up_process(rdp->nocb_grp->kthread);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+		rdp = &per_cpu(rcu_preempt_data, cpu);
+		if (rdp->nocb_grp->head == rdp)
+			wake_up_process(rdp->nocb_grp->kthread);
+#endif 
+	}
+
+	cpulist_scnprintf(buf, sizeof(buf), &rcu_nocb_mask);
+	pr_info("RCU: offloading callbacks from CPUs %s, %d per kthread\n",
+		buf, rcu_nocb_group_size);
+	return 0;
+}
+early_initcall(rcu_spawn_nocb_kthreads);
+
+#else 
+
+static void rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy, unsigned long flags)
+{
+	return false;
+}
+
+static int rcu_nocb_need_deferred_wakeup(int cpu)
+{
+	return 0;
+}
+
+static void rcu_nocb_do_deferred_wakeup(int cpu)
+{
+}
+
+static void rcu_nocb_barrier(struct rcu_state *rsp)
+{
+}
+
+#endif 
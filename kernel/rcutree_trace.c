@@ -417,6 +417,73 @@ static const struct file_operations rcu_pending_fops = {
 	.release = single_release,
 };
 
+#ifdef CONFIG_RCU_NOCB_CPU
+
+static void print_one_rcu_nocb(struct seq_file *m, struct rcu_data *rdp)
+{
+	struct rcu_nocb_group *grp = rdp->nocb_grp;
+	unsigned long n;
+
+	if (!grp)
+		return;
+	if (grp->head == rdp) {
+		n = ACCESS_ONCE(grp->n_batches);
+		seq_printf(m, "%s pid=%d nb=%lu gpw=%llu/%llu bm=%ld\n",
+			   grp->kthread->comm, task_pid_nr(grp->kthread), n,
+			   n ? div64_u64(grp->gp_wait_total,
+					 (u64)n * NSEC_PER_USEC) : 0,
+			   div64_u64(grp->gp_wait_max, NSEC_PER_USEC),
+			   grp->batch_max);
+	}
+	seq_printf(m, "%3d%c q=%ld p=%ld ci=%lu%s\n",
+		   rdp->cpu, cpu_is_offline(rdp->cpu) ? '!' : ' ',
+		   atomic_long_read(&rdp->nocb_q_count),
+		   ACCESS_ONCE(rdp->nocb_p_count),
+		   ACCESS_ONCE(rdp->n_nocb_invoked),
+		   ACCESS_ONCE(rdp->nocb_defer_wakeup) ? " W" : "");
+}
+
+static int show_rcu_nocb(struct seq_file *m, void *unused)
+{
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	seq_puts(m, "rcu_preempt:\n");
+	PRINT_RCU_DATA(rcu_preempt_data, print_one_rcu_nocb, m);
+#endif 
+	seq_puts(m, "rcu_sched:\n");
+	PRINT_RCU_DATA(rcu_sched_data, print_one_rcu_nocb, m);
+	seq_puts(m, "rcu_bh:\n");
+	PRINT_RCU_DATA(rcu_bh_data, print_one_rcu_nocb, m);
+	return 0;
+}
+
+static int rcu_nocb_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_rcu_nocb, NULL);
+}
+
+static const struct file_operations rcu_nocb_fops = {
+	.owner = THIS_MODULE,
+	.open = rcu_nocb_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int rcu_nocb_trace_create_file(struct dentry *rcudir)
+{
+	return !debugfs_create_file("rcu_nocb", 0444, rcudir, NULL,
+				    &rcu_nocb_fops);
+}
+
+#else 
+
+static int rcu_nocb_trace_create_file(struct dentry *rcudir)
+{
+	return 0;
+}
+
+#endif 
+
 static int show_rcutorture(struct seq_file *m, void *unused)
 {
 	seq_printf(m, "rcutorture test sequence: %lu %s\n",
@@ -481,6 +548,9 @@ static int __init rcutree_trace_init(void)
 						NULL, &rcutorture_fops);
 	if (!retval)
 		goto free_out;
+
+	if (rcu_nocb_trace_create_file(rcudir))
+		goto free_out;
 	return 0;
 free_out:
 	debugfs_remove_recursive(rcudir);
@@ -36,6 +36,7 @@
 #include <linux/interrupt.h>
 #include <linux/capability.h>
 #include <linux/completion.h>
+#include <linux/cpufreq_times.h>
 #include <linux/kernel_stat.h>
 #include <linux/debug_locks.h>
 #include <linux/perf_event.h>
@@ -927,6 +928,8 @@ void set_task_cpu(struct task_struct *p, unsigned int new_cpu)
 	trace_sched_migrate_task(p, new_cpu);
 
 	if (task_cpu(p) != new_cpu) {
+		if (p->sched_class->migrate_task_rq)
+			p->sched_class->migrate_task_rq(p, new_cpu);
 		p->se.nr_migrations++;
 		perf_sw_event(PERF_COUNT_SW_CPU_MIGRATIONS, 1, NULL, 0);
 	}
@@ -1364,6 +1367,10 @@ static void __sched_fork(struct task_struct *p)
 	p->se.vruntime			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
 
+#ifdef CONFIG_SMP
+	memset(&p->se.avg, 0, sizeof(p->se.avg));
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
@@ -1438,6 +1445,7 @@ void wake_up_new_task(struct task_struct *p)
 #endif
 
 	rq = __task_rq_lock(p);
+	init_task_runnable_average(p);
 	activate_task(rq, p, 0);
 	p->on_rq = 1;
 	trace_sched_wakeup_new(p, true);
@@ -2036,6 +2044,8 @@ void account_user_time(struct task_struct *p, cputime_t cputime,
 
 	
 	acct_update_integrals(p);
+
+	cpufreq_acct_update_power(p, cputime);
 }
 
 static void account_guest_time(struct task_struct *p, cputime_t cputime,
@@ -2073,6 +2083,8 @@ void __account_system_time(struct task_struct *p, cputime_t cputime,
 
 	
 	acct_update_integrals(p);
+
+	cpufreq_acct_update_power(p, cputime);
 }
 
 void account_system_time(struct task_struct *p, int hardirq_offset,
@@ -4567,6 +4579,7 @@ cpu_attach_domain(struct sched_domain *sd, struct root_domain *rd, int cpu)
 	destroy_sched_domains(tmp, cpu);
 
 	update_top_cache_domain(cpu);
+	update_packing_domain(cpu);
 }
 
 static cpumask_var_t cpu_isolated_map;
@@ -5575,6 +5588,7 @@ void __init sched_init(void)
 		rq->online = 0;
 		rq->idle_stamp = 0;
 		rq->avg_idle = 2*sysctl_sched_migration_cost;
+		per_cpu(sd_pack_buddy, i) = -1;
 
 		INIT_LIST_HEAD(&rq->cfs_tasks);
 
@@ -91,6 +91,10 @@ struct task_group {
 	unsigned long shares;
 
 	atomic_t load_weight;
+#ifdef CONFIG_SMP
+	atomic64_t load_avg;
+	atomic_t runnable_avg;
+#endif
 #endif
 
 #ifdef CONFIG_RT_GROUP_SCHED
@@ -179,6 +183,13 @@ struct cfs_rq {
 	unsigned int nr_spread_over;
 #endif
 
+#ifdef CONFIG_SMP
+	unsigned long runnable_load_avg, blocked_load_avg;
+	unsigned long utilization_load_avg;
+	atomic64_t decay_counter, removed_load;
+	u64 last_decay;
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct rq *rq;	
 
@@ -194,6 +205,9 @@ struct cfs_rq {
 	u64 load_stamp, load_last, load_unacc_exec_time;
 
 	unsigned long load_contribution;
+
+	u32 tg_runnable_contrib;
+	u64 tg_load_contrib;
 #endif 
 #ifdef CONFIG_CFS_BANDWIDTH
 	int runtime_enabled;
@@ -324,6 +338,8 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+	struct sched_avg avg;
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -416,6 +432,10 @@ static inline struct sched_domain *highest_flag_domain(int cpu, int flag)
 DECLARE_PER_CPU(struct sched_domain *, sd_llc);
 DECLARE_PER_CPU(int, sd_llc_id);
 
+DECLARE_PER_CPU(int, sd_pack_buddy);
+
+extern void update_packing_domain(int cpu);
+
 #endif 
 
 #include "stats.h"
@@ -682,12 +702,51 @@ extern const struct sched_class idle_sched_class;
 extern void trigger_load_balance(struct rq *rq, int cpu);
 extern void idle_balance(int this_cpu, struct rq *this_rq);
 
+extern void idle_enter_fair(struct rq *this_rq);
+extern void idle_exit_fair(struct rq *this_rq);
+extern void init_task_runnable_average(struct task_struct *p);
+
 #else	
 
 static inline void idle_balance(int cpu, struct rq *rq)
 {
 }
 
+static inline void idle_enter_fair(struct rq *this_rq)
+{
+}
+
+static inline void idle_exit_fair(struct rq *this_rq)
+{
+}
+
+static inline void init_task_runnable_average(struct task_struct *p)
+{
+}
+
+#endif
+
+#ifdef CONFIG_CPU_FREQ
+DECLARE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
+
+/*
+ * Report the current utilization of @rq to the cpufreq governor, if one
+ * has registered for it. Only the local rq is reported, remote enqueues
+ * are picked up on that cpu's next tick.
+ */
+static inline void cpufreq_update_util(struct rq *rq, unsigned long util)
+{
+	struct update_util_data *data;
+
+	if (cpu_of(rq) != smp_processor_id())
+		return;
+
+	data = rcu_dereference_sched(*this_cpu_ptr(&cpufreq_update_util_data));
+	if (data)
+		data->func(data, rq->clock, util, SCHED_POWER_SCALE);
+}
+#else
+static inline void cpufreq_update_util(struct rq *rq, unsigned long util) {}
 #endif
 
 #ifdef CONFIG_SYSRQ_SCHED_DEBUG
@@ -0,0 +1,162 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * Compressor producing the LZ4 block format described at
+ * http://code.google.com/p/lz4/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+#define SKIP_STRENGTH	6
+
+static inline u32 lz4_hash(u32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static inline unsigned char *lz4_put_length(unsigned char *op, size_t len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char)len;
+	return op;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	u32 *hash_table = wrkmem;
+	const unsigned char *ip = src;
+	const unsigned char *anchor = src;
+	const unsigned char *const iend = src + src_len;
+	const unsigned char *const mflimit = iend - MFLIMIT;
+	const unsigned char *const matchlimit = iend - LASTLITERALS;
+	const unsigned char *ref;
+	unsigned char *op = dst;
+	unsigned char *token;
+	size_t len;
+	u32 h;
+
+	/* the hash table stores 32 bit offsets from src */
+	if (src_len > 0x7fffffffUL)
+		return -EINVAL;
+
+	if (src_len < MINLENGTH)
+		goto last_literals;
+
+	memset(hash_table, 0, LZ4_MEM_COMPRESS);
+	hash_table[lz4_hash(LZ4_READ32(ip))] = 0;
+	ip++;
+
+	for (;;) {
+		unsigned int attempts = 1U << SKIP_STRENGTH;
+
+		/* find a match */
+		for (;;) {
+			h = lz4_hash(LZ4_READ32(ip));
+			ref = src + hash_table[h];
+			hash_table[h] = ip - src;
+			if (ref < ip && ip - ref <= MAX_DISTANCE &&
+			    LZ4_READ32(ref) == LZ4_READ32(ip))
+				break;
+			ip += attempts++ >> SKIP_STRENGTH;
+			if (unlikely(ip > mflimit))
+				goto last_literals;
+		}
+
+		/* catch up */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		/* encode literal length */
+		len = ip - anchor;
+		token = op++;
+		if (len >= RUN_MASK) {
+			*token = RUN_MASK << ML_BITS;
+			op = lz4_put_length(op, len - RUN_MASK);
+		} else {
+			*token = len << ML_BITS;
+		}
+		memcpy(op, anchor, len);
+		op += len;
+
+next_match:
+		/* encode offset */
+		put_unaligned_le16(ip - ref, op);
+		op += 2;
+
+		/* start counting */
+		ip += MINMATCH;
+		ref += MINMATCH;
+		anchor = ip;
+		while (ip < matchlimit && *ip == *ref) {
+			ip++;
+			ref++;
+		}
+
+		/* encode match length */
+		len = ip - anchor;
+		if (len >= ML_MASK) {
+			*token += ML_MASK;
+			op = lz4_put_length(op, len - ML_MASK);
+		} else {
+			*token += len;
+		}
+		anchor = ip;
+
+		/* test end of chunk */
+		if (ip > mflimit)
+			break;
+
+		/* fill table */
+		hash_table[lz4_hash(LZ4_READ32(ip - 2))] = ip - 2 - src;
+
+		/* test next position */
+		h = lz4_hash(LZ4_READ32(ip));
+		ref = src + hash_table[h];
+		hash_table[h] = ip - src;
+		if (ref < ip && ip - ref <= MAX_DISTANCE &&
+		    LZ4_READ32(ref) == LZ4_READ32(ip)) {
+			token = op++;
+			*token = 0;
+			goto next_match;
+		}
+
+		/* prepare next loop */
+		ip++;
+		if (ip > mflimit)
+			break;
+	}
+
+last_literals:
+	len = iend - anchor;
+	token = op++;
+	if (len >= RUN_MASK) {
+		*token = RUN_MASK << ML_BITS;
+		op = lz4_put_length(op, len - RUN_MASK);
+	} else {
+		*token = len << ML_BITS;
+	}
+	memcpy(op, anchor, len);
+	op += len;
+
+	*dst_len = op - dst;
+	return 0;
+}
+EXPORT_SYMBOL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 compressor");
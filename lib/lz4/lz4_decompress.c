@@ -0,0 +1,158 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * Decompressor for the LZ4 block format described at
+ * http://code.google.com/p/lz4/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+static inline int lz4_get_length(const unsigned char **ipp,
+		const unsigned char *iend, size_t *len)
+{
+	const unsigned char *ip = *ipp;
+	unsigned int s;
+
+	do {
+		if (unlikely(ip >= iend))
+			return -1;
+		s = *ip++;
+		*len += s;
+	} while (s == 255);
+
+	*ipp = ip;
+	return 0;
+}
+
+/*
+ * Decode at most 'osize' bytes. Every literal run and match is checked
+ * against both buffers, so malformed input can never read or write out
+ * of bounds. If 'src_end' is given the output size is known exactly and
+ * decoding stops once it is reached, reporting where the stream ended.
+ * Returns the number of bytes produced, or < 0 on error.
+ */
+static int lz4_uncompress_safe(const unsigned char *source,
+		const unsigned char **src_end, size_t isize,
+		unsigned char *dest, size_t osize)
+{
+	const unsigned char *ip = source;
+	const unsigned char *const iend = ip + isize;
+	const unsigned char *ref;
+	unsigned char *op = dest;
+	unsigned char *const oend = op + osize;
+	unsigned int token;
+	size_t length, offset;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		/* get run length */
+		length = token >> ML_BITS;
+		if (length == RUN_MASK && lz4_get_length(&ip, iend, &length))
+			goto _output_error;
+
+		/* copy literals */
+		if (unlikely(length > (size_t)(iend - ip) ||
+			     length > (size_t)(oend - op)))
+			goto _output_error;
+		memcpy(op, ip, length);
+		op += length;
+		ip += length;
+
+		/* the last sequence carries literals only */
+		if (ip == iend || (src_end && op == oend))
+			break;
+
+		/* get offset */
+		if (unlikely(iend - ip < 2))
+			goto _output_error;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (unlikely(offset == 0 || offset > (size_t)(op - dest)))
+			goto _output_error;
+		ref = op - offset;
+
+		/* get match length */
+		length = token & ML_MASK;
+		if (length == ML_MASK && lz4_get_length(&ip, iend, &length))
+			goto _output_error;
+		length += MINMATCH;
+		if (unlikely(length > (size_t)(oend - op)))
+			goto _output_error;
+
+		/* copy repeated sequence */
+		if (offset >= length) {
+			memcpy(op, ref, length);
+			op += length;
+		} else if (offset >= COPYLENGTH) {
+			unsigned char *const cpy = op + length;
+
+			while (cpy - op >= COPYLENGTH) {
+				LZ4_COPY8(op, ref);
+				op += COPYLENGTH;
+				ref += COPYLENGTH;
+			}
+			while (op < cpy)
+				*op++ = *ref++;
+		} else {
+			while (length--)
+				*op++ = *ref++;
+		}
+	}
+
+	if (src_end)
+		*src_end = ip;
+	return op - dest;
+
+	/* write overflow error detected */
+_output_error:
+	return -1;
+}
+
+int lz4_decompress(const unsigned char *src, size_t *src_len,
+		unsigned char *dest, size_t actual_dest_len)
+{
+	const unsigned char *src_end;
+	int ret;
+
+	ret = lz4_uncompress_safe(src, &src_end, *src_len, dest,
+			actual_dest_len);
+	if (ret < 0 || (size_t)ret != actual_dest_len)
+		return -1;
+
+	*src_len = src_end - src;
+	return 0;
+}
+#ifndef STATIC
+EXPORT_SYMBOL(lz4_decompress);
+#endif
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	int ret;
+
+	ret = lz4_uncompress_safe(src, NULL, src_len, dest, *dest_len);
+	if (ret < 0)
+		return -1;
+
+	*dest_len = ret;
+	return 0;
+}
+#ifndef STATIC
+EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+#endif
@@ -0,0 +1,26 @@
+/*
+ * lz4defs.h -- architecture specific defines
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <asm/unaligned.h>
+
+#define MINMATCH		4
+#define COPYLENGTH		8
+#define LASTLITERALS		5
+#define MFLIMIT			(COPYLENGTH + MINMATCH)
+#define MINLENGTH		(MFLIMIT + 1)
+
+#define MAX_DISTANCE		((1 << 16) - 1)
+
+#define ML_BITS			4
+#define ML_MASK			((1U << ML_BITS) - 1)
+#define RUN_BITS		(8 - ML_BITS)
+#define RUN_MASK		((1U << RUN_BITS) - 1)
+
+#define LZ4_READ32(p)		get_unaligned((const u32 *)(p))
+#define LZ4_COPY8(d, s)		\
+	put_unaligned(get_unaligned((const u64 *)(s)), (u64 *)(d))
@@ -0,0 +1,166 @@
+/*
+ * Workqueue wakeup benchmark
+ *
+ * Keeps one self-rearming delayed work per online cpu going, either on
+ * system_wq or on system_power_efficient_wq, and counts on which cpus the
+ * work ran. Driven from debugfs:
+ *
+ *   echo "percpu 10" > /sys/kernel/debug/wq_power_bench/run
+ *   echo "power 10" > /sys/kernel/debug/wq_power_bench/run
+ *   cat /sys/kernel/debug/wq_power_bench/stats
+ *
+ * A write blocks until the run is over. tools/testing/selftests/workqueue
+ * reads the cpuidle statistics around the runs.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#include <linux/cpu.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+
+static unsigned int period_ms = 20;
+module_param(period_ms, uint, 0644);
+
+static DEFINE_PER_CPU(struct delayed_work, bench_works);
+static DEFINE_PER_CPU(unsigned long, bench_runs);
+static DEFINE_MUTEX(bench_lock);
+
+static struct workqueue_struct *bench_wq;
+static const char *bench_mode = "none";
+static unsigned int bench_seconds;
+static bool bench_stop;
+static struct dentry *bench_dir;
+
+static void bench_work_fn(struct work_struct *work)
+{
+	this_cpu_inc(bench_runs);
+	if (ACCESS_ONCE(bench_stop))
+		return;
+	queue_delayed_work(bench_wq, to_delayed_work(work),
+			   msecs_to_jiffies(period_ms));
+}
+
+static void bench_run(struct workqueue_struct *wq, unsigned int seconds)
+{
+	unsigned int cpu;
+
+	bench_wq = wq;
+	bench_stop = false;
+	for_each_possible_cpu(cpu) {
+		per_cpu(bench_runs, cpu) = 0;
+		INIT_DELAYED_WORK(&per_cpu(bench_works, cpu), bench_work_fn);
+	}
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		queue_delayed_work_on(cpu, wq, &per_cpu(bench_works, cpu),
+				      msecs_to_jiffies(period_ms));
+	put_online_cpus();
+
+	msleep_interruptible(seconds * MSEC_PER_SEC);
+
+	ACCESS_ONCE(bench_stop) = true;
+	for_each_possible_cpu(cpu)
+		cancel_delayed_work_sync(&per_cpu(bench_works, cpu));
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *ubuf,
+			       size_t count, loff_t *ppos)
+{
+	struct workqueue_struct *wq;
+	char buf[32], mode[16];
+	unsigned int seconds = 10;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%15s %u", mode, &seconds) < 1 || !seconds)
+		return -EINVAL;
+	if (!strcmp(mode, "percpu"))
+		wq = system_wq;
+	else if (!strcmp(mode, "power"))
+		wq = system_power_efficient_wq;
+	else
+		return -EINVAL;
+
+	mutex_lock(&bench_lock);
+	bench_mode = wq == system_wq ? "percpu" : "power";
+	bench_seconds = seconds;
+	bench_run(wq, seconds);
+	mutex_unlock(&bench_lock);
+	return count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.owner = THIS_MODULE,
+	.write = bench_run_write,
+	.llseek = noop_llseek,
+};
+
+static int bench_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned long total = 0;
+	unsigned int cpu;
+
+	mutex_lock(&bench_lock);
+	seq_printf(m, "mode: %s\nseconds: %u\nperiod_ms: %u\n", bench_mode,
+		   bench_seconds, period_ms);
+	for_each_possible_cpu(cpu) {
+		seq_printf(m, "cpu%u: %lu\n", cpu, per_cpu(bench_runs, cpu));
+		total += per_cpu(bench_runs, cpu);
+	}
+	seq_printf(m, "ran: %lu\n", total);
+	mutex_unlock(&bench_lock);
+	return 0;
+}
+
+static int bench_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_stats_show, NULL);
+}
+
+static const struct file_operations bench_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = bench_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init wq_power_bench_init(void)
+{
+	bench_dir = debugfs_create_dir("wq_power_bench", NULL);
+	if (IS_ERR_OR_NULL(bench_dir))
+		return -ENODEV;
+	if (!debugfs_create_file("run", 0200, bench_dir, NULL,
+				 &bench_run_fops) ||
+	    !debugfs_create_file("stats", 0444, bench_dir, NULL,
+				 &bench_stats_fops)) {
+		debugfs_remove_recursive(bench_dir);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void __exit wq_power_bench_exit(void)
+{
+	debugfs_remove_recursive(bench_dir);
+}
+
+module_init(wq_power_bench_init);
+module_exit(wq_power_bench_exit);
+MODULE_DESCRIPTION("Workqueue wakeup benchmark");
+MODULE_LICENSE("GPL v2");
@@ -49,6 +49,7 @@
 #include <linux/page_cgroup.h>
 #include <linux/cpu.h>
 #include <linux/oom.h>
+#include <linux/vmpressure.h>
 #include "internal.h"
 #include <net/sock.h>
 #include <net/tcp_memcontrol.h>
@@ -226,6 +227,8 @@ struct mem_cgroup {
 	
 	struct list_head oom_notify;
 
+	struct vmpressure vmpressure;
+
 	unsigned long 	move_charge_at_immigrate;
 	atomic_t	moving_account;
 	
@@ -3735,6 +3738,12 @@ static struct cftype mem_cgroup_files[] = {
 		.unregister_event = mem_cgroup_oom_unregister_event,
 		.private = MEMFILE_PRIVATE(_OOM_TYPE, OOM_CONTROL),
 	},
+	{
+		.name = "pressure_level",
+		.mode = S_IRUGO,
+		.register_event = vmpressure_register_event,
+		.unregister_event = vmpressure_unregister_event,
+	},
 #ifdef CONFIG_NUMA
 	{
 		.name = "numa_stat",
@@ -3906,6 +3915,25 @@ struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *memcg)
 }
 EXPORT_SYMBOL(parent_mem_cgroup);
 
+struct vmpressure *memcg_to_vmpressure(struct mem_cgroup *memcg)
+{
+	if (!memcg)
+		memcg = root_mem_cgroup;
+	if (!memcg)
+		return NULL;
+	return &memcg->vmpressure;
+}
+
+struct cgroup *vmpressure_to_cgroup(struct vmpressure *vmpr)
+{
+	return container_of(vmpr, struct mem_cgroup, vmpressure)->css.cgroup;
+}
+
+struct vmpressure *cgroup_to_vmpressure(struct cgroup *cg)
+{
+	return &mem_cgroup_from_cont(cg)->vmpressure;
+}
+
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
 static void __init enable_swap_cgroup(void)
 {
@@ -3998,6 +4026,7 @@ mem_cgroup_create(struct cgroup *cont)
 	}
 	memcg->last_scanned_node = MAX_NUMNODES;
 	INIT_LIST_HEAD(&memcg->oom_notify);
+	vmpressure_init(&memcg->vmpressure);
 
 	if (parent)
 		memcg->swappiness = mem_cgroup_swappiness(parent);
@@ -4024,6 +4053,7 @@ static void mem_cgroup_destroy(struct cgroup *cont)
 
 	kmem_cgroup_destroy(cont);
 
+	cancel_work_sync(&memcg->vmpressure.work);
 	mem_cgroup_put(memcg);
 }
 
@@ -0,0 +1,816 @@
+/*
+ * binder_bench: binder IPC throughput and latency benchmark
+ *
+ * Runs N client/server process pairs over /dev/binder. Every server
+ * publishes a service with the context manager and every client looks up
+ * its own server and then issues synchronous transactions back to back,
+ * timing each round trip. The clients are started together so that the
+ * pairs contend in the driver, which is what the numbers are meant to
+ * show.
+ *
+ * The services are registered with the running servicemanager, which
+ * requires root or the system uid. When no context manager is running the
+ * benchmark becomes its own.
+ *
+ * Usage: binder_bench [-p pairs] [-i iterations] [-s payload bytes]
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "binder.h"
+
+#define BINDER_DEV		"/dev/binder"
+#define MAP_SIZE		(128 * 1024)
+#define MAX_PAIRS		64
+#define MAX_PAYLOAD		(16 * 1024)
+#define MAX_SERVICES		(MAX_PAIRS + 1)
+#define LAT_BUCKETS		10000	/* 1us each, the last one collects the rest */
+
+/* servicemanager protocol */
+#define SVC_MGR_GET_SERVICE	1
+#define SVC_MGR_CHECK_SERVICE	2
+#define SVC_MGR_ADD_SERVICE	3
+#define SVC_MGR_NAME		"android.os.IServiceManager"
+
+#define BENCH_CODE		(('_' << 24) | ('B' << 16) | ('N' << 8) | 'C')
+
+struct bench_binder {
+	int fd;
+	void *map;
+};
+
+struct parcel {
+	uint8_t data[512];
+	size_t offs[4];
+	size_t len;
+	size_t noffs;
+};
+
+struct parcel_reader {
+	const uint8_t *ptr;
+	const uint8_t *end;
+};
+
+struct bench_result {
+	int pair;
+	int errors;
+	unsigned long count;
+	uint64_t elapsed_ns;
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	unsigned int p50_us;
+	unsigned int p90_us;
+	unsigned int p99_us;
+};
+
+typedef int (*bench_handler_t)(struct bench_binder *b,
+			       struct binder_transaction_data *txn);
+
+static int server_node;		/* its address identifies the server node */
+static size_t payload_size = 128;
+static uint8_t reply_payload[MAX_PAYLOAD];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_open(struct bench_binder *b)
+{
+	struct binder_version vers;
+
+	b->fd = open(BINDER_DEV, O_RDWR);
+	if (b->fd < 0) {
+		perror("binder_bench: open " BINDER_DEV);
+		return -1;
+	}
+	if (ioctl(b->fd, BINDER_VERSION, &vers) < 0 ||
+	    vers.protocol_version != BINDER_CURRENT_PROTOCOL_VERSION) {
+		fprintf(stderr, "binder_bench: binder protocol mismatch\n");
+		close(b->fd);
+		return -1;
+	}
+	b->map = mmap(NULL, MAP_SIZE, PROT_READ, MAP_PRIVATE, b->fd, 0);
+	if (b->map == MAP_FAILED) {
+		perror("binder_bench: mmap");
+		close(b->fd);
+		return -1;
+	}
+	return 0;
+}
+
+static int bench_write(struct bench_binder *b, const void *data, size_t len)
+{
+	struct binder_write_read bwr;
+
+	memset(&bwr, 0, sizeof(bwr));
+	bwr.write_size = len;
+	bwr.write_buffer = (unsigned long)data;
+	if (ioctl(b->fd, BINDER_WRITE_READ, &bwr) < 0) {
+		perror("binder_bench: write");
+		return -1;
+	}
+	return 0;
+}
+
+static int bench_write_cmd(struct bench_binder *b, uint32_t cmd, uint32_t arg)
+{
+	uint32_t wr[2] = { cmd, arg };
+
+	return bench_write(b, wr, sizeof(wr));
+}
+
+static int bench_free(struct bench_binder *b, const void *buffer)
+{
+	struct {
+		uint32_t cmd;
+		const void *buffer;
+	} __attribute__((packed)) wr = { BC_FREE_BUFFER, buffer };
+
+	return bench_write(b, &wr, sizeof(wr));
+}
+
+/* Acknowledges the reference count changes the driver asks us to take. */
+static int bench_node_cmd(struct bench_binder *b, uint32_t cmd,
+			  void *ptr, void *cookie)
+{
+	struct {
+		uint32_t cmd;
+		void *ptr;
+		void *cookie;
+	} __attribute__((packed)) wr = { 0, ptr, cookie };
+
+	if (cmd == BR_INCREFS)
+		wr.cmd = BC_INCREFS_DONE;
+	else if (cmd == BR_ACQUIRE)
+		wr.cmd = BC_ACQUIRE_DONE;
+	else
+		return 0;
+	return bench_write(b, &wr, sizeof(wr));
+}
+
+static int bench_reply(struct bench_binder *b,
+		       struct binder_transaction_data *txn,
+		       const void *data, size_t len,
+		       const size_t *offs, size_t noffs)
+{
+	struct {
+		uint32_t cmd_free;
+		const void *buffer;
+		uint32_t cmd_reply;
+		struct binder_transaction_data tr;
+	} __attribute__((packed)) wr;
+
+	memset(&wr, 0, sizeof(wr));
+	wr.cmd_free = BC_FREE_BUFFER;
+	wr.buffer = txn->data.ptr.buffer;
+	wr.cmd_reply = BC_REPLY;
+	wr.tr.data_size = len;
+	wr.tr.offsets_size = noffs * sizeof(size_t);
+	wr.tr.data.ptr.buffer = data;
+	wr.tr.data.ptr.offsets = offs;
+	return bench_write(b, &wr, sizeof(wr));
+}
+
+/*
+ * Handles the commands in a read buffer. Reference count requests are
+ * acknowledged, incoming transactions are passed to handler and a reply
+ * is copied to *reply. Returns 1 once a reply was found, 0 if more has to
+ * be read and -1 on error.
+ */
+static int bench_parse(struct bench_binder *b, const void *buf, size_t size,
+		       struct binder_transaction_data *reply,
+		       bench_handler_t handler)
+{
+	const uint8_t *ptr = buf;
+	const uint8_t *end = ptr + size;
+
+	while (ptr < end) {
+		uint32_t cmd = *(const uint32_t *)ptr;
+
+		ptr += sizeof(uint32_t);
+		switch (cmd) {
+		case BR_NOOP:
+		case BR_TRANSACTION_COMPLETE:
+		case BR_SPAWN_LOOPER:
+			break;
+		case BR_INCREFS:
+		case BR_ACQUIRE:
+		case BR_RELEASE:
+		case BR_DECREFS: {
+			void *node_ptr = ((void * const *)ptr)[0];
+			void *cookie = ((void * const *)ptr)[1];
+
+			ptr += 2 * sizeof(void *);
+			if (bench_node_cmd(b, cmd, node_ptr, cookie))
+				return -1;
+			break;
+		}
+		case BR_DEAD_BINDER:
+		case BR_CLEAR_DEATH_NOTIFICATION_DONE:
+			ptr += sizeof(void *);
+			break;
+		case BR_TRANSACTION: {
+			struct binder_transaction_data txn;
+
+			memcpy(&txn, ptr, sizeof(txn));
+			ptr += sizeof(txn);
+			if (handler == NULL || handler(b, &txn))
+				return -1;
+			break;
+		}
+		case BR_REPLY:
+			if (reply == NULL)
+				return -1;
+			memcpy(reply, ptr, sizeof(*reply));
+			ptr += sizeof(*reply);
+			return 1;
+		case BR_DEAD_REPLY:
+		case BR_FAILED_REPLY:
+			fprintf(stderr, "binder_bench: transaction failed\n");
+			return -1;
+		default:
+			fprintf(stderr, "binder_bench: unexpected command %x\n",
+				cmd);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Sends a transaction to handle and waits for the reply, which the caller
+ * has to release with BC_FREE_BUFFER. To save a system call per round
+ * trip, the previous reply can be released along with the transaction by
+ * passing it as free_buf.
+ */
+static int bench_call(struct bench_binder *b, uint32_t handle, uint32_t code,
+		      const void *data, size_t len,
+		      const size_t *offs, size_t noffs,
+		      const void *free_buf,
+		      struct binder_transaction_data *reply)
+{
+	struct {
+		uint32_t cmd_free;
+		const void *buffer;
+		uint32_t cmd;
+		struct binder_transaction_data tr;
+	} __attribute__((packed)) wr;
+	uint32_t rbuf[64];
+	struct binder_write_read bwr;
+	int ret;
+
+	memset(&wr, 0, sizeof(wr));
+	wr.cmd_free = BC_FREE_BUFFER;
+	wr.buffer = free_buf;
+	wr.cmd = BC_TRANSACTION;
+	wr.tr.target.handle = handle;
+	wr.tr.code = code;
+	wr.tr.flags = TF_ACCEPT_FDS;
+	wr.tr.data_size = len;
+	wr.tr.offsets_size = noffs * sizeof(size_t);
+	wr.tr.data.ptr.buffer = data;
+	wr.tr.data.ptr.offsets = offs;
+
+	memset(&bwr, 0, sizeof(bwr));
+	if (free_buf) {
+		bwr.write_buffer = (unsigned long)&wr;
+		bwr.write_size = sizeof(wr);
+	} else {
+		bwr.write_buffer = (unsigned long)&wr.cmd;
+		bwr.write_size = sizeof(wr) - offsetof(typeof(wr), cmd);
+	}
+	do {
+		bwr.read_size = sizeof(rbuf);
+		bwr.read_consumed = 0;
+		bwr.read_buffer = (unsigned long)rbuf;
+		if (ioctl(b->fd, BINDER_WRITE_READ, &bwr) < 0) {
+			perror("binder_bench: transaction");
+			return -1;
+		}
+		ret = bench_parse(b, rbuf, bwr.read_consumed, reply, NULL);
+	} while (ret == 0);
+
+	return ret < 0 ? -1 : 0;
+}
+
+static int bench_loop(struct bench_binder *b, bench_handler_t handler)
+{
+	uint32_t rbuf[64];
+	struct binder_write_read bwr;
+	uint32_t cmd = BC_ENTER_LOOPER;
+
+	if (bench_write(b, &cmd, sizeof(cmd)))
+		return -1;
+	memset(&bwr, 0, sizeof(bwr));
+	for (;;) {
+		bwr.read_size = sizeof(rbuf);
+		bwr.read_consumed = 0;
+		bwr.read_buffer = (unsigned long)rbuf;
+		if (ioctl(b->fd, BINDER_WRITE_READ, &bwr) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("binder_bench: looper");
+			return -1;
+		}
+		if (bench_parse(b, rbuf, bwr.read_consumed, NULL, handler) < 0)
+			return -1;
+	}
+}
+
+static void *parcel_alloc(struct parcel *p, size_t len)
+{
+	void *ptr;
+
+	len = (len + 3) & ~3;
+	if (p->len + len > sizeof(p->data)) {
+		fprintf(stderr, "binder_bench: parcel overflow\n");
+		exit(1);
+	}
+	ptr = p->data + p->len;
+	memset(ptr, 0, len);
+	p->len += len;
+	return ptr;
+}
+
+static void parcel_put_u32(struct parcel *p, uint32_t val)
+{
+	*(uint32_t *)parcel_alloc(p, sizeof(val)) = val;
+}
+
+static void parcel_put_string16(struct parcel *p, const char *str)
+{
+	size_t i, len = strlen(str);
+	uint16_t *dst;
+
+	parcel_put_u32(p, len);
+	dst = parcel_alloc(p, (len + 1) * sizeof(uint16_t));
+	for (i = 0; i < len; i++)
+		dst[i] = (unsigned char)str[i];
+}
+
+static void parcel_put_obj(struct parcel *p,
+			   const struct flat_binder_object *obj)
+{
+	p->offs[p->noffs++] = p->len;
+	memcpy(parcel_alloc(p, sizeof(*obj)), obj, sizeof(*obj));
+}
+
+/* Every request to the context manager starts with the interface token. */
+static void parcel_init_svcmgr(struct parcel *p, const char *name)
+{
+	memset(p, 0, sizeof(*p));
+	parcel_put_u32(p, 0);	/* strict mode policy */
+	parcel_put_string16(p, SVC_MGR_NAME);
+	parcel_put_string16(p, name);
+}
+
+static int parcel_get_u32(struct parcel_reader *r, uint32_t *val)
+{
+	if (r->end - r->ptr < (long)sizeof(*val))
+		return -1;
+	*val = *(const uint32_t *)r->ptr;
+	r->ptr += sizeof(*val);
+	return 0;
+}
+
+static int parcel_get_string16(struct parcel_reader *r, char *buf,
+			       size_t size)
+{
+	const uint16_t *src;
+	uint32_t i, len;
+
+	if (parcel_get_u32(r, &len) || len >= size)
+		return -1;
+	if (r->end - r->ptr < (long)((len + 1) * sizeof(uint16_t)))
+		return -1;
+	src = (const uint16_t *)r->ptr;
+	for (i = 0; i < len; i++)
+		buf[i] = src[i] < 0x80 ? src[i] : '?';
+	buf[len] = '\0';
+	r->ptr += ((len + 1) * sizeof(uint16_t) + 3) & ~3;
+	return 0;
+}
+
+static const struct flat_binder_object *
+txn_first_obj(const struct binder_transaction_data *txn)
+{
+	const size_t *offs = txn->data.ptr.offsets;
+
+	if (txn->offsets_size < sizeof(size_t) ||
+	    offs[0] + sizeof(struct flat_binder_object) > txn->data_size)
+		return NULL;
+	return (const void *)((const uint8_t *)txn->data.ptr.buffer + offs[0]);
+}
+
+static int svcmgr_add(struct bench_binder *b, const char *name)
+{
+	struct flat_binder_object obj;
+	struct binder_transaction_data reply;
+	struct parcel p;
+	int ret;
+
+	parcel_init_svcmgr(&p, name);
+	memset(&obj, 0, sizeof(obj));
+	obj.type = BINDER_TYPE_BINDER;
+	obj.flags = 0x7f | FLAT_BINDER_FLAG_ACCEPTS_FDS;
+	obj.binder = &server_node;
+	obj.cookie = &server_node;
+	parcel_put_obj(&p, &obj);
+	parcel_put_u32(&p, 0);	/* allow isolated */
+
+	if (bench_call(b, 0, SVC_MGR_ADD_SERVICE, p.data, p.len,
+		       p.offs, p.noffs, NULL, &reply))
+		return -1;
+	ret = (reply.flags & TF_STATUS_CODE) ||
+	      (reply.data_size >= sizeof(uint32_t) &&
+	       *(const uint32_t *)reply.data.ptr.buffer != 0);
+	bench_free(b, reply.data.ptr.buffer);
+	if (ret)
+		fprintf(stderr, "binder_bench: %s: registration refused\n",
+			name);
+	return ret ? -1 : 0;
+}
+
+/* Returns a strong reference to the service, or 0 if it is not there. */
+static uint32_t svcmgr_lookup(struct bench_binder *b, const char *name)
+{
+	const struct flat_binder_object *obj;
+	struct binder_transaction_data reply;
+	struct parcel p;
+	uint32_t handle = 0;
+
+	parcel_init_svcmgr(&p, name);
+	if (bench_call(b, 0, SVC_MGR_CHECK_SERVICE, p.data, p.len,
+		       p.offs, p.noffs, NULL, &reply))
+		return 0;
+	obj = txn_first_obj(&reply);
+	if (obj && obj->type == BINDER_TYPE_HANDLE && obj->handle) {
+		handle = obj->handle;
+		/* the reply only holds the ref until its buffer is freed */
+		bench_write_cmd(b, BC_ACQUIRE, handle);
+	}
+	bench_free(b, reply.data.ptr.buffer);
+	return handle;
+}
+
+/* The minimal context manager used when servicemanager is not running. */
+static struct {
+	char name[64];
+	uint32_t handle;
+} services[MAX_SERVICES];
+static int nr_services;
+
+static int svcmgr_handler(struct bench_binder *b,
+			  struct binder_transaction_data *txn)
+{
+	struct parcel_reader r;
+	struct parcel p;
+	char name[64];
+	uint32_t status = 0;
+	int i;
+
+	r.ptr = txn->data.ptr.buffer;
+	r.end = r.ptr + txn->data_size;
+	memset(&p, 0, sizeof(p));
+	if (parcel_get_u32(&r, &status) ||
+	    parcel_get_string16(&r, name, sizeof(name)) ||
+	    strcmp(name, SVC_MGR_NAME) ||
+	    parcel_get_string16(&r, name, sizeof(name))) {
+		status = (uint32_t)-EINVAL;
+		goto out;
+	}
+
+	switch (txn->code) {
+	case SVC_MGR_GET_SERVICE:
+	case SVC_MGR_CHECK_SERVICE: {
+		struct flat_binder_object obj;
+
+		memset(&obj, 0, sizeof(obj));
+		obj.type = BINDER_TYPE_BINDER;
+		for (i = 0; i < nr_services; i++) {
+			if (!strcmp(services[i].name, name)) {
+				obj.type = BINDER_TYPE_HANDLE;
+				obj.flags = 0x7f | FLAT_BINDER_FLAG_ACCEPTS_FDS;
+				obj.handle = services[i].handle;
+				break;
+			}
+		}
+		parcel_put_obj(&p, &obj);
+		return bench_reply(b, txn, p.data, p.len, p.offs, p.noffs);
+	}
+	case SVC_MGR_ADD_SERVICE: {
+		const struct flat_binder_object *obj = txn_first_obj(txn);
+
+		if (obj == NULL || obj->type != BINDER_TYPE_HANDLE ||
+		    nr_services == MAX_SERVICES) {
+			status = (uint32_t)-EINVAL;
+			break;
+		}
+		strcpy(services[nr_services].name, name);
+		services[nr_services].handle = obj->handle;
+		nr_services++;
+		bench_write_cmd(b, BC_ACQUIRE, obj->handle);
+		status = 0;
+		break;
+	}
+	default:
+		status = (uint32_t)-EINVAL;
+		break;
+	}
+out:
+	parcel_put_u32(&p, status);
+	return bench_reply(b, txn, p.data, p.len, NULL, 0);
+}
+
+static int server_handler(struct bench_binder *b,
+			  struct binder_transaction_data *txn)
+{
+	size_t len = txn->data_size;
+
+	if (txn->code != BENCH_CODE)
+		len = 0;
+	if (len > sizeof(reply_payload))
+		len = sizeof(reply_payload);
+	return bench_reply(b, txn, reply_payload, len, NULL, 0);
+}
+
+static unsigned int lat_percentile(const unsigned int *hist,
+				   unsigned long count, unsigned int pct)
+{
+	unsigned long want = (count * pct + 99) / 100;
+	unsigned long seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= want)
+			return i;
+	}
+	return LAT_BUCKETS - 1;
+}
+
+static void run_client(int pair, const char *name, unsigned long iterations,
+		       int ready_fd, int go_fd, int result_fd)
+{
+	static unsigned int hist[LAT_BUCKETS];
+	static uint8_t payload[MAX_PAYLOAD];
+	struct binder_transaction_data reply;
+	struct bench_result res;
+	struct bench_binder b;
+	const void *last = NULL;
+	unsigned long i, warmup = iterations / 10 + 1;
+	uint32_t handle;
+	uint64_t start;
+	char c;
+
+	memset(&res, 0, sizeof(res));
+	res.pair = pair;
+	res.min_ns = UINT64_MAX;
+	if (bench_open(&b) || (handle = svcmgr_lookup(&b, name)) == 0) {
+		fprintf(stderr, "binder_bench: %s: lookup failed\n", name);
+		res.errors = 1;
+		c = 'F';
+		write(ready_fd, &c, 1);
+		write(result_fd, &res, sizeof(res));
+		exit(1);
+	}
+
+	for (i = 0; i < warmup; i++) {
+		if (bench_call(&b, handle, BENCH_CODE, payload, payload_size,
+			       NULL, 0, last, &reply))
+			break;
+		last = reply.data.ptr.buffer;
+	}
+	c = 'R';
+	write(ready_fd, &c, 1);
+	/* the parent closes the pipe to start all clients at once */
+	read(go_fd, &c, 1);
+
+	start = now_ns();
+	for (i = 0; i < iterations; i++) {
+		uint64_t t0 = now_ns(), lat;
+
+		if (bench_call(&b, handle, BENCH_CODE, payload, payload_size,
+			       NULL, 0, last, &reply)) {
+			res.errors++;
+			last = NULL;
+			continue;
+		}
+		lat = now_ns() - t0;
+		last = reply.data.ptr.buffer;
+		res.count++;
+		res.total_ns += lat;
+		if (lat < res.min_ns)
+			res.min_ns = lat;
+		if (lat > res.max_ns)
+			res.max_ns = lat;
+		hist[lat / 1000 < LAT_BUCKETS ? lat / 1000 : LAT_BUCKETS - 1]++;
+	}
+	res.elapsed_ns = now_ns() - start;
+	if (last)
+		bench_free(&b, last);
+
+	res.p50_us = lat_percentile(hist, res.count, 50);
+	res.p90_us = lat_percentile(hist, res.count, 90);
+	res.p99_us = lat_percentile(hist, res.count, 99);
+	write(result_fd, &res, sizeof(res));
+	exit(0);
+}
+
+static void run_server(const char *name, int ready_fd)
+{
+	struct bench_binder b;
+	char c = 'F';
+
+	if (bench_open(&b) || svcmgr_add(&b, name)) {
+		write(ready_fd, &c, 1);
+		exit(1);
+	}
+	c = 'R';
+	write(ready_fd, &c, 1);
+	bench_loop(&b, server_handler);
+	exit(1);
+}
+
+/* Writes 'M' if we are the context manager now, 'S' if there is one. */
+static void run_svcmgr(int ready_fd)
+{
+	struct bench_binder b;
+	char c = 'F';
+
+	if (bench_open(&b)) {
+		write(ready_fd, &c, 1);
+		exit(1);
+	}
+	if (ioctl(b.fd, BINDER_SET_CONTEXT_MGR, 0) < 0) {
+		c = 'S';
+		write(ready_fd, &c, 1);
+		exit(0);
+	}
+	c = 'M';
+	write(ready_fd, &c, 1);
+	bench_loop(&b, svcmgr_handler);
+	exit(1);
+}
+
+static int wait_ready(int fd, int n)
+{
+	int failed = 0;
+	char c;
+
+	while (n--) {
+		if (read(fd, &c, 1) != 1 || c != 'R')
+			failed++;
+	}
+	return failed;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: binder_bench [-p pairs] [-i iterations] [-s payload bytes]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_result res[MAX_PAIRS];
+	pid_t servers[MAX_PAIRS], clients[MAX_PAIRS], svcmgr;
+	int ready[2], go[2], results[2];
+	unsigned long iterations = 10000, total = 0;
+	int pairs = 4, errors = 0;
+	char names[MAX_PAIRS][64];
+	uint64_t start, elapsed;
+	int i, opt;
+	char c;
+
+	while ((opt = getopt(argc, argv, "p:i:s:")) != -1) {
+		switch (opt) {
+		case 'p':
+			pairs = atoi(optarg);
+			break;
+		case 'i':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			payload_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (pairs < 1 || pairs > MAX_PAIRS || iterations == 0 ||
+	    payload_size > MAX_PAYLOAD)
+		usage();
+
+	if (pipe(ready) || pipe(go) || pipe(results)) {
+		perror("binder_bench: pipe");
+		return 1;
+	}
+
+	/* binder state is per open file, so every child opens its own */
+	svcmgr = fork();
+	if (svcmgr == 0)
+		run_svcmgr(ready[1]);
+	if (read(ready[0], &c, 1) != 1 || c == 'F') {
+		fprintf(stderr, "binder_bench: cannot use " BINDER_DEV "\n");
+		return 1;
+	}
+	if (c == 'S') {
+		waitpid(svcmgr, NULL, 0);
+		svcmgr = 0;
+	}
+
+	for (i = 0; i < pairs; i++) {
+		snprintf(names[i], sizeof(names[i]), "binder_bench.%d.%d",
+			 getpid(), i);
+		servers[i] = fork();
+		if (servers[i] == 0)
+			run_server(names[i], ready[1]);
+	}
+	if (wait_ready(ready[0], pairs)) {
+		fprintf(stderr, "binder_bench: servers failed to start\n");
+		errors++;
+		goto out_kill_servers;
+	}
+
+	for (i = 0; i < pairs; i++) {
+		clients[i] = fork();
+		if (clients[i] == 0) {
+			close(go[1]);
+			run_client(i, names[i], iterations,
+				   ready[1], go[0], results[1]);
+		}
+	}
+	close(go[0]);
+	if (wait_ready(ready[0], pairs))
+		errors++;
+
+	start = now_ns();
+	close(go[1]);
+	for (i = 0; i < pairs; i++) {
+		struct bench_result r;
+
+		if (read(results[0], &r, sizeof(r)) != sizeof(r) ||
+		    r.pair < 0 || r.pair >= pairs) {
+			errors++;
+			continue;
+		}
+		res[r.pair] = r;
+	}
+	elapsed = now_ns() - start;
+	for (i = 0; i < pairs; i++)
+		waitpid(clients[i], NULL, 0);
+
+	printf("binder_bench: %d pairs, %lu iterations, %zu byte payload%s\n",
+	       pairs, iterations, payload_size,
+	       svcmgr ? ", private context manager" : "");
+	printf("pair      txn/s   avg us   min us   p50 us   p90 us   p99 us   max us\n");
+	for (i = 0; i < pairs; i++) {
+		struct bench_result *r = &res[i];
+
+		errors += r->errors;
+		if (r->count == 0)
+			continue;
+		total += r->count;
+		printf("%4d %10.1f %8.1f %8.1f %8u %8u %8u %8.1f\n", i,
+		       r->count * 1e9 / r->elapsed_ns,
+		       r->total_ns / 1e3 / r->count, r->min_ns / 1e3,
+		       r->p50_us, r->p90_us, r->p99_us, r->max_ns / 1e3);
+	}
+	printf("total %10.1f txn/s (%lu transactions in %.3f s, %d errors)\n",
+	       total * 1e9 / elapsed, total, elapsed / 1e9, errors);
+
+out_kill_servers:
+	for (i = 0; i < pairs; i++) {
+		kill(servers[i], SIGKILL);
+		waitpid(servers[i], NULL, 0);
+	}
+	if (svcmgr) {
+		kill(svcmgr, SIGKILL);
+		waitpid(svcmgr, NULL, 0);
+	}
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,472 @@
+/*
+ * frame_bench: frame time jank under different cpufreq governors
+ *
+ * Emulates a UI thread rendering at a fixed frame rate: every period a
+ * fixed amount of cpu work is done, with a heavy frame every few frames
+ * and an idle pause now and then so that the governor has to ramp up from
+ * a low frequency again. The same frame sequence is run under each
+ * governor in turn.
+ *
+ * Frame boundaries are written to trace_marker and frame times are taken
+ * from the trace, together with the cpu_frequency events emitted during
+ * the run. A frame that takes longer than the period is counted as jank.
+ * Without debugfs the frames are timed with clock_gettime() instead.
+ *
+ * Needs root to switch governors.
+ *
+ * Usage: frame_bench [-g governor,...] [-n frames] [-p period us]
+ *		      [-w work us] [-b heavy work us] [-e heavy every]
+ *		      [-i idle every] [-d trace dir]
+ *
+ * The amount of work is calibrated in us at the maximum frequency.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CPUS	64
+#define MAX_GOVS	8
+#define MAX_FRAMES	100000
+#define IDLE_PAUSE_US	500000
+#define MARKER		"frame_bench:"
+#define CPUFREQ_SYSFS	"/sys/devices/system/cpu/cpu%d/cpufreq/%s"
+
+static const char *trace_dir = "/sys/kernel/debug/tracing";
+static unsigned int nr_frames = 600;
+static unsigned int period_us = 16667;
+static unsigned int work_us = 4000;
+static unsigned int heavy_us = 12000;
+static unsigned int heavy_every = 10;
+static unsigned int idle_every = 120;
+
+static double loops_per_us;
+static int marker_fd = -1;
+
+struct frame {
+	uint64_t begin_ns;
+	uint64_t end_ns;
+};
+
+static struct frame frames[MAX_FRAMES];
+static struct frame trace_frames[MAX_FRAMES];
+static uint64_t durations[MAX_FRAMES];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int write_file(const char *path, const char *val)
+{
+	int fd = open(path, O_WRONLY | O_TRUNC);
+	ssize_t len = strlen(val);
+
+	if (fd < 0)
+		return -1;
+	if (write(fd, val, len) != len) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	return 0;
+}
+
+static int read_file(const char *path, char *buf, size_t size)
+{
+	int fd = open(path, O_RDONLY);
+	ssize_t len;
+
+	if (fd < 0)
+		return -1;
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len < 0)
+		return -1;
+	buf[len] = '\0';
+	if (len && buf[len - 1] == '\n')
+		buf[len - 1] = '\0';
+	return 0;
+}
+
+static int cpufreq_path(char *path, size_t size, int cpu, const char *file)
+{
+	snprintf(path, size, CPUFREQ_SYSFS, cpu, file);
+	return access(path, F_OK);
+}
+
+static int set_governor(const char *gov)
+{
+	char path[128];
+	int cpu, set = 0;
+
+	for (cpu = 0; cpu < MAX_CPUS; cpu++) {
+		if (cpufreq_path(path, sizeof(path), cpu, "scaling_governor"))
+			continue;
+		if (write_file(path, gov)) {
+			fprintf(stderr, "frame_bench: cpu%d: cannot set %s: %s\n",
+				cpu, gov, strerror(errno));
+			return -1;
+		}
+		set++;
+	}
+	return set ? 0 : -1;
+}
+
+static int governor_available(const char *gov)
+{
+	char path[128], buf[512], *tok, *save;
+
+	if (cpufreq_path(path, sizeof(path), 0,
+			 "scaling_available_governors") ||
+	    read_file(path, buf, sizeof(buf)))
+		return 0;
+	for (tok = strtok_r(buf, " ", &save); tok;
+	     tok = strtok_r(NULL, " ", &save))
+		if (!strcmp(tok, gov))
+			return 1;
+	return 0;
+}
+
+static void trace_write(const char *file, const char *val)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/%s", trace_dir, file);
+	write_file(path, val);
+}
+
+static int trace_start(void)
+{
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/trace_marker", trace_dir);
+	marker_fd = open(path, O_WRONLY);
+	if (marker_fd < 0)
+		return -1;
+
+	trace_write("tracing_on", "0");
+	trace_write("trace", "");
+	trace_write("events/power/cpu_frequency/enable", "1");
+	trace_write("tracing_on", "1");
+	return 0;
+}
+
+static void trace_stop(void)
+{
+	if (marker_fd < 0)
+		return;
+	trace_write("tracing_on", "0");
+	trace_write("events/power/cpu_frequency/enable", "0");
+	close(marker_fd);
+	marker_fd = -1;
+}
+
+static void trace_mark(const char *what, unsigned int frame)
+{
+	char buf[64];
+	int len;
+
+	if (marker_fd < 0)
+		return;
+	len = snprintf(buf, sizeof(buf), MARKER " %s %u\n", what, frame);
+	if (write(marker_fd, buf, len) != len) {
+		close(marker_fd);
+		marker_fd = -1;
+	}
+}
+
+/*
+ * Trace lines look like
+ *   <task>-<pid> [cpu] flags <sec>.<usec>: <event>: <payload>
+ * so the timestamp is the token that ends right before ": <event>".
+ */
+static int trace_timestamp(const char *line, const char *event,
+			   uint64_t *ts)
+{
+	unsigned long sec, usec;
+	const char *p = event;
+
+	while (p > line && p[-1] != ' ')
+		p--;
+	if (sscanf(p, "%lu.%lu:", &sec, &usec) != 2)
+		return -1;
+	*ts = (uint64_t)sec * 1000000000ULL + (uint64_t)usec * 1000;
+	return 0;
+}
+
+struct trace_stats {
+	unsigned int frames;
+	unsigned long transitions;
+	unsigned long min_khz;
+	unsigned long max_khz;
+};
+
+static int trace_parse(struct trace_stats *st)
+{
+	char path[256], line[512];
+	FILE *f;
+
+	memset(st, 0, sizeof(*st));
+	memset(trace_frames, 0, sizeof(trace_frames));
+
+	snprintf(path, sizeof(path), "%s/trace", trace_dir);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		char *ev, what[16];
+		unsigned int frame;
+		unsigned long khz;
+		uint64_t ts;
+
+		if ((ev = strstr(line, ": tracing_mark_write: " MARKER))) {
+			if (trace_timestamp(line, ev, &ts) ||
+			    sscanf(strstr(ev, MARKER) + strlen(MARKER),
+				   "%15s %u", what, &frame) != 2 ||
+			    frame >= nr_frames)
+				continue;
+			if (!strcmp(what, "begin")) {
+				trace_frames[frame].begin_ns = ts;
+			} else if (!strcmp(what, "end")) {
+				trace_frames[frame].end_ns = ts;
+				st->frames++;
+			}
+		} else if ((ev = strstr(line, ": cpu_frequency: "))) {
+			if (sscanf(ev, ": cpu_frequency: state=%lu", &khz) != 1)
+				continue;
+			st->transitions++;
+			if (!st->min_khz || khz < st->min_khz)
+				st->min_khz = khz;
+			if (khz > st->max_khz)
+				st->max_khz = khz;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+static volatile unsigned long spin_sink;
+
+static void spin(unsigned long loops)
+{
+	unsigned long i, x = spin_sink;
+
+	for (i = 0; i < loops; i++)
+		x = x * 1103515245 + 12345;
+	spin_sink = x;
+}
+
+static int calibrate(void)
+{
+	const unsigned long loops = 20000000;
+	uint64_t best = ~0ULL;
+	int i;
+
+	if (governor_available("performance") && set_governor("performance"))
+		return -1;
+	sleep(1);
+	for (i = 0; i < 5; i++) {
+		uint64_t t = now_ns();
+
+		spin(loops);
+		t = now_ns() - t;
+		if (t < best)
+			best = t;
+	}
+	loops_per_us = (double)loops * 1000 / best;
+	return 0;
+}
+
+static void sleep_until(uint64_t ns)
+{
+	struct timespec ts = {
+		.tv_sec = ns / 1000000000ULL,
+		.tv_nsec = ns % 1000000000ULL,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+	       EINTR)
+		;
+}
+
+static void run_frames(void)
+{
+	uint64_t next = now_ns() + 100000000ULL;
+	unsigned int i;
+
+	for (i = 0; i < nr_frames; i++) {
+		unsigned int us = work_us;
+
+		if (idle_every && i && i % idle_every == 0)
+			next += (uint64_t)IDLE_PAUSE_US * 1000;
+		if (heavy_every && i % heavy_every == 0)
+			us = heavy_us;
+
+		sleep_until(next);
+		frames[i].begin_ns = now_ns();
+		trace_mark("begin", i);
+		spin((unsigned long)(us * loops_per_us));
+		trace_mark("end", i);
+		frames[i].end_ns = now_ns();
+
+		next += (uint64_t)period_us * 1000;
+		/* a late frame skips the vsyncs it missed, like a real UI */
+		while (next < frames[i].end_ns)
+			next += (uint64_t)period_us * 1000;
+	}
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report(const char *gov, const struct frame *fr,
+		   const char *source, const struct trace_stats *st)
+{
+	unsigned int i, n = 0, jank = 0;
+	uint64_t sum = 0;
+
+	for (i = 0; i < nr_frames; i++) {
+		if (!fr[i].begin_ns || fr[i].end_ns < fr[i].begin_ns)
+			continue;
+		durations[n] = fr[i].end_ns - fr[i].begin_ns;
+		if (durations[n] > (uint64_t)period_us * 1000)
+			jank++;
+		sum += durations[n++];
+	}
+	if (!n) {
+		printf("%-12s no frames recorded\n", gov);
+		return;
+	}
+	qsort(durations, n, sizeof(durations[0]), cmp_u64);
+
+	printf("%-12s %6u %6u %6.2f%% %8llu %8llu %8llu %8llu  %-6s",
+	       gov, n, jank, 100.0 * jank / n,
+	       (unsigned long long)(sum / n / 1000),
+	       (unsigned long long)(durations[n * 90 / 100] / 1000),
+	       (unsigned long long)(durations[n * 99 / 100] / 1000),
+	       (unsigned long long)(durations[n - 1] / 1000), source);
+	if (st)
+		printf(" %8lu %8lu-%lu", st->transitions, st->min_khz,
+		       st->max_khz);
+	printf("\n");
+}
+
+static int run_governor(const char *gov)
+{
+	struct trace_stats st;
+	int traced;
+
+	if (!governor_available(gov)) {
+		printf("%-12s not available, skipped\n", gov);
+		return 0;
+	}
+	if (set_governor(gov))
+		return -1;
+	/* let the previous run's boost wear off */
+	sleep(2);
+
+	memset(frames, 0, sizeof(frames));
+	traced = !trace_start();
+	run_frames();
+	trace_stop();
+
+	if (traced && !trace_parse(&st) && st.frames == nr_frames)
+		report(gov, trace_frames, "trace", &st);
+	else
+		report(gov, frames, "clock", NULL);
+	fflush(stdout);
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: frame_bench [-g governor,...] [-n frames] "
+		"[-p period us] [-w work us] [-b heavy work us] "
+		"[-e heavy every] [-i idle every] [-d trace dir]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	char govs[256] = "interactive,sched";
+	char saved[64] = "", path[128];
+	char *gov, *save;
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "g:n:p:w:b:e:i:d:")) != -1) {
+		switch (opt) {
+		case 'g':
+			snprintf(govs, sizeof(govs), "%s", optarg);
+			break;
+		case 'n':
+			nr_frames = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			period_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			work_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			heavy_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			heavy_every = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			idle_every = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			trace_dir = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (!nr_frames || nr_frames > MAX_FRAMES || !period_us)
+		usage();
+
+	if (cpufreq_path(path, sizeof(path), 0, "scaling_governor") ||
+	    read_file(path, saved, sizeof(saved))) {
+		fprintf(stderr, "frame_bench: no cpufreq on cpu0\n");
+		return 1;
+	}
+	if (calibrate()) {
+		fprintf(stderr, "frame_bench: calibration failed\n");
+		return 1;
+	}
+
+	printf("frame_bench: %u frames, %u us period, %u/%u us work, "
+	       "heavy every %u, idle every %u (%.0f loops/us)\n",
+	       nr_frames, period_us, work_us, heavy_us, heavy_every,
+	       idle_every, loops_per_us);
+	printf("governor     frames   jank  jank%%  mean us   p90 us   "
+	       "p99 us   max us  source  freqchg  khz range\n");
+	fflush(stdout);
+
+	for (gov = strtok_r(govs, ",", &save); gov;
+	     gov = strtok_r(NULL, ",", &save))
+		if (run_governor(gov))
+			ret = 1;
+
+	set_governor(saved);
+	return ret;
+}
@@ -0,0 +1,331 @@
+/*
+ * inline_bench: small file create/read latency and space use on ext4
+ *
+ * Creates a number of files of each given size in a directory on the
+ * filesystem under test, syncs, and reads them back, reporting the mean
+ * create and read latency per file, the blocks charged to the files
+ * (st_blocks) and the blocks the filesystem lost (statvfs). It then does
+ * the same with small directories, each holding a few empty files, timing
+ * mkdir plus the creates and a readdir of each directory.
+ *
+ * The number of files and directories that ended up with
+ * EXT4_INLINE_DATA_FL is reported too. Run it once on a filesystem made
+ * with "mke2fs -O inline_data -I 256" and once without inline_data to see
+ * what the feature saves.
+ *
+ * Usage: inline_bench [-d dir] [-n files] [-e entries] [-c] [size ...]
+ *
+ * The sizes default to 16 60 128 512 4096 bytes. -c drops the page and
+ * inode caches before reading, which needs root.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/types.h>
+
+#define EXT4_INLINE_DATA_FL	0x10000000
+
+static const char *base_dir = ".";
+static unsigned int nr_files = 1000;
+static unsigned int nr_entries = 3;
+static int drop_cache;
+
+struct result {
+	double create_us;
+	double read_us;
+	unsigned long long st_bytes;
+	unsigned long long fs_bytes;
+	unsigned int nr_inline;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long fs_used(const char *path)
+{
+	struct statvfs st;
+
+	if (statvfs(path, &st))
+		return 0;
+	return (unsigned long long)(st.f_blocks - st.f_bfree) * st.f_frsize;
+}
+
+static unsigned long long used_since(const char *path,
+				     unsigned long long used)
+{
+	unsigned long long now_used = fs_used(path);
+
+	return now_used > used ? now_used - used : 0;
+}
+
+static void drop_caches(void)
+{
+	int fd;
+
+	sync();
+	if (!drop_cache)
+		return;
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0 || write(fd, "3", 1) != 1)
+		perror("drop_caches");
+	if (fd >= 0)
+		close(fd);
+}
+
+static int is_inline(const char *path)
+{
+	int fd, flags = 0;
+
+	fd = open(path, O_RDONLY | O_NONBLOCK);
+	if (fd < 0)
+		return 0;
+	if (ioctl(fd, FS_IOC_GETFLAGS, &flags))
+		flags = 0;
+	close(fd);
+	return !!(flags & EXT4_INLINE_DATA_FL);
+}
+
+static int account(const char *path, struct result *res)
+{
+	struct stat st;
+
+	if (stat(path, &st)) {
+		perror(path);
+		return -1;
+	}
+	res->st_bytes += (unsigned long long)st.st_blocks * 512;
+	res->nr_inline += is_inline(path);
+	return 0;
+}
+
+static int run_files(const char *dir, size_t size, struct result *res)
+{
+	char path[4096], *buf;
+	unsigned long long used;
+	unsigned int i;
+	double t;
+	int fd, ret = -1;
+
+	buf = malloc(size ? size : 1);
+	if (!buf)
+		return -1;
+	memset(buf, 'x', size);
+
+	used = fs_used(dir);
+	t = now();
+	for (i = 0; i < nr_files; i++) {
+		snprintf(path, sizeof(path), "%s/f%u", dir, i);
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0 || write(fd, buf, size) != (ssize_t)size) {
+			perror(path);
+			goto out;
+		}
+		close(fd);
+	}
+	sync();
+	res->create_us = (now() - t) * 1e6 / nr_files;
+	res->fs_bytes = used_since(dir, used);
+
+	drop_caches();
+	t = now();
+	for (i = 0; i < nr_files; i++) {
+		snprintf(path, sizeof(path), "%s/f%u", dir, i);
+		fd = open(path, O_RDONLY);
+		if (fd < 0 || read(fd, buf, size) != (ssize_t)size) {
+			perror(path);
+			goto out;
+		}
+		close(fd);
+	}
+	res->read_us = (now() - t) * 1e6 / nr_files;
+
+	for (i = 0; i < nr_files; i++) {
+		snprintf(path, sizeof(path), "%s/f%u", dir, i);
+		if (account(path, res))
+			goto out;
+	}
+	ret = 0;
+out:
+	free(buf);
+	return ret;
+}
+
+static int run_dirs(const char *dir, struct result *res)
+{
+	char path[4096];
+	unsigned long long used;
+	unsigned int i, j, seen;
+	struct dirent *de;
+	DIR *d;
+	double t;
+	int fd;
+
+	used = fs_used(dir);
+	t = now();
+	for (i = 0; i < nr_files; i++) {
+		snprintf(path, sizeof(path), "%s/d%u", dir, i);
+		if (mkdir(path, 0755)) {
+			perror(path);
+			return -1;
+		}
+		for (j = 0; j < nr_entries; j++) {
+			snprintf(path, sizeof(path), "%s/d%u/e%u", dir, i, j);
+			fd = open(path, O_WRONLY | O_CREAT, 0644);
+			if (fd < 0) {
+				perror(path);
+				return -1;
+			}
+			close(fd);
+		}
+	}
+	sync();
+	res->create_us = (now() - t) * 1e6 / nr_files;
+	res->fs_bytes = used_since(dir, used);
+
+	drop_caches();
+	t = now();
+	for (i = 0; i < nr_files; i++) {
+		snprintf(path, sizeof(path), "%s/d%u", dir, i);
+		d = opendir(path);
+		if (!d) {
+			perror(path);
+			return -1;
+		}
+		seen = 0;
+		while ((de = readdir(d)))
+			seen++;
+		closedir(d);
+		if (seen != nr_entries + 2) {
+			fprintf(stderr, "%s: %u entries, expected %u\n",
+				path, seen, nr_entries + 2);
+			return -1;
+		}
+	}
+	res->read_us = (now() - t) * 1e6 / nr_files;
+
+	for (i = 0; i < nr_files; i++) {
+		snprintf(path, sizeof(path), "%s/d%u", dir, i);
+		if (account(path, res))
+			return -1;
+	}
+	return 0;
+}
+
+static int remove_tree(const char *dir)
+{
+	char cmd[1100];
+
+	snprintf(cmd, sizeof(cmd), "rm -rf '%s'", dir);
+	return system(cmd);
+}
+
+static void report(const char *name, struct result *res)
+{
+	printf("%-10s %10.1f %10.1f %12llu %12llu %8u/%u\n", name,
+	       res->create_us, res->read_us,
+	       res->st_bytes / nr_files, res->fs_bytes / nr_files,
+	       res->nr_inline, nr_files);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-d dir] [-n files] [-e entries] [-c] [size ...]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t default_sizes[] = { 16, 60, 128, 512, 4096 };
+	char dir[1024], name[32];
+	struct result res;
+	int opt, i, nr_sizes;
+	size_t size;
+
+	while ((opt = getopt(argc, argv, "d:n:e:c")) != -1) {
+		switch (opt) {
+		case 'd':
+			base_dir = optarg;
+			break;
+		case 'n':
+			nr_files = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			nr_entries = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			drop_cache = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!nr_files)
+		usage(argv[0]);
+
+	nr_sizes = argc - optind;
+	if (!nr_sizes)
+		nr_sizes = sizeof(default_sizes) / sizeof(default_sizes[0]);
+
+	printf("%u files per run%s\n", nr_files,
+	       drop_cache ? ", cold cache" : "");
+	printf("%-10s %10s %10s %12s %12s %10s\n", "", "create us",
+	       "read us", "st bytes", "fs bytes", "inline");
+
+	for (i = 0; i < nr_sizes; i++) {
+		if (optind < argc)
+			size = strtoul(argv[optind + i], NULL, 0);
+		else
+			size = default_sizes[i];
+
+		snprintf(dir, sizeof(dir), "%s/inline_bench.%zu", base_dir,
+			 size);
+		remove_tree(dir);
+		if (mkdir(dir, 0755)) {
+			perror(dir);
+			return 1;
+		}
+		memset(&res, 0, sizeof(res));
+		if (run_files(dir, size, &res))
+			return 1;
+		snprintf(name, sizeof(name), "%zuB", size);
+		report(name, &res);
+		remove_tree(dir);
+	}
+
+	snprintf(dir, sizeof(dir), "%s/inline_bench.dirs", base_dir);
+	remove_tree(dir);
+	if (mkdir(dir, 0755)) {
+		perror(dir);
+		return 1;
+	}
+	memset(&res, 0, sizeof(res));
+	if (run_dirs(dir, &res))
+		return 1;
+	snprintf(name, sizeof(name), "dir+%u", nr_entries);
+	report(name, &res);
+	remove_tree(dir);
+
+	return 0;
+}
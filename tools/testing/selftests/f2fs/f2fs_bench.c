@@ -0,0 +1,327 @@
+/*
+ * f2fs_bench: flash-oriented write patterns for comparing filesystems
+ *
+ * Runs, in a directory on the filesystem under test:
+ *
+ *   seq	sequential 512KB writes of one file, one fsync at the end
+ *   rand	4KB random overwrites of a file, each followed by fsync,
+ *		the way SQLite journals update a database
+ *   small	creation of 4KB files, each followed by fsync
+ *   aged	the rand pattern again after the filesystem was filled to
+ *		the given percentage and half of it was deleted, so that a
+ *		log-structured filesystem has to clean segments
+ *
+ * Each result is one "name: value unit" line, and random and small also
+ * report mean and 99th percentile latencies, so that the output of two
+ * runs can be lined up by a script.
+ *
+ * Usage: f2fs_bench [-d dir] [-s MB] [-n ops] [-f fill%] [test ...]
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/types.h>
+
+#define CHUNK		(512 * 1024)
+#define BLK		4096
+
+static const char *base_dir = ".";
+static unsigned int file_mb = 64;
+static unsigned int nr_ops = 2000;
+static unsigned int fill_pct = 70;
+static char buf[CHUNK];
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report_lat(const char *name, double *lat, unsigned int n)
+{
+	double sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		sum += lat[i];
+	qsort(lat, n, sizeof(*lat), cmp_double);
+	printf("%s_lat_mean: %.1f us\n", name, sum / n * 1e6);
+	printf("%s_lat_p99: %.1f us\n", name, lat[n * 99 / 100] * 1e6);
+}
+
+static void fill_buf(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = rand();
+}
+
+static int create_file(const char *name, unsigned long long bytes)
+{
+	unsigned long long done;
+	int fd;
+
+	fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		die(name);
+	for (done = 0; done < bytes; done += CHUNK)
+		if (write(fd, buf, CHUNK) != CHUNK)
+			return -1;
+	if (fsync(fd))
+		die("fsync");
+	return fd;
+}
+
+static void test_seq(void)
+{
+	char name[256];
+	double start, elapsed;
+	int fd;
+
+	snprintf(name, sizeof(name), "%s/seq.dat", base_dir);
+	start = now();
+	fd = create_file(name, (unsigned long long)file_mb << 20);
+	if (fd < 0)
+		die("write");
+	elapsed = now() - start;
+	close(fd);
+	unlink(name);
+
+	printf("seq_write: %.1f MB/s\n", file_mb / elapsed);
+}
+
+static void rand_overwrite(const char *tag, const char *name)
+{
+	unsigned long long blocks = ((unsigned long long)file_mb << 20) / BLK;
+	double *lat, start, total;
+	unsigned int i;
+	int fd;
+
+	lat = calloc(nr_ops, sizeof(*lat));
+	if (!lat)
+		die("calloc");
+
+	fd = open(name, O_RDWR);
+	if (fd < 0)
+		die(name);
+
+	total = now();
+	for (i = 0; i < nr_ops; i++) {
+		off_t off = (off_t)(rand() % blocks) * BLK;
+
+		start = now();
+		if (pwrite(fd, buf + (i % (CHUNK / BLK)) * BLK, BLK, off) != BLK)
+			die("pwrite");
+		if (fsync(fd))
+			die("fsync");
+		lat[i] = now() - start;
+	}
+	total = now() - total;
+	close(fd);
+
+	printf("%s_iops: %.0f ops/s\n", tag, nr_ops / total);
+	report_lat(tag, lat, nr_ops);
+	free(lat);
+}
+
+static void test_rand(void)
+{
+	char name[256];
+	int fd;
+
+	snprintf(name, sizeof(name), "%s/rand.dat", base_dir);
+	fd = create_file(name, (unsigned long long)file_mb << 20);
+	if (fd < 0)
+		die("write");
+	close(fd);
+
+	rand_overwrite("rand", name);
+	unlink(name);
+}
+
+static void test_small(void)
+{
+	double *lat, start, total;
+	char name[256];
+	unsigned int i;
+	int fd;
+
+	lat = calloc(nr_ops, sizeof(*lat));
+	if (!lat)
+		die("calloc");
+
+	snprintf(name, sizeof(name), "%s/small", base_dir);
+	if (mkdir(name, 0755) && errno != EEXIST)
+		die(name);
+
+	total = now();
+	for (i = 0; i < nr_ops; i++) {
+		snprintf(name, sizeof(name), "%s/small/f%u", base_dir, i);
+		start = now();
+		fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			die(name);
+		if (write(fd, buf, BLK) != BLK)
+			die("write");
+		if (fsync(fd))
+			die("fsync");
+		close(fd);
+		lat[i] = now() - start;
+	}
+	total = now() - total;
+
+	printf("small_create: %.0f files/s\n", nr_ops / total);
+	report_lat("small", lat, nr_ops);
+
+	for (i = 0; i < nr_ops; i++) {
+		snprintf(name, sizeof(name), "%s/small/f%u", base_dir, i);
+		unlink(name);
+	}
+	snprintf(name, sizeof(name), "%s/small", base_dir);
+	rmdir(name);
+	free(lat);
+}
+
+static void test_aged(void)
+{
+	unsigned long long avail, target, written = 0;
+	struct statvfs st;
+	char name[256];
+	unsigned int nr_fill = 0, i;
+	int fd;
+
+	snprintf(name, sizeof(name), "%s/rand.dat", base_dir);
+	fd = create_file(name, (unsigned long long)file_mb << 20);
+	if (fd < 0)
+		die("write");
+	close(fd);
+
+	/* fill with 4MB files, then punch holes all over by deleting half */
+	if (statvfs(base_dir, &st))
+		die("statvfs");
+	avail = (unsigned long long)st.f_blocks * st.f_frsize;
+	target = avail * fill_pct / 100;
+	written = avail - (unsigned long long)st.f_bavail * st.f_frsize;
+
+	while (written + (4 << 20) < target) {
+		snprintf(name, sizeof(name), "%s/fill%u", base_dir, nr_fill);
+		fd = create_file(name, 4 << 20);
+		if (fd < 0) {
+			/* ENOSPC: close enough to full */
+			unlink(name);
+			break;
+		}
+		close(fd);
+		nr_fill++;
+		written += 4 << 20;
+	}
+	for (i = 0; i < nr_fill; i += 2) {
+		snprintf(name, sizeof(name), "%s/fill%u", base_dir, i);
+		unlink(name);
+	}
+	sync();
+
+	snprintf(name, sizeof(name), "%s/rand.dat", base_dir);
+	rand_overwrite("aged", name);
+	unlink(name);
+
+	for (i = 1; i < nr_fill; i += 2) {
+		snprintf(name, sizeof(name), "%s/fill%u", base_dir, i);
+		unlink(name);
+	}
+}
+
+static const struct {
+	const char *name;
+	void (*fn)(void);
+} tests[] = {
+	{ "seq", test_seq },
+	{ "rand", test_rand },
+	{ "small", test_small },
+	{ "aged", test_aged },
+};
+
+#define NR_TESTS	(sizeof(tests) / sizeof(tests[0]))
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-d dir] [-s MB] [-n ops] [-f fill%%] "
+			"[seq|rand|small|aged ...]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:s:n:f:")) != -1) {
+		switch (opt) {
+		case 'd':
+			base_dir = optarg;
+			break;
+		case 's':
+			file_mb = atoi(optarg);
+			break;
+		case 'n':
+			nr_ops = atoi(optarg);
+			break;
+		case 'f':
+			fill_pct = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!file_mb || !nr_ops || fill_pct > 95)
+		usage(argv[0]);
+
+	srand(getpid());
+	fill_buf();
+
+	if (optind == argc) {
+		for (i = 0; i < NR_TESTS; i++)
+			tests[i].fn();
+		return 0;
+	}
+
+	for (; optind < argc; optind++) {
+		for (i = 0; i < NR_TESTS; i++) {
+			if (!strcmp(argv[optind], tests[i].name)) {
+				tests[i].fn();
+				break;
+			}
+		}
+		if (i == NR_TESTS)
+			usage(argv[0]);
+	}
+	return 0;
+}
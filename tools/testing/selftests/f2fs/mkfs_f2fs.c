@@ -0,0 +1,511 @@
+/*
+ * mkfs_f2fs: minimal formatter for the in-kernel f2fs
+ *
+ * Writes an empty f2fs holding only the root directory to a block device
+ * or image file, so that the benchmark can run without f2fs-tools. The
+ * layout is what fs/f2fs expects: 4KB blocks, 2MB segments, one segment
+ * per section, and normal (not compacted) summaries in the checkpoint.
+ *
+ *   block 0          two copies of the superblock, one segment
+ *   segment0_blkaddr two checkpoint segments
+ *                    SIT, NAT (two copies each), SSA
+ *   main_blkaddr     main area; six logs are opened on its first segments
+ *
+ * Usage: mkfs_f2fs [-o overprovision%] [-l label] device
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define _GNU_SOURCE
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define F2FS_SUPER_MAGIC	0xF2F52010
+#define F2FS_SUPER_OFFSET	1024
+#define F2FS_BLKSIZE		4096
+#define LOG_BLOCKS_PER_SEG	9
+#define BLOCKS_PER_SEG		(1 << LOG_BLOCKS_PER_SEG)
+#define F2FS_MAX_EXTENSION	64
+#define F2FS_MAX_NAME_LEN	256
+#define ADDRS_PER_INODE		923
+#define ADDRS_PER_BLOCK		1018
+#define NR_CURSEG_TYPE		6
+#define CP_UMOUNT_FLAG		0x00000001
+#define SIT_VBLOCKS_SHIFT	10
+#define SUM_TYPE_NODE		1
+#define SUM_TYPE_DATA		0
+#define NR_DENTRY_IN_BLOCK	214
+#define F2FS_FT_DIR		2
+
+#define NODE_INO		1
+#define META_INO		2
+#define ROOT_INO		3
+
+/* logs, in the order of the kernel's curseg types */
+enum { HOT_DATA, WARM_DATA, COLD_DATA, HOT_NODE, WARM_NODE, COLD_NODE };
+
+struct f2fs_super_block {
+	uint32_t magic;
+	uint16_t major_ver;
+	uint16_t minor_ver;
+	uint32_t log_sectorsize;
+	uint32_t log_sectors_per_block;
+	uint32_t log_blocksize;
+	uint32_t log_blocks_per_seg;
+	uint32_t segs_per_sec;
+	uint32_t secs_per_zone;
+	uint32_t checksum_offset;
+	uint64_t block_count;
+	uint32_t section_count;
+	uint32_t segment_count;
+	uint32_t segment_count_ckpt;
+	uint32_t segment_count_sit;
+	uint32_t segment_count_nat;
+	uint32_t segment_count_ssa;
+	uint32_t segment_count_main;
+	uint32_t segment0_blkaddr;
+	uint32_t cp_blkaddr;
+	uint32_t sit_blkaddr;
+	uint32_t nat_blkaddr;
+	uint32_t ssa_blkaddr;
+	uint32_t main_blkaddr;
+	uint32_t root_ino;
+	uint32_t node_ino;
+	uint32_t meta_ino;
+	uint8_t uuid[16];
+	uint16_t volume_name[512];
+	uint32_t extension_count;
+	uint8_t extension_list[F2FS_MAX_EXTENSION][8];
+} __attribute__((packed));
+
+struct f2fs_checkpoint {
+	uint64_t checkpoint_ver;
+	uint64_t user_block_count;
+	uint64_t valid_block_count;
+	uint32_t rsvd_segment_count;
+	uint32_t overprov_segment_count;
+	uint32_t free_segment_count;
+	uint32_t cur_node_segno[8];
+	uint16_t cur_node_blkoff[8];
+	uint32_t cur_data_segno[8];
+	uint16_t cur_data_blkoff[8];
+	uint32_t ckpt_flags;
+	uint32_t cp_pack_total_block_count;
+	uint32_t cp_pack_start_sum;
+	uint32_t valid_node_count;
+	uint32_t valid_inode_count;
+	uint32_t next_free_nid;
+	uint32_t sit_ver_bitmap_bytesize;
+	uint32_t nat_ver_bitmap_bytesize;
+	uint32_t checksum_offset;
+	uint64_t elapsed_time;
+	unsigned char alloc_type[16];
+	unsigned char sit_nat_version_bitmap[1];
+} __attribute__((packed));
+
+struct f2fs_inode {
+	uint16_t i_mode;
+	uint8_t i_advise;
+	uint8_t i_reserved;
+	uint32_t i_uid;
+	uint32_t i_gid;
+	uint32_t i_links;
+	uint64_t i_size;
+	uint64_t i_blocks;
+	uint64_t i_atime;
+	uint64_t i_ctime;
+	uint64_t i_mtime;
+	uint32_t i_atime_nsec;
+	uint32_t i_ctime_nsec;
+	uint32_t i_mtime_nsec;
+	uint32_t i_generation;
+	uint32_t i_current_depth;
+	uint32_t i_xattr_nid;
+	uint32_t i_flags;
+	uint32_t i_pino;
+	uint32_t i_namelen;
+	uint8_t i_name[F2FS_MAX_NAME_LEN];
+	uint32_t i_ext[3];
+	uint32_t i_addr[ADDRS_PER_INODE];
+	uint32_t i_nid[5];
+} __attribute__((packed));
+
+struct node_footer {
+	uint32_t nid;
+	uint32_t ino;
+	uint32_t flag;
+	uint64_t cp_ver;
+	uint32_t next_blkaddr;
+} __attribute__((packed));
+
+struct f2fs_node {
+	union {
+		struct f2fs_inode i;
+		uint32_t addr[ADDRS_PER_BLOCK];
+	};
+	struct node_footer footer;
+} __attribute__((packed));
+
+struct f2fs_nat_entry {
+	uint8_t version;
+	uint32_t ino;
+	uint32_t block_addr;
+} __attribute__((packed));
+
+#define NAT_ENTRY_PER_BLOCK	(F2FS_BLKSIZE / sizeof(struct f2fs_nat_entry))
+
+struct f2fs_sit_entry {
+	uint16_t vblocks;
+	uint8_t valid_map[64];
+	uint64_t mtime;
+} __attribute__((packed));
+
+#define SIT_ENTRY_PER_BLOCK	(F2FS_BLKSIZE / sizeof(struct f2fs_sit_entry))
+
+struct f2fs_summary {
+	uint32_t nid;
+	uint8_t version;
+	uint16_t ofs_in_node;
+} __attribute__((packed));
+
+struct f2fs_summary_block {
+	struct f2fs_summary entries[512];
+	uint8_t journal[F2FS_BLKSIZE - 512 * 7 - 5];
+	uint8_t entry_type;
+	uint32_t check_sum;
+} __attribute__((packed));
+
+struct f2fs_dir_entry {
+	uint32_t hash_code;
+	uint32_t ino;
+	uint16_t name_len;
+	uint8_t file_type;
+} __attribute__((packed));
+
+#define SIZE_OF_DENTRY_BITMAP	((NR_DENTRY_IN_BLOCK + 7) / 8)
+
+struct f2fs_dentry_block {
+	uint8_t dentry_bitmap[SIZE_OF_DENTRY_BITMAP];
+	uint8_t reserved[F2FS_BLKSIZE - (11 + 8) * NR_DENTRY_IN_BLOCK -
+						SIZE_OF_DENTRY_BITMAP];
+	struct f2fs_dir_entry dentry[NR_DENTRY_IN_BLOCK];
+	uint8_t filename[NR_DENTRY_IN_BLOCK][8];
+} __attribute__((packed));
+
+#define BUILD_CHECK(name, cond)	typedef char name[(cond) ? 1 : -1]
+BUILD_CHECK(node_size, sizeof(struct f2fs_node) == F2FS_BLKSIZE);
+BUILD_CHECK(sum_size, sizeof(struct f2fs_summary_block) == F2FS_BLKSIZE);
+BUILD_CHECK(dent_size, sizeof(struct f2fs_dentry_block) == F2FS_BLKSIZE);
+
+static int fd;
+static unsigned char blk[F2FS_BLKSIZE];
+
+/* crc32_le() of the kernel, seeded with the magic and not inverted */
+static uint32_t f2fs_crc32(const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	uint32_t crc = F2FS_SUPER_MAGIC;
+	int i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+	}
+	return crc;
+}
+
+static void write_block(uint64_t blkaddr, const void *buf)
+{
+	if (pwrite(fd, buf, F2FS_BLKSIZE, blkaddr * F2FS_BLKSIZE) !=
+							F2FS_BLKSIZE) {
+		perror("pwrite");
+		exit(1);
+	}
+}
+
+static void zero_blocks(uint64_t start, uint64_t count)
+{
+	memset(blk, 0, sizeof(blk));
+	while (count--)
+		write_block(start++, blk);
+}
+
+static uint64_t device_blocks(const char *path)
+{
+	struct stat st;
+	uint64_t bytes;
+
+	if (fstat(fd, &st)) {
+		perror(path);
+		exit(1);
+	}
+	if (S_ISBLK(st.st_mode)) {
+		if (ioctl(fd, BLKGETSIZE64, &bytes)) {
+			perror("BLKGETSIZE64");
+			exit(1);
+		}
+	} else {
+		bytes = st.st_size;
+	}
+	return bytes / F2FS_BLKSIZE;
+}
+
+static void set_sit(struct f2fs_sit_entry *se, int type, int nr_valid)
+{
+	int i;
+
+	se->vblocks = htole16((type << SIT_VBLOCKS_SHIFT) | nr_valid);
+	for (i = 0; i < nr_valid; i++)
+		se->valid_map[i >> 3] |= 0x80 >> (i & 7);
+}
+
+int main(int argc, char **argv)
+{
+	struct f2fs_super_block sb;
+	struct f2fs_checkpoint *cp;
+	struct f2fs_summary_block *sum;
+	struct f2fs_node *node;
+	struct f2fs_dentry_block *dent;
+	struct f2fs_nat_entry *nat;
+	struct f2fs_sit_entry *sit;
+	const char *label = "";
+	unsigned int ovp_ratio = 5;
+	uint64_t total_blocks;
+	uint32_t total_segs, sit_segs, nat_segs, ssa_segs, main_segs;
+	uint32_t rsvd_segs, ovp_segs, main_blkaddr, curseg[NR_CURSEG_TYPE];
+	uint32_t crc, i;
+	time_t now = time(NULL);
+	int opt;
+
+	while ((opt = getopt(argc, argv, "o:l:")) != -1) {
+		switch (opt) {
+		case 'o':
+			ovp_ratio = atoi(optarg);
+			break;
+		case 'l':
+			label = optarg;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1 || ovp_ratio < 1 || ovp_ratio > 50)
+		goto usage;
+
+	fd = open(argv[optind], O_RDWR);
+	if (fd < 0) {
+		perror(argv[optind]);
+		return 1;
+	}
+	total_blocks = device_blocks(argv[optind]);
+
+	/* the first segment only holds the superblocks */
+	total_segs = total_blocks / BLOCKS_PER_SEG;
+	if (total_segs < 48) {
+		fprintf(stderr, "device too small: %u segments\n", total_segs);
+		return 1;
+	}
+	total_segs--;
+
+	sit_segs = (total_segs + SIT_ENTRY_PER_BLOCK * BLOCKS_PER_SEG - 1) /
+				(SIT_ENTRY_PER_BLOCK * BLOCKS_PER_SEG);
+	nat_segs = (total_blocks / NAT_ENTRY_PER_BLOCK + BLOCKS_PER_SEG - 1) /
+				BLOCKS_PER_SEG;
+	ssa_segs = (total_segs + BLOCKS_PER_SEG - 1) / BLOCKS_PER_SEG;
+	main_segs = total_segs - 2 - 2 * sit_segs - 2 * nat_segs - ssa_segs;
+
+	/* both version bitmaps have to fit into the checkpoint block */
+	if ((sit_segs + nat_segs) * BLOCKS_PER_SEG / 8 >
+			F2FS_BLKSIZE - 4 -
+			offsetof(struct f2fs_checkpoint,
+					sit_nat_version_bitmap)) {
+		fprintf(stderr, "device too large\n");
+		return 1;
+	}
+
+	/* room for foreground cleaning of every log, plus overprovision */
+	rsvd_segs = 2 * NR_CURSEG_TYPE;
+	ovp_segs = (main_segs - rsvd_segs) * ovp_ratio / 100 + rsvd_segs;
+
+	memset(&sb, 0, sizeof(sb));
+	sb.magic = htole32(F2FS_SUPER_MAGIC);
+	sb.major_ver = htole16(1);
+	sb.log_sectorsize = htole32(9);
+	sb.log_sectors_per_block = htole32(3);
+	sb.log_blocksize = htole32(12);
+	sb.log_blocks_per_seg = htole32(LOG_BLOCKS_PER_SEG);
+	sb.segs_per_sec = htole32(1);
+	sb.secs_per_zone = htole32(1);
+	sb.block_count = htole64(total_blocks);
+	sb.section_count = htole32(main_segs);
+	sb.segment_count = htole32(total_segs);
+	sb.segment_count_ckpt = htole32(2);
+	sb.segment_count_sit = htole32(2 * sit_segs);
+	sb.segment_count_nat = htole32(2 * nat_segs);
+	sb.segment_count_ssa = htole32(ssa_segs);
+	sb.segment_count_main = htole32(main_segs);
+	sb.segment0_blkaddr = htole32(BLOCKS_PER_SEG);
+	sb.cp_blkaddr = htole32(BLOCKS_PER_SEG);
+	sb.sit_blkaddr = htole32(le32toh(sb.cp_blkaddr) + 2 * BLOCKS_PER_SEG);
+	sb.nat_blkaddr = htole32(le32toh(sb.sit_blkaddr) +
+					2 * sit_segs * BLOCKS_PER_SEG);
+	sb.ssa_blkaddr = htole32(le32toh(sb.nat_blkaddr) +
+					2 * nat_segs * BLOCKS_PER_SEG);
+	main_blkaddr = le32toh(sb.ssa_blkaddr) + ssa_segs * BLOCKS_PER_SEG;
+	sb.main_blkaddr = htole32(main_blkaddr);
+	sb.root_ino = htole32(ROOT_INO);
+	sb.node_ino = htole32(NODE_INO);
+	sb.meta_ino = htole32(META_INO);
+	srand(now ^ getpid());
+	for (i = 0; i < sizeof(sb.uuid); i++)
+		sb.uuid[i] = rand();
+	for (i = 0; label[i] && i < 511; i++)
+		sb.volume_name[i] = htole16(label[i]);
+	sb.extension_count = htole32(3);
+	strcpy((char *)sb.extension_list[0], "jpg");
+	strcpy((char *)sb.extension_list[1], "mp4");
+	strcpy((char *)sb.extension_list[2], "apk");
+
+	/* each log starts on a segment of its own */
+	for (i = 0; i < NR_CURSEG_TYPE; i++)
+		curseg[i] = i;
+
+	/* metadata areas */
+	zero_blocks(0, main_blkaddr);
+
+	memset(blk, 0, sizeof(blk));
+	memcpy(blk + F2FS_SUPER_OFFSET, &sb, sizeof(sb));
+	write_block(0, blk);
+	write_block(1, blk);
+
+	/* checkpoint pack #1: cp block, six summaries, cp block */
+	memset(blk, 0, sizeof(blk));
+	cp = (struct f2fs_checkpoint *)blk;
+	cp->checkpoint_ver = htole64(1);
+	cp->user_block_count = htole64((uint64_t)(main_segs - ovp_segs) *
+							BLOCKS_PER_SEG);
+	cp->valid_block_count = htole64(2);
+	cp->rsvd_segment_count = htole32(rsvd_segs);
+	cp->overprov_segment_count = htole32(ovp_segs);
+	cp->free_segment_count = htole32(main_segs - NR_CURSEG_TYPE);
+	for (i = 0; i < 3; i++) {
+		cp->cur_data_segno[i] = htole32(curseg[HOT_DATA + i]);
+		cp->cur_node_segno[i] = htole32(curseg[HOT_NODE + i]);
+	}
+	for (i = 3; i < 8; i++) {
+		cp->cur_data_segno[i] = htole32(~0U);
+		cp->cur_node_segno[i] = htole32(~0U);
+	}
+	cp->cur_data_blkoff[0] = htole16(1);	/* root dentry block */
+	cp->cur_node_blkoff[0] = htole16(1);	/* root inode */
+	cp->ckpt_flags = htole32(CP_UMOUNT_FLAG);
+	cp->cp_pack_total_block_count = htole32(2 + NR_CURSEG_TYPE);
+	cp->cp_pack_start_sum = htole32(1);
+	cp->valid_node_count = htole32(1);
+	cp->valid_inode_count = htole32(1);
+	cp->next_free_nid = htole32(ROOT_INO + 1);
+	cp->sit_ver_bitmap_bytesize = htole32(sit_segs * BLOCKS_PER_SEG / 8);
+	cp->nat_ver_bitmap_bytesize = htole32(nat_segs * BLOCKS_PER_SEG / 8);
+	cp->checksum_offset = htole32(F2FS_BLKSIZE - 4);
+	crc = f2fs_crc32(cp, F2FS_BLKSIZE - 4);
+	*(uint32_t *)(blk + F2FS_BLKSIZE - 4) = htole32(crc);
+	write_block(le32toh(sb.cp_blkaddr), blk);
+	write_block(le32toh(sb.cp_blkaddr) + 1 + NR_CURSEG_TYPE, blk);
+
+	for (i = 0; i < NR_CURSEG_TYPE; i++) {
+		memset(blk, 0, sizeof(blk));
+		sum = (struct f2fs_summary_block *)blk;
+		sum->entry_type = i < HOT_NODE ? SUM_TYPE_DATA : SUM_TYPE_NODE;
+		if (i == HOT_DATA || i == HOT_NODE)
+			sum->entries[0].nid = htole32(ROOT_INO);
+		write_block(le32toh(sb.cp_blkaddr) + 1 + i, blk);
+	}
+
+	/* SIT: the logs own their segments, two blocks are in use */
+	memset(blk, 0, sizeof(blk));
+	sit = (struct f2fs_sit_entry *)blk;
+	for (i = 0; i < NR_CURSEG_TYPE; i++)
+		set_sit(&sit[curseg[i]], i,
+				(i == HOT_DATA || i == HOT_NODE) ? 1 : 0);
+	write_block(le32toh(sb.sit_blkaddr), blk);
+
+	/* NAT: node and meta inodes are reserved, the root is live */
+	memset(blk, 0, sizeof(blk));
+	nat = (struct f2fs_nat_entry *)blk;
+	nat[NODE_INO].ino = htole32(NODE_INO);
+	nat[NODE_INO].block_addr = htole32(1);
+	nat[META_INO].ino = htole32(META_INO);
+	nat[META_INO].block_addr = htole32(1);
+	nat[ROOT_INO].ino = htole32(ROOT_INO);
+	nat[ROOT_INO].block_addr = htole32(main_blkaddr +
+				curseg[HOT_NODE] * BLOCKS_PER_SEG);
+	write_block(le32toh(sb.nat_blkaddr), blk);
+
+	/* root inode */
+	memset(blk, 0, sizeof(blk));
+	node = (struct f2fs_node *)blk;
+	node->i.i_mode = htole16(040755);
+	node->i.i_uid = htole32(getuid());
+	node->i.i_gid = htole32(getgid());
+	node->i.i_links = htole32(2);
+	node->i.i_size = htole64(F2FS_BLKSIZE);
+	node->i.i_blocks = htole64(2 * (F2FS_BLKSIZE >> 9));
+	node->i.i_atime = node->i.i_ctime = node->i.i_mtime = htole64(now);
+	node->i.i_current_depth = htole32(1);
+	node->i.i_pino = htole32(ROOT_INO);
+	node->i.i_addr[0] = htole32(main_blkaddr +
+				curseg[HOT_DATA] * BLOCKS_PER_SEG);
+	node->footer.nid = htole32(ROOT_INO);
+	node->footer.ino = htole32(ROOT_INO);
+	node->footer.cp_ver = htole64(1);
+	node->footer.next_blkaddr = htole32(main_blkaddr +
+				curseg[HOT_NODE] * BLOCKS_PER_SEG + 1);
+	write_block(main_blkaddr + curseg[HOT_NODE] * BLOCKS_PER_SEG, blk);
+
+	/* root directory block with "." and ".." */
+	memset(blk, 0, sizeof(blk));
+	dent = (struct f2fs_dentry_block *)blk;
+	dent->dentry_bitmap[0] = 0x3;
+	for (i = 0; i < 2; i++) {
+		dent->dentry[i].ino = htole32(ROOT_INO);
+		dent->dentry[i].name_len = htole16(i + 1);
+		dent->dentry[i].file_type = F2FS_FT_DIR;
+		memset(dent->filename[i], '.', i + 1);
+	}
+	write_block(main_blkaddr + curseg[HOT_DATA] * BLOCKS_PER_SEG, blk);
+
+	/* stale blocks past the logs' heads would look like fsync chains */
+	for (i = 0; i < NR_CURSEG_TYPE; i++)
+		zero_blocks(main_blkaddr + curseg[i] * BLOCKS_PER_SEG +
+				((i == HOT_DATA || i == HOT_NODE) ? 1 : 0), 1);
+
+	if (fsync(fd)) {
+		perror("fsync");
+		return 1;
+	}
+	close(fd);
+
+	printf("f2fs: %llu blocks, %u main segments, %u overprovisioned\n",
+			(unsigned long long)total_blocks, main_segs, ovp_segs);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-o overprovision%%] [-l label] device\n",
+			argv[0]);
+	return 1;
+}
@@ -0,0 +1,105 @@
+#!/bin/sh
+#
+# Compare f2fs with ext4 on the same RAM-backed block device.
+#
+# A loop device over a file in /dev/shm (or /dev/ram0 with -r) takes the
+# media out of the picture, so the numbers show what each filesystem
+# itself issues per operation. Each filesystem is freshly made, mounted,
+# exercised by f2fs_bench and unmounted; the results are printed side by
+# side.
+#
+# Usage: run_bench.sh [-r] [-s device MB] [-- f2fs_bench options]
+
+SIZE_MB=512
+USE_RAM=0
+FILESYSTEMS="f2fs ext4"
+
+while getopts "rs:" opt; do
+	case $opt in
+	r) USE_RAM=1 ;;
+	s) SIZE_MB=$OPTARG ;;
+	*) echo "usage: $0 [-r] [-s MB] [f2fs_bench options]"; exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ "$(id -u)" != 0 ]; then
+	echo "run_bench: must be run as root, skipping"
+	exit 0
+fi
+if ! grep -qw f2fs /proc/filesystems; then
+	echo "run_bench: kernel has no f2fs support, skipping"
+	exit 0
+fi
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+MNT=$(mktemp -d /tmp/f2fs_bench.XXXXXX)
+OUT=$(mktemp -d /tmp/f2fs_bench_out.XXXXXX)
+IMG=
+DEV=
+
+cleanup() {
+	umount "$MNT" 2>/dev/null
+	[ -n "$IMG" ] && losetup -d "$DEV" 2>/dev/null
+	[ -n "$IMG" ] && rm -f "$IMG"
+	rmdir "$MNT"
+	rm -rf "$OUT"
+}
+trap cleanup EXIT
+
+if [ $USE_RAM = 1 ]; then
+	DEV=/dev/ram0
+	if [ ! -b $DEV ]; then
+		echo "run_bench: no $DEV, skipping"
+		exit 0
+	fi
+else
+	IMG=/dev/shm/f2fs_bench.img
+	dd if=/dev/zero of=$IMG bs=1M count=$SIZE_MB 2>/dev/null || exit 1
+	DEV=$(losetup -f --show $IMG) || exit 1
+fi
+
+mkfs() {
+	case $1 in
+	f2fs)
+		if command -v mkfs.f2fs >/dev/null; then
+			mkfs.f2fs -l bench $DEV
+		else
+			"$HERE/mkfs_f2fs" -l bench $DEV
+		fi ;;
+	ext4) mkfs.ext4 -q -F $DEV ;;
+	esac
+}
+
+RAN=
+for fs in $FILESYSTEMS; do
+	if ! mkfs $fs >/dev/null 2>&1; then
+		echo "run_bench: cannot make $fs, skipping it"
+		continue
+	fi
+	if ! mount -t $fs $DEV "$MNT"; then
+		echo "run_bench: cannot mount $fs, skipping it"
+		continue
+	fi
+	echo "running on $fs..."
+	"$HERE/f2fs_bench" -d "$MNT" "$@" > "$OUT/$fs" || echo "$fs: failed"
+	umount "$MNT"
+	RAN="$RAN $fs"
+done
+
+# one row per metric, one column per filesystem
+[ -n "$RAN" ] || exit 1
+printf "\n%-20s" "metric"
+for fs in $RAN; do
+	printf "%14s" $fs
+done
+echo
+first=$(echo $RAN | cut -d' ' -f1)
+cut -d: -f1 "$OUT/$first" | while read metric; do
+	printf "%-20s" $metric
+	for fs in $RAN; do
+		v=$(grep "^$metric:" "$OUT/$fs" | cut -d' ' -f2-)
+		printf "%14s" "${v:--}"
+	done
+	echo
+done
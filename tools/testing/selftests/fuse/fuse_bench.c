@@ -0,0 +1,631 @@
+/*
+ * fuse_bench: FUSE file throughput with and without passthrough
+ *
+ * Mounts a minimal loopback FUSE filesystem with one file backed by a
+ * file in a lower directory, served by a daemon built in here that talks
+ * to /dev/fuse directly. The same fio-style jobs (sequential write and
+ * read, random read and write) are run against
+ *
+ *   lower        the backing file itself
+ *   fuse         the FUSE file, every read and write goes to the daemon
+ *   passthrough  the FUSE file opened with FOPEN_PASSTHROUGH
+ *
+ * and the throughput is reported together with the number of READ and
+ * WRITE requests the daemon had to serve. The passthrough run is skipped
+ * if the kernel does not offer FUSE_PASSTHROUGH.
+ *
+ * With -w the fuse run negotiates FUSE_WRITEBACK_CACHE, so that buffered
+ * writes are batched in the page cache and the WRITE count drops.
+ *
+ * Needs root and /dev/fuse.
+ *
+ * Usage: fuse_bench [-d lower dir] [-s size MiB] [-b seq block]
+ *		     [-r rand block] [-n rand ops] [-c] [-w]
+ *
+ * -c drops the page cache of the files before every job.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+/* FUSE 7.18 protocol, as in include/linux/fuse.h of this tree */
+#define FUSE_KERNEL_VERSION	7
+#define FUSE_KERNEL_MINOR	18
+
+#define FUSE_LOOKUP		1
+#define FUSE_FORGET		2
+#define FUSE_GETATTR		3
+#define FUSE_SETATTR		4
+#define FUSE_OPEN		14
+#define FUSE_READ		15
+#define FUSE_WRITE		16
+#define FUSE_STATFS		17
+#define FUSE_RELEASE		18
+#define FUSE_FSYNC		20
+#define FUSE_FLUSH		25
+#define FUSE_INIT		26
+#define FUSE_INTERRUPT		36
+#define FUSE_BATCH_FORGET	42
+
+#define FUSE_ASYNC_READ		(1 << 0)
+#define FUSE_BIG_WRITES		(1 << 5)
+#define FUSE_WRITEBACK_CACHE	(1 << 16)
+#define FUSE_PASSTHROUGH	(1u << 31)
+#define FOPEN_PASSTHROUGH	(1u << 31)
+#define FATTR_SIZE		(1 << 3)
+
+struct fuse_attr {
+	uint64_t ino, size, blocks, atime, mtime, ctime;
+	uint32_t atimensec, mtimensec, ctimensec;
+	uint32_t mode, nlink, uid, gid, rdev, blksize, padding;
+};
+
+struct fuse_in_header {
+	uint32_t len, opcode;
+	uint64_t unique, nodeid;
+	uint32_t uid, gid, pid, padding;
+};
+
+struct fuse_out_header {
+	uint32_t len;
+	int32_t error;
+	uint64_t unique;
+};
+
+struct fuse_init_in {
+	uint32_t major, minor, max_readahead, flags;
+};
+
+struct fuse_init_out {
+	uint32_t major, minor, max_readahead, flags;
+	uint16_t max_background, congestion_threshold;
+	uint32_t max_write;
+};
+
+struct fuse_entry_out {
+	uint64_t nodeid, generation, entry_valid, attr_valid;
+	uint32_t entry_valid_nsec, attr_valid_nsec;
+	struct fuse_attr attr;
+};
+
+struct fuse_attr_out {
+	uint64_t attr_valid;
+	uint32_t attr_valid_nsec, dummy;
+	struct fuse_attr attr;
+};
+
+struct fuse_setattr_in {
+	uint32_t valid, padding;
+	uint64_t fh, size, lock_owner, atime, mtime, unused2;
+	uint32_t atimensec, mtimensec, unused3, mode, unused4, uid, gid;
+	uint32_t unused5;
+};
+
+struct fuse_open_out {
+	uint64_t fh;
+	uint32_t open_flags;
+	int32_t passthrough_fd;
+};
+
+struct fuse_rw_in {
+	uint64_t fh, offset;
+	uint32_t size, rw_flags;
+	uint64_t lock_owner;
+	uint32_t flags, padding;
+};
+
+struct fuse_write_out {
+	uint32_t size, padding;
+};
+
+struct fuse_statfs_out {
+	uint64_t blocks, bfree, bavail, files, ffree;
+	uint32_t bsize, namelen, frsize, padding, spare[6];
+};
+
+#define MAX_WRITE	(128 * 1024)
+#define DEV_BUF		(MAX_WRITE + 4096)
+#define FILE_NODEID	2
+#define FILE_NAME	"bench"
+#define LOWER_NAME	"fuse_bench.dat"
+
+enum { JOB_SEQWRITE, JOB_SEQREAD, JOB_RANDREAD, JOB_RANDWRITE, NR_JOBS };
+
+static const char *job_names[NR_JOBS] = {
+	"seqwrite", "seqread", "randread", "randwrite",
+};
+
+struct daemon_stats {
+	int passthrough;
+	int writeback_cache;
+	unsigned long reads;
+	unsigned long writes;
+};
+
+struct run_result {
+	double mbps[NR_JOBS];
+	double iops[NR_JOBS];
+	unsigned long reads;
+	unsigned long writes;
+};
+
+static const char *lower_dir = "/data/local/tmp";
+static unsigned long long file_size = 64ULL << 20;
+static unsigned int seq_bs = 128 * 1024;
+static unsigned int rand_bs = 4096;
+static unsigned int rand_ops = 8192;
+static int drop_cache;
+static int writeback_cache;
+
+static struct daemon_stats *stats;
+static char lower_path[256];
+static char mnt_path[256];
+
+static void fill_attr(int fd, uint64_t ino, struct fuse_attr *attr)
+{
+	struct stat st;
+
+	memset(attr, 0, sizeof(*attr));
+	attr->ino = ino;
+	if (ino == FILE_NODEID && !fstat(fd, &st)) {
+		attr->mode = S_IFREG | 0644;
+		attr->nlink = 1;
+		attr->size = st.st_size;
+		attr->blocks = st.st_blocks;
+		attr->mtime = st.st_mtime;
+		attr->ctime = st.st_ctime;
+		attr->atime = st.st_atime;
+	} else {
+		attr->mode = S_IFDIR | 0755;
+		attr->nlink = 2;
+	}
+	attr->blksize = 4096;
+}
+
+static void reply(int dev, uint64_t unique, int error, const void *arg,
+		  size_t size)
+{
+	struct fuse_out_header out;
+	struct iovec iov[2];
+
+	out.len = sizeof(out) + (error ? 0 : size);
+	out.error = error;
+	out.unique = unique;
+	iov[0].iov_base = &out;
+	iov[0].iov_len = sizeof(out);
+	iov[1].iov_base = (void *)arg;
+	iov[1].iov_len = error ? 0 : size;
+	if (writev(dev, iov, 2) < 0 && errno != ENOENT)
+		perror("fuse daemon: reply");
+}
+
+static void serve(int dev, int lower, int passthrough)
+{
+	char *buf, *data;
+	ssize_t len;
+
+	buf = malloc(DEV_BUF);
+	data = malloc(MAX_WRITE);
+	if (!buf || !data)
+		_exit(1);
+
+	for (;;) {
+		struct fuse_in_header *in = (struct fuse_in_header *)buf;
+		void *arg = buf + sizeof(*in);
+
+		len = read(dev, buf, DEV_BUF);
+		if (len < 0) {
+			if (errno == EINTR || errno == ENOENT)
+				continue;
+			break;
+		}
+		if ((size_t)len < sizeof(*in))
+			continue;
+
+		switch (in->opcode) {
+		case FUSE_INIT: {
+			struct fuse_init_in *ii = arg;
+			struct fuse_init_out io;
+
+			memset(&io, 0, sizeof(io));
+			io.major = FUSE_KERNEL_VERSION;
+			io.minor = FUSE_KERNEL_MINOR;
+			io.max_readahead = ii->max_readahead;
+			io.flags = FUSE_ASYNC_READ | FUSE_BIG_WRITES;
+			if (passthrough && (ii->flags & FUSE_PASSTHROUGH)) {
+				io.flags |= FUSE_PASSTHROUGH;
+				stats->passthrough = 1;
+			}
+			if (writeback_cache && !passthrough &&
+			    (ii->flags & FUSE_WRITEBACK_CACHE)) {
+				io.flags |= FUSE_WRITEBACK_CACHE;
+				stats->writeback_cache = 1;
+			}
+			io.max_background = 12;
+			io.congestion_threshold = 9;
+			io.max_write = MAX_WRITE;
+			reply(dev, in->unique, 0, &io, sizeof(io));
+			break;
+		}
+		case FUSE_LOOKUP: {
+			struct fuse_entry_out eo;
+
+			if (in->nodeid != 1 || strcmp(arg, FILE_NAME)) {
+				reply(dev, in->unique, -ENOENT, NULL, 0);
+				break;
+			}
+			memset(&eo, 0, sizeof(eo));
+			eo.nodeid = FILE_NODEID;
+			eo.entry_valid = 3600;
+			eo.attr_valid = 3600;
+			fill_attr(lower, FILE_NODEID, &eo.attr);
+			reply(dev, in->unique, 0, &eo, sizeof(eo));
+			break;
+		}
+		case FUSE_SETATTR: {
+			struct fuse_setattr_in *si = arg;
+
+			if ((si->valid & FATTR_SIZE) &&
+			    ftruncate(lower, si->size)) {
+				reply(dev, in->unique, -errno, NULL, 0);
+				break;
+			}
+		}
+			/* fall through */
+		case FUSE_GETATTR: {
+			struct fuse_attr_out ao;
+
+			memset(&ao, 0, sizeof(ao));
+			ao.attr_valid = 3600;
+			fill_attr(lower, in->nodeid, &ao.attr);
+			reply(dev, in->unique, 0, &ao, sizeof(ao));
+			break;
+		}
+		case FUSE_OPEN: {
+			struct fuse_open_out oo;
+
+			memset(&oo, 0, sizeof(oo));
+			if (stats->passthrough) {
+				oo.open_flags = FOPEN_PASSTHROUGH;
+				oo.passthrough_fd = lower;
+			}
+			reply(dev, in->unique, 0, &oo, sizeof(oo));
+			break;
+		}
+		case FUSE_READ: {
+			struct fuse_rw_in *ri = arg;
+			size_t size = ri->size < MAX_WRITE ? ri->size : MAX_WRITE;
+			ssize_t n;
+
+			stats->reads++;
+			n = pread(lower, data, size, ri->offset);
+			reply(dev, in->unique, n < 0 ? -errno : 0, data,
+			      n < 0 ? 0 : n);
+			break;
+		}
+		case FUSE_WRITE: {
+			struct fuse_rw_in *wi = arg;
+			struct fuse_write_out wo;
+			ssize_t n;
+
+			stats->writes++;
+			n = pwrite(lower, (char *)arg + sizeof(*wi), wi->size,
+				   wi->offset);
+			memset(&wo, 0, sizeof(wo));
+			wo.size = n < 0 ? 0 : n;
+			reply(dev, in->unique, n < 0 ? -errno : 0, &wo,
+			      sizeof(wo));
+			break;
+		}
+		case FUSE_FSYNC:
+			reply(dev, in->unique, fdatasync(lower) ? -errno : 0,
+			      NULL, 0);
+			break;
+		case FUSE_STATFS: {
+			struct fuse_statfs_out so;
+
+			memset(&so, 0, sizeof(so));
+			so.bsize = 4096;
+			so.frsize = 4096;
+			so.namelen = 255;
+			reply(dev, in->unique, 0, &so, sizeof(so));
+			break;
+		}
+		case FUSE_FLUSH:
+		case FUSE_RELEASE:
+			reply(dev, in->unique, 0, NULL, 0);
+			break;
+		case FUSE_FORGET:
+		case FUSE_BATCH_FORGET:
+		case FUSE_INTERRUPT:
+			break;
+		default:
+			reply(dev, in->unique, -ENOSYS, NULL, 0);
+			break;
+		}
+	}
+	_exit(0);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void drop(int fd)
+{
+	int lfd;
+
+	if (!drop_cache)
+		return;
+	fsync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	lfd = open(lower_path, O_RDONLY);
+	if (lfd >= 0) {
+		posix_fadvise(lfd, 0, 0, POSIX_FADV_DONTNEED);
+		close(lfd);
+	}
+}
+
+static int run_job(int fd, int job, char *buf, double *mbps, double *iops)
+{
+	unsigned long long done = 0, nblocks = file_size / rand_bs;
+	unsigned int seed = 1, ops = 0;
+	double start, elapsed;
+	ssize_t n;
+
+	drop(fd);
+	start = now();
+	switch (job) {
+	case JOB_SEQWRITE:
+	case JOB_SEQREAD:
+		for (done = 0; done < file_size; done += n, ops++) {
+			size_t len = seq_bs;
+
+			if (file_size - done < len)
+				len = file_size - done;
+			if (job == JOB_SEQWRITE)
+				n = pwrite(fd, buf, len, done);
+			else
+				n = pread(fd, buf, len, done);
+			if (n <= 0)
+				return -1;
+		}
+		if (job == JOB_SEQWRITE && fsync(fd))
+			return -1;
+		break;
+	default:
+		for (ops = 0; ops < rand_ops; ops++) {
+			off_t off = (off_t)(rand_r(&seed) % nblocks) * rand_bs;
+
+			if (job == JOB_RANDWRITE)
+				n = pwrite(fd, buf, rand_bs, off);
+			else
+				n = pread(fd, buf, rand_bs, off);
+			if (n != (ssize_t)rand_bs)
+				return -1;
+			done += n;
+		}
+		if (job == JOB_RANDWRITE && fsync(fd))
+			return -1;
+		break;
+	}
+	elapsed = now() - start;
+	if (elapsed <= 0)
+		elapsed = 1e-9;
+	*mbps = done / elapsed / (1 << 20);
+	*iops = ops / elapsed;
+	return 0;
+}
+
+static int run_jobs(const char *path, struct run_result *res)
+{
+	char *buf;
+	int fd, job, ret = 0;
+
+	buf = malloc(seq_bs > rand_bs ? seq_bs : rand_bs);
+	if (!buf)
+		return -1;
+	memset(buf, 0x5a, seq_bs > rand_bs ? seq_bs : rand_bs);
+
+	fd = open(path, O_RDWR);
+	if (fd < 0) {
+		perror(path);
+		free(buf);
+		return -1;
+	}
+	for (job = 0; job < NR_JOBS && !ret; job++) {
+		ret = run_job(fd, job, buf, &res->mbps[job], &res->iops[job]);
+		if (ret)
+			fprintf(stderr, "%s: %s failed: %s\n", path,
+				job_names[job], strerror(errno));
+	}
+	close(fd);
+	free(buf);
+	return ret;
+}
+
+static int run_fuse(int passthrough, struct run_result *res)
+{
+	char opts[128], file[300];
+	int dev, lower, status, ret;
+	pid_t pid;
+
+	dev = open("/dev/fuse", O_RDWR);
+	if (dev < 0) {
+		perror("/dev/fuse");
+		return -1;
+	}
+	snprintf(opts, sizeof(opts),
+		 "fd=%d,rootmode=40000,user_id=0,group_id=0,allow_other", dev);
+	if (mount("fuse_bench", mnt_path, "fuse", MS_NOSUID | MS_NODEV,
+		  opts)) {
+		perror("mount");
+		close(dev);
+		return -1;
+	}
+
+	memset(stats, 0, sizeof(*stats));
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		umount2(mnt_path, MNT_DETACH);
+		close(dev);
+		return -1;
+	}
+	if (!pid) {
+		lower = open(lower_path, O_RDWR);
+		if (lower < 0)
+			_exit(1);
+		serve(dev, lower, passthrough);
+	}
+	close(dev);
+
+	snprintf(file, sizeof(file), "%s/%s", mnt_path, FILE_NAME);
+	ret = run_jobs(file, res);
+	res->reads = stats->reads;
+	res->writes = stats->writes;
+	if (passthrough && !stats->passthrough)
+		ret = 1;
+	if (!passthrough && writeback_cache && !stats->writeback_cache)
+		printf("writeback cache not supported by this kernel\n");
+
+	umount2(mnt_path, MNT_DETACH);
+	kill(pid, SIGTERM);
+	waitpid(pid, &status, 0);
+	return ret;
+}
+
+static void report(const char *name, struct run_result *res, int daemon)
+{
+	int job;
+
+	printf("%-12s", name);
+	for (job = 0; job < NR_JOBS; job++)
+		printf(" %9.1f %8.0f", res->mbps[job], res->iops[job]);
+	if (daemon)
+		printf("  %8lu %8lu", res->reads, res->writes);
+	printf("\n");
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-d lower dir] [-s size MiB] "
+		"[-b seq block] [-r rand block] [-n rand ops] [-c] [-w]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct run_result lower, fuse, passthrough;
+	int opt, fd, job, ret;
+
+	while ((opt = getopt(argc, argv, "d:s:b:r:n:cw")) != -1) {
+		switch (opt) {
+		case 'd':
+			lower_dir = optarg;
+			break;
+		case 's':
+			file_size = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'b':
+			seq_bs = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rand_bs = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			rand_ops = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			drop_cache = 1;
+			break;
+		case 'w':
+			writeback_cache = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!file_size || !seq_bs || !rand_bs || file_size < rand_bs)
+		usage(argv[0]);
+
+	stats = mmap(NULL, sizeof(*stats), PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (stats == MAP_FAILED) {
+		perror("mmap");
+		return 1;
+	}
+
+	snprintf(lower_path, sizeof(lower_path), "%s/%s", lower_dir,
+		 LOWER_NAME);
+	snprintf(mnt_path, sizeof(mnt_path), "%s/fuse_bench.mnt", lower_dir);
+	fd = open(lower_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || ftruncate(fd, file_size)) {
+		perror(lower_path);
+		return 1;
+	}
+	close(fd);
+	if (mkdir(mnt_path, 0755) && errno != EEXIST) {
+		perror(mnt_path);
+		return 1;
+	}
+
+	printf("size %llu MiB, seq block %u, rand block %u, %u rand ops%s\n",
+	       file_size >> 20, seq_bs, rand_bs, rand_ops,
+	       drop_cache ? ", cold cache" : "");
+	printf("%-12s", "");
+	for (job = 0; job < NR_JOBS; job++)
+		printf(" %9s %8s", job_names[job], "iops");
+	printf("  %8s %8s\n", "READs", "WRITEs");
+
+	memset(&lower, 0, sizeof(lower));
+	ret = run_jobs(lower_path, &lower);
+	if (!ret)
+		report("lower", &lower, 0);
+
+	memset(&fuse, 0, sizeof(fuse));
+	if (!ret) {
+		ret = run_fuse(0, &fuse);
+		if (!ret)
+			report(writeback_cache ? "fuse-wb" : "fuse", &fuse, 1);
+	}
+
+	memset(&passthrough, 0, sizeof(passthrough));
+	if (!ret) {
+		ret = run_fuse(1, &passthrough);
+		if (!ret)
+			report("passthrough", &passthrough, 1);
+		else if (ret > 0) {
+			printf("passthrough: not supported by this kernel\n");
+			ret = 0;
+		}
+	}
+
+	rmdir(mnt_path);
+	unlink(lower_path);
+	return ret ? 1 : 0;
+}
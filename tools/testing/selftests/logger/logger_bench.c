@@ -0,0 +1,168 @@
+/*
+ * logger_bench: /dev/log write throughput with concurrent writers
+ *
+ * Writes entries to a logger device the way liblog does, one writev() of
+ * priority, tag and message per entry, from 1 up to the given number of
+ * threads at once, and reports writes/sec for each thread count.
+ *
+ * Usage: logger_bench [-d device] [-t max threads] [-n writes per thread]
+ *		       [-s message bytes]
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#define MAX_THREADS	64
+#define MAX_MSG		4000
+#define LOG_PRIO_INFO	4
+#define LOG_TAG		"logger_bench"
+
+static const char *device = "/dev/log/main";
+static unsigned long writes_per_thread = 100000;
+static size_t msg_size = 64;
+
+static pthread_barrier_t start_barrier;
+
+struct writer {
+	pthread_t thread;
+	int fd;
+	unsigned long errors;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *writer_fn(void *arg)
+{
+	struct writer *w = arg;
+	unsigned char prio = LOG_PRIO_INFO;
+	char tag[] = LOG_TAG;
+	char msg[MAX_MSG + 1];
+	struct iovec iov[3];
+	unsigned long i;
+
+	memset(msg, 'x', msg_size);
+	msg[msg_size] = '\0';
+	iov[0].iov_base = &prio;
+	iov[0].iov_len = 1;
+	iov[1].iov_base = tag;
+	iov[1].iov_len = sizeof(tag);
+	iov[2].iov_base = msg;
+	iov[2].iov_len = msg_size + 1;
+
+	pthread_barrier_wait(&start_barrier);
+	for (i = 0; i < writes_per_thread; i++) {
+		if (writev(w->fd, iov, 3) < 0)
+			w->errors++;
+	}
+	return NULL;
+}
+
+static int run(int nr_threads)
+{
+	struct writer writers[MAX_THREADS];
+	unsigned long errors = 0;
+	uint64_t start, elapsed;
+	double total, bytes;
+	int i;
+
+	/* like liblog, every writer thread shares one fd per process */
+	writers[0].fd = open(device, O_WRONLY);
+	if (writers[0].fd < 0) {
+		fprintf(stderr, "logger_bench: open %s: %s\n", device,
+			strerror(errno));
+		return -1;
+	}
+
+	pthread_barrier_init(&start_barrier, NULL, nr_threads + 1);
+	for (i = 0; i < nr_threads; i++) {
+		writers[i].fd = writers[0].fd;
+		writers[i].errors = 0;
+		if (pthread_create(&writers[i].thread, NULL, writer_fn,
+				   &writers[i])) {
+			fprintf(stderr, "logger_bench: pthread_create failed\n");
+			exit(1);
+		}
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	start = now_ns();
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(writers[i].thread, NULL);
+		errors += writers[i].errors;
+	}
+	elapsed = now_ns() - start;
+	pthread_barrier_destroy(&start_barrier);
+	close(writers[0].fd);
+
+	total = (double)writes_per_thread * nr_threads;
+	/* payload as the logger sees it: prio, tag and message */
+	bytes = total * (1 + sizeof(LOG_TAG) + msg_size + 1);
+	printf("%7d %12.0f %12.0f %10.2f %8lu\n", nr_threads,
+	       total * 1e9 / elapsed,
+	       (double)writes_per_thread * 1e9 / elapsed,
+	       bytes * 1e9 / elapsed / (1 << 20), errors);
+	return errors ? -1 : 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: logger_bench [-d device] [-t max threads] "
+		"[-n writes per thread] [-s message bytes]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int max_threads = 4;
+	int ret = 0;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "d:t:n:s:")) != -1) {
+		switch (opt) {
+		case 'd':
+			device = optarg;
+			break;
+		case 't':
+			max_threads = atoi(optarg);
+			break;
+		case 'n':
+			writes_per_thread = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			msg_size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (max_threads < 1 || max_threads > MAX_THREADS ||
+	    writes_per_thread == 0 || msg_size > MAX_MSG)
+		usage();
+
+	printf("logger_bench: %s, %lu writes per thread, %zu byte messages\n",
+	       device, writes_per_thread, msg_size);
+	printf("threads     writes/s  per thread/s       MiB/s   errors\n");
+	fflush(stdout);
+	for (i = 1; i <= max_threads; i++)
+		if (run(i))
+			ret = 1;
+	return ret;
+}
@@ -0,0 +1,390 @@
+/*
+ * pack_bench: idle wakeups and throughput with small-task packing
+ *
+ * Runs a number of periodic background threads, each waking up every
+ * period to do a little work, the way sensor, audio and ipc workers do,
+ * next to one cpu-bound worker pinned to the last cpu. The same load is
+ * run with small-task packing off and on, by setting the
+ * kernel.sched_small_task_pct sysctl to 0 and to the -u percentage.
+ *
+ * For each run it reports, per cpu, how often the cpu left idle and how
+ * often and how long it was in its deepest idle state (from cpuidle), and
+ * where the periodic threads woke up. It also reports how late the
+ * periodic threads woke up and how many loops the worker managed, to show
+ * what packing costs.
+ *
+ * Needs root to switch the sysctl. Without it the load is run once with
+ * the current setting.
+ *
+ * Usage: pack_bench [-t threads] [-p period us] [-w work us] [-s seconds]
+ *		     [-b 0|1] [-u small task %]
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CPUS	64
+#define MAX_STATES	16
+#define MAX_THREADS	256
+#define CPUIDLE_SYSFS	"/sys/devices/system/cpu/cpu%d/cpuidle/state%d/%s"
+
+#define SMALL_TASK_PCT	"/proc/sys/kernel/sched_small_task_pct"
+
+static unsigned int small_pct = 20;
+static unsigned int nr_threads = 8;
+static unsigned int period_us = 10000;
+static unsigned int work_us = 300;
+static unsigned int seconds = 10;
+static int use_worker = 1;
+
+static int nr_cpus;
+static double loops_per_us;
+static volatile int stop;
+
+struct idle_stats {
+	int nr_states;
+	uint64_t usage[MAX_CPUS];
+	uint64_t deep_usage[MAX_CPUS];
+	uint64_t deep_time[MAX_CPUS];
+};
+
+struct run_result {
+	struct idle_stats idle;
+	uint64_t wakeups_on[MAX_CPUS];
+	uint64_t nr_wakeups;
+	uint64_t total_late_ns;
+	uint64_t max_late_ns;
+	uint64_t worker_loops;
+};
+
+static struct run_result result;
+static pthread_mutex_t result_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int read_u64(const char *path, uint64_t *val)
+{
+	char buf[64];
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+	*val = strtoull(buf, NULL, 10);
+	return 0;
+}
+
+static int write_file(const char *path, const char *val)
+{
+	int fd = open(path, O_WRONLY);
+	ssize_t len = strlen(val);
+
+	if (fd < 0)
+		return -1;
+	if (write(fd, val, len) != len) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	return 0;
+}
+
+static void read_idle_stats(struct idle_stats *st)
+{
+	char path[128];
+	int cpu, state;
+
+	memset(st, 0, sizeof(*st));
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		for (state = 0; state < MAX_STATES; state++) {
+			uint64_t usage, time;
+
+			snprintf(path, sizeof(path), CPUIDLE_SYSFS, cpu, state,
+				 "usage");
+			if (read_u64(path, &usage))
+				break;
+			snprintf(path, sizeof(path), CPUIDLE_SYSFS, cpu, state,
+				 "time");
+			if (read_u64(path, &time))
+				time = 0;
+
+			st->usage[cpu] += usage;
+			st->deep_usage[cpu] = usage;
+			st->deep_time[cpu] = time;
+		}
+		if (state > st->nr_states)
+			st->nr_states = state;
+	}
+}
+
+static void busy_loop(double us)
+{
+	volatile unsigned long i;
+	unsigned long n = (unsigned long)(us * loops_per_us);
+
+	for (i = 0; i < n; i++)
+		;
+}
+
+static void calibrate(void)
+{
+	uint64_t t0, t1;
+	unsigned long n = 1000000;
+
+	for (;;) {
+		volatile unsigned long i;
+
+		t0 = now_ns();
+		for (i = 0; i < n; i++)
+			;
+		t1 = now_ns();
+		if (t1 - t0 > 50000000ULL)
+			break;
+		n *= 2;
+	}
+	loops_per_us = (double)n * 1000.0 / (double)(t1 - t0);
+}
+
+static void *periodic_thread(void *arg)
+{
+	uint64_t wakeups_on[MAX_CPUS] = { 0 };
+	uint64_t nr = 0, total_late = 0, max_late = 0;
+	struct timespec next;
+	int cpu;
+
+	(void)arg;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop) {
+		uint64_t expected, late;
+
+		next.tv_nsec += period_us * 1000L;
+		while (next.tv_nsec >= 1000000000L) {
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+				    NULL))
+			continue;
+
+		expected = (uint64_t)next.tv_sec * 1000000000ULL +
+			next.tv_nsec;
+		late = now_ns() - expected;
+		total_late += late;
+		if (late > max_late)
+			max_late = late;
+
+		cpu = sched_getcpu();
+		if (cpu >= 0 && cpu < MAX_CPUS)
+			wakeups_on[cpu]++;
+		nr++;
+
+		busy_loop(work_us);
+	}
+
+	pthread_mutex_lock(&result_lock);
+	for (cpu = 0; cpu < MAX_CPUS; cpu++)
+		result.wakeups_on[cpu] += wakeups_on[cpu];
+	result.nr_wakeups += nr;
+	result.total_late_ns += total_late;
+	if (max_late > result.max_late_ns)
+		result.max_late_ns = max_late;
+	pthread_mutex_unlock(&result_lock);
+	return NULL;
+}
+
+static void *worker_thread(void *arg)
+{
+	volatile unsigned long loops = 0;
+	cpu_set_t set;
+
+	(void)arg;
+	CPU_ZERO(&set);
+	CPU_SET(nr_cpus - 1, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+
+	while (!stop)
+		loops++;
+
+	pthread_mutex_lock(&result_lock);
+	result.worker_loops = loops;
+	pthread_mutex_unlock(&result_lock);
+	return NULL;
+}
+
+static int set_packing(unsigned int pct)
+{
+	char val[16];
+
+	snprintf(val, sizeof(val), "%u", pct);
+	return write_file(SMALL_TASK_PCT, val);
+}
+
+static int run(struct run_result *res)
+{
+	pthread_t threads[MAX_THREADS], worker;
+	struct idle_stats before;
+	unsigned int i;
+
+	memset(&result, 0, sizeof(result));
+	stop = 0;
+
+	read_idle_stats(&before);
+	if (use_worker && pthread_create(&worker, NULL, worker_thread, NULL))
+		return -1;
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&threads[i], NULL, periodic_thread, NULL))
+			return -1;
+
+	sleep(seconds);
+	stop = 1;
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	if (use_worker)
+		pthread_join(worker, NULL);
+	read_idle_stats(&result.idle);
+
+	for (i = 0; i < (unsigned int)nr_cpus; i++) {
+		result.idle.usage[i] -= before.usage[i];
+		result.idle.deep_usage[i] -= before.deep_usage[i];
+		result.idle.deep_time[i] -= before.deep_time[i];
+	}
+	*res = result;
+	return 0;
+}
+
+static void report(const char *name, struct run_result *res,
+		   struct run_result *base)
+{
+	int cpu;
+
+	printf("%s:\n", name);
+	printf("  cpu  idle exits/s  deep entries/s  deep residency  "
+	       "periodic wakeups\n");
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		double deep_pct = res->idle.deep_time[cpu] /
+			(seconds * 10000.0);
+
+		printf("  %3d  %12.1f  %14.1f  %13.1f%%  %16llu\n", cpu,
+		       (double)res->idle.usage[cpu] / seconds,
+		       (double)res->idle.deep_usage[cpu] / seconds,
+		       res->idle.nr_states ? deep_pct : 0.0,
+		       (unsigned long long)res->wakeups_on[cpu]);
+	}
+	if (res->nr_wakeups)
+		printf("  wakeup lateness: avg %.1f us, max %.1f us\n",
+		       res->total_late_ns / 1000.0 / res->nr_wakeups,
+		       res->max_late_ns / 1000.0);
+	if (use_worker) {
+		printf("  worker: %.2f Mloops/s", res->worker_loops /
+		       (seconds * 1000000.0));
+		if (base && base->worker_loops)
+			printf(" (%+.2f%%)", 100.0 *
+			       ((double)res->worker_loops - base->worker_loops) /
+			       base->worker_loops);
+		printf("\n");
+	}
+	if (!res->idle.nr_states)
+		printf("  (no cpuidle statistics available)\n");
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t threads] [-p period us] [-w work us] "
+		"[-s seconds] [-b 0|1] [-u small task %%]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct run_result nopack, pack;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:p:w:s:b:u:")) != -1) {
+		switch (opt) {
+		case 't':
+			nr_threads = atoi(optarg);
+			break;
+		case 'p':
+			period_us = atoi(optarg);
+			break;
+		case 'w':
+			work_us = atoi(optarg);
+			break;
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'b':
+			use_worker = atoi(optarg);
+			break;
+		case 'u':
+			small_pct = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!nr_threads || nr_threads > MAX_THREADS || !period_us ||
+	    !seconds || work_us >= period_us || !small_pct || small_pct > 100)
+		usage(argv[0]);
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_cpus < 1)
+		nr_cpus = 1;
+	if (nr_cpus > MAX_CPUS)
+		nr_cpus = MAX_CPUS;
+
+	calibrate();
+	printf("%u threads, %u us every %u us, %s, %u s per run\n",
+	       nr_threads, work_us, period_us,
+	       use_worker ? "one busy worker" : "no worker", seconds);
+
+	if (set_packing(0)) {
+		fprintf(stderr, "cannot write %s, "
+			"running with the current setting only\n", SMALL_TASK_PCT);
+		if (run(&nopack))
+			return 1;
+		report("current", &nopack, NULL);
+		return 0;
+	}
+
+	if (run(&nopack))
+		return 1;
+	report("packing off", &nopack, NULL);
+
+	if (set_packing(small_pct))
+		return 1;
+	if (run(&pack)) {
+		set_packing(0);
+		return 1;
+	}
+	set_packing(0);
+	report("packing on", &pack, &nopack);
+	return 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * zram_bench: swap-out throughput to zram against the number of cores
+ *
+ * Sets /dev/zram0 up as the highest priority swap device, pins most of
+ * the free memory with an mlock()ed balloon, and then has 1, 2, ... N
+ * threads, each pinned to its own cpu, fill their share of a working set
+ * larger than what is left. Nearly every page they touch has to be
+ * compressed and swapped out to zram, so the rate of pswpout during the
+ * fill shows how swap-out compression scales with the number of writers.
+ *
+ * Pages are filled with partly random, partly repeated data, so that they
+ * compress about like real anonymous memory and are not elided as
+ * same-filled pages.
+ *
+ * If /dev/zram0 already is an active swap device it is used as it is,
+ * otherwise it is initialised here and reset at the end. Needs root; it
+ * is not part of run_tests, use "make run_zram_bench".
+ *
+ * Usage: zram_bench [-s working set MB] [-l MB left free] [-t max threads]
+ *		     [-c compression streams]
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/swap.h>
+
+#define ZRAM_DEV	"/dev/zram0"
+#define ZRAM_SYSFS	"/sys/block/zram0/"
+#define MAX_THREADS	64
+
+static unsigned int set_mb = 256;
+static unsigned int left_mb;
+static unsigned int max_threads;
+static unsigned int nr_streams;
+
+static long page_size;
+static int own_swap;
+static char *balloon;
+static size_t balloon_len;
+
+static int cpus[MAX_THREADS];
+static int nr_cpus;
+
+static pthread_barrier_t start_barrier, done_barrier;
+
+struct worker {
+	pthread_t thread;
+	int cpu;
+	size_t len;
+	uint64_t seed;
+	double done;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+	perror(what);
+	exit(1);
+}
+
+static int write_file(const char *path, const char *val)
+{
+	int fd = open(path, O_WRONLY);
+	ssize_t len = strlen(val);
+
+	if (fd < 0)
+		return -1;
+	if (write(fd, val, len) != len) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	return 0;
+}
+
+static long long read_ll(const char *path)
+{
+	char buf[64];
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+	return atoll(buf);
+}
+
+/* value of a "name value" line in /proc/meminfo or /proc/vmstat */
+static long long read_stat(const char *path, const char *name)
+{
+	char line[128];
+	size_t len = strlen(name);
+	long long val = -1;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (!strncmp(line, name, len) &&
+		    (line[len] == ' ' || line[len] == ':')) {
+			val = atoll(line + len + 1);
+			break;
+		}
+	}
+	fclose(f);
+	return val;
+}
+
+static int zram_is_swap(void)
+{
+	char line[256];
+	int found = 0;
+	FILE *f;
+
+	f = fopen("/proc/swaps", "r");
+	if (!f)
+		return 0;
+	while (fgets(line, sizeof(line), f))
+		if (!strncmp(line, ZRAM_DEV " ", strlen(ZRAM_DEV) + 1))
+			found = 1;
+	fclose(f);
+	return found;
+}
+
+/* version 1 swap header, as mkswap writes it */
+static void write_swap_header(unsigned long long disksize)
+{
+	char *page;
+	uint32_t *info;
+	int fd;
+
+	page = calloc(1, page_size);
+	if (!page)
+		die("calloc");
+	info = (uint32_t *)(page + 1024);
+	info[0] = 1;				/* version */
+	info[1] = disksize / page_size - 1;	/* last_page */
+	info[2] = 0;				/* nr_badpages */
+	memcpy(page + page_size - 10, "SWAPSPACE2", 10);
+
+	fd = open(ZRAM_DEV, O_WRONLY);
+	if (fd < 0)
+		die(ZRAM_DEV);
+	if (pwrite(fd, page, page_size, 0) != page_size)
+		die("write swap header");
+	fsync(fd);
+	close(fd);
+	free(page);
+}
+
+static void setup_zram(void)
+{
+	unsigned long long disksize = (unsigned long long)set_mb << 21;
+	char val[32];
+
+	if (zram_is_swap()) {
+		printf("using %s as it is set up\n", ZRAM_DEV);
+		return;
+	}
+	if (read_ll(ZRAM_SYSFS "initstate") == 1) {
+		printf("%s is in use, skipping\n", ZRAM_DEV);
+		exit(0);
+	}
+
+	snprintf(val, sizeof(val), "%u", nr_streams);
+	if (write_file(ZRAM_SYSFS "max_comp_streams", val))
+		fprintf(stderr, "cannot set max_comp_streams\n");
+	snprintf(val, sizeof(val), "%llu", disksize);
+	if (write_file(ZRAM_SYSFS "disksize", val))
+		die("disksize");
+	write_swap_header(disksize);
+	if (swapon(ZRAM_DEV, SWAP_FLAG_PREFER | SWAP_FLAG_PRIO_MASK))
+		die("swapon");
+	own_swap = 1;
+}
+
+static void cleanup_zram(void)
+{
+	if (!own_swap)
+		return;
+	if (swapoff(ZRAM_DEV))
+		perror("swapoff");
+	write_file(ZRAM_SYSFS "reset", "1");
+}
+
+/*
+ * Pin all but left_mb of the free and easily reclaimed memory, so that
+ * the working set cannot be made room for by dropping page cache and
+ * has to swap.
+ */
+static void inflate_balloon(void)
+{
+	long long free_kb = read_stat("/proc/meminfo", "MemFree") +
+			    read_stat("/proc/meminfo", "Buffers") +
+			    read_stat("/proc/meminfo", "Cached") -
+			    read_stat("/proc/meminfo", "Shmem");
+	size_t off, chunk = 16 << 20;
+
+	if (free_kb < 0 || (unsigned long long)free_kb <= left_mb * 1024ULL)
+		return;
+	balloon_len = (free_kb - left_mb * 1024ULL) << 10;
+	balloon = mmap(NULL, balloon_len, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (balloon == MAP_FAILED)
+		die("mmap balloon");
+	for (off = 0; off < balloon_len; off += chunk) {
+		size_t len = balloon_len - off < chunk ? balloon_len - off :
+			     chunk;
+
+		if (mlock(balloon + off, len))
+			break;
+	}
+	printf("balloon: %zu MB locked, about %u MB left\n", off >> 20,
+	       left_mb);
+}
+
+static uint64_t next_rand(uint64_t *x)
+{
+	*x ^= *x << 13;
+	*x ^= *x >> 7;
+	*x ^= *x << 17;
+	return *x;
+}
+
+static void fill_page(uint64_t *p, uint64_t *seed)
+{
+	size_t i, words = page_size / sizeof(*p);
+
+	/* a quarter random, the rest a repeated pattern */
+	for (i = 0; i < words; i++)
+		p[i] = (i & 3) ? 0x6162636465666768ULL + (i & 15) :
+			next_rand(seed);
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	cpu_set_t set;
+	size_t off;
+	char *buf;
+
+	CPU_ZERO(&set);
+	CPU_SET(w->cpu, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+
+	buf = mmap(NULL, w->len, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED)
+		die("mmap");
+
+	pthread_barrier_wait(&start_barrier);
+	for (off = 0; off < w->len; off += page_size)
+		fill_page((uint64_t *)(buf + off), &w->seed);
+	w->done = now();
+
+	/* keep the pages until the zram statistics have been read */
+	pthread_barrier_wait(&done_barrier);
+	pthread_barrier_wait(&done_barrier);
+	munmap(buf, w->len);
+	return NULL;
+}
+
+/*
+ * Returns the swap-out MB/s of one fill of the working set by n threads,
+ * and in *ratio how well the data that went to zram compressed.
+ */
+static double run(unsigned int n, double *ratio)
+{
+	struct worker workers[MAX_THREADS];
+	long long pswpout, orig, compr;
+	double start, end = 0;
+	unsigned int i;
+
+	pthread_barrier_init(&start_barrier, NULL, n + 1);
+	pthread_barrier_init(&done_barrier, NULL, n + 1);
+	for (i = 0; i < n; i++) {
+		workers[i].cpu = cpus[i % nr_cpus];
+		workers[i].len = ((size_t)set_mb << 20) / n;
+		workers[i].len -= workers[i].len % page_size;
+		workers[i].seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+		if (pthread_create(&workers[i].thread, NULL, worker_fn,
+				   &workers[i]))
+			die("pthread_create");
+	}
+
+	pswpout = read_stat("/proc/vmstat", "pswpout");
+	pthread_barrier_wait(&start_barrier);
+	start = now();
+
+	pthread_barrier_wait(&done_barrier);
+	pswpout = read_stat("/proc/vmstat", "pswpout") - pswpout;
+	orig = read_ll(ZRAM_SYSFS "orig_data_size");
+	compr = read_ll(ZRAM_SYSFS "compr_data_size");
+	*ratio = compr > 0 ? (double)orig / compr : 0;
+	pthread_barrier_wait(&done_barrier);
+
+	for (i = 0; i < n; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].done > end)
+			end = workers[i].done;
+	}
+	pthread_barrier_destroy(&start_barrier);
+	pthread_barrier_destroy(&done_barrier);
+
+	return pswpout * page_size / 1048576.0 / (end - start);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s working set MB] [-l MB left free] "
+		"[-t max threads] [-c compression streams]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	double base = 0, mbs, ratio;
+	cpu_set_t set;
+	unsigned int n;
+	int cpu, opt;
+
+	/* the cpus we may run on, which need not be numbered from 0 */
+	if (sched_getaffinity(0, sizeof(set), &set))
+		die("sched_getaffinity");
+	for (cpu = 0; cpu < CPU_SETSIZE && nr_cpus < MAX_THREADS; cpu++)
+		if (CPU_ISSET(cpu, &set))
+			cpus[nr_cpus++] = cpu;
+	page_size = sysconf(_SC_PAGESIZE);
+	max_threads = nr_cpus;
+	nr_streams = nr_cpus;
+
+	while ((opt = getopt(argc, argv, "s:l:t:c:")) != -1) {
+		switch (opt) {
+		case 's':
+			set_mb = atoi(optarg);
+			break;
+		case 'l':
+			left_mb = atoi(optarg);
+			break;
+		case 't':
+			max_threads = atoi(optarg);
+			break;
+		case 'c':
+			nr_streams = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!left_mb)
+		left_mb = set_mb / 2;
+	if (!set_mb || !max_threads || max_threads > MAX_THREADS ||
+	    !nr_streams || left_mb >= set_mb)
+		usage(argv[0]);
+
+	if (geteuid()) {
+		printf("zram_bench: must be run as root, skipping\n");
+		return 0;
+	}
+	if (access(ZRAM_DEV, F_OK) || access(ZRAM_SYSFS, F_OK)) {
+		printf("zram_bench: no %s, skipping\n", ZRAM_DEV);
+		return 0;
+	}
+
+	setup_zram();
+	inflate_balloon();
+
+	printf("%u MB working set, %u compression streams\n", set_mb,
+	       nr_streams);
+	printf("threads  swap-out MB/s  per thread  speedup  ratio\n");
+	for (n = 1; n <= max_threads; n++) {
+		mbs = run(n, &ratio);
+		if (n == 1)
+			base = mbs;
+		printf("%7u  %13.1f  %10.1f  %6.2fx  %5.2f\n", n, mbs, mbs / n,
+		       base > 0 ? mbs / base : 0.0, ratio);
+	}
+
+	if (balloon)
+		munmap(balloon, balloon_len);
+	cleanup_zram();
+	return 0;
+}
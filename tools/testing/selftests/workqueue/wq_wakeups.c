@@ -0,0 +1,205 @@
+/*
+ * wq_wakeups: idle wakeups caused by periodic work on system_wq and on
+ * system_power_efficient_wq
+ *
+ * Uses the wq_power_bench module (CONFIG_WQ_POWER_BENCH) to keep one
+ * periodic delayed work per online cpu going, first on the per-cpu
+ * system_wq and then on system_power_efficient_wq. For each run it
+ * reports, per cpu, how often the cpu left idle (from cpuidle) and how
+ * often the work ran there.
+ *
+ * With workqueue.power_efficient off both runs behave the same; with it
+ * on the second run should wake fewer idle cpus.
+ *
+ * Needs root, debugfs and the module loaded.
+ *
+ * Usage: wq_wakeups [-s seconds] [-d debugfs dir]
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_CPUS	64
+#define MAX_STATES	16
+#define CPUIDLE_SYSFS	"/sys/devices/system/cpu/cpu%d/cpuidle/state%d/usage"
+#define PE_PARAM	"/sys/module/workqueue/parameters/power_efficient"
+
+static const char *debugfs_dir = "/sys/kernel/debug";
+static unsigned int seconds = 10;
+static int nr_cpus;
+
+struct run_result {
+	int have_idle;
+	uint64_t idle_exits[MAX_CPUS];
+	uint64_t runs[MAX_CPUS];
+	uint64_t total_runs;
+};
+
+static int read_u64(const char *path, uint64_t *val)
+{
+	char buf[64];
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+	*val = strtoull(buf, NULL, 10);
+	return 0;
+}
+
+static int read_idle_exits(uint64_t *exits)
+{
+	char path[128];
+	int cpu, state, found = 0;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		exits[cpu] = 0;
+		for (state = 0; state < MAX_STATES; state++) {
+			uint64_t usage;
+
+			snprintf(path, sizeof(path), CPUIDLE_SYSFS, cpu, state);
+			if (read_u64(path, &usage))
+				break;
+			exits[cpu] += usage;
+			found = 1;
+		}
+	}
+	return found;
+}
+
+static int read_stats(struct run_result *res)
+{
+	char path[256], line[128];
+	unsigned long long val;
+	FILE *f;
+	int cpu;
+
+	snprintf(path, sizeof(path), "%s/wq_power_bench/stats", debugfs_dir);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "cpu%d: %llu", &cpu, &val) == 2 &&
+		    cpu >= 0 && cpu < MAX_CPUS)
+			res->runs[cpu] = val;
+		else if (sscanf(line, "ran: %llu", &val) == 1)
+			res->total_runs = val;
+	}
+	fclose(f);
+	return 0;
+}
+
+static int run(const char *mode, struct run_result *res)
+{
+	uint64_t before[MAX_CPUS];
+	char path[256], cmd[32];
+	ssize_t len;
+	int fd, cpu;
+
+	memset(res, 0, sizeof(*res));
+	snprintf(path, sizeof(path), "%s/wq_power_bench/run", debugfs_dir);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+
+	len = snprintf(cmd, sizeof(cmd), "%s %u", mode, seconds);
+	read_idle_exits(before);
+	if (write(fd, cmd, len) != len) {
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	res->have_idle = read_idle_exits(res->idle_exits);
+
+	for (cpu = 0; cpu < nr_cpus; cpu++)
+		res->idle_exits[cpu] -= before[cpu];
+	return read_stats(res);
+}
+
+static void report(const char *name, struct run_result *res)
+{
+	uint64_t total_exits = 0;
+	int cpu;
+
+	printf("%s:\n", name);
+	printf("  cpu  idle exits/s  work runs/s\n");
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		printf("  %3d  %12.1f  %11.1f\n", cpu,
+		       (double)res->idle_exits[cpu] / seconds,
+		       (double)res->runs[cpu] / seconds);
+		total_exits += res->idle_exits[cpu];
+	}
+	printf("  total  %10.1f  %11.1f\n", (double)total_exits / seconds,
+	       (double)res->total_runs / seconds);
+	if (!res->have_idle)
+		printf("  (no cpuidle statistics available)\n");
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-s seconds] [-d debugfs dir]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct run_result percpu, power;
+	char pe_buf[8] = "?";
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "s:d:")) != -1) {
+		switch (opt) {
+		case 's':
+			seconds = atoi(optarg);
+			break;
+		case 'd':
+			debugfs_dir = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!seconds)
+		usage(argv[0]);
+
+	nr_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	if (nr_cpus < 1)
+		nr_cpus = 1;
+	if (nr_cpus > MAX_CPUS)
+		nr_cpus = MAX_CPUS;
+
+	fd = open(PE_PARAM, O_RDONLY);
+	if (fd >= 0) {
+		if (read(fd, pe_buf, 1) != 1)
+			pe_buf[0] = '?';
+		close(fd);
+	}
+	printf("workqueue.power_efficient=%c, %u s per run\n", pe_buf[0],
+	       seconds);
+
+	if (run("percpu", &percpu)) {
+		fprintf(stderr, "cannot use %s/wq_power_bench, "
+			"is wq_power_bench loaded?\n", debugfs_dir);
+		return 1;
+	}
+	report("system_wq", &percpu);
+
+	if (run("power", &power))
+		return 1;
+	report("system_power_efficient_wq", &power);
+	return 0;
+}